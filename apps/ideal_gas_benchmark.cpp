@@ -0,0 +1,387 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/config.h"
+#include "core/histogram.h"
+#include "core/particle_container.h"
+#include "nlohmann/json.hpp"
+
+using idealgas::AdaptiveStepOptions;
+using idealgas::BroadphaseMode;
+using idealgas::Histogram;
+using idealgas::NeighborListOptions;
+using idealgas::NeighborListStats;
+using idealgas::ParticleContainer;
+using idealgas::PrecisionMode;
+using nlohmann::json;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The shipped configurations whose particle types are benchmarked, each a
+// different mix of radii, masses and speeds
+const vector<string> kConfigPaths = {
+    IDEALGAS_CONFIG_DIR "/visualizer/config.json",
+    IDEALGAS_CONFIG_DIR "/benchmark/config_scaling.json",
+    IDEALGAS_CONFIG_DIR "/test/config_test.json",
+    IDEALGAS_CONFIG_DIR "/benchmark/config_polydisperse.json"};
+// The configurations whose particle types are scaled up for the step
+// benchmarks, indices into kConfigPaths
+const vector<int64_t> kMixes = {0, 1};
+// The particle counts of the step benchmarks, and the values per step of the
+// histogram benchmarks
+const vector<int64_t> kParticleCounts = {1000, 10000, 100000, 1000000,
+                                         10000000};
+// The fractions of the container covered by particles, in thousandths
+const vector<int64_t> kDensities = {20, 200};
+// The pixel margin written into generated configurations
+const double kMargin = 100;
+// The seed of the generated configurations, so every run times the same
+// particles
+const uint64_t kSeed = 1;
+// The ratio of a circle's area to its squared radius
+const double kPi = 3.14159265358979323846;
+
+/**
+ * @brief Reads a JSON configuration file.
+ *
+ * @param path the path of the file
+ * @return the parsed json
+ */
+json ReadConfig(const string& path) {
+  std::ifstream input(path);
+  json config;
+  input >> config;
+  return config;
+}
+
+/**
+ * @brief Scales the particle types of a shipped configuration to a total
+ * particle count, keeping their proportions, and sizes a square container so
+ * that the particles cover a given fraction of it.
+ *
+ * @param mix the index of the configuration in kConfigPaths
+ * @param particle_count the total number of particles
+ * @param density the fraction of the container covered by particles
+ * @return the generated json configuration
+ */
+json MakeConfig(size_t mix, size_t particle_count, double density) {
+  json config = ReadConfig(kConfigPaths[mix]);
+  json& particles = config["container"]["particles"];
+
+  size_t shipped_count = 0;
+  for (const auto& type : particles) {
+    shipped_count += type["particle count"].get<size_t>();
+  }
+
+  // The expected area of a particle, as the radius is uniform in its range
+  double area = 0;
+  size_t assigned = 0;
+  size_t type_index = 0;
+  for (auto& type : particles) {
+    size_t count =
+        ++type_index == particles.size()
+            ? particle_count - assigned
+            : particle_count * type["particle count"].get<size_t>() /
+                  shipped_count;
+    assigned += count;
+    type["particle count"] = count;
+
+    double min_radius = type["min radius"].get<double>();
+    double max_radius = type["max radius"].get<double>();
+    area += count * kPi *
+            (min_radius * min_radius + min_radius * max_radius +
+             max_radius * max_radius) / 3;
+  }
+
+  // Invert the window to container size conversion of Configure
+  double side = std::sqrt(area / density);
+  config["window"]["width"] = std::to_string((size_t)((side + kMargin) * 4 / 3));
+  config["window"]["height"] = std::to_string((size_t)(side + 2 * kMargin));
+  config["window"]["margin"] = std::to_string((size_t)kMargin);
+  config["container"]["threads"] = 1;
+  config["container"]["seed"] = kSeed;
+  return config;
+}
+
+/**
+ * @brief Builds a container from the benchmark arguments: the configuration
+ * mix, the particle count and the density in thousandths.
+ *
+ * @param state the benchmark state holding the arguments
+ * @param container the container to configure
+ */
+void SetUpContainer(const benchmark::State& state,
+                    ParticleContainer& container) {
+  container.ConfigureFromJson(MakeConfig(state.range(0), state.range(1),
+                                         state.range(2) / 1000.0));
+}
+
+/**
+ * @brief Reports the particle count and density alongside the timings.
+ *
+ * @param state the benchmark state to report to
+ */
+void ReportParticles(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+  state.counters["particles"] = state.range(1);
+  state.counters["density"] = state.range(2) / 1000.0;
+}
+
+/**
+ * @brief Times one full step.
+ *
+ */
+void BM_Increment(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  for (auto _ : state) {
+    container.Increment();
+  }
+  ReportParticles(state);
+}
+
+/**
+ * @brief Times one full step split into adaptive sub-steps, either the same
+ * number for every species or only as many as each species needs.
+ *
+ */
+void BM_IncrementAdaptive(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  AdaptiveStepOptions options;
+  options.enabled = true;
+  options.per_species = state.range(3) != 0;
+  container.SetAdaptiveStepOptions(options);
+  for (auto _ : state) {
+    container.Increment();
+  }
+  ReportParticles(state);
+  state.counters["substeps"] = container.GetSubstepCount();
+}
+
+/**
+ * @brief Times one full step in single, mixed or double precision, and
+ * reports how far the kinetic energy drifted from that of the first step.
+ *
+ */
+void BM_IncrementPrecision(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  container.SetPrecisionMode((PrecisionMode)state.range(3));
+  container.Increment();
+  double initial_energy =
+      container.GetObservableHistory().back().kinetic_energy;
+  for (auto _ : state) {
+    container.Increment();
+  }
+  ReportParticles(state);
+  double final_energy = container.GetObservableHistory().back().kinetic_energy;
+  state.counters["precision"] = state.range(3);
+  state.counters["energy drift"] =
+      initial_energy > 0
+          ? std::abs(final_energy - initial_energy) / initial_energy
+          : 0;
+}
+
+/**
+ * @brief Times one full step with the neighbor list of the given skin, or
+ * without it for a skin of 0, and reports how often it was rebuilt and how
+ * large it grew.
+ *
+ */
+void BM_IncrementNeighborList(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  NeighborListOptions options;
+  options.enabled = state.range(3) > 0;
+  options.skin = (float)state.range(3);
+  container.SetNeighborListOptions(options);
+  for (auto _ : state) {
+    container.Increment();
+  }
+  ReportParticles(state);
+  const NeighborListStats& stats = container.GetNeighborListStats();
+  state.counters["skin"] = state.range(3);
+  state.counters["builds per pass"] =
+      stats.passes > 0 ? (double)stats.builds / stats.passes : 0;
+  state.counters["pairs"] = stats.pair_count;
+  state.counters["list bytes"] = stats.memory_bytes;
+}
+
+/**
+ * @brief Times the particle collision half of a step.
+ *
+ */
+void BM_IncrementParticleCollisions(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  for (auto _ : state) {
+    container.IncrementParticleCollisions();
+  }
+  ReportParticles(state);
+}
+
+/**
+ * @brief Times the particle collision half of a step with a uniform grid or
+ * with a grid per size of radius, whose gain grows with the spread of radii.
+ *
+ */
+void BM_IncrementParticleCollisionsBroadphase(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  container.SetBroadphaseMode((BroadphaseMode)state.range(3));
+  for (auto _ : state) {
+    container.IncrementParticleCollisions();
+  }
+  ReportParticles(state);
+}
+
+/**
+ * @brief Times the wall collision and integration half of a step.
+ *
+ */
+void BM_IncrementWallCollisions(benchmark::State& state) {
+  ParticleContainer container;
+  SetUpContainer(state, container);
+  for (auto _ : state) {
+    container.IncrementWallCollisions();
+  }
+  ReportParticles(state);
+}
+
+/**
+ * @brief Times turning a histogram's counts into bin heights, which should
+ * not depend on the number of values.
+ *
+ */
+void BM_CalculateFrequencies(benchmark::State& state) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> speed_dist(0, 20);
+  Histogram histogram("Speeds", 10);
+  for (int64_t index = 0; index < state.range(0); ++index) {
+    histogram.Update(speed_dist(gen));
+  }
+  for (auto _ : state) {
+    histogram.CalculateFrequencies();
+    benchmark::DoNotOptimize(histogram.GetBinHeights());
+  }
+}
+
+/**
+ * @brief Times binning one step's worth of speeds into a windowed histogram.
+ *
+ */
+void BM_HistogramUpdate(benchmark::State& state) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> speed_dist(0, 20);
+  vector<float> speeds(state.range(0));
+  for (float& speed : speeds) {
+    speed = speed_dist(gen);
+  }
+  Histogram histogram("Speeds", 10, 600);
+  for (auto _ : state) {
+    for (float speed : speeds) {
+      histogram.Update(speed);
+    }
+    histogram.EndStep();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/**
+ * @brief Times parsing a shipped configuration file and creating its
+ * particles.
+ *
+ */
+void BM_Configure(benchmark::State& state) {
+  for (auto _ : state) {
+    ParticleContainer container;
+    container.Configure(kConfigPaths[state.range(0)]);
+    benchmark::DoNotOptimize(container.GetParticles().size());
+  }
+  state.SetLabel(kConfigPaths[state.range(0)]);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Increment)
+    ->ArgNames({"mix", "particles", "density"})
+    ->ArgsProduct({kMixes, kParticleCounts, kDensities})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementAdaptive)
+    ->ArgNames({"mix", "particles", "density", "per species"})
+    ->ArgsProduct({{1}, {1000, 10000, 100000, 1000000}, {20}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementPrecision)
+    ->ArgNames({"mix", "particles", "density", "precision"})
+    ->ArgsProduct({{1}, {10000, 100000, 1000000}, kDensities, {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementNeighborList)
+    ->ArgNames({"mix", "particles", "density", "skin"})
+    ->ArgsProduct({{1}, {10000, 100000, 1000000}, kDensities, {0, 1, 2, 4}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementParticleCollisions)
+    ->ArgNames({"mix", "particles", "density"})
+    ->ArgsProduct({kMixes, kParticleCounts, kDensities})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementParticleCollisionsBroadphase)
+    ->ArgNames({"mix", "particles", "density", "broadphase"})
+    ->ArgsProduct({{1, 3},
+                   {10000, 100000, 1000000},
+                   kDensities,
+                   {(int64_t)BroadphaseMode::kGrid,
+                    (int64_t)BroadphaseMode::kHierarchicalGrid}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IncrementWallCollisions)
+    ->ArgNames({"mix", "particles", "density"})
+    ->ArgsProduct({kMixes, kParticleCounts, kDensities})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CalculateFrequencies)
+    ->ArgNames({"values"})
+    ->ArgsProduct({kParticleCounts})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HistogramUpdate)
+    ->ArgNames({"values"})
+    ->ArgsProduct({kParticleCounts})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Configure)
+    ->ArgNames({"config"})
+    ->DenseRange(0, kConfigPaths.size() - 1)
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Runs the benchmarks, printing JSON unless another format is asked
+ * for, so that results can be compared between releases. Any Google Benchmark
+ * flag is accepted, e.g. --benchmark_filter=Increment/0/1000/ or
+ * --benchmark_out=results.json.
+ *
+ * Usage: ideal-gas-bench [benchmark flags]
+ */
+int main(int argc, char** argv) {
+  vector<char*> args(argv, argv + argc);
+  bool has_format = false;
+  for (char* arg : args) {
+    has_format |= std::strncmp(arg, "--benchmark_format", 18) == 0;
+  }
+  char json_format[] = "--benchmark_format=json";
+  if (!has_format) {
+    args.insert(args.begin() + 1, json_format);
+  }
+
+  int arg_count = args.size();
+  benchmark::Initialize(&arg_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(arg_count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
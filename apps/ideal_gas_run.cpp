@@ -0,0 +1,584 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/checkpoint.h"
+#include "core/config.h"
+#include "core/ensemble.h"
+#include "core/image_writer.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/software_renderer.h"
+#include "core/sweep.h"
+#include "core/trajectory.h"
+
+using idealgas::CheckpointTimer;
+using idealgas::Ensemble;
+using idealgas::EnsembleOptions;
+using idealgas::EnsembleResult;
+using idealgas::Estimate;
+using idealgas::LoadConfig;
+using idealgas::NeighborListStats;
+using idealgas::Observables;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::PrecisionMode;
+using idealgas::RingBuffer;
+using idealgas::SimulationConfig;
+using idealgas::SoftwareRenderer;
+using idealgas::SpeedDistribution;
+using idealgas::Sweep;
+using idealgas::SweepResult;
+using idealgas::TrajectoryOptions;
+using idealgas::TrajectoryWriter;
+using idealgas::WritePng;
+using idealgas::WritePpm;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The number of steps run when neither a step count nor a time is given
+const size_t kDefaultSteps = 1000;
+
+/**
+ * @brief The totals of one particle species.
+ *
+ */
+struct SpeciesStatistics {
+  size_t count = 0;
+  double speed_sum = 0;
+  double kinetic_energy = 0;
+};
+
+/**
+ * @brief Prints the usage message.
+ *
+ * @param program the name the program was run as
+ */
+void PrintUsage(const char* program) {
+  std::fprintf(stderr,
+               "Usage: %s <config path> [--steps N | --time T] "
+               "[--threads N] [--restart PATH] [--checkpoint PATH] "
+               "[--checkpoint-every SECONDS] [--trajectory PATH] "
+               "[--trajectory-stride N] [--frames DIRECTORY] "
+               "[--frame-stride N] [--frame-format png|ppm]\n"
+               "       %s <config path> --replicas N [--steps N | --time T] "
+               "[--threads N] [--warmup N] [--sample-stride N] [--bins N]\n"
+               "       %s <config path> --sweep PATH [--steps N] "
+               "[--threads N] [--table PATH]\n",
+               program, program, program);
+}
+
+/**
+ * @brief Names a precision mode as the configuration spells it.
+ *
+ * @param mode the precision mode
+ * @return the name of the mode
+ */
+const char* PrecisionName(PrecisionMode mode) {
+  switch (mode) {
+    case PrecisionMode::kMixed:
+      return "mixed";
+    case PrecisionMode::kDouble:
+      return "double";
+    default:
+      return "single";
+  }
+}
+
+/**
+ * @brief Prints the count, mean speed and kinetic energy of each species, and
+ * the total kinetic energy and momentum of every particle.
+ *
+ * @param particles the particles to summarize
+ */
+void PrintStatistics(const ParticleStore& particles) {
+  vector<SpeciesStatistics> species(particles.GetSpeciesNames().size());
+  double kinetic_energy = 0;
+  double momentum[ParticleStore::kMaxDimensions] = {0, 0, 0};
+  size_t dimensions = particles.GetDimensions();
+
+  for (size_t index = 0; index < particles.size(); ++index) {
+    float mass = particles.GetMasses()[index];
+    float speed = particles.GetSpeed(index);
+    float squared_speed = 0;
+    for (size_t axis = 0; axis < dimensions; ++axis) {
+      float velocity = particles.GetVelocities(axis)[index];
+      squared_speed += velocity * velocity;
+      momentum[axis] += mass * velocity;
+    }
+    double energy = 0.5 * mass * squared_speed;
+
+    SpeciesStatistics& totals = species[particles.GetSpecies()[index]];
+    ++totals.count;
+    totals.speed_sum += speed;
+    totals.kinetic_energy += energy;
+
+    kinetic_energy += energy;
+  }
+
+  for (size_t id = 0; id < species.size(); ++id) {
+    const SpeciesStatistics& totals = species[id];
+    double mean_speed =
+        totals.count > 0 ? totals.speed_sum / totals.count : 0;
+    std::printf("  %-28s count %8zu  mean speed %10.4f  "
+                "kinetic energy %14.4f\n",
+                particles.GetSpeciesName(id).c_str(), totals.count, mean_speed,
+                totals.kinetic_energy);
+  }
+  std::printf("total kinetic energy  %.6g\n", kinetic_energy);
+  if (dimensions == 3) {
+    std::printf("total momentum        (%.6g, %.6g, %.6g)\n", momentum[0],
+                momentum[1], momentum[2]);
+  } else {
+    std::printf("total momentum        (%.6g, %.6g)\n", momentum[0],
+                momentum[1]);
+  }
+}
+
+/**
+ * @brief Prints the temperature of each species after the last step, and the
+ * wall pressure averaged over the steps in the history.
+ *
+ * @param history the observables of the most recent steps
+ * @param particles the particles, for their species names
+ */
+void PrintObservables(const RingBuffer<Observables>& history,
+                      const ParticleStore& particles) {
+  if (history.empty()) {
+    return;
+  }
+
+  const Observables& last = history.back();
+  for (size_t id = 0; id < last.temperatures.size(); ++id) {
+    std::printf("  %-28s temperature %14.6g\n",
+                particles.GetSpeciesName(id).c_str(), last.temperatures[id]);
+  }
+
+  double pressure_sum = 0;
+  for (size_t step = 0; step < history.size(); ++step) {
+    pressure_sum += history[step].pressure;
+  }
+  std::printf("mean pressure         %.6g (last %zu steps)\n",
+              pressure_sum / history.size(), history.size());
+}
+
+/**
+ * @brief Prints the speed distribution of each species, averaged over an
+ * ensemble, beside the Maxwell-Boltzmann distribution, and the temperatures,
+ * pressure and energy with their confidence intervals.
+ *
+ * @param result the merged statistics of the ensemble
+ */
+void PrintEnsemble(const EnsembleResult& result) {
+  for (size_t id = 0; id < result.speeds.size(); ++id) {
+    const SpeedDistribution& speeds = result.speeds[id];
+    const Estimate& temperature = result.temperatures[id];
+    std::printf("  %-28s temperature %14.6g +- %.3g\n", speeds.title.c_str(),
+                temperature.mean, temperature.half_width);
+    std::printf("    %12s  %12s  %10s  %12s\n", "speed below", "fraction",
+                "+-", "expected");
+    for (size_t bin = 0; bin < speeds.bin_cutoffs.size(); ++bin) {
+      std::printf("    %12.4g  %12.6f  %10.6f  %12.6f\n",
+                  speeds.bin_cutoffs[bin], speeds.fractions[bin].mean,
+                  speeds.fractions[bin].half_width,
+                  speeds.maxwell_boltzmann[bin]);
+    }
+    std::printf("    %12s  %12.6f  %10.6f\n", "above", speeds.overflow.mean,
+                speeds.overflow.half_width);
+  }
+  std::printf("mean pressure         %.6g +- %.3g\n", result.pressure.mean,
+              result.pressure.half_width);
+  std::printf("mean kinetic energy   %.6g +- %.3g\n",
+              result.kinetic_energy.mean, result.kinetic_energy.half_width);
+}
+
+/**
+ * @brief Runs an ensemble of independent replicas of a configuration and
+ * prints their merged statistics.
+ *
+ * @param config_path the path of the configuration file
+ * @param options the EnsembleOptions
+ * @return the exit status
+ */
+int RunEnsemble(const char* config_path, const EnsembleOptions& options) {
+  std::unique_ptr<Ensemble> ensemble;
+  try {
+    std::ifstream input(config_path);
+    json config;
+    input >> config;
+    ensemble = std::make_unique<Ensemble>(config, options);
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "Could not load %s: %s\n", config_path, error.what());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  EnsembleResult result = ensemble->Run();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::printf("replicas              %zu\n", result.replicas);
+  std::printf("seed                  %llu\n", (unsigned long long)result.seed);
+  std::printf("steps                 %zu (%zu warmup, sampled every %zu)\n",
+              options.steps, options.warmup_steps, options.sample_stride);
+  std::printf("wall time             %.3f s\n", elapsed.count());
+  std::printf("species\n");
+  PrintEnsemble(result);
+  return 0;
+}
+
+/**
+ * @brief Runs every job of a sweep and writes the table of results.
+ *
+ * @param config_path the path of the configuration file
+ * @param sweep_path the path of the sweep specification
+ * @param steps the steps each job takes, or 0 for the specification's
+ * @param thread_count the number of jobs run at once, or 0 for every
+ * hardware thread
+ * @param table_path the path of the CSV table, or empty to print it
+ * @return the exit status
+ */
+int RunSweep(const char* config_path, const string& sweep_path, size_t steps,
+             size_t thread_count, const string& table_path) {
+  std::unique_ptr<Sweep> sweep;
+  try {
+    std::ifstream config_input(config_path);
+    json config;
+    config_input >> config;
+    std::ifstream sweep_input(sweep_path);
+    json spec;
+    sweep_input >> spec;
+    sweep = std::make_unique<Sweep>(config, spec);
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "Could not load the sweep: %s\n", error.what());
+    return 1;
+  }
+  if (steps > 0) {
+    sweep->SetSteps(steps);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  vector<SweepResult> results = sweep->Run(thread_count);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (table_path.empty()) {
+    sweep->WriteTable(std::cout, results);
+  } else {
+    std::ofstream table(table_path);
+    sweep->WriteTable(table, results);
+    if (!table) {
+      std::fprintf(stderr, "Could not write %s\n", table_path.c_str());
+      return 1;
+    }
+  }
+
+  size_t failures = 0;
+  for (const SweepResult& result : results) {
+    failures += result.error.empty() ? 0 : 1;
+  }
+  std::fprintf(stderr, "%zu jobs (%zu failed) in %.3f s\n", results.size(),
+               failures, elapsed.count());
+  return failures > 0 ? 1 : 0;
+}
+
+}  // namespace
+
+/**
+ * @brief Runs the simulation described by a configuration file without a
+ * window, for a number of steps or a span of simulated time, then prints the
+ * throughput and the final statistics of the particles.
+ *
+ * A run can start from a checkpoint instead of the configured particles, and
+ * save checkpoints every so many seconds of wall time and once more at the
+ * end. The positions and velocities of every stride-th step can be streamed
+ * to a trajectory file, and every stride-th step can be drawn, as the
+ * visualizer draws it, to numbered image files in an existing directory. The
+ * checkpoint and trajectory settings of the configuration apply unless
+ * overridden.
+ *
+ * With --replicas, the configuration is instead run as an ensemble of
+ * independent replicas, spread across the threads, and the speed
+ * distribution of each species is printed with confidence intervals beside
+ * the Maxwell-Boltzmann distribution. The first half of each run is left to
+ * settle unless --warmup says otherwise.
+ *
+ * With --sweep, every job of a sweep specification (see Sweep) is run
+ * instead, several at once, and a CSV table of each job's settings,
+ * throughput and observables is printed or written to --table.
+ *
+ * Usage: ideal-gas-run <config path> [--steps N | --time T] [--threads N]
+ *            [--restart PATH] [--checkpoint PATH] [--checkpoint-every SECONDS]
+ *            [--trajectory PATH] [--trajectory-stride N]
+ *            [--frames DIRECTORY] [--frame-stride N] [--frame-format png|ppm]
+ *        ideal-gas-run <config path> --replicas N [--steps N | --time T]
+ *            [--threads N] [--warmup N] [--sample-stride N] [--bins N]
+ *        ideal-gas-run <config path> --sweep PATH [--steps N] [--threads N]
+ *            [--table PATH]
+ */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  size_t steps = kDefaultSteps;
+  double duration = -1;
+  long threads = -1;
+  string restart_path;
+  string checkpoint_path;
+  double checkpoint_interval = -1;
+  string trajectory_path;
+  TrajectoryOptions trajectory_options;
+  string frame_directory;
+  size_t frame_stride = 1;
+  string frame_format = "png";
+  size_t replicas = 0;
+  EnsembleOptions ensemble_options;
+  long warmup_steps = -1;
+  bool steps_given = false;
+  string sweep_path;
+  string table_path;
+  for (int arg = 2; arg < argc; ++arg) {
+    if (arg + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    if (std::strcmp(argv[arg], "--steps") == 0) {
+      steps = std::stoul(argv[++arg]);
+      steps_given = true;
+    } else if (std::strcmp(argv[arg], "--time") == 0) {
+      duration = std::stod(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--threads") == 0) {
+      threads = std::stol(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--restart") == 0) {
+      restart_path = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--checkpoint") == 0) {
+      checkpoint_path = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--checkpoint-every") == 0) {
+      checkpoint_interval = std::stod(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--trajectory") == 0) {
+      trajectory_path = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--trajectory-stride") == 0) {
+      trajectory_options.stride = std::stoul(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--frames") == 0) {
+      frame_directory = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--frame-stride") == 0) {
+      frame_stride = std::max(std::stoul(argv[++arg]), 1ul);
+    } else if (std::strcmp(argv[arg], "--replicas") == 0) {
+      replicas = std::stoul(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--warmup") == 0) {
+      warmup_steps = std::stol(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--sample-stride") == 0) {
+      ensemble_options.sample_stride = std::stoul(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--bins") == 0) {
+      ensemble_options.bin_count = std::stoul(argv[++arg]);
+    } else if (std::strcmp(argv[arg], "--sweep") == 0) {
+      sweep_path = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--table") == 0) {
+      table_path = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--frame-format") == 0) {
+      frame_format = argv[++arg];
+      if (frame_format != "png" && frame_format != "ppm") {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  // Ensembles and sweeps run many containers and save nothing from any of
+  // them
+  bool saves = !restart_path.empty() || !checkpoint_path.empty() ||
+               !trajectory_path.empty() || !frame_directory.empty();
+  if (!sweep_path.empty()) {
+    if (saves || replicas > 0 || duration >= 0) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    return RunSweep(argv[1], sweep_path, steps_given ? steps : 0,
+                    threads >= 0 ? threads : 0, table_path);
+  }
+  if (replicas > 0) {
+    if (saves) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    ensemble_options.replicas = replicas;
+    ensemble_options.steps = steps;
+    ensemble_options.thread_count = threads >= 0 ? threads : 0;
+    if (duration >= 0) {
+      ensemble_options.steps =
+          (size_t)std::ceil(duration / ParticleContainer().GetTimeStep());
+    }
+    // The first half of each replica settles by default
+    ensemble_options.warmup_steps =
+        warmup_steps >= 0 ? warmup_steps : ensemble_options.steps / 2;
+    return RunEnsemble(argv[1], ensemble_options);
+  }
+
+  ParticleContainer container;
+  SimulationConfig config;
+  try {
+    config = LoadConfig(argv[1]);
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "Could not load %s: %s\n", argv[1], error.what());
+    return 1;
+  }
+  // A restart takes its particles from the checkpoint, so the configured
+  // ones are never generated or placed
+  SimulationConfig container_config = config;
+  if (!restart_path.empty()) {
+    if (!std::ifstream(restart_path).good()) {
+      std::fprintf(stderr, "Could not restart: could not open %s.\n",
+                   restart_path.c_str());
+      return 1;
+    }
+    container_config.resume_checkpoint = true;
+    container_config.checkpoint_path = restart_path;
+  }
+  try {
+    container.Configure(container_config);
+  } catch (const std::exception& error) {
+    if (restart_path.empty()) {
+      std::fprintf(stderr, "Could not load %s: %s\n", argv[1], error.what());
+    } else {
+      std::fprintf(stderr, "Could not restart: %s\n", error.what());
+    }
+    return 1;
+  }
+  if (checkpoint_path.empty()) {
+    checkpoint_path = config.checkpoint_path;
+  }
+  if (checkpoint_interval < 0) {
+    checkpoint_interval = config.checkpoint_interval_seconds;
+  }
+  CheckpointTimer checkpoint_timer(
+      checkpoint_path, checkpoint_path.empty() ? 0 : checkpoint_interval);
+  if (!trajectory_path.empty()) {
+    trajectory_options.dimensions = container.GetDimensions();
+    try {
+      container.SetTrajectoryWriter(std::make_shared<TrajectoryWriter>(
+          trajectory_path, trajectory_options));
+    } catch (const std::exception& error) {
+      std::fprintf(stderr, "Could not start the trajectory: %s\n",
+                   error.what());
+      return 1;
+    }
+  }
+  if (threads >= 0) {
+    container.SetThreadCount(threads);
+  }
+
+  // A span of simulated time is rounded up to whole steps
+  if (duration >= 0) {
+    steps = (size_t)std::ceil(duration / container.GetTimeStep());
+  }
+
+  // Frames are drawn with the simulation's threads, between steps
+  std::unique_ptr<SoftwareRenderer> renderer;
+  if (!frame_directory.empty()) {
+    renderer = std::make_unique<SoftwareRenderer>(
+        config, container.GetThreadCount());
+  }
+  size_t frame_count = 0;
+  std::chrono::duration<double> render_time(0);
+
+  // Read through a const reference, since writing would make the
+  // event-driven engine start over
+  const ParticleStore& particles = std::as_const(container).GetParticles();
+  size_t particle_count = particles.size();
+  auto start = std::chrono::steady_clock::now();
+  try {
+    for (size_t step = 0; step < steps; ++step) {
+      container.Increment();
+      checkpoint_timer.Update(container);
+
+      if (renderer) {
+        auto render_start = std::chrono::steady_clock::now();
+        renderer->UpdateHistograms(particles);
+        if (step % frame_stride == 0) {
+          renderer->Render(particles);
+          char name[32];
+          std::snprintf(name, sizeof(name), "/frame_%06zu.%s", frame_count++,
+                        frame_format.c_str());
+          if (frame_format == "png") {
+            WritePng(frame_directory + name, renderer->GetImage());
+          } else {
+            WritePpm(frame_directory + name, renderer->GetImage());
+          }
+        }
+        render_time += std::chrono::steady_clock::now() - render_start;
+      }
+    }
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "Could not save the run: %s\n", error.what());
+    return 1;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (!checkpoint_path.empty()) {
+    try {
+      container.SaveCheckpoint(checkpoint_path);
+    } catch (const std::exception& error) {
+      std::fprintf(stderr, "Could not save a checkpoint: %s\n", error.what());
+      return 1;
+    }
+  }
+
+  std::printf("particles             %zu\n", particle_count);
+  std::printf("dimensions            %zu\n", container.GetDimensions());
+  std::printf("precision             %s\n",
+              PrecisionName(container.GetPrecisionMode()));
+  std::printf("threads               %zu\n", container.GetThreadCount());
+  std::printf("seed                  %llu\n",
+              (unsigned long long)container.GetSeed());
+  std::printf("steps                 %zu\n", steps);
+  std::printf("simulated time        %.6g\n", container.GetSimulatedTime());
+  std::printf("wall time             %.3f s\n", elapsed.count());
+  std::printf("throughput            %.4g particle-steps/s\n",
+              elapsed.count() > 0 ? particle_count * steps / elapsed.count()
+                                  : 0.0);
+  if (renderer) {
+    std::printf("frames                %zu (%.3f s each)\n", frame_count,
+                frame_count > 0 ? render_time.count() / frame_count : 0.0);
+  }
+  if (container.GetNeighborListOptions().enabled) {
+    const NeighborListStats& stats = container.GetNeighborListStats();
+    std::printf("neighbor list         %zu builds in %zu passes, %zu pairs, "
+                "%.1f KiB\n",
+                stats.builds, stats.passes, stats.pair_count,
+                stats.memory_bytes / 1024.0);
+  }
+  std::shared_ptr<TrajectoryWriter> trajectory =
+      container.GetTrajectoryWriter();
+  if (trajectory) {
+    try {
+      trajectory->Close();
+    } catch (const std::exception& error) {
+      std::fprintf(stderr, "Could not finish the trajectory: %s\n",
+                   error.what());
+      return 1;
+    }
+    std::printf("trajectory frames     %zu (%zu stalls)\n",
+                trajectory->GetFrameCount(), trajectory->GetStallCount());
+  }
+  std::printf("species\n");
+  PrintStatistics(particles);
+  PrintObservables(container.GetObservableHistory(), particles);
+  return 0;
+}
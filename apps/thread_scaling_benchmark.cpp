@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/config.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The number of steps timed for each thread count
+const size_t kDefaultSteps = 100;
+
+/**
+ * @brief Hashes the final positions so that runs with different thread counts
+ * can be checked for identical results.
+ *
+ * @param particles the particles to hash
+ * @return the 64-bit FNV-1a hash of the position arrays
+ */
+uint64_t HashPositions(const ParticleStore& particles) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+    for (float component : particles.GetPositions(axis)) {
+      uint32_t bits;
+      std::memcpy(&bits, &component, sizeof(bits));
+      hash = (hash ^ bits) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+}  // namespace
+
+/**
+ * @brief Times ParticleContainer::Increment on one starting state at 1, 2, 4,
+ * ... threads up to the hardware thread count, and prints the throughput and
+ * speedup of each.
+ *
+ * Usage: ideal-gas-scaling-bench <config path> [steps]
+ */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s <config path> [steps]\n", argv[0]);
+    return 1;
+  }
+  size_t steps = argc > 2 ? std::stoul(argv[2]) : kDefaultSteps;
+
+  // Every run starts from the same particles so that their results match
+  ParticleContainer container;
+  container.Configure(argv[1]);
+  const ParticleStore initial_particles = container.GetParticles();
+
+  size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  std::printf("%zu particles, %zu steps\n", initial_particles.size(), steps);
+  std::printf("%8s %16s %10s %18s\n", "threads", "particle-steps/s", "speedup",
+              "position hash");
+
+  double serial_seconds = 0;
+  for (size_t threads : thread_counts) {
+    container.GetParticles() = initial_particles;
+    container.SetThreadCount(threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+      container.Increment();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (threads == 1) {
+      serial_seconds = elapsed.count();
+    }
+    std::printf("%8zu %16.4g %10.2f %18llx\n", threads,
+                initial_particles.size() * steps / elapsed.count(),
+                serial_seconds / elapsed.count(),
+                (unsigned long long)HashPositions(container.GetParticles()));
+  }
+  return 0;
+}
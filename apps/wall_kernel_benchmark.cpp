@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "core/wall_kernel.h"
+
+using idealgas::GetSimdLevelName;
+using idealgas::GetSupportedSimdLevel;
+using idealgas::ReflectAndIntegrate;
+using idealgas::SimdLevel;
+using std::vector;
+
+namespace {
+
+// The number of particles processed by each timed run, split into repeats
+const size_t kParticlesPerRun = 50000000;
+
+}  // namespace
+
+/**
+ * @brief Times the wall reflection and integration kernel at every supported
+ * instruction set over several particle counts, and prints the time per
+ * particle and the speedup over the scalar kernel.
+ *
+ * Usage: ideal-gas-wall-kernel-bench
+ */
+int main() {
+  std::printf("%10s %8s %14s %10s\n", "particles", "level", "ns/particle",
+              "speedup");
+
+  for (size_t count : {1000, 10000, 100000, 1000000}) {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> position_dist(0, 1000);
+    std::uniform_real_distribution<float> velocity_dist(-3, 3);
+    vector<float> x(count);
+    vector<float> y(count);
+    vector<float> velocity_x(count);
+    vector<float> velocity_y(count);
+    vector<float> radii(count, 4);
+    vector<uint8_t> wall_hits(count);
+    for (size_t index = 0; index < count; ++index) {
+      x[index] = position_dist(gen);
+      y[index] = position_dist(gen);
+      velocity_x[index] = velocity_dist(gen);
+      velocity_y[index] = velocity_dist(gen);
+    }
+
+    double scalar_seconds = 0;
+    for (SimdLevel level :
+         {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2}) {
+      if (level > GetSupportedSimdLevel()) {
+        continue;
+      }
+
+      size_t repeats = kParticlesPerRun / count;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t repeat = 0; repeat < repeats; ++repeat) {
+        ReflectAndIntegrate(level, x.data(), y.data(), velocity_x.data(),
+                            velocity_y.data(), radii.data(), count, 1000, 1000,
+                            1, wall_hits.data());
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      if (level == SimdLevel::kScalar) {
+        scalar_seconds = elapsed.count();
+      }
+      std::printf("%10zu %8s %14.3f %10.2f\n", count,
+                  GetSimdLevelName(level).c_str(),
+                  elapsed.count() * 1e9 / (repeats * count),
+                  scalar_seconds / elapsed.count());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,316 @@
+#pragma once
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/particle_store.h"
+#include "glm/glm.hpp"
+
+using glm::vec3;
+using idealgas::ParticleStore;
+using std::array;
+using std::pair;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The CellGrid class is a uniform-grid broadphase for particle
+ * collisions. Particles are binned by counting sort into contiguous per-cell
+ * ranges, with cells sized from the largest radius so that every overlapping
+ * pair lies in the same or an adjacent cell.
+ *
+ * Cells are also split into colors by their row and column modulo three, and
+ * by their layer in three dimensions. The pairs visited from two cells of the
+ * same color never share a particle, so the cells of one color can be
+ * resolved in parallel.
+ *
+ * Along a periodic axis the grid spans the whole period, and the cells at
+ * either end are neighbors across the seam. The cell count along that axis
+ * is a multiple of three, so the colors still alternate across the seam.
+ *
+ */
+class CellGrid {
+ public:
+  // The most cell colors, from a three by three by three checkerboard
+  static constexpr size_t kColorCount = 27;
+
+  /**
+   * @brief Bins the given particles into cells, sizing the grid to the
+   * particles' bounding box and the largest radius present. Particles with a
+   * z axis are binned into layers as well.
+   *
+   * @param particles the store of particles to bin
+   */
+  void Build(const ParticleStore& particles);
+
+  /**
+   * @brief Bins the given particles into cells, wrapping each axis with a
+   * nonzero period. Positions along a periodic axis must lie in [0, period].
+   *
+   * @param particles the store of particles to bin
+   * @param periods the period of the x, y and z axes, or 0 for an axis that
+   * does not wrap
+   * @param skin the gap by which pairs may miss touching and still fall in
+   * the same or adjacent cells, which widens every cell
+   */
+  void Build(const ParticleStore& particles, const array<float, 3>& periods,
+             float skin = 0);
+
+  /**
+   * @brief Bins only some of the given particles into cells, sizing the grid
+   * to them alone. The pairs visited hold their indices in the store.
+   *
+   * @param particles the store of particles to bin
+   * @param periods the period of the x, y and z axes, or 0 for an axis that
+   * does not wrap
+   * @param indices the indices of the particles to bin
+   * @param skin the gap by which pairs may miss touching and still fall in
+   * the same or adjacent cells
+   */
+  void Build(const ParticleStore& particles, const array<float, 3>& periods,
+             const vector<size_t>& indices, float skin = 0);
+
+  /**
+   * @brief Calls the callback once for every pair of particles in the same or
+   * adjacent cells. Each unordered pair is visited exactly once, color by
+   * color, in the same order as resolving every color's cells in turn.
+   *
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachCandidatePair(Callback&& callback) const;
+
+  /**
+   * @brief Calls the callback for every pair between a particle in a cell and
+   * a particle later in that cell or in one of its forward neighbors.
+   *
+   * @param cell the index of the cell
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachCandidatePairInCell(size_t cell, Callback&& callback) const;
+
+  /**
+   * @brief Calls the callback for every particle in a cell and in every cell
+   * adjacent to it, including across the seam of a periodic axis.
+   *
+   * @param cell the index of the cell
+   * @param callback a callable taking the size_t particle index
+   */
+  template <typename Callback>
+  void ForEachParticleAround(size_t cell, Callback&& callback) const;
+
+  /**
+   * @brief Gets the index of the cell containing a particle, which need not
+   * be binned. Particles outside the grid get the nearest cell, and any
+   * particle touching a binned one is then still within its adjacent cells.
+   *
+   * @param particles the store holding the particle
+   * @param index the index of the particle
+   * @return the size_t index of the cell
+   */
+  size_t LocateCell(const ParticleStore& particles, size_t index) const;
+
+  /**
+   * @brief Gets the color of a cell, from its layer, row and column modulo
+   * three.
+   *
+   * @param cell the index of the cell
+   * @return the size_t color, less than GetColorCount()
+   */
+  size_t GetColorOf(size_t cell) const;
+
+  /**
+   * @brief Gets the occupied cells of one color.
+   *
+   * @param color the color, less than GetColorCount()
+   * @return a reference to the vector of cell indices
+   */
+  const vector<size_t>& GetCellsOfColor(size_t color) const;
+
+  /**
+   * @brief Gets the number of colors in use, 9 for a single layer of cells
+   * and 27 for several.
+   *
+   * @return the size_t number of colors
+   */
+  size_t GetColorCount() const;
+
+  /**
+   * @brief Gets the smallest side length of the cells. Cells along a
+   * periodic axis are stretched to divide the period evenly.
+   *
+   * @return the float cell size
+   */
+  float GetCellSize() const;
+
+  /**
+   * @brief Gets the total number of cells in the grid.
+   *
+   * @return the size_t number of cells
+   */
+  size_t GetCellCount() const;
+
+ private:
+  // The smallest allowed cell size, used when every radius is zero
+  const float kMinCellSize = 1;
+  // The number of cells allowed per particle before the cells are coarsened
+  const size_t kCellsPerParticle = 4;
+  // The number of cells always allowed, regardless of particle count
+  const size_t kMinCellLimit = 1024;
+
+  /**
+   * @brief Gets the index of the cell containing a position.
+   *
+   * @param x the x component of the position to locate
+   * @param y the y component of the position to locate
+   * @return the size_t index of the cell
+   */
+  size_t CellIndexOf(float x, float y) const;
+
+  /**
+   * @brief Gets the layer of cells containing a position.
+   *
+   * @param z the z component of the position to locate
+   * @return the size_t index of the layer
+   */
+  size_t LayerOf(float z) const;
+
+  // The most forward neighbors a cell has, in three dimensions
+  static constexpr size_t kMaxNeighborCells = 13;
+
+  /**
+   * @brief Finds the forward neighbors of a cell, across the seam of a
+   * periodic axis. Edges that do not wrap have none.
+   *
+   * @param cell the index of the cell
+   * @param neighbor_cells the array to fill with the neighbors' indices,
+   * which holds kMaxNeighborCells
+   * @return the size_t number of neighbors found
+   */
+  size_t FindNeighborCells(size_t cell, size_t* neighbor_cells) const;
+
+  // The most cells around a cell, itself included, in three dimensions
+  static constexpr size_t kMaxSurroundingCells = 27;
+
+  /**
+   * @brief Finds a cell and every cell adjacent to it, across the seam of a
+   * periodic axis.
+   *
+   * @param cell the index of the cell
+   * @param surrounding_cells the array to fill with the cells' indices, which
+   * holds kMaxSurroundingCells
+   * @return the size_t number of cells found
+   */
+  size_t FindSurroundingCells(size_t cell, size_t* surrounding_cells) const;
+
+  /**
+   * @brief Bins particles into cells, as both forms of Build do.
+   *
+   * @tparam IndexOf a callable mapping each slot to a particle index
+   * @param particles the store of particles to bin
+   * @param periods the period of the x, y and z axes, or 0
+   * @param count the number of particles to bin
+   * @param index_of the index in the store of the particle in each slot
+   * @param skin the gap added to the cell size
+   */
+  template <typename IndexOf>
+  void BuildCells(const ParticleStore& particles,
+                  const array<float, 3>& periods, size_t count,
+                  IndexOf index_of, float skin);
+
+  // The number of cells along a periodic axis that it takes for its seam
+  // to be crossed, below which the axis is a single cell
+  const size_t kMinPeriodicCells = 3;
+
+  /**
+   * @brief Finds the cell count and width along one axis.
+   *
+   * @param lower the lowest position along the axis
+   * @param upper the highest position along the axis
+   * @param period the period of the axis, or 0
+   * @param count the number of cells to set
+   * @param width the width of each cell to set
+   * @param wraps whether the axis wraps around, to set
+   */
+  void SizeAxis(float lower, float upper, float period, size_t& count,
+                float& width, bool& wraps) const;
+
+  // The side length of each cell, before periodic axes stretch it
+  float cell_size_ = kMinCellSize;
+  // The width, height and depth of each cell
+  vec3 cell_sides_ = vec3(kMinCellSize);
+  // Whether the neighbors of the first and last column, row and layer wrap
+  // around
+  array<bool, 3> wraps_ = {false, false, false};
+  // The position of the top left front corner of the grid
+  vec3 origin_;
+  // The number of cell columns
+  size_t columns_ = 0;
+  // The number of cell rows
+  size_t rows_ = 0;
+  // The number of cell layers, 1 in two dimensions
+  size_t layers_ = 1;
+  // The offset of each cell's range in cell_particles_, plus a final end offset
+  vector<size_t> cell_starts_;
+  // The particle indices, ordered by cell
+  vector<size_t> cell_particles_;
+  // The cell index of each binned particle, in the order they were given
+  vector<size_t> particle_cells_;
+  // The insertion cursor of each cell used during the counting sort
+  vector<size_t> cell_cursors_;
+  // The occupied cells of each color
+  array<vector<size_t>, kColorCount> color_cells_;
+};
+
+template <typename Callback>
+void CellGrid::ForEachCandidatePair(Callback&& callback) const {
+  for (size_t color = 0; color < GetColorCount(); ++color) {
+    for (size_t cell : color_cells_[color]) {
+      ForEachCandidatePairInCell(cell, callback);
+    }
+  }
+}
+
+template <typename Callback>
+inline void CellGrid::ForEachCandidatePairInCell(size_t cell,
+                                          Callback&& callback) const {
+  // The adjacent cells are found once for all the particles of the cell
+  size_t neighbor_cells[kMaxNeighborCells];
+  size_t neighbor_count = FindNeighborCells(cell, neighbor_cells);
+
+  for (size_t base = cell_starts_[cell]; base < cell_starts_[cell + 1];
+       ++base) {
+    // Pairs within the same cell
+    for (size_t neighbor = base + 1; neighbor < cell_starts_[cell + 1];
+         ++neighbor) {
+      callback(cell_particles_[base], cell_particles_[neighbor]);
+    }
+
+    // Pairs with the adjacent cells
+    for (size_t index = 0; index < neighbor_count; ++index) {
+      size_t neighbor_cell = neighbor_cells[index];
+      for (size_t neighbor = cell_starts_[neighbor_cell];
+           neighbor < cell_starts_[neighbor_cell + 1]; ++neighbor) {
+        callback(cell_particles_[base], cell_particles_[neighbor]);
+      }
+    }
+  }
+}
+
+template <typename Callback>
+void CellGrid::ForEachParticleAround(size_t cell, Callback&& callback) const {
+  size_t surrounding_cells[kMaxSurroundingCells];
+  size_t surrounding_count = FindSurroundingCells(cell, surrounding_cells);
+  for (size_t index = 0; index < surrounding_count; ++index) {
+    size_t surrounding_cell = surrounding_cells[index];
+    for (size_t slot = cell_starts_[surrounding_cell];
+         slot < cell_starts_[surrounding_cell + 1]; ++slot) {
+      callback(cell_particles_[slot]);
+    }
+  }
+}
+
+}  // namespace idealgas
@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+// The double copies of one particle array that mixed and double precision
+// keep, one array per axis, empty for the axes and arrays not kept
+using PreciseArrays = array<vector<double>, ParticleStore::kMaxDimensions>;
+
+/**
+ * @brief The CheckpointState struct is the state of a container saved
+ * alongside its particles. The random number state is just the seed, as every
+ * particle's initial state is drawn from its seed, species and index.
+ *
+ */
+struct CheckpointState {
+  uint64_t seed = 0;
+  double simulated_time = 0;
+  float time_step = 1;
+  SimulationMode simulation_mode = SimulationMode::kTimeStep;
+  PrecisionMode precision = PrecisionMode::kSingle;
+  uint64_t width = 0;
+  uint64_t height = 0;
+  uint64_t depth = 0;
+};
+
+/**
+ * @brief Writes a binary checkpoint of a container's state and particles.
+ *
+ * The layout is a fixed header holding the format version, the particle and
+ * species counts, the dimensions and the CheckpointState, then the species
+ * table of names, colors and visible and enabled flags, then each particle
+ * array in ParticleStore order, raw and in native byte order, with one
+ * position and velocity array per axis. Mixed and double precision then add their double positions, and
+ * double precision its double velocities, one array per axis, so that a
+ * resumed run keeps every bit the original had. Every section starts on a
+ * 64-byte boundary, so a mapped checkpoint can be copied straight into the
+ * arrays. The file is written beside the path and renamed over it, so a
+ * crash never leaves a half-written checkpoint behind.
+ *
+ * @throws std::runtime_error when the file cannot be written
+ * @param path the path of the checkpoint
+ * @param state the state of the container
+ * @param particles the particles of the container
+ * @param precise_positions the double positions, used unless the state is in
+ * single precision, and taken from the floats for an axis not yet copied
+ * @param precise_velocities the double velocities, used in double precision
+ * alike
+ */
+void WriteCheckpoint(const string& path, const CheckpointState& state,
+                     const ParticleStore& particles,
+                     const PreciseArrays& precise_positions,
+                     const PreciseArrays& precise_velocities);
+
+/**
+ * @brief Reads a checkpoint written by WriteCheckpoint by mapping it into
+ * memory, without a parsing pass over the particles.
+ *
+ * @throws std::runtime_error when the file cannot be read, is not a
+ * checkpoint, has another format version or byte order, or is truncated
+ * @param path the path of the checkpoint
+ * @param particles the store to replace with the saved particles and species
+ * @return the saved CheckpointState
+ */
+CheckpointState ReadCheckpoint(const string& path, ParticleStore& particles);
+
+/**
+ * @brief Reads a checkpoint written by WriteCheckpoint, along with the double
+ * positions and velocities saved in mixed and double precision.
+ *
+ * @throws std::runtime_error when the file cannot be read, is not a
+ * checkpoint, has another format version or byte order, or is truncated
+ * @param path the path of the checkpoint
+ * @param particles the store to replace with the saved particles and species
+ * @param precise_positions the arrays to replace with the saved double
+ * positions, left empty in single precision
+ * @param precise_velocities the arrays to replace with the saved double
+ * velocities, left empty unless in double precision
+ * @return the saved CheckpointState
+ */
+CheckpointState ReadCheckpoint(const string& path, ParticleStore& particles,
+                               PreciseArrays& precise_positions,
+                               PreciseArrays& precise_velocities);
+
+/**
+ * @brief The CheckpointTimer class saves a container's checkpoint every so
+ * many seconds of wall time, for simulation loops to call once per step.
+ *
+ */
+class CheckpointTimer {
+ public:
+  /**
+   * @brief Constructs a timer whose first checkpoint is due one interval from
+   * now.
+   *
+   * @param path the path of the checkpoint, overwritten each time
+   * @param interval_seconds the seconds between checkpoints, or 0 to never
+   * save one
+   */
+  CheckpointTimer(const string& path, double interval_seconds);
+
+  /**
+   * @brief Saves a checkpoint of the container if one is due.
+   *
+   * @throws std::runtime_error when the checkpoint cannot be written
+   * @param container the container to save
+   * @return true when a checkpoint was saved
+   */
+  bool Update(const ParticleContainer& container);
+
+  /**
+   * @brief Gets the path the checkpoints are saved to.
+   *
+   * @return the string path
+   */
+  const string& GetPath() const;
+
+ private:
+  // The path of the checkpoint
+  string path_;
+  // The wall time between checkpoints, or zero to never save one
+  std::chrono::duration<double> interval_;
+  // The wall time of the last checkpoint, or of the timer's creation
+  std::chrono::steady_clock::time_point last_save_;
+};
+
+}  // namespace idealgas
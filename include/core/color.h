@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+
+namespace idealgas {
+
+/**
+ * @brief The ColorT class is a plain RGB color, so that the simulation core
+ * does not depend on a graphics library. It mirrors the parts of Cinder's
+ * ColorT that the core uses, and converts to it by its components.
+ *
+ * @tparam T the type of each component, from 0 to 1
+ */
+template <typename T>
+class ColorT {
+ public:
+  /**
+   * @brief Constructs a black color.
+   *
+   */
+  ColorT() : r(0), g(0), b(0) {}
+
+  /**
+   * @brief Constructs a color from its components.
+   *
+   * @param red the red component
+   * @param green the green component
+   * @param blue the blue component
+   */
+  ColorT(T red, T green, T blue) : r(red), g(green), b(blue) {}
+
+  /**
+   * @brief Creates a color from a hex value such as 0xFF8000.
+   *
+   * @param hex_value the 24-bit RGB value
+   * @return the ColorT of the value
+   */
+  static ColorT hex(uint32_t hex_value) {
+    return ColorT(((hex_value >> 16) & 0xFF) / T(255),
+                  ((hex_value >> 8) & 0xFF) / T(255),
+                  (hex_value & 0xFF) / T(255));
+  }
+
+  /**
+   * @brief Multiplies two colors component by component, to tint one.
+   *
+   * @param other the color to multiply by
+   * @return the product ColorT
+   */
+  ColorT operator*(const ColorT& other) const {
+    return ColorT(r * other.r, g * other.g, b * other.b);
+  }
+
+  /**
+   * @brief Checks whether two colors have equal components.
+   *
+   * @param other the color to compare to
+   * @return true when every component matches
+   * @return false otherwise
+   */
+  bool operator==(const ColorT& other) const {
+    return r == other.r && g == other.g && b == other.b;
+  }
+
+  /**
+   * @brief Checks whether two colors differ in any component.
+   *
+   * @param other the color to compare to
+   * @return true when any component differs
+   * @return false otherwise
+   */
+  bool operator!=(const ColorT& other) const {
+    return !(*this == other);
+  }
+
+  // The red component
+  T r;
+  // The green component
+  T g;
+  // The blue component
+  T b;
+};
+
+}  // namespace idealgas
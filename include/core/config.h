@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "core/particle_container.h"
+#include "core/placement.h"
+#include "core/trajectory.h"
+
+using nlohmann::json;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The settings of one species whose particles are drawn at random.
+ *
+ */
+struct SpeciesConfig {
+  string name;
+  size_t particle_count = 0;
+  size_t min_velocity = 0;
+  size_t max_velocity = 0;
+  size_t min_mass = 0;
+  size_t max_mass = 0;
+  size_t min_radius = 0;
+  size_t max_radius = 0;
+  // The color of the species as 0xRRGGBB
+  uint32_t color = 0xFFFFFF;
+};
+
+/**
+ * @brief The SimulationConfig struct is a configuration file read and checked
+ * once, with every setting converted to its type and every optional setting
+ * filled in with its default.
+ *
+ */
+struct SimulationConfig {
+  // The pixel width of the window
+  size_t window_width = 0;
+  // The pixel height of the window
+  size_t window_height = 0;
+  // The pixel margin around the container and other objects
+  size_t margin = 0;
+  // The pixel width of the stroke used to draw boundaries
+  size_t stroke = 0;
+  // The colors of the background, boundaries and text as 0xRRGGBB
+  uint32_t background_color = 0;
+  uint32_t stroke_color = 0;
+  uint32_t text_color = 0;
+  // The font name of the text
+  string font;
+  // The pixel size of the container, which takes three quarters of the
+  // window's width and its height, less the margins
+  size_t container_width = 0;
+  size_t container_height = 0;
+  // The pixel depth of the container in three dimensions, its height unless
+  // configured
+  size_t container_depth = 0;
+  // The number of axes the particles move along, 2 or 3
+  size_t dimensions = 2;
+
+  // The number of bins in each histogram
+  size_t histogram_bin_count = 0;
+  // The number of recent steps in each histogram, or 0 for every step
+  size_t histogram_window_steps = 0;
+  // The steps taken per second by the visualizer
+  double steps_per_second = 60;
+  // The number of steps kept in the observable history
+  size_t observable_history_steps =
+      ParticleContainer::kDefaultObservableHistoryLength;
+
+  // The settings of adaptive time stepping, disabled unless configured
+  AdaptiveStepOptions adaptive_step;
+  // The settings of the neighbor list, disabled unless configured
+  NeighborListOptions neighbor_list;
+  // The number of threads stepping the particles
+  size_t thread_count = 1;
+  // The seed of the random particles, itself random unless configured
+  uint64_t seed = 0;
+  // The way particles are advanced through time
+  SimulationMode simulation_mode = SimulationMode::kTimeStep;
+  // The floating-point type positions and velocities advance in
+  PrecisionMode precision = PrecisionMode::kSingle;
+  // The strategy used to find touching particles
+  BroadphaseMode broadphase = BroadphaseMode::kGrid;
+  // What happens to particles at the edges of the x, y and z axes
+  array<BoundaryMode, 3> boundaries = {};
+
+  // The path steps are streamed to, or empty for none
+  string trajectory_path;
+  // The settings of the trajectory
+  TrajectoryOptions trajectory;
+  // The path checkpoints are saved to, or empty for none
+  string checkpoint_path;
+  // The seconds of wall time between checkpoints, or 0 for none
+  double checkpoint_interval_seconds = 0;
+  // Whether an existing checkpoint replaces the configured particles
+  bool resume_checkpoint = false;
+
+  // The file of explicit particles added before the random ones, or empty
+  string initial_conditions_path;
+  // The species whose particles are drawn at random
+  vector<SpeciesConfig> species;
+  // How the random particles are placed
+  PlacementMode placement = PlacementMode::kUniform;
+};
+
+/**
+ * @brief Reads and checks a parsed configuration. Numbers may be given as
+ * JSON numbers or as strings holding numbers, and colors as hexadecimal
+ * strings such as "0xFFBFBF" or as numbers.
+ *
+ * @throws json::type_error when a required setting is missing or of the
+ * wrong type
+ * @throws std::invalid_argument when a setting is out of range
+ * @param config the parsed configuration
+ * @return the SimulationConfig
+ */
+SimulationConfig ParseConfig(const json& config);
+
+/**
+ * @brief Reads and checks a configuration file.
+ *
+ * @throws json::parse_error when the file is not valid JSON
+ * @throws json::type_error when a required setting is missing or of the
+ * wrong type
+ * @throws std::invalid_argument when a setting is out of range
+ * @param path the path of the configuration file
+ * @return the SimulationConfig
+ */
+SimulationConfig LoadConfig(const string& path);
+
+}  // namespace idealgas
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+using nlohmann::json;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The settings of an ensemble of independent runs.
+ *
+ */
+struct EnsembleOptions {
+  // The number of independent containers run
+  size_t replicas = 16;
+  // The number of steps each replica takes
+  size_t steps = 1000;
+  // The steps taken before anything is measured, so the gas can settle
+  size_t warmup_steps = 500;
+  // The speeds of every particle are binned once every this many steps after
+  // the warmup
+  size_t sample_stride = 10;
+  // The number of speed bins per species
+  size_t bin_count = 20;
+  // The number of replicas run at once, or 0 for every hardware thread
+  size_t thread_count = 0;
+  // The half width of each confidence interval in standard errors, 1.96 for
+  // 95% under the normal approximation
+  double confidence_z = 1.96;
+};
+
+/**
+ * @brief A mean over the replicas and the half width of its confidence
+ * interval.
+ *
+ */
+struct Estimate {
+  double mean = 0;
+  double half_width = 0;
+};
+
+/**
+ * @brief The speed distribution of one species, averaged over the replicas.
+ *
+ */
+struct SpeedDistribution {
+  string title;
+  // The upper cutoff of each bin, the lowest bin starting at zero
+  vector<float> bin_cutoffs;
+  // The fraction of the species' sampled speeds in each bin
+  vector<Estimate> fractions;
+  // The fraction of sampled speeds above the last cutoff
+  Estimate overflow;
+  // The fraction of each bin under a Maxwell-Boltzmann distribution at the
+  // species' mean temperature, for the species' masses
+  vector<double> maxwell_boltzmann;
+};
+
+/**
+ * @brief The statistics of an ensemble, each averaged over the measured steps
+ * of every replica.
+ *
+ */
+struct EnsembleResult {
+  // The seed every replica's seed is derived from
+  uint64_t seed = 0;
+  // The number of replicas run
+  size_t replicas = 0;
+  // The speed distribution of every species, indexed by SpeciesId
+  vector<SpeedDistribution> speeds;
+  // The temperature of every species, indexed by SpeciesId
+  vector<Estimate> temperatures;
+  // The pressure on the walls
+  Estimate pressure;
+  // The total kinetic energy
+  Estimate kinetic_energy;
+};
+
+/**
+ * @brief The Ensemble class runs many independent containers from one
+ * configuration, each with its own seed, and merges their speed histograms
+ * and observables into means with confidence intervals.
+ *
+ * Replicas are scheduled across a thread pool, each stepping on a single
+ * thread, and a container exists only while its replica runs. What a replica
+ * leaves behind is a fixed-size summary of bin fractions and observable
+ * means, so memory grows with the thread count rather than the replica count.
+ * Every replica bins into the same fixed range, chosen before the run, so the
+ * summaries merge by plain sums. They are merged in replica order, so the
+ * result is the same for every thread count.
+ *
+ */
+class Ensemble {
+ public:
+  /**
+   * @brief Constructs an ensemble of a configuration. The configuration's
+   * seed, or a random one, seeds the ensemble; its threads, checkpoint and
+   * trajectory settings are ignored.
+   *
+   * @throws json::type_error when a required setting is missing
+   * @param config the parsed configuration, in the same format as the
+   * configuration file
+   * @param options the EnsembleOptions
+   */
+  Ensemble(const json& config, const EnsembleOptions& options);
+
+  /**
+   * @brief Runs every replica and merges their statistics.
+   *
+   * @return the EnsembleResult
+   */
+  EnsembleResult Run() const;
+
+  /**
+   * @brief Gets the seed of one replica, derived from the ensemble's seed
+   * with the Philox generator so that replicas' streams do not overlap.
+   *
+   * @param replica the index of the replica
+   * @return the uint64_t seed
+   */
+  uint64_t GetReplicaSeed(size_t replica) const;
+
+  /**
+   * @brief Gets the seed every replica's seed is derived from.
+   *
+   * @return the uint64_t seed
+   */
+  uint64_t GetSeed() const;
+
+ private:
+  /**
+   * @brief Chooses the speed bins of each species from the first replica's
+   * initial particles: four times the RMS speed of the species' lightest
+   * particle at the temperature the gas settles to, beyond which a
+   * Maxwell-Boltzmann distribution leaves about one speed in ten million.
+   * Also keeps a sample of each species' masses for the expected
+   * distribution.
+   *
+   */
+  void ChooseBins();
+
+  // The configuration of every replica, with the per-run settings removed
+  json config_;
+  // The settings of the ensemble
+  EnsembleOptions options_;
+  // The seed every replica's seed is derived from
+  uint64_t seed_;
+  // The name of every species, indexed by SpeciesId
+  vector<string> species_names_;
+  // The upper edge of each species' last bin
+  vector<double> max_speeds_;
+  // A sample of each species' masses
+  vector<vector<float>> species_masses_;
+  // The number of axes the particles move along
+  size_t dimensions_ = 2;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,224 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "core/particle_store.h"
+
+using idealgas::ParticleStore;
+using std::array;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The EventDrivenEngine class advances hard-sphere particles exactly,
+ * jumping from one collision to the next instead of taking fixed steps. Every
+ * particle-particle, particle-wall and cell-crossing event is kept in a
+ * priority queue, and events made stale by a later collision are skipped by
+ * comparing per-particle event counters. Particles are only moved when an
+ * event involves them, so the work per event does not grow with the number of
+ * particles.
+ *
+ */
+class EventDrivenEngine {
+ public:
+  /**
+   * @brief Advances the particles by a span of simulated time, resolving every
+   * collision at its exact time. The engine rebuilds its event queue after
+   * Reset, and when the particle count or container size changed since the
+   * last call. It does not compare the particles themselves, so whoever
+   * writes them between calls must call Reset.
+   *
+   * @param particles the particles to advance
+   * @param duration the simulated time to advance by
+   * @param width the width of the container
+   * @param height the height of the container
+   */
+  void Advance(ParticleStore& particles, float duration, float width,
+               float height);
+
+  /**
+   * @brief Forgets every predicted event, so that the next call to Advance
+   * starts from scratch. Called whenever the particles were written from
+   * outside the engine.
+   *
+   */
+  void Reset();
+
+  /**
+   * @brief Gets the number of collision and cell-crossing events processed so
+   * far, not counting stale events.
+   *
+   * @return the size_t number of events
+   */
+  size_t GetProcessedEventCount() const;
+
+  /**
+   * @brief Gets the momentum the particles gave to the walls during the last
+   * call to Advance.
+   *
+   * @return the double total of each wall collision's momentum change
+   */
+  double GetWallImpulse() const;
+
+ private:
+  // The number of cells allowed per particle
+  const size_t kCellsPerParticle = 4;
+  // The number of cells always allowed, regardless of particle count
+  const size_t kMinCellLimit = 1024;
+  // The queue is rebuilt when it holds this many events per particle
+  const size_t kMaxQueuedEventsPerParticle = 32;
+  // Advance stops early after this many events per particle, which only
+  // happens when many particles start out overlapping. The particles then
+  // wait out the rest of the span where they are.
+  const size_t kMaxEventsPerParticle = 10000;
+
+  /**
+   * @brief The kinds of events in the queue.
+   *
+   */
+  enum class EventType : uint8_t { kParticle, kWall, kCell };
+
+  /**
+   * @brief One predicted event, valid only while the event counts of its
+   * particles are unchanged.
+   *
+   */
+  struct Event {
+    // The absolute simulated time of the event
+    double time;
+    // The first particle involved
+    uint32_t first;
+    // The second particle, or the axis for wall and cell events
+    uint32_t second;
+    // The event count of the first particle when predicted
+    uint32_t first_count;
+    // The event count of the second particle when predicted
+    uint32_t second_count;
+    // What happens at the event
+    EventType type;
+    // For cell events, +1 or -1 along the axis
+    int8_t direction;
+
+    bool operator>(const Event& other) const { return time > other.time; }
+  };
+
+  /**
+   * @brief Checks whether the particle count or container size changed since
+   * the engine was built.
+   *
+   * @param particles the particles to check
+   * @param width the width of the container
+   * @param height the height of the container
+   * @return true when the engine must be rebuilt
+   * @return false when the predicted events are still valid
+   */
+  bool NeedsRebuild(const ParticleStore& particles, float width,
+                    float height) const;
+
+  /**
+   * @brief Sizes the cells, bins every particle and predicts every event.
+   * Every particle must already be at the current time.
+   *
+   * @param particles the particles to build for
+   * @param width the width of the container
+   * @param height the height of the container
+   */
+  void Rebuild(const ParticleStore& particles, float width, float height);
+
+  /**
+   * @brief Moves a particle along its path to a time.
+   *
+   * @param particles the particles to update
+   * @param index the index of the particle to move
+   * @param time the absolute simulated time to move to
+   */
+  void MoveTo(ParticleStore& particles, uint32_t index, double time);
+
+  /**
+   * @brief Predicts the next wall, cell-crossing and particle events of a
+   * particle, which must already be at the current time.
+   *
+   * @param particles the particles to predict for
+   * @param index the index of the particle
+   * @param later_only whether to only predict collisions with particles of a
+   * higher index, to avoid predicting each pair twice
+   */
+  void Predict(const ParticleStore& particles, uint32_t index,
+               bool later_only);
+
+  /**
+   * @brief Predicts when two particles will touch, if ever. The first
+   * particle must be at the current time, the second may lag behind it.
+   *
+   * @param particles the particles to predict for
+   * @param first the index of the first particle
+   * @param second the index of the second particle
+   */
+  void PredictPair(const ParticleStore& particles, uint32_t first,
+                   uint32_t second);
+
+  /**
+   * @brief Executes a collision between two touching particles and tints the
+   * one with the smaller index.
+   *
+   * @param particles the particles to update
+   * @param first the index of the first particle
+   * @param second the index of the second particle
+   */
+  void Collide(ParticleStore& particles, uint32_t first, uint32_t second);
+
+  /**
+   * @brief Gets the cell column or row containing a coordinate.
+   *
+   * @param position the coordinate along the axis
+   * @param axis 0 for columns, 1 for rows
+   * @return the size_t column or row, clamped to the grid
+   */
+  size_t CellCoordinate(float position, size_t axis) const;
+
+  /**
+   * @brief Moves a particle into a cell, out of its current one.
+   *
+   * @param index the index of the particle
+   * @param cell the index of the cell to move into
+   */
+  void MoveToCell(uint32_t index, size_t cell);
+
+  // The current simulated time
+  double now_ = 0;
+  // The number of events processed
+  size_t processed_events_ = 0;
+  // The momentum given to the walls during the last call to Advance
+  double wall_impulse_ = 0;
+  // Whether the engine has been built for the current particles
+  bool built_ = false;
+
+  // The simulated time each particle's stored position belongs to
+  vector<double> times_;
+  // The number of events each particle has been through
+  vector<uint32_t> counts_;
+  // The predicted events, soonest first
+  std::priority_queue<Event, vector<Event>, std::greater<Event>> events_;
+
+  // The side length of each cell
+  float cell_size_ = 1;
+  // The number of cells along each axis
+  array<size_t, 2> cell_counts_ = {0, 0};
+  // The particles in each cell
+  vector<vector<uint32_t>> cell_members_;
+  // The cell of each particle
+  vector<size_t> particle_cells_;
+  // The position of each particle within its cell's member list
+  vector<size_t> particle_slots_;
+
+  // The container size the engine was built for
+  float width_ = 0;
+  // The container height the engine was built for
+  float height_ = 0;
+};
+
+}  // namespace idealgas
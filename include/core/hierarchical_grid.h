@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "core/cell_grid.h"
+#include "core/particle_store.h"
+
+using idealgas::CellGrid;
+using idealgas::ParticleStore;
+using std::array;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The HierarchicalGrid class is a broadphase for particles of widely
+ * different radii. A single CellGrid sizes every cell for the largest
+ * particle, so small particles crowd into each cell and are all tested
+ * against one another. Here particles are split by radius into levels, each
+ * holding radii up to four times the largest of the level before, and each
+ * level is its own CellGrid with cells sized for its own particles. Levels
+ * closer in radius would fit each particle more tightly, but every level
+ * makes each finer particle search its cells once more, which costs more
+ * than the pairs it saves.
+ *
+ * Pairs within a level are found as in a CellGrid. Every particle of a finer
+ * level is also located in each coarser level's grid, as a visitor of one of
+ * its cells, and is paired with the coarser particles in that cell and its
+ * adjacent cells. Finer particles are never larger than coarser ones, so the
+ * coarser cells are wide enough for any pair across the two levels. Each
+ * pair of levels is searched from the finer side only, so no pair is visited
+ * twice.
+ *
+ * The cells of every level are numbered one after another, and so are their
+ * colors. A cell's pairs and its visitors' pairs only reach the cell and its
+ * adjacent cells, so the cells of one color still share no particles and can
+ * be resolved in parallel.
+ *
+ */
+class HierarchicalGrid {
+ public:
+  // The most levels, beyond which the largest particles share the last one.
+  // Radii from 0.5 to the radius limit of 100 need only four.
+  static constexpr size_t kMaxLevels = 6;
+
+  /**
+   * @brief Splits the particles into levels by radius and bins each level,
+   * wrapping each axis with a nonzero period. Positions along a periodic axis
+   * must lie in [0, period].
+   *
+   * @param particles the store of particles to bin
+   * @param periods the period of the x, y and z axes, or 0 for an axis that
+   * does not wrap
+   * @param skin the gap by which pairs may miss touching and still be
+   * visited, which widens every level's cells
+   */
+  void Build(const ParticleStore& particles, const array<float, 3>& periods,
+             float skin = 0);
+
+  /**
+   * @brief Calls the callback once for every candidate pair of particles,
+   * within a level or across two. Each unordered pair is visited exactly
+   * once, in the same order as resolving every color's cells in turn.
+   *
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachCandidatePair(Callback&& callback) const;
+
+  /**
+   * @brief Calls the callback for the pairs a cell owns: those of its own
+   * level's particles with later ones in the cell or its forward neighbors,
+   * and those of its visitors with its level's particles in the cell or any
+   * adjacent cell.
+   *
+   * @param cell the index of the cell, numbered across every level
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachCandidatePairInCell(size_t cell, Callback&& callback) const;
+
+  /**
+   * @brief Gets the occupied cells of one color, which hold particles or
+   * visitors.
+   *
+   * @param color the color, less than GetColorCount()
+   * @return a reference to the vector of cell indices, numbered across every
+   * level
+   */
+  const vector<size_t>& GetCellsOfColor(size_t color) const;
+
+  /**
+   * @brief Gets the number of colors in use, summed over every level.
+   *
+   * @return the size_t number of colors
+   */
+  size_t GetColorCount() const;
+
+  /**
+   * @brief Gets the number of levels holding particles.
+   *
+   * @return the size_t number of levels
+   */
+  size_t GetLevelCount() const;
+
+  /**
+   * @brief Gets the grid of one level, finest first.
+   *
+   * @param level the level, less than GetLevelCount()
+   * @return a reference to the level's CellGrid
+   */
+  const CellGrid& GetLevel(size_t level) const;
+
+ private:
+  /**
+   * @brief One level of the hierarchy.
+   *
+   */
+  struct Level {
+    // The grid of the level's own particles
+    CellGrid grid;
+    // The particles of the level, in index order
+    vector<size_t> particles;
+    // The offset of each cell's range in visitors, plus a final end offset
+    vector<size_t> visitor_starts;
+    // The finer particles located in this level, ordered by cell
+    vector<size_t> visitors;
+    // The cell of each finer particle, in the order they were located
+    vector<size_t> visitor_cells;
+    // The number of this level's first cell among every level's cells
+    size_t first_cell = 0;
+  };
+
+  // The ratio of the largest radius of one level to that of the level before
+  const float kLevelRatio = 4;
+  // The smallest radius a level is sized from, so that particles without
+  // radius still share the first level with small ones
+  const float kMinRadius = 0.5f;
+
+  /**
+   * @brief Locates every finer particle in a level's grid, counting sorting
+   * them into its cells.
+   *
+   * @param particles the store holding the particles
+   * @param level the index of the level in all_levels_
+   */
+  void LocateVisitors(const ParticleStore& particles, size_t level);
+
+  /**
+   * @brief Finds the level owning a cell numbered across every level.
+   *
+   * @param cell the index of the cell
+   * @return the size_t index of the level in levels_
+   */
+  size_t LevelOf(size_t cell) const;
+
+  // Every level, finest first, including empty ones, whose grids are kept
+  // so that later builds reuse their memory
+  array<Level, kMaxLevels> all_levels_;
+  // The indices in all_levels_ of the levels holding particles, finest first
+  vector<size_t> levels_;
+  // The occupied cells of every level's colors, one level after another
+  vector<vector<size_t>> color_cells_;
+};
+
+template <typename Callback>
+void HierarchicalGrid::ForEachCandidatePair(Callback&& callback) const {
+  for (const vector<size_t>& cells : color_cells_) {
+    for (size_t cell : cells) {
+      ForEachCandidatePairInCell(cell, callback);
+    }
+  }
+}
+
+template <typename Callback>
+inline void HierarchicalGrid::ForEachCandidatePairInCell(
+    size_t cell, Callback&& callback) const {
+  const Level& level = all_levels_[levels_[LevelOf(cell)]];
+  size_t local_cell = cell - level.first_cell;
+  level.grid.ForEachCandidatePairInCell(local_cell, callback);
+
+  // The visitors are paired with every particle around the cell, which are
+  // found once for all of them
+  if (level.visitor_starts.empty()) {
+    return;
+  }
+  size_t begin = level.visitor_starts[local_cell];
+  size_t end = level.visitor_starts[local_cell + 1];
+  if (begin == end) {
+    return;
+  }
+  level.grid.ForEachParticleAround(local_cell, [&](size_t particle) {
+    for (size_t slot = begin; slot < end; ++slot) {
+      callback(level.visitors[slot], particle);
+    }
+  });
+}
+
+}  // namespace idealgas
@@ -3,13 +3,6 @@
 #include <string>
 #include <vector>
 
-#include "cinder/gl/gl.h"
-#include "core/particle.h"
-
-using ci::ColorT;
-using ci::Font;
-using glm::vec2;
-using idealgas::Particle;
 using std::string;
 using std::vector;
 
@@ -17,94 +10,154 @@ namespace idealgas {
 
 /**
  * @brief The histogram class calculates the binnings for the speeds of the
- * particles in the simulation and plots them in the Cinder app if desired.
+ * particles in the simulation. The visualizer plots them with HistogramPlot.
+ *
+ * Values are binned as they arrive into a fixed number of counters, so memory
+ * and time per value stay constant however long the simulation runs. The
+ * range of the bins is set by the first batch of values and doubles whenever
+ * a later value falls outside it, merging neighboring bins in pairs. The
+ * histogram can cover every value so far, or only the last few steps, kept as
+ * a ring of per-step counts.
  *
  */
 class Histogram {
  public:
-  /**
-   * @brief Short constructor for non-plotted histogram. 
-   * 
-   * @param title the string title of the histogram
-   * @param bin_count the number of bins in the histogram
-   */
-  Histogram(const string& title, size_t bin_count);
-
   /**
    * @brief Constructs a new Histogram object.
    *
-   * @param title the title of the plot
+   * @param title the string title of the histogram
    * @param bin_count the number of bins in the histogram
-   * @param width the width of the plot
-   * @param height the height of the plot
-   * @param offset the vec2 offset from the origin 
-   * @param stroke the width of the stroke of the histogram's lines
-   * @param stroke_color the color of the histogram's lines
-   * @param bar_color the color of the histogram's bars
-   * @param text_color the color of the histogram's text
-   * @param font the font of the histogram's text
+   * @param window_steps the number of completed steps covered, or 0 to cover
+   * every value so far
    */
-  Histogram(const string& title, size_t bin_count, size_t width, size_t height,
-            const vec2& offset, size_t stroke,
-            const ColorT<float>& stroke_color, const ColorT<float>& bar_color,
-            const ColorT<float>& text_color, const string& font);
+  Histogram(const string& title, size_t bin_count, size_t window_steps = 0);
 
   /**
-   * @brief Calls the appropriate drawing functions in order to display the
-   * histogram in the app.
+   * @brief Updates the histogram by adding a value to the distribution.
+   * Values that are not finite are ignored.
    *
+   * @param value the value
    */
-  void Draw();
+  void Update(float value);
 
   /**
-   * @brief Updates the histogram by adding a value to the distribution.
+   * @brief Completes the current step, so that its values leave the window
+   * after window_steps more steps.
    *
-   * @param value the value
    */
-  void Update(float value);
+  void EndStep();
 
   /**
-   * @brief Calculates the normalized frequencies of different speeds,
-   * representing by bin heights.
+   * @brief Calculates the frequencies of different speeds, representing by bin
+   * heights. When every value in the window is equal, every bin has the full
+   * count.
    *
    */
   void CalculateFrequencies();
 
   /**
-   * @brief Normalizes the size of each bin height for graphing. 
-   * 
+   * @brief Normalizes the size of each bin height for graphing.
+   *
    */
   void NormalizeBins();
 
   /**
-   * @brief Returns the heights of the histogram's bins. 
-   * 
+   * @brief Returns the heights of the histogram's bins.
+   *
    * @return vector<float> of the relative heights for all the bins
    */
   vector<float> GetBinHeights() const;
 
+  /**
+   * @brief Returns the upper cutoffs of the histogram's bins.
+   *
+   * @return vector<float> of the upper value of each bin
+   */
+  vector<float> GetBinCutoffs() const;
+
+  /**
+   * @brief Returns the title of the histogram.
+   *
+   * @return the string title
+   */
+  const string& GetTitle() const;
+
+  /**
+   * @brief Returns the number of values currently in the window.
+   *
+   * @return the size_t number of values
+   */
+  size_t GetValueCount() const;
+
  private:
+  // The most values held back to choose the first range
+  const size_t kMaxPendingValues = 4096;
+
   /**
-   * @brief Draws the frame of the histogram.
+   * @brief Chooses the range of the bins from the pending values and bins
+   * them. Like the batch histogram this replaces, the range is half-open, so
+   * values equal to the largest pending value are left out.
    *
    */
-  void DrawFrame();
+  void EstablishRange();
 
   /**
-   * @brief Draws the titles and labels of the histogram.
+   * @brief Adds a value to the counts of the current step, widening the range
+   * until it fits. A value on the upper edge falls in the last bin.
    *
+   * @param value the value to add
    */
-  void DrawText();
+  void Bin(float value);
 
   /**
-   * @brief Draws the bins/bars of the histogram.
+   * @brief Doubles the width of the bins, growing the range downward or
+   * upward, and merges the counts of every step to match.
    *
+   * @param downward whether to grow the range below its lower edge
    */
-  void DrawBins();
+  void Widen(bool downward);
 
+  /**
+   * @brief Merges one set of counts into the doubled bins.
+   *
+   * @param counts the counts to merge, bin_count_ long
+   * @param downward whether the range grew below its lower edge
+   */
+  void MergeCounts(size_t* counts, bool downward) const;
+
+  // The values seen before the range is chosen
+  vector<float> pending_values_;
+  // Whether the range of the bins has been chosen
+  bool has_range_ = false;
+  // The lower edge of the first bin
+  double lower_edge_ = 0;
+  // The width of each bin
+  double bin_width_ = 1;
+  // The upper edge of the last bin, where later values still fall
+  double upper_edge_ = 0;
+
+  // The counts of the step in progress
+  vector<size_t> step_counts_;
+  // The counts of every step in the window, including the one in progress
+  vector<size_t> window_counts_;
+  // The smallest value of the step in progress
+  float step_min_;
+  // The largest value of the step in progress
+  float step_max_;
+
+  // The counts of each completed step in the window, bin_count_ per step
+  vector<size_t> history_counts_;
+  // The smallest value of each completed step in the window
+  vector<float> history_min_;
+  // The largest value of each completed step in the window
+  vector<float> history_max_;
+  // The ring slot the next completed step is written to
+  size_t history_next_ = 0;
+  // The number of completed steps in the ring
+  size_t history_size_ = 0;
+  // The number of completed steps covered, or 0 for every step
+  size_t window_steps_;
 
-  // The values from which to construct the histogram
-  vector<float> values_;
   // The evenly spaced upper cutoffs for each bin, ranging from minimum to
   // maximum value
   vector<float> bin_cutoffs_;
@@ -115,35 +168,6 @@ class Histogram {
   string title_;
   // The number of bins to use to create the histogram
   size_t bin_count_;
-  // The pixel width of the graph
-  size_t width_;
-  // The pixel height of the graph
-  size_t height_;
-  // The vec2 offset of the top left of the graph, relative to the top left of
-  // the window
-  vec2 offset_;
-  // The thickness of the stroke with which to draw the frame lines
-  size_t stroke_;
-  // The color of the stroke
-  ColorT<float> stroke_color_;
-  // The color of the histogram bars
-  ColorT<float> bar_color_;
-  // The color of the label and title text
-  ColorT<float> text_color_;
-  // The font family of the text printed on the graph
-  string font_family_;
-
-  // The offset of the graph (separate from the offset of the frame)
-  vec2 graph_offset_;
-  // The pixel width of the graph (marginally smaller than the width of the
-  // histogram)
-  size_t graph_width_;
-  // The pixel width of each bin in the graph
-  size_t bin_width_;
-  // Label font 
-  Font label_font_;
-  // Title font 
-  Font title_font_;
 };
 
-}  // namespace idealgas
\ No newline at end of file
+}  // namespace idealgas
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The Image struct is a picture of 8-bit RGB pixels, stored row by row
+ * from the top left.
+ *
+ */
+struct Image {
+  size_t width = 0;
+  size_t height = 0;
+  // Three bytes per pixel, red then green then blue
+  vector<uint8_t> pixels;
+};
+
+/**
+ * @brief Writes an image as a PNG file. The pixels are deflated with zlib
+ * when it is available, and stored uncompressed otherwise.
+ *
+ * @throws std::runtime_error when the file cannot be written
+ * @param path the path of the file
+ * @param image the image to write
+ * @param compression_level the zlib level, from 0 to 9
+ */
+void WritePng(const string& path, const Image& image,
+              int compression_level = 1);
+
+/**
+ * @brief Writes an image as a binary PPM file, the raw pixels behind a short
+ * text header, for when encoding time matters more than size.
+ *
+ * @throws std::runtime_error when the file cannot be written
+ * @param path the path of the file
+ * @param image the image to write
+ */
+void WritePpm(const string& path, const Image& image);
+
+}  // namespace idealgas
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using std::string;
+
+namespace idealgas {
+
+/**
+ * @brief Reads explicit particles into a store. A file whose name ends in
+ * .csv is read as CSV text. Any other file is read as a checkpoint written
+ * by WriteCheckpoint, whose dimensions must be the store's; the rest of its
+ * state is ignored. Either way the particles are added to the store species
+ * by species, and species already in the store keep their color and flags.
+ *
+ * A CSV file starts with a header naming its columns, in any order:
+ * species, x, y, vx, vy, mass and radius, and others that are ignored. A
+ * three-dimensional store also needs z and vz columns. Every other line is
+ * one particle. Species names may be quoted, to hold commas, but no field may
+ * hold a line break. Species new to the store are white.
+ *
+ * The text is split into chunks at line breaks and parsed on every thread of
+ * the pool twice: once to count each species' rows, so that each species'
+ * range can be grown to its final size, and once to write every row straight
+ * into its place in the arrays.
+ *
+ * @throws std::runtime_error when the file cannot be read, a line is not a
+ * particle, naming the line, or a checkpoint has other dimensions
+ * @param path the path of the file
+ * @param particles the store to add the particles to
+ * @param thread_pool the threads that parse the text
+ */
+void ReadInitialConditions(const string& path, ParticleStore& particles,
+                           ThreadPool& thread_pool);
+
+}  // namespace idealgas
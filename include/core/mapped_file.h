@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+using std::string;
+
+namespace idealgas {
+
+/**
+ * @brief The MappedFile class maps a whole file into memory read-only, so its
+ * bytes can be used in place without reading them through a stream. The
+ * mapping is released when the object is destroyed.
+ *
+ */
+class MappedFile {
+ public:
+  /**
+   * @brief Maps a file into memory.
+   *
+   * @throws std::runtime_error when the file cannot be opened or mapped
+   * @param path the path of the file
+   */
+  explicit MappedFile(const string& path);
+
+  /**
+   * @brief Unmaps the file.
+   *
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * @brief Gets the first byte of the file, aligned to a memory page.
+   *
+   * @return a pointer to the mapped bytes, or nullptr for an empty file
+   */
+  const char* data() const;
+
+  /**
+   * @brief Gets the size of the file.
+   *
+   * @return the size_t number of bytes
+   */
+  size_t size() const;
+
+ private:
+  // The mapped bytes of the file
+  const char* data_ = nullptr;
+  // The number of mapped bytes
+  size_t size_ = 0;
+  // The platform's handle of the mapping, if it needs one to unmap
+  void* mapping_ = nullptr;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,256 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using idealgas::ParticleStore;
+using idealgas::ThreadPool;
+using std::array;
+using std::pair;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The NeighborList class is a Verlet list: every pair of particles
+ * within a skin distance of touching, found once from a grid built with that
+ * skin and reused for as many steps as no particle can have crossed it. Each
+ * particle's drift since the build is its displacement plus any growth of its
+ * radius, and a pair left out of the list cannot touch until the drifts of
+ * its particles add up to more than the skin. The list is stale once any
+ * drift exceeds half the skin.
+ *
+ * The grid's cells of each color are split into segments of a fixed number of
+ * cells, and each segment keeps the pairs of its cells in compressed sparse
+ * rows: a row per particle with listed neighbors, holding their indices.
+ * Segments of one color share no particles, so they can be resolved in
+ * parallel, and both the segments and the order of their pairs are the same
+ * for every thread count.
+ *
+ */
+class NeighborList {
+ public:
+  // The grid cells in each segment
+  static constexpr size_t kCellsPerSegment = 64;
+
+  /**
+   * @brief Lists the pairs near enough among a built grid's candidate pairs,
+   * and remembers the positions and radii they were listed at.
+   *
+   * @tparam Grid CellGrid or HierarchicalGrid
+   * @tparam IsNear a callable taking two size_t particle indices and returning
+   * whether they are within the skin of touching
+   * @param particles the store the grid was built from
+   * @param periods the period of the x, y and z axes the grid was built with
+   * @param skin the skin the grid was built with
+   * @param grid the grid holding the particles
+   * @param is_near the test of whether a candidate pair is listed
+   * @param thread_pool the threads that list the pairs
+   */
+  template <typename Grid, typename IsNear>
+  void Build(const ParticleStore& particles, const array<float, 3>& periods,
+             float skin, const Grid& grid, IsNear&& is_near,
+             ThreadPool& thread_pool);
+
+  /**
+   * @brief Checks whether the list may miss a touching pair: when it was
+   * never built, was built for other particles, periods or skin, or when
+   * some particle drifted more than half the skin since.
+   *
+   * @param particles the store of particles to check
+   * @param periods the period of the x, y and z axes, or 0
+   * @param skin the skin the list should have
+   * @param thread_pool the threads that measure the drifts
+   * @return true when the list must be rebuilt
+   */
+  bool IsStale(const ParticleStore& particles, const array<float, 3>& periods,
+               float skin, ThreadPool& thread_pool) const;
+
+  /**
+   * @brief Forgets the list, so that it is stale until built again. Its
+   * memory is kept.
+   *
+   */
+  void Clear();
+
+  /**
+   * @brief Gets the number of colors of the grid the list was built from.
+   *
+   * @return the size_t number of colors
+   */
+  size_t GetColorCount() const;
+
+  /**
+   * @brief Gets the segments of one color.
+   *
+   * @param color the color, less than GetColorCount()
+   * @return the pair of the first segment and the one after the last
+   */
+  pair<size_t, size_t> GetSegmentsOfColor(size_t color) const;
+
+  /**
+   * @brief Calls the callback for every pair listed in one segment, in the
+   * order the grid visited them.
+   *
+   * @param segment the index of the segment
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachPairInSegment(size_t segment, Callback&& callback) const;
+
+  /**
+   * @brief Calls the callback for every listed pair, color by color.
+   *
+   * @param callback a callable taking the two size_t particle indices
+   */
+  template <typename Callback>
+  void ForEachPair(Callback&& callback) const;
+
+  /**
+   * @brief Gets the number of listed pairs.
+   *
+   * @return the size_t number of pairs
+   */
+  size_t GetPairCount() const;
+
+  /**
+   * @brief Gets the memory held by the list, including the capacity kept for
+   * later builds.
+   *
+   * @return the size_t number of bytes
+   */
+  size_t GetMemoryBytes() const;
+
+ private:
+  /**
+   * @brief The pairs of one run of same-colored cells, in compressed sparse
+   * rows.
+   *
+   */
+  struct Segment {
+    // The particle of each row
+    vector<uint32_t> particles;
+    // The offset of each row's neighbors, plus a final end offset
+    vector<uint32_t> starts;
+    // The neighbors of every row, one row after another
+    vector<uint32_t> neighbors;
+  };
+
+  // The fewest particles whose drifts are measured by one thread
+  const size_t kMinParticlesPerChunk = 4096;
+
+  /**
+   * @brief Remembers the particles the list is built for.
+   *
+   * @param particles the store of particles
+   * @param periods the period of the x, y and z axes, or 0
+   * @param skin the skin of the list
+   */
+  void SetReference(const ParticleStore& particles,
+                    const array<float, 3>& periods, float skin);
+
+  // The segments, of which only the first segment_count_ are in use, so that
+  // later builds reuse the memory of the rest
+  vector<Segment> segments_;
+  // The number of segments in use
+  size_t segment_count_ = 0;
+  // The first segment of each color, plus a final end
+  vector<size_t> color_starts_;
+  // Whether the list holds the pairs of its reference particles
+  bool built_ = false;
+  // The positions of the particles when the list was built, per axis
+  array<vector<float>, ParticleStore::kMaxDimensions> reference_positions_;
+  // The radii of the particles when the list was built
+  vector<float> reference_radii_;
+  // The number of axes the particles moved along when the list was built
+  size_t reference_dimensions_ = 0;
+  // The periods the list was built with
+  array<float, 3> reference_periods_ = {0, 0, 0};
+  // The skin the list was built with
+  float reference_skin_ = 0;
+};
+
+template <typename Grid, typename IsNear>
+void NeighborList::Build(const ParticleStore& particles,
+                         const array<float, 3>& periods, float skin,
+                         const Grid& grid, IsNear&& is_near,
+                         ThreadPool& thread_pool) {
+  // Every color's cells are split into segments, numbered color by color
+  color_starts_.assign(1, 0);
+  for (size_t color = 0; color < grid.GetColorCount(); ++color) {
+    size_t cell_count = grid.GetCellsOfColor(color).size();
+    color_starts_.push_back(color_starts_.back() +
+                            (cell_count + kCellsPerSegment - 1) /
+                                kCellsPerSegment);
+  }
+  segment_count_ = color_starts_.back();
+  if (segments_.size() < segment_count_) {
+    segments_.resize(segment_count_);
+  }
+
+  // Building only reads the particles, so every segment is listed at once
+  thread_pool.ParallelFor(
+      segment_count_,
+      [&](size_t begin, size_t end) {
+        for (size_t segment = begin; segment < end; ++segment) {
+          // The last color starting at or before the segment holds it, as
+          // colors without cells start where the next one does
+          size_t color = std::upper_bound(color_starts_.begin(),
+                                          color_starts_.end(), segment) -
+                         color_starts_.begin() - 1;
+          const vector<size_t>& cells = grid.GetCellsOfColor(color);
+          size_t first = (segment - color_starts_[color]) * kCellsPerSegment;
+          size_t last = std::min(first + kCellsPerSegment, cells.size());
+
+          Segment& rows = segments_[segment];
+          rows.particles.clear();
+          rows.starts.clear();
+          rows.neighbors.clear();
+          for (size_t cell = first; cell < last; ++cell) {
+            grid.ForEachCandidatePairInCell(
+                cells[cell], [&](size_t base, size_t neighbor) {
+                  if (!is_near(base, neighbor)) {
+                    return;
+                  }
+                  // A row is opened for each new base particle
+                  if (rows.particles.empty() ||
+                      rows.particles.back() != base) {
+                    rows.particles.push_back((uint32_t)base);
+                    rows.starts.push_back((uint32_t)rows.neighbors.size());
+                  }
+                  rows.neighbors.push_back((uint32_t)neighbor);
+                });
+          }
+          rows.starts.push_back((uint32_t)rows.neighbors.size());
+        }
+      },
+      1);
+  SetReference(particles, periods, skin);
+}
+
+template <typename Callback>
+void NeighborList::ForEachPairInSegment(size_t segment,
+                                        Callback&& callback) const {
+  const Segment& rows = segments_[segment];
+  for (size_t row = 0; row < rows.particles.size(); ++row) {
+    size_t base = rows.particles[row];
+    for (size_t slot = rows.starts[row]; slot < rows.starts[row + 1];
+         ++slot) {
+      callback(base, (size_t)rows.neighbors[slot]);
+    }
+  }
+}
+
+template <typename Callback>
+void NeighborList::ForEachPair(Callback&& callback) const {
+  for (size_t segment = 0; segment < segment_count_; ++segment) {
+    ForEachPairInSegment(segment, callback);
+  }
+}
+
+}  // namespace idealgas
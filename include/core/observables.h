@@ -0,0 +1,36 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "core/particle_store.h"
+
+using std::array;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The Observables struct holds the thermodynamic state of the simulated
+ * particles after one step. Particles of disabled species are left out.
+ *
+ * Temperatures are in units where Boltzmann's constant is one, so a species'
+ * temperature is the mean kinetic energy of its particles over half the
+ * number of dimensions. Pressure is the momentum given to the walls per unit
+ * of time and of wall length, or of wall area in three dimensions.
+ *
+ */
+struct Observables {
+  // The simulated time at the end of the step
+  double time = 0;
+  // The total kinetic energy
+  double kinetic_energy = 0;
+  // The total momentum, one component per axis
+  array<double, ParticleStore::kMaxDimensions> momentum = {};
+  // The pressure on the walls, averaged over the step
+  double pressure = 0;
+  // The temperature of each species, indexed by SpeciesId, or 0 for a species
+  // with no simulated particles
+  vector<double> temperatures;
+};
+
+}  // namespace idealgas
@@ -1,9 +1,9 @@
 #pragma once
 #include <string>
 
-#include "cinder/gl/gl.h"
+#include "core/color.h"
+#include "glm/glm.hpp"
 
-using ci::ColorT;
 using glm::vec2;
 using std::string;
 
@@ -33,9 +33,9 @@ class Particle {
   /**
    * @brief Gets the name of the particle.
    *
-   * @return the string name of the particle
+   * @return a reference to the string name of the particle
    */
-  string GetName() const;
+  const string& GetName() const;
 
   /**
    * @brief Sets the name of the particle.
@@ -103,9 +103,9 @@ class Particle {
   /**
    * @brief Gets the color of the particle. 
    * 
-   * @return the ColorT<float> of the particle
+   * @return a reference to the ColorT<float> of the particle
    */
-  ColorT<float> GetColor() const;
+  const ColorT<float>& GetColor() const;
 
   /**
    * @brief Sets the color of the particle. 
@@ -1,42 +1,211 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "nlohmann/json.hpp"
-#include "cinder/gl/gl.h"
+#include "core/cell_grid.h"
+#include "core/color.h"
+#include "core/event_driven_engine.h"
+#include "core/hierarchical_grid.h"
+#include "core/neighbor_list.h"
+#include "core/observables.h"
 #include "core/particle.h"
+#include "core/particle_store.h"
+#include "core/ring_buffer.h"
+#include "core/thread_pool.h"
+#include "core/wall_kernel.h"
 
 using glm::vec2;
 using nlohmann::json;
+using std::array;
 using std::map;
+using std::pair;
 using std::string;
-using std::unordered_map;
 using std::vector;
 
 namespace idealgas {
 
+struct SimulationConfig;
+class TrajectoryWriter;
+
+/**
+ * @brief The strategies for finding which pairs of particles are touching.
+ *
+ */
+enum class BroadphaseMode {
+  // Bins particles into a uniform grid and checks adjacent cells, O(n)
+  kGrid,
+  // Checks every pair of particles, O(n^2)
+  kBruteForce,
+  // Runs both and throws if the grid misses or invents a pair
+  kValidated,
+  // Bins particles into a grid per size of radius and checks adjacent cells
+  // within and across sizes, O(n) however widely the radii differ
+  kHierarchicalGrid
+};
+
+/**
+ * @brief The ways of advancing the particles through time.
+ *
+ */
+enum class SimulationMode {
+  // Moves every particle by a fixed step and resolves the overlaps found
+  kTimeStep,
+  // Jumps between exactly predicted collisions, so nothing tunnels or overlaps
+  kEventDriven
+};
+
+/**
+ * @brief The floating-point precision the particles are advanced in.
+ *
+ */
+enum class PrecisionMode {
+  // Keeps and moves everything in float
+  kSingle,
+  // Moves positions kept in double, while collisions are found and resolved
+  // in float
+  kMixed,
+  // Keeps positions and velocities in double, and resolves collisions in
+  // double
+  kDouble
+};
+
+/**
+ * @brief The settings of adaptive time stepping, which splits each time step
+ * into sub-steps short enough that no particle moves more than a fraction of
+ * its radius in one. Only the time-step engine uses them; the event-driven
+ * engine is exact already.
+ *
+ * With per-species sub-stepping, each species takes only as many sub-steps as
+ * its own fastest particle needs, rounded up to a power of two. A slow species
+ * moves once every few of the fastest species' sub-steps, by the combined
+ * time, and only pairs with a moving particle are checked for collisions.
+ */
+struct AdaptiveStepOptions {
+  // Whether steps are split into sub-steps
+  bool enabled = false;
+  // The farthest a particle may move in one sub-step, as a fraction of its
+  // radius
+  float max_displacement = 0.25f;
+  // The most sub-steps a step is split into, rounded down to a power of two
+  size_t max_substeps = 64;
+  // Whether slow species take fewer sub-steps than fast ones
+  bool per_species = true;
+};
+
+/**
+ * @brief The settings of the Verlet neighbor list, which keeps every pair of
+ * particles within a skin distance of touching and reuses it across steps
+ * until some particle has drifted more than half the skin. Only the grid
+ * broadphases use it. A wider skin rebuilds less often but checks more pairs
+ * in every step.
+ */
+struct NeighborListOptions {
+  // Whether collisions are found from the list
+  bool enabled = false;
+  // The gap by which listed pairs may miss touching, in position units
+  float skin = 2;
+};
+
+/**
+ * @brief How the neighbor list has been used since it was last reset.
+ *
+ */
+struct NeighborListStats {
+  // The collision passes that resolved pairs from the list
+  size_t passes = 0;
+  // The passes that had to rebuild the list first
+  size_t builds = 0;
+  // The pairs in the list when it was last built
+  size_t pair_count = 0;
+  // The memory held by the list, in bytes
+  size_t memory_bytes = 0;
+};
+
 /**
  * @brief The ParticleContainer class holds all the logic behind the particle
  * collisions with walls and other particles and manages the particles during
  * each time increment.
  *
+ * Particles move in two or three dimensions. The collision and overlap code
+ * is compiled once for each number of axes, with every per-axis loop
+ * unrolled, and each step picks the version for its particles.
+ *
+ * The store holds every particle in float. In mixed and double precision the
+ * container also keeps double copies of the positions, and in double
+ * precision of the velocities, which are the ones moved. The float arrays are
+ * rounded from them after every move, and a float component written from
+ * outside, which no longer matches its rounded copy, replaces the copy at the
+ * start of the next step. The grid and the vector wall kernels always work
+ * in float.
+ *
  */
 class ParticleContainer {
  public:
+  // The maximum allowed radius of a particle
+  static constexpr size_t kRadiusLimit = 100;
+  // The number of steps kept in the observable history unless configured
+  static constexpr size_t kDefaultObservableHistoryLength = 600;
+
+  /**
+   * @brief Reads and checks a configuration file, then configures the
+   * container from it.
+   *
+   * @throws json::parse_error when the file is not valid JSON
+   * @throws json::type_error when a required setting is missing
+   * @throws std::invalid_argument when a setting is out of range
+   * @throws std::runtime_error when a checkpoint or initial conditions file
+   * cannot be read
+   * @param config_path the path of the configuration file
+   * @return the SimulationConfig, with the container's size and dimensions
+   * as loaded from a checkpoint if it resumed from one
+   */
+  SimulationConfig Configure(const string& config_path);
+
   /**
-   * @brief The string map of parameters for the window read from the
-   * configuration file.
+   * @brief Configures the container from an already parsed JSON
+   * configuration, in the same format as the configuration file.
    *
-   * @return unordered_map<string, string> with key variable name and value of
-   * corresponding variable
+   * @throws json::type_error when a required setting is missing
+   * @throws std::invalid_argument when a setting is out of range
+   * @throws std::runtime_error when a checkpoint or initial conditions file
+   * cannot be read
+   * @param config the parsed configuration
+   * @return the SimulationConfig, with the container's size and dimensions
+   * as loaded from a checkpoint if it resumed from one
    */
-  unordered_map<string, string> Configure(const string& config_path);
+  SimulationConfig ConfigureFromJson(const json& config);
+
+  /**
+   * @brief Configures the container from a checked configuration: its
+   * settings, then its particles. The particles come from a checkpoint when
+   * resuming from one. Otherwise the initial conditions file, if any, is read
+   * first, on the configured threads, and then each species' random
+   * particles are added. With lattice placement, the random particles are
+   * then moved so that none overlaps another.
+   *
+   * @throws std::runtime_error when a checkpoint or initial conditions file
+   * cannot be read
+   * @throws std::invalid_argument when lattice placement cannot fit the
+   * particles
+   * @param config the SimulationConfig
+   */
+  void Configure(const SimulationConfig& config);
 
   /**
    * @brief Initializes a set of particles of a given type by creating them with
    * randomly dispersed masses, radii, and speeds within the constraints of the
-   * input.
+   * input. Each particle's state depends only on the seed, its species and its
+   * index within the species, so it is the same for every thread count. In
+   * three dimensions the z components are drawn after the others, so the x
+   * and y components are those of a two-dimensional run.
    *
    * @param name the string name of the particle type
    * @param particle_count the number of particles to initialize
@@ -68,25 +237,78 @@ class ParticleContainer {
   void Increment();
 
   /**
-   * @brief Gets a reference to the vector of particles in the container.
+   * @brief Checks and executes all collisions between particles, the first
+   * half of a time step.
+   *
+   */
+  void IncrementParticleCollisions();
+
+  /**
+   * @brief Checks and executes all collisions between particles and a wall,
+   * then moves every particle by one time step, the second half of a step.
    *
-   * @return vector<Particle>& the vector of particles in the container
    */
-  vector<Particle>& GetParticles(); 
+  void IncrementWallCollisions();
 
   /**
-   * @brief Set the particles by a vector. 
+   * @brief Gets a reference to the store of particles in the container, to
+   * write to. The event-driven engine rebuilds its events at the next step,
+   * so readers should use the const overload.
+   *
+   * @return ParticleStore& the particles in the container
+   */
+  ParticleStore& GetParticles();
+
+  /**
+   * @brief Gets a read-only reference to the store of particles in the
+   * container.
+   *
+   * @return const ParticleStore& the particles in the container
+   */
+  const ParticleStore& GetParticles() const;
+
+  /**
+   * @brief Set the particles by a vector. The species table is kept, so
+   * species IDs and names stay stable.
    * 
    * @param particles a vector of Particle objects to reset
    */
   void SetParticles(const vector<Particle>& particles);
 
+  /**
+   * @brief Shows or hides a species when drawn. Hidden particles are still
+   * simulated, so the event-driven engine keeps its events.
+   *
+   * @param species the SpeciesId to change
+   * @param visible whether the species is drawn
+   */
+  void SetSpeciesVisible(SpeciesId species, bool visible);
+
+  /**
+   * @brief Enables or disables a species in the simulation. When the species
+   * changes, the event-driven engine rebuilds its events at the next step.
+   *
+   * @param species the SpeciesId to change
+   * @param enabled whether the species is enabled
+   */
+  void SetSpeciesEnabled(SpeciesId species, bool enabled);
+
+  /**
+   * @brief Removes every particle and species, and forgets the simulated
+   * time, observables, adaptive time steps, dimensions, precision and
+   * trajectory writer, so that the container can be configured again for
+   * another run. The memory of the particle arrays and pair lists is kept.
+   * Settings no configuration covers, such as the time step, are kept too.
+   *
+   */
+  void Reset();
+
   /**
    * @brief Gets a reference to a vector of the particle type names.
    *
-   * @return the vector of particle type strings
+   * @return the vector of particle type strings, ordered by SpeciesId
    */
-  vector<string> GetParticleNames() const;
+  const vector<string>& GetParticleNames() const;
 
   /**
    * @brief Gets the current time step of the object. 
@@ -102,55 +324,643 @@ class ParticleContainer {
    */
   void SetTimeStep(float time_step);
 
- private:
-  // The maximum allowed radius of a particle
-  const size_t kRadiusLimit = 100;
-  // The nearby particle limit for checking for collisions
-  const size_t kNearbyLimit = 10;
+  /**
+   * @brief Gets the settings of adaptive time stepping.
+   *
+   * @return a reference to the AdaptiveStepOptions
+   */
+  const AdaptiveStepOptions& GetAdaptiveStepOptions() const;
 
   /**
-   * @brief Checks and executes all collisions between particles.
+   * @brief Sets the settings of adaptive time stepping.
    *
+   * @param options the AdaptiveStepOptions to set
    */
-  void IncrementParticleCollisions();
+  void SetAdaptiveStepOptions(const AdaptiveStepOptions& options);
 
   /**
-   * @brief Checks and executes all collisions between particles and a wall.
+   * @brief Gets the settings of the neighbor list.
    *
+   * @return a reference to the NeighborListOptions
    */
-  void IncrementWallCollisions();
+  const NeighborListOptions& GetNeighborListOptions() const;
+
+  /**
+   * @brief Sets the settings of the neighbor list, discarding the list and
+   * its stats.
+   *
+   * @param options the NeighborListOptions to set
+   */
+  void SetNeighborListOptions(const NeighborListOptions& options);
+
+  /**
+   * @brief Gets how often the neighbor list was rebuilt and how large it is.
+   *
+   * @return a reference to the NeighborListStats
+   */
+  const NeighborListStats& GetNeighborListStats() const;
+
+  /**
+   * @brief Gets the number of sub-steps the last step was split into, 1 when
+   * it was not split.
+   *
+   * @return the size_t number of sub-steps
+   */
+  size_t GetSubstepCount() const;
+
+  /**
+   * @brief Gets the simulated time the particles have been advanced by since
+   * they were created.
+   *
+   * @return the double simulated time
+   */
+  double GetSimulatedTime() const;
+
+  /**
+   * @brief Saves the particles, the seed, the time step, the simulated time,
+   * the simulation mode, the container size and dimensions, and the
+   * precision with the double copies it keeps to a binary checkpoint. The
+   * thread count and broadphase mode are settings of the run, not its state,
+   * and are not saved.
+   *
+   * @throws std::runtime_error when the checkpoint cannot be written
+   * @param path the path of the checkpoint
+   */
+  void SaveCheckpoint(const string& path) const;
+
+  /**
+   * @brief Replaces the particles and state of the container with those of a
+   * checkpoint written by SaveCheckpoint.
+   *
+   * @throws std::runtime_error when the file is not a readable checkpoint
+   * @param path the path of the checkpoint
+   */
+  void LoadCheckpoint(const string& path);
+
+  /**
+   * @brief Gets the observables of the most recent steps, measured during
+   * each step rather than in a separate pass over the particles.
+   *
+   * @return a reference to the RingBuffer of Observables, oldest first
+   */
+  const RingBuffer<Observables>& GetObservableHistory() const;
+
+  /**
+   * @brief Sets the number of steps kept in the observable history, which
+   * forgets the steps kept so far.
+   *
+   * @param steps the number of steps, at least one
+   */
+  void SetObservableHistoryLength(size_t steps);
+
+  /**
+   * @brief Gets the writer each step is streamed to.
+   *
+   * @return the shared_ptr to the TrajectoryWriter, or nullptr for none
+   */
+  std::shared_ptr<TrajectoryWriter> GetTrajectoryWriter() const;
+
+  /**
+   * @brief Sets the writer each step is streamed to after it is taken.
+   *
+   * @param writer the TrajectoryWriter to stream to, or nullptr to stop
+   */
+  void SetTrajectoryWriter(std::shared_ptr<TrajectoryWriter> writer);
+
+  /**
+   * @brief Gets the seed of the random initial particle states.
+   *
+   * @return the uint64_t seed
+   */
+  uint64_t GetSeed() const;
+
+  /**
+   * @brief Sets the seed of the random initial particle states. Particles
+   * initialized afterward with the same seed are bit-identical.
+   *
+   * @param seed the uint64_t seed to set
+   */
+  void SetSeed(uint64_t seed);
+
+  /**
+   * @brief Gets the number of threads used by each step.
+   *
+   * @return the size_t thread count
+   */
+  size_t GetThreadCount() const;
+
+  /**
+   * @brief Sets the number of threads used by each step. The result of a step
+   * is the same for every thread count.
+   *
+   * @param thread_count the number of threads, or 0 for every hardware thread
+   */
+  void SetThreadCount(size_t thread_count);
+
+  /**
+   * @brief Gets the instruction set used for wall reflection and integration.
+   *
+   * @return the current SimdLevel
+   */
+  SimdLevel GetSimdLevel() const;
+
+  /**
+   * @brief Sets the instruction set used for wall reflection and integration.
+   * Every level gives identical results.
+   *
+   * @throws std::invalid_argument when this processor does not support it
+   * @param level the SimdLevel to set
+   */
+  void SetSimdLevel(SimdLevel level);
+
+  /**
+   * @brief Gets the strategy used to find touching particles.
+   *
+   * @return the current BroadphaseMode
+   */
+  BroadphaseMode GetBroadphaseMode() const;
+
+  /**
+   * @brief Sets the strategy used to find touching particles.
+   *
+   * @param mode the BroadphaseMode to set
+   */
+  void SetBroadphaseMode(BroadphaseMode mode);
+
+  /**
+   * @brief Gets the way particles are advanced through time.
+   *
+   * @return the current SimulationMode
+   */
+  SimulationMode GetSimulationMode() const;
+
+  /**
+   * @brief Sets the way particles are advanced through time. In event-driven
+   * mode each call to Increment advances by exactly one time step.
+   *
+   * @throws std::invalid_argument when event-driven mode is set with a
+   * periodic axis, in three dimensions or in mixed or double precision
+   * @param mode the SimulationMode to set
+   */
+  void SetSimulationMode(SimulationMode mode);
+
+  /**
+   * @brief Gets the number of axes the particles move along.
+   *
+   * @return the size_t number of dimensions, 2 or 3
+   */
+  size_t GetDimensions() const;
+
+  /**
+   * @brief Sets the number of axes the particles move along. Particles
+   * gaining the z axis start at rest at zero along it. The event-driven
+   * engine only moves particles in two dimensions.
+   *
+   * @throws std::invalid_argument when the number is not 2 or 3, or when
+   * three dimensions are set in event-driven mode
+   * @param dimensions the number of dimensions
+   */
+  void SetDimensions(size_t dimensions);
+
+  /**
+   * @brief Gets the precision the particles are advanced in.
+   *
+   * @return the current PrecisionMode
+   */
+  PrecisionMode GetPrecisionMode() const;
+
+  /**
+   * @brief Sets the precision the particles are advanced in. The double
+   * copies a mode needs are taken from the float arrays at the next step.
+   * The event-driven engine only runs in single precision.
+   *
+   * @throws std::invalid_argument when mixed or double precision is set in
+   * event-driven mode
+   * @param mode the PrecisionMode to set
+   */
+  void SetPrecisionMode(PrecisionMode mode);
+
+  /**
+   * @brief Gets what happens to particles at the edges of the container.
+   *
+   * @return the BoundaryMode of the x, y and z axes
+   */
+  const array<BoundaryMode, 3>& GetBoundaryModes() const;
+
+  /**
+   * @brief Sets what happens to particles at the edges of the container, per
+   * axis. Along a periodic axis particles leaving one side come back in the
+   * other, collisions are found and resolved with the nearest image of each
+   * neighbor across the seam, and no pressure is measured on its walls. The
+   * event-driven engine needs walls on both axes.
+   *
+   * @throws std::invalid_argument when an axis is periodic in event-driven
+   * mode
+   * @param modes the BoundaryMode of the x, y and z axes, where the z axis
+   * only matters in three dimensions
+   */
+  void SetBoundaryModes(const array<BoundaryMode, 3>& modes);
+
+  /**
+   * @brief Gets the number of events the event-driven engine has processed.
+   *
+   * @return the size_t number of events
+   */
+  size_t GetProcessedEventCount() const;
+
+  /**
+   * @brief Finds every pair of particles that are touching or overlapping,
+   * using the current broadphase mode.
+   *
+   * @throws std::logic_error in validated mode when the grid result differs
+   * from the brute force result
+   * @return vector of index pairs, each with the smaller index first
+   */
+  const vector<pair<size_t, size_t>>& FindOverlappingPairs();
+
+ private:
+  /**
+   * @brief One block of particles of a single species, with the sums of its
+   * observables and the bounds that pick its sub-steps.
+   *
+   */
+  struct ParticleBlock {
+    // The first particle of the block
+    size_t begin;
+    // The particle after the last
+    size_t end;
+    // The species of every particle in the block
+    SpeciesId species;
+    // The total kinetic energy
+    double kinetic_energy;
+    // The total momentum, one component per axis
+    array<double, ParticleStore::kMaxDimensions> momentum;
+    // The momentum given to the walls
+    double wall_impulse;
+    // The fastest speed in the block
+    float max_speed;
+    // The smallest radius in the block
+    float min_radius;
+  };
+
+  // The fewest grid cells given to one thread when resolving collisions
+  const size_t kMinCellsPerChunk = 64;
+  // The fewest particles given to one thread when checking walls
+  const size_t kMinParticlesPerChunk = 4096;
 
   /**
    * @brief Alters two given particles' velocities as required if they are close
    * to or touching each other.
    *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type the collision is resolved in
    * @param base the index of the first particle
    * @param neighbor the index of the second particle
    * @return true when a collision has occurred
    * @return false when a collision has occurred
    */
+  template <size_t Dims, typename Scalar>
   bool ExecuteParticleCollision(size_t base, size_t neighbor);
   
   /**
-   * @brief Alters a given particle's velocity as required if they are close to
-   * a wall.
+   * @brief Executes the collision between two overlapping particles and tints
+   * the first particle when their velocities change.
    *
-   * @param index the index of the particle to check for wall collisions
-   * @return true when a collision has occurred
-   * @return false when a collision has not occurred
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type the collision is resolved in
+   * @param base the index of the first particle
+   * @param neighbor the index of the second particle
+   */
+  template <size_t Dims, typename Scalar>
+  void ResolveCollision(size_t base, size_t neighbor);
+
+  /**
+   * @brief Checks whether two particles are touching or overlapping. Particles
+   * of disabled species never are, since they do not collide.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   * @param base the index of the first particle
+   * @param neighbor the index of the second particle
+   * @return true when the particles overlap
+   * @return false when the particles are apart
+   */
+  template <size_t Dims, typename Scalar>
+  bool AreOverlapping(size_t base, size_t neighbor) const;
+
+  /**
+   * @brief Checks whether two particles are within the neighbor list's skin
+   * of touching, whether or not their species collide.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   * @param base the index of the first particle
+   * @param neighbor the index of the second particle
+   * @return true when the pair belongs in the list
+   */
+  template <size_t Dims, typename Scalar>
+  bool AreNear(size_t base, size_t neighbor) const;
+
+  /**
+   * @brief Gets the squared distance between two particles' centers, through
+   * the nearest periodic image.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   * @param base the index of the first particle
+   * @param neighbor the index of the second particle
+   * @return the Scalar squared distance
+   */
+  template <size_t Dims, typename Scalar>
+  Scalar SquaredDistance(size_t base, size_t neighbor) const;
+
+  /**
+   * @brief Checks and executes all collisions between particles, picking the
+   * version for the particles' dimensions and precision.
+   *
+   */
+  void CollideParticles();
+
+  /**
+   * @brief Checks and executes all collisions between particles, as
+   * CollideParticles does for the particles' dimensions and precision.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type collisions are found and resolved in
+   */
+  template <size_t Dims, typename Scalar>
+  void ResolveParticleCollisions();
+
+  /**
+   * @brief Checks and executes the collisions among a built grid's candidate
+   * pairs, resolving the cells of each color in parallel.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type collisions are found and resolved in
+   * @tparam Grid CellGrid or HierarchicalGrid
+   * @param grid the grid holding the particles
+   */
+  template <size_t Dims, typename Scalar, typename Grid>
+  void ResolveGridCollisions(const Grid& grid);
+
+  /**
+   * @brief Checks and executes the collisions among the neighbor list's
+   * pairs, rebuilding the list first when some particle drifted too far. The
+   * segments of each color are resolved in parallel.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type collisions are found and resolved in
+   */
+  template <size_t Dims, typename Scalar>
+  void ResolveListedCollisions();
+
+  /**
+   * @brief Reflects every particle off the walls and moves it by one time
+   * step, then records the step's observables.
+   *
+   */
+  void MoveParticles();
+
+  /**
+   * @brief Splits a step into sub-steps and takes them, as adaptive time
+   * stepping is set up to.
+   *
+   */
+  void IncrementSubsteps();
+
+  /**
+   * @brief Picks the number of sub-steps in the coming step, and how many of
+   * them each species moves once in, from each species' fastest speed and
+   * smallest radius.
+   *
+   */
+  void PlanSubsteps();
+
+  /**
+   * @brief Reflects and moves the blocks of every moving species, each by its
+   * own stride of sub-steps, and measures them after their last move.
+   *
+   * @param substep_time the length of one sub-step
+   * @param measure whether to measure the observables of the moved blocks
+   */
+  void IntegrateBlocks(float substep_time, bool measure);
+
+  /**
+   * @brief Reflects, moves and measures the blocks, as IntegrateBlocks does
+   * for the precision.
+   *
+   * @tparam Position the type of the positions moved
+   * @tparam Velocity the type of the velocities moved
+   * @param substep_time the length of one sub-step
+   * @param measure whether to measure the observables of the moved blocks
+   */
+  template <typename Position, typename Velocity>
+  void IntegrateBlocksAs(float substep_time, bool measure);
+
+  /**
+   * @brief Brings the double copies up to date with the float arrays: copies
+   * are taken whole when the particles or axes changed, and otherwise each
+   * float component that no longer matches its rounded copy replaces it.
+   * Nothing is kept in single precision. The time step that follows writes
+   * the particles without the event-driven engine, so it is reset here.
+   *
+   */
+  void SyncPrecise();
+
+  /**
+   * @brief Rounds the double copies of a range of particles into the float
+   * arrays.
+   *
+   * @param begin the first particle
+   * @param end the particle after the last
+   */
+  void RoundPrecise(size_t begin, size_t end);
+
+  /**
+   * @brief Gets the positions along an axis at a precision: the store's
+   * float array, or the double copy.
+   *
+   * @tparam Scalar float or double
+   * @param axis the axis of the component
+   * @return a reference to the vector of components
+   */
+  template <typename Scalar>
+  vector<Scalar>& PositionsOf(size_t axis);
+  template <typename Scalar>
+  const vector<Scalar>& PositionsOf(size_t axis) const;
+
+  /**
+   * @brief Gets the velocities along an axis at a precision: the store's
+   * float array, or the double copy.
+   *
+   * @tparam Scalar float or double
+   * @param axis the axis of the component
+   * @return a reference to the vector of components
+   */
+  template <typename Scalar>
+  vector<Scalar>& VelocitiesOf(size_t axis);
+  template <typename Scalar>
+  const vector<Scalar>& VelocitiesOf(size_t axis) const;
+  /**
+   * @brief Checks whether a pair of particles is checked for collisions in
+   * the current sub-step, which it is when either of them moves in it.
+   *
+   * @param base the index of the first particle
+   * @param neighbor the index of the second particle
+   * @return true when the pair is checked
+   */
+  bool IsActivePair(size_t base, size_t neighbor) const;
+
+  /**
+   * @brief Splits the particles of enabled species into blocks, each within
+   * one species, and clears their sums.
+   *
+   */
+  void FindEnabledBlocks();
+
+  /**
+   * @brief Adds a particle's kinetic energy and momentum to its block's sums.
+   *
+   * @tparam Velocity the type of the velocities measured
+   * @param block the sums of the particle's block
+   * @param index the index of the particle
+   */
+  template <typename Velocity>
+  void MeasureParticle(ParticleBlock& block, size_t index) const;
+
+  /**
+   * @brief Reduces the blocks' sums, in block order so that the result is
+   * the same for every thread count, and records them in the history.
+   *
+   * @param wall_impulse the momentum given to the walls outside the blocks
+   */
+  void RecordObservables(double wall_impulse);
+
+  /**
+   * @brief Gets the period of each axis for the grid.
+   *
+   * @return the container's width, height and depth along periodic axes, and
+   * 0 along walled ones
+   */
+  array<float, 3> GetGridPeriods() const;
+
+  /**
+   * @brief Gets the position of a neighbor's image nearest to a particle,
+   * shifted by whole periods across the seam of a periodic axis when that is
+   * closer.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions
+   * @param base the index of the particle
+   * @param neighbor the index of the neighbor
+   * @return the position of the neighbor's nearest image
+   */
+  template <size_t Dims, typename Scalar>
+  glm::vec<Dims, Scalar> NearestImage(size_t base, size_t neighbor) const;
+
+  /**
+   * @brief Finds every pair of touching particles, as FindOverlappingPairs
+   * does for the particles' dimensions and precision.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   */
+  template <size_t Dims, typename Scalar>
+  void CollectOverlappingPairs();
+
+  /**
+   * @brief Builds a grid and collects the overlapping pairs among its
+   * candidate pairs.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   * @tparam Grid CellGrid or HierarchicalGrid
+   * @param grid the grid to build
+   * @param pairs the vector to fill with overlapping index pairs
+   */
+  template <size_t Dims, typename Scalar, typename Grid>
+  void FindGridPairs(Grid& grid, vector<pair<size_t, size_t>>& pairs);
+
+  /**
+   * @brief Collects the overlapping pairs by checking every pair.
+   *
+   * @tparam Dims the number of axes the particles move along
+   * @tparam Scalar the type of the positions compared
+   * @param pairs the vector to fill with overlapping index pairs
    */
-  bool ExecuteWallCollision(size_t index);
+  template <size_t Dims, typename Scalar>
+  void FindBruteForcePairs(vector<pair<size_t, size_t>>& pairs) const;
 
-  // A vector of all the particles in the container
-  vector<Particle> particles_;
-  // A vector of the names of particle types
-  vector<string> particle_names_;
+  // All the particles in the container, stored as arrays
+  ParticleStore particles_;
+  // The uniform grid used to find nearby particles
+  CellGrid grid_;
+  // The grids by radius used to find nearby particles of very different sizes
+  HierarchicalGrid hierarchical_grid_;
+  // The strategy used to find touching particles
+  BroadphaseMode broadphase_mode_ = BroadphaseMode::kGrid;
+  // The pairs near enough to touch, kept across steps
+  NeighborList neighbor_list_;
+  // The settings of the neighbor list
+  NeighborListOptions neighbor_list_options_;
+  // How the neighbor list has been used
+  NeighborListStats neighbor_list_stats_;
+  // The overlapping pairs found during the current step
+  vector<pair<size_t, size_t>> overlapping_pairs_;
+  // The brute force pairs used to validate the grid
+  vector<pair<size_t, size_t>> validation_pairs_;
+  // The way particles are advanced through time
+  SimulationMode simulation_mode_ = SimulationMode::kTimeStep;
+  // What happens to particles at the edges of the container, per axis
+  array<BoundaryMode, 3> boundaries_ = {};
+  // The precision the particles are advanced in
+  PrecisionMode precision_mode_ = PrecisionMode::kSingle;
+  // The positions in double, one array per axis in use, kept in mixed and
+  // double precision
+  array<vector<double>, ParticleStore::kMaxDimensions> precise_positions_;
+  // The velocities in double, one array per axis in use, kept in double
+  // precision
+  array<vector<double>, ParticleStore::kMaxDimensions> precise_velocities_;
+  // The exact collision engine used in event-driven mode
+  EventDrivenEngine engine_;
+  // The instruction set used for wall reflection and integration
+  SimdLevel simd_level_ = GetSupportedSimdLevel();
+  // Whether each particle hit a wall during the current step
+  vector<uint8_t> wall_hits_;
+  // The settings of adaptive time stepping
+  AdaptiveStepOptions adaptive_options_;
+  // The number of sub-steps in the last step
+  size_t substep_count_ = 1;
+  // Whether a split step is being taken, so some species may be still
+  bool substepping_ = false;
+  // The number of sub-steps each species moves once in, indexed by SpeciesId
+  vector<size_t> species_strides_;
+  // Whether each species moves in the current sub-step, indexed by SpeciesId
+  vector<uint8_t> species_active_;
+  // The blocks of enabled particles moved during the current step
+  vector<ParticleBlock> blocks_;
+  // The number of simulated particles of each species, counted while
+  // recording
+  vector<size_t> species_counts_;
+  // The observables of the most recent steps
+  RingBuffer<Observables> observable_history_ =
+      RingBuffer<Observables>(kDefaultObservableHistoryLength);
+  // The threads shared by the collision and wall loops
+  std::shared_ptr<ThreadPool> thread_pool_ = std::make_shared<ThreadPool>(1);
+  // The writer each step is streamed to, if any
+  std::shared_ptr<TrajectoryWriter> trajectory_writer_;
+  // The seed of the random initial particle states
+  uint64_t seed_ = 0;
   // The time step for particle incrementing
   float time_step_ = 1;
-  // The pixel width of the container
-  size_t width_;
-  // The pixel height of the container
-  size_t height_;
+  // The simulated time the particles have been advanced by
+  double simulated_time_ = 0;
+  // The pixel width of the container, unbounded until configured
+  size_t width_ = std::numeric_limits<size_t>::max();
+  // The pixel height of the container, unbounded until configured
+  size_t height_ = std::numeric_limits<size_t>::max();
+  // The pixel depth of the container, unbounded until configured
+  size_t depth_ = std::numeric_limits<size_t>::max();
 };
 
 }  // namespace idealgas
\ No newline at end of file
@@ -0,0 +1,517 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/color.h"
+#include "core/particle.h"
+#include "glm/glm.hpp"
+
+using glm::vec2;
+using idealgas::Particle;
+using std::array;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+// The small integer ID of a particle species in a ParticleStore
+using SpeciesId = uint16_t;
+
+class ParticleStore;
+
+/**
+ * @brief The ParticleView class is a lightweight handle to one particle inside
+ * a ParticleStore. It has the same getters and setters as Particle, but reads
+ * and writes the store's arrays directly.
+ *
+ */
+class ParticleView {
+ public:
+  /**
+   * @brief Constructs a view of a particle in a store.
+   *
+   * @param store the store containing the particle
+   * @param index the index of the particle in the store
+   */
+  ParticleView(ParticleStore* store, size_t index);
+
+  /**
+   * @brief Copies the viewed particle into a standalone Particle.
+   *
+   * @return the Particle with the same properties
+   */
+  operator Particle() const;
+
+  /**
+   * @brief Gets the name of the particle's species.
+   *
+   * @return a reference to the string name of the species
+   */
+  const string& GetName() const;
+
+  /**
+   * @brief Moves the particle to the species with the given name, adding the
+   * species if it is new. The particle moves into its new species' range, so
+   * the indices of particles may change.
+   *
+   * @param name the string name to be set
+   */
+  void SetName(const string& name);
+
+  /**
+   * @brief Gets the position of the particle.
+   *
+   * @return the vec2 position of the particle
+   */
+  vec2 GetPosition() const;
+
+  /**
+   * @brief Sets the position of the particle.
+   *
+   * @param position the vec2 position of the particle to be set
+   */
+  void SetPosition(const vec2& position);
+
+  /**
+   * @brief Gets the velocity of the particle.
+   *
+   * @return the vec2 velocity of the particle
+   */
+  vec2 GetVelocity() const;
+
+  /**
+   * @brief Sets the velocity of the particle.
+   *
+   * @param velocity the vec2 velocity of the particle to be set
+   */
+  void SetVelocity(const vec2& velocity);
+
+  /**
+   * @brief Gets the mass of the particle.
+   *
+   * @return the float mass of the particle
+   */
+  float GetMass() const;
+
+  /**
+   * @brief Sets the mass of the particle.
+   *
+   * @param mass the float mass of the particle to be set
+   */
+  void SetMass(float mass);
+
+  /**
+   * @brief Gets the radius of the particle.
+   *
+   * @return the float radius of the particle
+   */
+  float GetRadius() const;
+
+  /**
+   * @brief Sets the radius of the particle.
+   *
+   * @param radius the float radius of the particle to be set
+   */
+  void SetRadius(float radius);
+
+  /**
+   * @brief Gets the color of the particle.
+   *
+   * @return a reference to the ColorT<float> of the particle
+   */
+  const ColorT<float>& GetColor() const;
+
+  /**
+   * @brief Sets the color of the particle.
+   *
+   * @param color the ColorT<float> of the particle to be set
+   */
+  void SetColor(const ColorT<float>& color);
+
+ private:
+  // The store containing the particle
+  ParticleStore* store_;
+  // The index of the particle in the store
+  size_t index_;
+};
+
+/**
+ * @brief The ParticleStore class holds every particle as a structure of
+ * arrays, so that the collision and integration loops only stream the
+ * position, velocity, mass, and radius data they use. Names and base colors
+ * are interned once per species and referenced by a SpeciesId.
+ *
+ * The particles of each species are kept in one contiguous range, ordered by
+ * SpeciesId, so that a species can be drawn, measured or skipped as a whole.
+ * Each species also has a visible flag, for drawing and statistics, and an
+ * enabled flag, for the simulation, which are independent of each other.
+ *
+ * A store holds two or three axes of positions and velocities. The vec2
+ * accessors, and Particle, only see the x and y axes, and particles added
+ * through them start at rest at zero along the z axis.
+ *
+ */
+class ParticleStore {
+ public:
+  // The most spatial axes stored for positions and velocities
+  static constexpr size_t kMaxDimensions = 3;
+
+  /**
+   * @brief The Iterator class steps through the store, yielding a
+   * ParticleView for each particle.
+   *
+   */
+  class Iterator {
+   public:
+    Iterator(ParticleStore* store, size_t index);
+    ParticleView operator*() const;
+    Iterator& operator++();
+    bool operator==(const Iterator& other) const;
+    bool operator!=(const Iterator& other) const;
+
+   private:
+    // The store being iterated
+    ParticleStore* store_;
+    // The index of the current particle
+    size_t index_;
+  };
+
+  /**
+   * @brief Gets the number of spatial axes of positions and velocities.
+   *
+   * @return the size_t number of axes, 2 unless set
+   */
+  size_t GetDimensions() const;
+
+  /**
+   * @brief Sets the number of spatial axes of positions and velocities. New
+   * axes start at zero for every particle, and dropped axes are forgotten.
+   *
+   * @throws std::invalid_argument when the number is not 2 or 3
+   * @param dimensions the number of axes
+   */
+  void SetDimensions(size_t dimensions);
+
+  /**
+   * @brief Gets the ID of a species, adding it to the species table if a
+   * species with that name does not exist yet.
+   *
+   * @param name the string name of the species
+   * @param color the base color of the species, used only when it is new
+   * @return the SpeciesId of the species
+   */
+  SpeciesId InternSpecies(const string& name, const ColorT<float>& color);
+
+  /**
+   * @brief Gets the name of a species.
+   *
+   * @param species the SpeciesId to look up
+   * @return a reference to the string name of the species
+   */
+  const string& GetSpeciesName(SpeciesId species) const;
+
+  /**
+   * @brief Gets the base color of a species.
+   *
+   * @param species the SpeciesId to look up
+   * @return a reference to the ColorT<float> of the species
+   */
+  const ColorT<float>& GetSpeciesColor(SpeciesId species) const;
+
+  /**
+   * @brief Gets the names of every species, ordered by SpeciesId.
+   *
+   * @return a reference to the vector of species names
+   */
+  const vector<string>& GetSpeciesNames() const;
+
+  /**
+   * @brief Gets the range of indices holding the particles of a species.
+   *
+   * @param species the SpeciesId to look up
+   * @return the pair of the first index and the index after the last
+   */
+  pair<size_t, size_t> GetSpeciesRange(SpeciesId species) const;
+
+  /**
+   * @brief Checks whether a species is drawn and counted in statistics.
+   *
+   * @param species the SpeciesId to look up
+   * @return true when the species is visible, as every species starts
+   */
+  bool IsSpeciesVisible(SpeciesId species) const;
+
+  /**
+   * @brief Shows or hides a species when drawing and in statistics. Hidden
+   * particles are still simulated.
+   *
+   * @param species the SpeciesId to change
+   * @param visible whether the species is visible
+   */
+  void SetSpeciesVisible(SpeciesId species, bool visible);
+
+  /**
+   * @brief Checks whether a species is simulated.
+   *
+   * @param species the SpeciesId to look up
+   * @return true when the species is enabled, as every species starts
+   */
+  bool IsSpeciesEnabled(SpeciesId species) const;
+
+  /**
+   * @brief Enables or disables a species in the simulation. Disabled particles
+   * keep their state but neither move nor collide until enabled again.
+   *
+   * @param species the SpeciesId to change
+   * @param enabled whether the species is enabled
+   */
+  void SetSpeciesEnabled(SpeciesId species, bool enabled);
+
+  /**
+   * @brief Checks whether the particle at an index is simulated.
+   *
+   * @param index the index of the particle
+   * @return true when the particle's species is enabled
+   */
+  bool IsEnabled(size_t index) const {
+    return species_enabled_[species_[index]];
+  }
+
+  /**
+   * @brief Adds a copy of a standalone particle, interning its species. Like
+   * every way of adding particles, it goes at the end of its species' range.
+   *
+   * @param particle the Particle to add
+   */
+  void Add(const Particle& particle);
+
+  /**
+   * @brief Appends a particle of an already interned species, with the
+   * species' base color.
+   *
+   * @param species the SpeciesId of the particle
+   * @param position the vec2 position of the particle
+   * @param velocity the vec2 velocity of the particle
+   * @param mass the float mass of the particle
+   * @param radius the float radius of the particle
+   */
+  void Add(SpeciesId species, const vec2& position, const vec2& velocity,
+           float mass, float radius);
+
+  /**
+   * @brief Appends a number of particles of an already interned species, at
+   * rest at the origin with no mass or radius, to be filled in through the
+   * arrays.
+   *
+   * @param species the SpeciesId of the particles
+   * @param count the number of particles to append
+   * @return the index of the first new particle
+   */
+  size_t Append(SpeciesId species, size_t count);
+
+  /**
+   * @brief Reorders the particles by species, keeping their order within each
+   * species, after the species array was written directly.
+   *
+   */
+  void GroupBySpecies();
+
+  /**
+   * @brief Removes every particle while keeping the species table.
+   *
+   */
+  void Clear();
+
+  /**
+   * @brief Removes every particle and forgets the species table, keeping the
+   * memory of every array for the particles added next.
+   *
+   */
+  void Reset();
+
+  /**
+   * @brief Reserves room for a number of particles in every array.
+   *
+   * @param capacity the number of particles to reserve room for
+   */
+  void Reserve(size_t capacity);
+
+  /**
+   * @brief Gets the number of particles in the store.
+   *
+   * @return the size_t particle count
+   */
+  size_t size() const;
+
+  /**
+   * @brief Checks whether the store has no particles.
+   *
+   * @return true when the store is empty
+   */
+  bool empty() const;
+
+  /**
+   * @brief Gets a view of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @return the ParticleView of the particle
+   */
+  ParticleView operator[](size_t index);
+
+  /**
+   * @brief Gets a standalone copy of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @return the Particle copy
+   */
+  Particle operator[](size_t index) const;
+
+  /**
+   * @brief Gets an iterator to the first particle.
+   *
+   * @return the Iterator at index zero
+   */
+  Iterator begin();
+
+  /**
+   * @brief Gets an iterator past the last particle.
+   *
+   * @return the Iterator at index size()
+   */
+  Iterator end();
+
+  /**
+   * @brief Gets the position of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @return the vec2 position
+   */
+  vec2 GetPosition(size_t index) const;
+
+  /**
+   * @brief Sets the position of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @param position the vec2 position to be set
+   */
+  void SetPosition(size_t index, const vec2& position);
+
+  /**
+   * @brief Gets the velocity of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @return the vec2 velocity
+   */
+  vec2 GetVelocity(size_t index) const;
+
+  /**
+   * @brief Sets the velocity of the particle at an index.
+   *
+   * @param index the index of the particle
+   * @param velocity the vec2 velocity to be set
+   */
+  void SetVelocity(size_t index, const vec2& velocity);
+
+  /**
+   * @brief Gets the speed of the particle at an index, over every axis.
+   *
+   * @param index the index of the particle
+   * @return the float speed
+   */
+  float GetSpeed(size_t index) const;
+
+  /**
+   * @brief Gets the contiguous array of one position component.
+   *
+   * @param axis the axis of the component, 0 for x, 1 for y and 2 for z
+   * @return a reference to the vector of components
+   */
+  vector<float>& GetPositions(size_t axis);
+  const vector<float>& GetPositions(size_t axis) const;
+
+  /**
+   * @brief Gets the contiguous array of one velocity component.
+   *
+   * @param axis the axis of the component, 0 for x, 1 for y and 2 for z
+   * @return a reference to the vector of components
+   */
+  vector<float>& GetVelocities(size_t axis);
+  const vector<float>& GetVelocities(size_t axis) const;
+
+  /**
+   * @brief Gets the contiguous array of masses.
+   *
+   * @return a reference to the vector of masses
+   */
+  vector<float>& GetMasses();
+  const vector<float>& GetMasses() const;
+
+  /**
+   * @brief Gets the contiguous array of radii.
+   *
+   * @return a reference to the vector of radii
+   */
+  vector<float>& GetRadii();
+  const vector<float>& GetRadii() const;
+
+  /**
+   * @brief Gets the contiguous array of species IDs. After writing to it,
+   * call GroupBySpecies to restore the species ranges.
+   *
+   * @return a reference to the vector of SpeciesIds
+   */
+  vector<SpeciesId>& GetSpecies();
+  const vector<SpeciesId>& GetSpecies() const;
+
+  /**
+   * @brief Gets the contiguous array of particle colors, which start as their
+   * species' color and are tinted by collisions.
+   *
+   * @return a reference to the vector of colors
+   */
+  vector<ColorT<float>>& GetColors();
+  const vector<ColorT<float>>& GetColors() const;
+
+ private:
+  /**
+   * @brief Inserts a number of particles, at rest at the origin with no mass
+   * or radius, at the end of a species' range.
+   *
+   * @param species the SpeciesId of the particles
+   * @param count the number of particles to insert
+   * @return the index of the first new particle
+   */
+  size_t Insert(SpeciesId species, size_t count);
+
+  // The number of axes in use, whose arrays hold every particle
+  size_t dimensions_ = 2;
+  // The position components of every particle, one array per axis in use
+  array<vector<float>, kMaxDimensions> positions_;
+  // The velocity components of every particle, one array per axis in use
+  array<vector<float>, kMaxDimensions> velocities_;
+  // The mass of every particle
+  vector<float> masses_;
+  // The radius of every particle
+  vector<float> radii_;
+  // The species of every particle
+  vector<SpeciesId> species_;
+  // The current color of every particle, only touched when it collides
+  vector<ColorT<float>> colors_;
+
+  // The name of every species, indexed by SpeciesId
+  vector<string> species_names_;
+  // The base color of every species, indexed by SpeciesId
+  vector<ColorT<float>> species_colors_;
+  // The first index of every species' range, with one extra entry for the end
+  vector<size_t> species_starts_ = {0};
+  // Whether every species is drawn, indexed by SpeciesId
+  vector<uint8_t> species_visible_;
+  // Whether every species is simulated, indexed by SpeciesId
+  vector<uint8_t> species_enabled_;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using std::array;
+
+namespace idealgas {
+
+/**
+ * @brief The Philox class is the Philox4x32-10 counter-based random number
+ * generator. Each block of four random words is a pure function of a counter
+ * and a key, so any particle's numbers can be drawn on any thread, in any
+ * order, without sharing generator state.
+ *
+ * A Philox object is a short stream of numbers for one (seed, stream, index)
+ * triple, drawn from consecutive blocks.
+ *
+ */
+class Philox {
+ public:
+  // Four 32-bit counter words, or four random words
+  using Block = array<uint32_t, 4>;
+  // Two 32-bit key words
+  using Key = array<uint32_t, 2>;
+
+  /**
+   * @brief Generates the block of random words for a counter and key.
+   *
+   * @param counter the Block counter
+   * @param key the Key
+   * @return the Block of random words
+   */
+  static Block Generate(const Block& counter, const Key& key);
+
+  /**
+   * @brief Constructs the stream of numbers for one item.
+   *
+   * @param seed the 64-bit seed, used as the key
+   * @param stream the stream the item belongs to, such as its species
+   * @param index the 64-bit index of the item within its stream
+   */
+  Philox(uint64_t seed, uint32_t stream, uint64_t index);
+
+  /**
+   * @brief Draws the next random word.
+   *
+   * @return the uint32_t random word
+   */
+  uint32_t NextUint();
+
+  /**
+   * @brief Draws a float uniformly distributed in [0, 1), using the top 24
+   * bits of a word.
+   *
+   * @return the float random number
+   */
+  float NextFloat();
+
+  /**
+   * @brief Draws a double uniformly distributed in [min, max).
+   *
+   * @param min the lower bound
+   * @param max the upper bound
+   * @return the double random number
+   */
+  double NextUniform(double min, double max);
+
+ private:
+  // The counter of the next block, whose last word numbers the blocks
+  Block counter_;
+  // The key derived from the seed
+  Key key_;
+  // The current block of random words
+  Block block_;
+  // The next unused word of the current block
+  size_t next_word_;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using std::array;
+using std::pair;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The ways of placing randomly initialized particles.
+ *
+ */
+enum class PlacementMode {
+  // Draws every position uniformly, so particles may start overlapping
+  kUniform,
+  // Fills random cells of a jittered lattice, so no two particles overlap
+  kLattice
+};
+
+/**
+ * @brief Moves particles so that none overlaps another particle or a wall.
+ *
+ * The container is covered by a lattice of square cells, or cubic cells in
+ * three dimensions, each wide enough for the largest particle being placed.
+ * The cells touched by particles outside the ranges are blocked. Each range
+ * gets its own share of the free cells, which are shuffled, and each of its
+ * cells is split into as many sub-cells as fit its largest particle. Every
+ * particle then sits in its own sub-cell, jittered as far as its radius
+ * allows. Particles in different sub-cells cannot touch, so no overlap check
+ * is needed, and the work is linear in the particles and cells.
+ *
+ * Positions depend only on the seed and the particles, so they are the same
+ * for every thread count.
+ *
+ * @throws std::invalid_argument when the lattice has too few free cells for
+ * the particles, before any particle is moved
+ * @param particles the store holding the particles
+ * @param ranges the index ranges of the particles to place, such as one per
+ * species; every other particle stays where it is
+ * @param extents the width, height and depth of the container, where the
+ * depth only matters for a three-dimensional store
+ * @param seed the seed of the shuffle and the jitter
+ * @param thread_pool the threads that place the particles
+ */
+void PlaceWithoutOverlaps(ParticleStore& particles,
+                          const vector<pair<size_t, size_t>>& ranges,
+                          const array<float, 3>& extents, uint64_t seed,
+                          ThreadPool& thread_pool);
+
+}  // namespace idealgas
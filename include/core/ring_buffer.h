@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The RingBuffer class keeps the most recent values of a time series,
+ * overwriting the oldest once it is full. Slots are reused, so pushing a value
+ * that owns memory allocates nothing once every slot has grown.
+ *
+ */
+template <typename T>
+class RingBuffer {
+ public:
+  /**
+   * @brief Constructs an empty ring.
+   *
+   * @param capacity the number of values kept, at least one
+   */
+  explicit RingBuffer(size_t capacity = 1) {
+    SetCapacity(capacity);
+  }
+
+  /**
+   * @brief Changes the number of values kept, forgetting every value.
+   *
+   * @param capacity the number of values kept, at least one
+   */
+  void SetCapacity(size_t capacity) {
+    slots_.resize(std::max<size_t>(capacity, 1));
+    Clear();
+  }
+
+  /**
+   * @brief Gets the number of values kept.
+   *
+   * @return the size_t capacity
+   */
+  size_t GetCapacity() const {
+    return slots_.size();
+  }
+
+  /**
+   * @brief Forgets every value, keeping the slots' memory.
+   *
+   */
+  void Clear() {
+    start_ = 0;
+    size_ = 0;
+  }
+
+  /**
+   * @brief Makes room for a new value, dropping the oldest when full.
+   *
+   * @return a reference to the slot to fill, still holding an old value
+   */
+  T& Push() {
+    if (size_ < slots_.size()) {
+      return slots_[(start_ + size_++) % slots_.size()];
+    }
+    T& slot = slots_[start_];
+    start_ = (start_ + 1) % slots_.size();
+    return slot;
+  }
+
+  /**
+   * @brief Gets the number of values held.
+   *
+   * @return the size_t number of values
+   */
+  size_t size() const {
+    return size_;
+  }
+
+  /**
+   * @brief Checks whether the ring holds no values.
+   *
+   * @return true when the ring is empty
+   */
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /**
+   * @brief Gets a value by age.
+   *
+   * @param index the index of the value, 0 for the oldest
+   * @return a reference to the value
+   */
+  const T& operator[](size_t index) const {
+    return slots_[(start_ + index) % slots_.size()];
+  }
+
+  /**
+   * @brief Gets the newest value. The ring must not be empty.
+   *
+   * @return a reference to the value
+   */
+  const T& back() const {
+    return (*this)[size_ - 1];
+  }
+
+ private:
+  // The slots of the ring, some of them holding values
+  vector<T> slots_;
+  // The slot of the oldest value
+  size_t start_ = 0;
+  // The number of values held
+  size_t size_ = 0;
+};
+
+}  // namespace idealgas
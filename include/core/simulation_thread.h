@@ -0,0 +1,180 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/color.h"
+#include "core/histogram.h"
+#include "core/observables.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/triple_buffer.h"
+
+using std::function;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The bins of one species' speed histogram, ready to draw.
+ *
+ */
+struct HistogramSnapshot {
+  string title;
+  // Whether the species is visible, and so drawn
+  bool visible = true;
+  // The normalized height of each bin, empty before the first value
+  vector<float> bin_heights;
+  // The upper cutoff of each bin
+  vector<float> bin_cutoffs;
+};
+
+/**
+ * @brief The SimulationSnapshot struct is what a frame draws: the particles
+ * and histograms after one step.
+ *
+ */
+struct SimulationSnapshot {
+  // The number of steps taken before the snapshot
+  uint64_t step = 0;
+  // The position components of every particle, one array per axis, of which
+  // the x and y axes are drawn
+  array<vector<float>, ParticleStore::kMaxDimensions> positions;
+  // The radius of every particle
+  vector<float> radii;
+  // The current color of every particle
+  vector<ColorT<float>> colors;
+  // The ranges of particles whose species are visible, each the first index
+  // and the index after the last
+  vector<pair<size_t, size_t>> visible_ranges;
+  // The speed histogram of every species, indexed by SpeciesId
+  vector<HistogramSnapshot> histograms;
+  // The observables measured during the step
+  Observables observables;
+};
+
+/**
+ * @brief The SimulationThread class steps a container on its own thread at
+ * a steady rate, so that drawing never waits on the physics. After every step
+ * it publishes a SimulationSnapshot through a TripleBuffer, which a render
+ * thread reads in place.
+ *
+ * Once started, the container belongs to the simulation thread. Other threads
+ * change it only through commands, which run between steps.
+ *
+ */
+class SimulationThread {
+ public:
+  /**
+   * @brief Constructs a stopped simulation of a container.
+   *
+   * @param container the container to step, which must outlive the thread
+   * @param histogram_bin_count the number of bins in each species' histogram
+   * @param histogram_window_steps the number of recent steps in each
+   * histogram, or 0 for every step
+   * @param steps_per_second the steps taken per second of wall time, or 0 to
+   * step as fast as possible
+   */
+  SimulationThread(ParticleContainer& container, size_t histogram_bin_count,
+                   size_t histogram_window_steps, double steps_per_second);
+
+  /**
+   * @brief Stops the thread.
+   *
+   */
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread&) = delete;
+  SimulationThread& operator=(const SimulationThread&) = delete;
+
+  /**
+   * @brief Publishes a snapshot of the container as it is, then starts
+   * stepping it on the simulation thread.
+   *
+   */
+  void Start();
+
+  /**
+   * @brief Stops stepping and joins the simulation thread, after running any
+   * commands still waiting. The container then belongs to the caller again.
+   *
+   */
+  void Stop();
+
+  /**
+   * @brief Queues a command to run on the simulation thread before its next
+   * step. Commands run in the order they are posted.
+   *
+   * @param command the command, given the container
+   */
+  void Post(function<void(ParticleContainer&)> command);
+
+  /**
+   * @brief Gets the latest snapshot. Only one thread may read snapshots.
+   *
+   * @return a reference to the snapshot, valid until the next call
+   */
+  const SimulationSnapshot& AcquireSnapshot();
+
+ private:
+  /**
+   * @brief Steps the container and publishes snapshots until stopped.
+   *
+   */
+  void Run();
+
+  /**
+   * @brief Runs the queued commands.
+   *
+   */
+  void RunCommands();
+
+  /**
+   * @brief Adds every visible particle's speed to its species' histogram and
+   * completes the step.
+   *
+   */
+  void UpdateHistograms();
+
+  /**
+   * @brief Copies the particles and histograms into the producer's snapshot
+   * and publishes it.
+   *
+   */
+  void PublishSnapshot();
+
+  // The container being stepped
+  ParticleContainer& container_;
+  // The number of bins in each histogram
+  size_t histogram_bin_count_;
+  // The number of recent steps in each histogram, or 0 for every step
+  size_t histogram_window_steps_;
+  // The wall time between steps, or zero for none
+  double step_seconds_;
+  // The histogram of each species' speeds, indexed by SpeciesId
+  vector<Histogram> histograms_;
+  // The number of steps taken
+  uint64_t step_ = 0;
+
+  // The snapshots handed to the render thread
+  TripleBuffer<SimulationSnapshot> snapshots_;
+  // The commands waiting to run
+  vector<function<void(ParticleContainer&)>> commands_;
+  // The commands being run, swapped with commands_ to run outside the lock
+  vector<function<void(ParticleContainer&)>> running_commands_;
+  // Guards commands_
+  std::mutex commands_mutex_;
+  // Whether the thread should keep stepping
+  std::atomic<bool> running_{false};
+  // The simulation thread
+  std::thread thread_;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,176 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/color.h"
+#include "core/config.h"
+#include "core/histogram.h"
+#include "core/image_writer.h"
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The SoftwareRenderer class draws the visualizer's scene on the CPU,
+ * with no window or GPU: the container frame, a solid circle per particle and
+ * a speed histogram per species, laid out as IdealGasVisualizer lays them
+ * out. Text needs the window's fonts, so titles and labels are left out.
+ *
+ * The image is split into bands of rows drawn in parallel. Each band draws
+ * only the shapes that reach it, in the same order, so the image is the same
+ * for every thread count.
+ *
+ */
+class SoftwareRenderer {
+ public:
+  /**
+   * @brief Constructs a renderer for the window described by a configuration.
+   *
+   * @param config the SimulationConfig returned by
+   * ParticleContainer::Configure
+   * @param thread_count the number of threads to draw with, or 0 for every
+   * hardware thread
+   */
+  SoftwareRenderer(const SimulationConfig& config, size_t thread_count = 1);
+
+  /**
+   * @brief Adds the speed of every particle to its species' histogram and
+   * completes the step, as the visualizer does once per frame.
+   *
+   * @param particles the particles after the step
+   */
+  void UpdateHistograms(const ParticleStore& particles);
+
+  /**
+   * @brief Draws the scene into the image.
+   *
+   * @param particles the particles to draw
+   */
+  void Render(const ParticleStore& particles);
+
+  /**
+   * @brief Gets the image drawn by the last call to Render.
+   *
+   * @return the Image, the size of the window
+   */
+  const Image& GetImage() const;
+
+ private:
+  // The number of rows in each band drawn by one thread
+  const size_t kBandRows = 32;
+
+  /**
+   * @brief A solid axis-aligned rectangle. Pixels whose centers fall inside
+   * it are filled.
+   *
+   */
+  struct Rect {
+    float left;
+    float top;
+    float right;
+    float bottom;
+    ColorT<float> color;
+  };
+
+  /**
+   * @brief Adds the four sides of a stroked rectangle, centered on its edges
+   * like Cinder's drawStrokedRect.
+   *
+   * @param rects the rectangles to add to
+   * @param left the left edge
+   * @param top the top edge
+   * @param right the right edge
+   * @param bottom the bottom edge
+   * @param color the stroke color
+   */
+  void AddStrokedRect(vector<Rect>& rects, float left, float top, float right,
+                      float bottom, const ColorT<float>& color) const;
+
+  /**
+   * @brief Lays out the frame and bars of each species' histogram, as
+   * HistogramPlot draws them.
+   *
+   * @param particles the particles whose species are plotted
+   */
+  void LayOutHistograms(const ParticleStore& particles);
+
+  /**
+   * @brief Lists the particles that reach each band, in index order.
+   *
+   * @param particles the particles to list
+   */
+  void BinParticles(const ParticleStore& particles);
+
+  /**
+   * @brief Draws every shape that reaches a band.
+   *
+   * @param band the band to draw
+   * @param particles the particles to draw
+   */
+  void DrawBand(size_t band, const ParticleStore& particles);
+
+  /**
+   * @brief Fills the part of a rectangle within some rows.
+   *
+   * @param rect the rectangle to fill
+   * @param row_begin the first row
+   * @param row_end the row after the last
+   */
+  void FillRect(const Rect& rect, size_t row_begin, size_t row_end);
+
+  /**
+   * @brief Fills the part of a circle within some rows.
+   *
+   * @param center_x the x position of the center
+   * @param center_y the y position of the center
+   * @param radius the radius
+   * @param color the fill color
+   * @param row_begin the first row
+   * @param row_end the row after the last
+   */
+  void FillCircle(float center_x, float center_y, float radius,
+                  const ColorT<float>& color, size_t row_begin,
+                  size_t row_end);
+
+  // The image being drawn
+  Image image_;
+  // The pixel margin around the container and other objects
+  size_t margin_;
+  // The pixel width of the stroke used to draw boundaries
+  size_t stroke_;
+  // The pixel width of the particle container
+  size_t container_width_;
+  // The pixel height of the particle container
+  size_t container_height_;
+  // The color of the background
+  ColorT<float> background_color_;
+  // The color of the stroke used to draw the boundaries
+  ColorT<float> stroke_color_;
+  // The color of the histogram bars, which the visualizer shares with text
+  ColorT<float> bar_color_;
+
+  // The number of bins in each histogram
+  size_t histogram_bin_count_;
+  // The number of recent steps plotted by each histogram, or 0 for every step
+  size_t histogram_window_steps_;
+  // The histogram of each species' speeds, indexed by SpeciesId
+  vector<Histogram> histograms_;
+
+  // The rectangles drawn under the particles
+  vector<Rect> back_rects_;
+  // The rectangles drawn over the particles
+  vector<Rect> front_rects_;
+  // The particles reaching each band, concatenated band after band
+  vector<uint32_t> band_particles_;
+  // The start of each band's particles, with one extra entry for the end
+  vector<size_t> band_starts_;
+  // The threads that draw the bands
+  std::unique_ptr<ThreadPool> thread_pool_;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+using nlohmann::json;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief What one job of a sweep measured.
+ *
+ */
+struct SweepResult {
+  // The value of every swept setting in the job's configuration, in the
+  // order of the sweep's columns, or null where the setting is absent
+  vector<json> values;
+  // The number of particles simulated
+  size_t particle_count = 0;
+  // The number of steps taken
+  size_t steps = 0;
+  // The seed of the job's particles
+  uint64_t seed = 0;
+  // The wall time the steps took
+  double seconds = 0;
+  // The particles advanced per second of wall time
+  double throughput = 0;
+  // The total kinetic energy after the last step
+  double kinetic_energy = 0;
+  // The temperature of the simulated particles after the last step, their
+  // mean kinetic energy over half the number of dimensions
+  double temperature = 0;
+  // The pressure on the walls, averaged over the observable history
+  double pressure = 0;
+  // Why the job could not run, or empty when it ran
+  string error;
+};
+
+/**
+ * @brief The Sweep class expands a sweep specification into jobs, each a
+ * copy of one configuration with some settings overridden, and runs them.
+ *
+ * A specification is a JSON object. Its "product" is a list of
+ * {"path": ..., "values": [...]} entries whose values are combined in every
+ * way, the last entry varying fastest. Its "points" is a list of objects,
+ * each mapping paths to values, that are overridden together. With both,
+ * every point is combined with every product combination. Its optional
+ * "steps" sets the steps each job takes. A path is either a JSON pointer,
+ * such as "/container/particles/Tiny, Speedy Particle/particle count", or
+ * the same keys joined with dots.
+ *
+ * Jobs run concurrently, one per thread, taken from a shared queue. Each
+ * thread keeps one container and resets it between jobs, so the particle
+ * arrays are allocated once per thread rather than once per job.
+ *
+ */
+class Sweep {
+ public:
+  /**
+   * @brief Constructs the jobs of a sweep over a configuration.
+   *
+   * @throws std::invalid_argument when the specification is malformed
+   * @param config the parsed configuration every job starts from
+   * @param spec the parsed sweep specification
+   */
+  Sweep(const json& config, const json& spec);
+
+  /**
+   * @brief Gets the swept settings, as JSON pointers in the order they first
+   * appear in the specification.
+   *
+   * @return the vector of pointer strings
+   */
+  const vector<string>& GetColumns() const;
+
+  /**
+   * @brief Gets the number of jobs the specification expands into.
+   *
+   * @return the size_t job count
+   */
+  size_t GetJobCount() const;
+
+  /**
+   * @brief Gets the steps each job takes, 1000 unless the specification says
+   * otherwise.
+   *
+   * @return the size_t step count
+   */
+  size_t GetSteps() const;
+
+  /**
+   * @brief Sets the steps each job takes.
+   *
+   * @param steps the size_t step count
+   */
+  void SetSteps(size_t steps);
+
+  /**
+   * @brief Builds the configuration of one job. Jobs step on a single thread
+   * and write no checkpoints or trajectories.
+   *
+   * @param job the index of the job
+   * @return the json configuration
+   */
+  json GetJobConfig(size_t job) const;
+
+  /**
+   * @brief Runs every job. A job whose configuration is rejected records why
+   * instead of stopping the sweep.
+   *
+   * @param thread_count the number of jobs run at once, or 0 for every
+   * hardware thread
+   * @return the SweepResult of every job, in job order
+   */
+  vector<SweepResult> Run(size_t thread_count) const;
+
+  /**
+   * @brief Writes results as a CSV table, one row per job, with a column for
+   * every swept setting followed by the measurements.
+   *
+   * @param output the stream to write to
+   * @param results the results of Run
+   */
+  void WriteTable(std::ostream& output,
+                  const vector<SweepResult>& results) const;
+
+ private:
+  // The steps each job takes when the specification does not say
+  static constexpr size_t kDefaultSteps = 1000;
+
+  // The configuration every job starts from
+  json config_;
+  // The overrides of every job, as pointers and values
+  vector<vector<pair<string, json>>> jobs_;
+  // The swept settings, as pointers
+  vector<string> columns_;
+  // The steps each job takes
+  size_t steps_ = kDefaultSteps;
+};
+
+}  // namespace idealgas
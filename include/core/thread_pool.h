@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::function;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The ThreadPool class keeps a fixed set of worker threads that split
+ * loops into contiguous chunks. The calling thread also works on each loop, so
+ * a pool of one thread runs everything inline with no synchronization.
+ *
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief Constructs a pool that runs loops across a number of threads.
+   *
+   * @param thread_count the total number of threads, including the caller; 0
+   * uses every hardware thread
+   */
+  explicit ThreadPool(size_t thread_count = 1);
+
+  /**
+   * @brief Stops and joins all of the worker threads.
+   *
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Runs a loop over [0, count) split into contiguous chunks, and
+   * returns once every chunk is finished. Loops too short to be worth
+   * splitting run inline on the calling thread. Loops started from several
+   * threads at once run one after another, and a loop body must not start
+   * another loop on the same pool.
+   *
+   * @param count the number of loop iterations
+   * @param body a callable taking the begin and end of a chunk
+   * @param min_chunk the smallest number of iterations given to one thread
+   */
+  void ParallelFor(size_t count, const function<void(size_t, size_t)>& body,
+                   size_t min_chunk = 256);
+
+  /**
+   * @brief Gets the total number of threads used by each loop.
+   *
+   * @return the size_t thread count, including the caller
+   */
+  size_t GetThreadCount() const;
+
+ private:
+  /**
+   * @brief The loop run by each worker thread, which waits for work and then
+   * claims chunks until none are left.
+   *
+   */
+  void WorkerLoop();
+
+  /**
+   * @brief Claims and runs chunks of the current loop until none are left.
+   *
+   * @param body the body of the loop
+   * @param count the number of iterations in the loop
+   * @param chunk_size the number of iterations in each chunk
+   * @param chunk_count the number of chunks in the loop
+   */
+  void RunChunks(const function<void(size_t, size_t)>& body, size_t count,
+                 size_t chunk_size, size_t chunk_count);
+
+  // The worker threads, not including the caller
+  vector<std::thread> workers_;
+  // Held by the caller for the whole of a parallel loop
+  std::mutex loop_mutex_;
+  // Guards the loop state shared with the workers
+  std::mutex mutex_;
+  // Wakes workers when a new loop starts or the pool stops
+  std::condition_variable work_ready_;
+  // Wakes the caller when every chunk of the loop is finished
+  std::condition_variable work_done_;
+  // Incremented for every new loop so workers can tell it apart from the last
+  size_t generation_ = 0;
+  // Set when the pool is shutting down
+  bool stopping_ = false;
+  // The number of workers currently running chunks of a loop
+  size_t active_workers_ = 0;
+
+  // The body of the current loop
+  const function<void(size_t, size_t)>* body_ = nullptr;
+  // The number of iterations in the current loop
+  size_t count_ = 0;
+  // The number of iterations in each chunk of the current loop
+  size_t chunk_size_ = 0;
+  // The next unclaimed chunk of the current loop
+  std::atomic<size_t> next_chunk_{0};
+  // The number of chunks in the current loop that are finished
+  std::atomic<size_t> finished_chunks_{0};
+  // The number of chunks in the current loop
+  size_t chunk_count_ = 0;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,303 @@
+#pragma once
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/particle_store.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The settings of a trajectory file.
+ *
+ */
+struct TrajectoryOptions {
+  // Every stride-th captured step is written
+  size_t stride = 1;
+  // Every keyframe_interval-th written frame is stored whole, the rest as
+  // differences from the frame before, so seeking decodes at most this many
+  size_t keyframe_interval = 32;
+  // The spacing positions are rounded to; values more than 2^31 quanta from
+  // zero are clamped
+  double position_quantum = 1.0 / 1024;
+  // The spacing velocities are rounded to
+  double velocity_quantum = 1.0 / 65536;
+  // The zlib level frames are compressed with, from 0 to 9
+  int compression_level = 1;
+  // The number of axes of the captured particles, 2 or 3
+  size_t dimensions = 2;
+};
+
+/**
+ * @brief One frame of a trajectory: the positions and velocities of every
+ * particle after a step.
+ *
+ */
+struct TrajectoryFrame {
+  // The number of the step, counting every captured step
+  uint64_t step = 0;
+  // The simulated time after the step
+  double time = 0;
+  // The position components of every particle, one array per axis, empty
+  // past the trajectory's dimensions
+  array<vector<float>, ParticleStore::kMaxDimensions> positions;
+  // The velocity components of every particle, one array per axis, empty
+  // past the trajectory's dimensions
+  array<vector<float>, ParticleStore::kMaxDimensions> velocities;
+};
+
+/**
+ * @brief The TrajectoryWriter class streams the positions and velocities of
+ * particles to a file as the simulation runs.
+ *
+ * Capturing a step only copies its arrays into one of two staging frames. A
+ * background thread rounds each staged frame to the quantum, takes the
+ * differences from the frame before, compresses it and writes it, so the
+ * simulation only waits when it gets two whole frames ahead of the disk. A
+ * frame index is written at the end, letting TrajectoryReader seek to any
+ * frame.
+ *
+ */
+class TrajectoryWriter {
+ public:
+  /**
+   * @brief Creates the trajectory file and starts the writing thread.
+   *
+   * @throws std::runtime_error when the file cannot be created
+   * @throws std::invalid_argument when an option is out of range
+   * @param path the path of the trajectory file
+   * @param options the TrajectoryOptions to write with
+   */
+  TrajectoryWriter(const string& path, const TrajectoryOptions& options);
+
+  /**
+   * @brief Finishes writing the trajectory, ignoring any error.
+   *
+   */
+  ~TrajectoryWriter();
+
+  TrajectoryWriter(const TrajectoryWriter&) = delete;
+  TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+  /**
+   * @brief Counts a step, and stages the particles for writing when the step
+   * falls on the stride.
+   *
+   * @throws std::runtime_error when an earlier frame could not be written
+   * @throws std::invalid_argument when the particles have other dimensions
+   * than the trajectory
+   * @param particles the particles after the step
+   * @param time the simulated time after the step
+   */
+  void Capture(const ParticleStore& particles, double time);
+
+  /**
+   * @brief Waits for every staged frame to be written, then writes the frame
+   * index and closes the file. Later captures are ignored.
+   *
+   * @throws std::runtime_error when a frame or the index could not be written
+   */
+  void Close();
+
+  /**
+   * @brief Gets the number of frames staged so far.
+   *
+   * @return the size_t number of frames
+   */
+  size_t GetFrameCount() const;
+
+  /**
+   * @brief Gets the number of captures that had to wait for the writing
+   * thread, which a larger stride avoids.
+   *
+   * @return the size_t number of waits
+   */
+  size_t GetStallCount() const;
+
+ private:
+  // The reader reads the frame index the writer leaves behind
+  friend class TrajectoryReader;
+
+  // The number of frames that can be staged at once
+  static constexpr size_t kStagingFrames = 2;
+
+  /**
+   * @brief An entry of the frame index, as written to the file.
+   *
+   */
+  struct IndexEntry {
+    uint64_t offset;
+    uint64_t step;
+    double time;
+    uint32_t keyframe;
+    uint32_t reserved;
+  };
+
+  /**
+   * @brief Writes staged frames until the writer is closed.
+   *
+   */
+  void WriterLoop();
+
+  /**
+   * @brief Encodes one staged frame and appends it to the file.
+   *
+   * @param frame the staged frame
+   */
+  void WriteFrame(const TrajectoryFrame& frame);
+
+  // The settings of the file
+  TrajectoryOptions options_;
+  // The rounded arrays of a frame: positions, then velocities, per axis
+  size_t field_count_;
+  // The path of the file, for error messages
+  string path_;
+  // The file being written, only touched by the writing thread after setup
+  std::ofstream output_;
+  // The index of every written frame
+  vector<IndexEntry> index_;
+
+  // The frames copied from the simulation
+  array<TrajectoryFrame, kStagingFrames> staging_;
+  // The staging frames waiting to be written, oldest first
+  std::deque<size_t> staged_;
+  // The staging frames free to be filled
+  vector<size_t> free_;
+  // Guards the staging queues and the flags below
+  mutable std::mutex mutex_;
+  // Signals a change to the staging queues
+  std::condition_variable changed_;
+  // Whether the writer is closing
+  bool closing_ = false;
+  // Whether the writer has closed
+  bool closed_ = false;
+  // The first error of the writing thread, empty when there is none
+  string error_;
+
+  // The number of steps captured, including those off the stride
+  uint64_t step_count_ = 0;
+  // The number of frames staged
+  size_t frame_count_ = 0;
+  // The number of captures that waited for a free staging frame
+  size_t stall_count_ = 0;
+
+  // The rounded values of the last written frame, differenced against
+  vector<int32_t> previous_values_;
+  // The rounded values of the frame being written
+  vector<int32_t> values_;
+  // The byte planes of the frame being written
+  vector<uint8_t> planes_;
+  // The compressed bytes of the frame being written
+  vector<uint8_t> compressed_;
+
+  // The thread that encodes and writes frames
+  std::thread thread_;
+};
+
+/**
+ * @brief The TrajectoryReader class reads the frames of a trajectory file in
+ * any order. Reading the frames in order decodes each only once.
+ *
+ */
+class TrajectoryReader {
+ public:
+  /**
+   * @brief Opens a trajectory file and reads its frame index. Files whose
+   * writer never finished have no index, so their frames are scanned instead,
+   * up to the last whole frame.
+   *
+   * @throws std::runtime_error when the file is not a readable trajectory
+   * @param path the path of the trajectory file
+   */
+  explicit TrajectoryReader(const string& path);
+
+  /**
+   * @brief Gets the number of frames in the file.
+   *
+   * @return the size_t number of frames
+   */
+  size_t GetFrameCount() const;
+
+  /**
+   * @brief Gets the number of axes of the particles in the file.
+   *
+   * @return the size_t number of dimensions, 2 or 3
+   */
+  size_t GetDimensions() const;
+
+  /**
+   * @brief Reads a frame, decoding forward from the nearest keyframe before
+   * it.
+   *
+   * @throws std::out_of_range when there is no such frame
+   * @throws std::runtime_error when the frame cannot be decoded
+   * @param frame_number the number of the frame, from 0
+   * @param frame the frame to fill
+   */
+  void ReadFrame(size_t frame_number, TrajectoryFrame& frame);
+
+ private:
+  /**
+   * @brief The location of a frame in the file.
+   *
+   */
+  struct FrameLocation {
+    uint64_t offset;
+    bool keyframe;
+  };
+
+  /**
+   * @brief Finds every whole frame by walking the file from the start.
+   *
+   * @param file_size the size of the file
+   */
+  void ScanFrames(uint64_t file_size);
+
+  /**
+   * @brief Decodes a frame into the rounded values, replacing them for a
+   * keyframe or adding to them otherwise.
+   *
+   * @param frame_number the number of the frame
+   */
+  void DecodeFrame(size_t frame_number);
+
+  // The path of the file, for error messages
+  string path_;
+  // The file being read
+  std::ifstream input_;
+  // The spacing positions were rounded to
+  double position_quantum_;
+  // The spacing velocities were rounded to
+  double velocity_quantum_;
+  // The number of axes of the particles
+  size_t dimensions_;
+  // The rounded arrays of a frame: positions, then velocities, per axis
+  size_t field_count_;
+  // The location of every frame
+  vector<FrameLocation> frames_;
+
+  // The number of the frame held in values_, or -1 for none
+  long long decoded_frame_ = -1;
+  // The step of the decoded frame
+  uint64_t decoded_step_ = 0;
+  // The simulated time of the decoded frame
+  double decoded_time_ = 0;
+  // The rounded values of the decoded frame
+  vector<int32_t> values_;
+  // The stored bytes of the frame being decoded
+  vector<uint8_t> stored_;
+  // The byte planes of the frame being decoded
+  vector<uint8_t> planes_;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+using std::array;
+
+namespace idealgas {
+
+/**
+ * @brief The TripleBuffer class hands the latest value from one producer
+ * thread to one consumer thread without locks or copies.
+ *
+ * The producer fills its own buffer and publishes it by swapping it with the
+ * middle buffer; the consumer takes the middle buffer, if it is newer, by
+ * swapping it with its own. Neither ever waits for the other, the consumer
+ * always sees a whole value, and values published faster than they are read
+ * are skipped. Buffers are reused, so a producer that assigns into them
+ * allocates nothing once they have grown.
+ *
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  /**
+   * @brief Gets the buffer the producer fills next. Only the producer may
+   * call this.
+   *
+   * @return a reference to the producer's buffer, holding an older value
+   */
+  T& GetWriteBuffer() {
+    return buffers_[write_];
+  }
+
+  /**
+   * @brief Publishes the producer's buffer, and gives the producer the old
+   * middle buffer to fill next. Only the producer may call this.
+   *
+   */
+  void Publish() {
+    write_ = middle_.exchange(write_ | kFreshBit, std::memory_order_acq_rel) &
+             kIndexMask;
+  }
+
+  /**
+   * @brief Takes the latest published value, if it is newer than the one the
+   * consumer holds. Only the consumer may call this.
+   *
+   * @return a reference to the consumer's buffer, valid until the next call
+   */
+  const T& Acquire() {
+    // Only the consumer clears the fresh bit, so it cannot vanish in between
+    if (middle_.load(std::memory_order_relaxed) & kFreshBit) {
+      read_ = middle_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    return buffers_[read_];
+  }
+
+ private:
+  // The bits of middle_ holding the middle buffer's index
+  static constexpr uint8_t kIndexMask = 3;
+  // The bit of middle_ set when the middle buffer has not been acquired
+  static constexpr uint8_t kFreshBit = 4;
+
+  // The three buffers, owned by the producer, the middle and the consumer
+  array<T, 3> buffers_;
+  // The index of the producer's buffer
+  uint8_t write_ = 0;
+  // The index of the middle buffer, and whether it is fresh
+  std::atomic<uint8_t> middle_{1};
+  // The index of the consumer's buffer
+  uint8_t read_ = 2;
+};
+
+}  // namespace idealgas
@@ -0,0 +1,165 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using std::array;
+using std::string;
+
+namespace idealgas {
+
+/**
+ * @brief The instruction sets the wall kernel can run with, from slowest to
+ * fastest.
+ *
+ */
+enum class SimdLevel {
+  // One particle at a time, on any processor
+  kScalar,
+  // Four particles at a time with SSE2
+  kSse2,
+  // Eight particles at a time with AVX2
+  kAvx2
+};
+
+/**
+ * @brief What happens to a particle reaching the edge of the container along
+ * one axis.
+ *
+ */
+enum class BoundaryMode {
+  // Particles bounce off the walls
+  kReflecting,
+  // Particles leaving through one side come back in through the other
+  kPeriodic
+};
+
+// The most axes the wall kernel moves particles along
+constexpr size_t kMaxKernelAxes = 3;
+
+// The bit of a wall hit marking a left or right wall
+constexpr uint8_t kWallHitX = 1;
+// The bit of a wall hit marking a top or bottom wall
+constexpr uint8_t kWallHitY = 2;
+// The bit of a wall hit marking a front or back wall
+constexpr uint8_t kWallHitZ = 4;
+
+/**
+ * @brief Gets the fastest instruction set supported by this processor.
+ *
+ * @return the best available SimdLevel
+ */
+SimdLevel GetSupportedSimdLevel();
+
+/**
+ * @brief Gets a printable name for an instruction set.
+ *
+ * @param level the SimdLevel to name
+ * @return the string name, such as "avx2"
+ */
+string GetSimdLevelName(SimdLevel level);
+
+/**
+ * @brief Reflects every particle moving into a wall and then moves every
+ * particle by one time step. Along a periodic axis nothing is reflected, and
+ * a particle that moves out of the container is wrapped back in by one
+ * container length. Each level gives bit-identical results, matching the
+ * scalar checks one particle at a time.
+ *
+ * @param level the instruction set to use, which must be supported
+ * @param x the x positions, updated in place
+ * @param y the y positions, updated in place
+ * @param velocity_x the x velocities, updated in place
+ * @param velocity_y the y velocities, updated in place
+ * @param radii the radii
+ * @param count the number of particles in each array
+ * @param width the width of the container
+ * @param height the height of the container
+ * @param time_step the time step to integrate over
+ * @param wall_hits set for each particle to the kWallHitX and kWallHitY bits
+ * of the walls it hit, or 0 for none
+ * @param boundaries the BoundaryMode of the x and y axes, both reflecting by
+ * default
+ */
+void ReflectAndIntegrate(SimdLevel level, float* x, float* y,
+                         float* velocity_x, float* velocity_y,
+                         const float* radii, size_t count, float width,
+                         float height, float time_step, uint8_t* wall_hits,
+                         const array<BoundaryMode, 2>& boundaries = {});
+
+/**
+ * @brief Reflects and moves particles along two or three axes, as the
+ * two-axis ReflectAndIntegrate does. Each number of axes has its own kernels,
+ * with the loops over the axes unrolled.
+ *
+ * @throws std::invalid_argument when the number of axes is not 2 or 3
+ * @param level the instruction set to use, which must be supported
+ * @param dimensions the number of axes, 2 or 3
+ * @param positions the positions along each axis, updated in place
+ * @param velocities the velocities along each axis, updated in place
+ * @param radii the radii
+ * @param count the number of particles in each array
+ * @param lengths the length of the container along each axis
+ * @param time_step the time step to integrate over
+ * @param wall_hits set for each particle to the kWallHitX, kWallHitY and
+ * kWallHitZ bits of the walls it hit, or 0 for none
+ * @param boundaries the BoundaryMode of each axis, all reflecting by default
+ */
+void ReflectAndIntegrate(
+    SimdLevel level, size_t dimensions,
+    const array<float*, kMaxKernelAxes>& positions,
+    const array<float*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    float time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries = {});
+
+/**
+ * @brief Reflects and moves particles whose positions are kept in double
+ * precision, as ReflectAndIntegrate does for float positions. The walls are
+ * checked and the positions advanced in double precision, one particle at a
+ * time, since the vector kernels only move float positions.
+ *
+ * @throws std::invalid_argument when the number of axes is not 2 or 3
+ * @param dimensions the number of axes, 2 or 3
+ * @param positions the double positions along each axis, updated in place
+ * @param velocities the float velocities along each axis, updated in place
+ * @param radii the radii
+ * @param count the number of particles in each array
+ * @param lengths the length of the container along each axis
+ * @param time_step the time step to integrate over
+ * @param wall_hits set for each particle to the kWallHitX, kWallHitY and
+ * kWallHitZ bits of the walls it hit, or 0 for none
+ * @param boundaries the BoundaryMode of each axis, all reflecting by default
+ */
+void ReflectAndIntegrate(
+    size_t dimensions, const array<double*, kMaxKernelAxes>& positions,
+    const array<float*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries = {});
+
+/**
+ * @brief Reflects and moves particles whose positions and velocities are
+ * both kept in double precision, one particle at a time.
+ *
+ * @throws std::invalid_argument when the number of axes is not 2 or 3
+ * @param dimensions the number of axes, 2 or 3
+ * @param positions the double positions along each axis, updated in place
+ * @param velocities the double velocities along each axis, updated in place
+ * @param radii the radii
+ * @param count the number of particles in each array
+ * @param lengths the length of the container along each axis
+ * @param time_step the time step to integrate over
+ * @param wall_hits set for each particle to the kWallHitX, kWallHitY and
+ * kWallHitZ bits of the walls it hit, or 0 for none
+ * @param boundaries the BoundaryMode of each axis, all reflecting by default
+ */
+void ReflectAndIntegrate(
+    size_t dimensions, const array<double*, kMaxKernelAxes>& positions,
+    const array<double*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries = {});
+
+}  // namespace idealgas
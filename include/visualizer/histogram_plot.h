@@ -0,0 +1,106 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "cinder/gl/gl.h"
+#include "core/simulation_thread.h"
+
+using ci::Font;
+using glm::vec2;
+using idealgas::HistogramSnapshot;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+/**
+ * @brief The HistogramPlot class draws a histogram of particle speeds in the
+ * Cinder app. The binning itself happens on the simulation thread, which
+ * hands over the bins in each snapshot.
+ *
+ */
+class HistogramPlot {
+ public:
+  /**
+   * @brief Constructs a new HistogramPlot object.
+   *
+   * @param bin_count the number of bins in the histogram
+   * @param width the width of the plot
+   * @param height the height of the plot
+   * @param offset the vec2 offset from the origin
+   * @param stroke the width of the stroke of the histogram's lines
+   * @param stroke_color the color of the histogram's lines
+   * @param bar_color the color of the histogram's bars
+   * @param text_color the color of the histogram's text
+   * @param font the font of the histogram's text
+   */
+  HistogramPlot(size_t bin_count, size_t width, size_t height, const vec2& offset, size_t stroke,
+                const ci::ColorT<float>& stroke_color,
+                const ci::ColorT<float>& bar_color,
+                const ci::ColorT<float>& text_color, const string& font);
+
+  /**
+   * @brief Calls the appropriate drawing functions in order to display the
+   * histogram in the app.
+   *
+   * @param histogram the bins and title to plot
+   */
+  void Draw(const HistogramSnapshot& histogram);
+
+ private:
+  /**
+   * @brief Draws the frame of the histogram.
+   *
+   */
+  void DrawFrame();
+
+  /**
+   * @brief Draws the titles and labels of the histogram.
+   *
+   * @param title the title of the histogram
+   */
+  void DrawText(const string& title);
+
+  /**
+   * @brief Draws the bins/bars of the histogram.
+   *
+   */
+  void DrawBins();
+
+  // The relative bin heights being drawn
+  vector<float> bin_heights_;
+  // The upper cutoffs of the bins being drawn
+  vector<float> bin_cutoffs_;
+
+  // The pixel width of the graph
+  size_t width_;
+  // The pixel height of the graph
+  size_t height_;
+  // The vec2 offset of the top left of the graph, relative to the top left of
+  // the window
+  vec2 offset_;
+  // The thickness of the stroke with which to draw the frame lines
+  size_t stroke_;
+  // The color of the stroke
+  ci::ColorT<float> stroke_color_;
+  // The color of the histogram bars
+  ci::ColorT<float> bar_color_;
+  // The color of the label and title text
+  ci::ColorT<float> text_color_;
+  // The font family of the text printed on the graph
+  string font_family_;
+
+  // The offset of the graph (separate from the offset of the frame)
+  vec2 graph_offset_;
+  // The pixel width of the graph (marginally smaller than the width of the
+  // histogram)
+  size_t graph_width_;
+  // The pixel width of each bin in the graph
+  size_t bin_width_;
+  // Label font
+  Font label_font_;
+  // Title font
+  Font title_font_;
+};
+
+}  // namespace idealgas
@@ -1,20 +1,25 @@
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
-#include "core/histogram.h"
+#include "core/checkpoint.h"
 #include "core/particle_container.h"
+#include "core/simulation_thread.h"
+#include "visualizer/histogram_plot.h"
 
 using ci::Color;
 using ci::app::App;
 using ci::app::KeyEvent;
 using ci::app::MouseEvent;
-using idealgas::Histogram;
+using idealgas::CheckpointTimer;
+using idealgas::HistogramPlot;
 using idealgas::ParticleContainer;
+using idealgas::SimulationSnapshot;
+using idealgas::SimulationThread;
 using std::string;
-using std::unordered_map;
 using std::vector;
 
 namespace idealgas {
@@ -25,6 +30,10 @@ namespace idealgas {
  * collisions. It also implements some visualizer controls that can be accessed
  * through the keyboard.
  *
+ * The particles are stepped on a SimulationThread at their own rate, and each
+ * frame draws the latest snapshot in place. Keyboard controls are posted to
+ * the simulation thread as commands.
+ *
  */
 class IdealGasVisualizer : public App {
  public:
@@ -49,7 +58,8 @@ class IdealGasVisualizer : public App {
 
   /**
    * @brief Updates all the variables of the visualization before each new draw
-   * heartbeat.
+   * heartbeat. The particles step on their own thread, so only a checkpoint is
+   * requested here.
    *
    */
   void update() override;
@@ -71,11 +81,20 @@ class IdealGasVisualizer : public App {
 
  private:
   /**
-   * @brief Hides the particles of a certain index in the particle names. 
-   * 
-   * @param index the name of particle type to keep
+   * @brief Hides every species but one from the screen and the histograms.
+   * Hidden species are still simulated.
+   *
+   * @param index the index of the particle type to keep visible
+   */
+  void IsolateSpecies(size_t index);
+
+  /**
+   * @brief Freezes a species in place, or sets it moving again. Frozen
+   * particles neither move nor collide.
+   *
+   * @param index the index of the particle type to freeze or unfreeze
    */
-  void HideParticles(const string& name);
+  void ToggleSpeciesEnabled(size_t index);
 
   /**
    * @brief Draws the frame of the container that bounds the particles.
@@ -92,21 +111,24 @@ class IdealGasVisualizer : public App {
   /**
    * @brief Draws each of the particles in the simulation.
    *
+   * @param snapshot the snapshot of the particles to draw
    */
-  void DrawParticles();
+  void DrawParticles(const SimulationSnapshot& snapshot);
 
   /**
-   * @brief Updates all of the histograms with the relevant particle speeds
-   * before refreshing them.
+   * @brief Draws the temperature of each species, and the energy, momentum
+   * and pressure of the particles, over the top left of the container.
    *
+   * @param snapshot the snapshot of the observables to draw
    */
-  void UpdateHistograms();
+  void DrawObservables(const SimulationSnapshot& snapshot);
 
   /**
    * @brief Draws the histograms of particle speeds on the screen.
    *
+   * @param snapshot the snapshot of the histograms to draw
    */
-  void DrawHistograms();
+  void DrawHistograms(const SimulationSnapshot& snapshot);
 
   // Path to the configuration file
   string config_path_ = "../../../../../../config/visualizer/config.json";
@@ -130,15 +152,25 @@ class IdealGasVisualizer : public App {
   Color text_color_;
   // The string font name of the text printed in the visualization
   string font_family_;
-  // The map of histograms plotting each string particle type's velocities
-  unordered_map<string, Histogram> histograms_;
+  // The histograms plotting each particle type's velocities, indexed by
+  // SpeciesId
+  vector<HistogramPlot> histograms_;
   // The number of bins in each histogram
   size_t histogram_bin_count_;
+  // The number of recent steps plotted by each histogram, or 0 for every step
+  size_t histogram_window_steps_;
+  // The steps taken per second, or 0 to step as fast as possible
+  double steps_per_second_;
+  // Whether the observables are drawn over the container
+  bool show_observables_ = false;
   // The particle container object contianing all of the particles and their
   // data
   ParticleContainer container_;
-  // The present particles that are currently hidden
-  vector<Particle> hidden_particles_;
+  // Saves checkpoints of the container, if the configuration asks for them
+  CheckpointTimer checkpoint_timer_ = CheckpointTimer("", 0);
+  // The thread stepping the container, declared last so that it stops before
+  // anything its commands use is destroyed
+  std::unique_ptr<SimulationThread> simulation_;
 };
 
 }  // namespace idealgas
\ No newline at end of file
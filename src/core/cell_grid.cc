@@ -0,0 +1,303 @@
+#include "core/cell_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "core/particle_store.h"
+
+using glm::vec3;
+using idealgas::CellGrid;
+using idealgas::ParticleStore;
+using std::floor;
+using std::max;
+using std::min;
+using std::vector;
+
+namespace idealgas {
+
+void CellGrid::Build(const ParticleStore& particles) {
+  Build(particles, {0, 0, 0});
+}
+
+void CellGrid::Build(const ParticleStore& particles,
+                     const array<float, 3>& periods, float skin) {
+  BuildCells(
+      particles, periods, particles.size(), [](size_t index) { return index; },
+      skin);
+}
+
+void CellGrid::Build(const ParticleStore& particles,
+                     const array<float, 3>& periods,
+                     const vector<size_t>& indices, float skin) {
+  BuildCells(
+      particles, periods, indices.size(),
+      [&indices](size_t slot) { return indices[slot]; }, skin);
+}
+
+template <typename IndexOf>
+void CellGrid::BuildCells(const ParticleStore& particles,
+                          const array<float, 3>& periods, size_t count,
+                          IndexOf index_of, float skin) {
+  const vector<float>& x = particles.GetPositions(0);
+  const vector<float>& y = particles.GetPositions(1);
+  const vector<float>& radii = particles.GetRadii();
+
+  cell_particles_.resize(count);
+  particle_cells_.resize(count);
+
+  for (auto& cells : color_cells_) {
+    cells.clear();
+  }
+
+  if (count == 0) {
+    columns_ = 0;
+    rows_ = 0;
+    layers_ = 1;
+    cell_starts_.assign(1, 0);
+    return;
+  }
+
+  // Find the bounding box of the particles and the largest radius
+  size_t first = index_of(0);
+  vec3 lower(x[first], y[first], 0);
+  vec3 upper = lower;
+  float max_radius = 0;
+  for (size_t slot = 0; slot < count; ++slot) {
+    size_t index = index_of(slot);
+    lower.x = min(lower.x, x[index]);
+    lower.y = min(lower.y, y[index]);
+    upper.x = max(upper.x, x[index]);
+    upper.y = max(upper.y, y[index]);
+    max_radius = max(max_radius, radii[index]);
+  }
+  bool layered = particles.GetDimensions() == 3;
+  if (layered) {
+    const vector<float>& z = particles.GetPositions(2);
+    lower.z = z[first];
+    upper.z = z[first];
+    for (size_t slot = 0; slot < count; ++slot) {
+      size_t index = index_of(slot);
+      lower.z = min(lower.z, z[index]);
+      upper.z = max(upper.z, z[index]);
+    }
+  }
+
+  // A periodic axis spans its whole period, so that its seam is a cell edge
+  for (size_t axis = 0; axis < 3; ++axis) {
+    if (periods[axis] > 0 && (axis < 2 || layered)) {
+      lower[axis] = 0;
+      upper[axis] = periods[axis];
+    }
+  }
+
+  // Any two touching particles are at most two maximum radii apart, and two
+  // within the skin of touching at most that plus the skin, so they always
+  // fall within the same or adjacent cells
+  origin_ = lower;
+  cell_size_ = max(2 * max_radius + skin, kMinCellSize);
+
+  // Coarsen the grid when sparse outliers would otherwise require far more
+  // cells than particles
+  size_t cell_limit = max(kMinCellLimit, kCellsPerParticle * count);
+  float depth_period = layered ? periods[2] : 0;
+  auto size_axes = [&]() {
+    SizeAxis(lower.x, upper.x, periods[0], columns_, cell_sides_.x,
+             wraps_[0]);
+    SizeAxis(lower.y, upper.y, periods[1], rows_, cell_sides_.y, wraps_[1]);
+    SizeAxis(lower.z, upper.z, depth_period, layers_, cell_sides_.z,
+             wraps_[2]);
+  };
+  size_axes();
+  while ((double)columns_ * rows_ * layers_ > cell_limit) {
+    cell_size_ *= 2;
+    size_axes();
+  }
+
+  // Count the particles in each cell, offset by one for the prefix sum. A
+  // second pass moves particles into their layers, which only several
+  // layers need.
+  cell_starts_.assign(GetCellCount() + 1, 0);
+  for (size_t slot = 0; slot < count; ++slot) {
+    size_t index = index_of(slot);
+    particle_cells_[slot] = CellIndexOf(x[index], y[index]);
+  }
+  if (layers_ > 1) {
+    const vector<float>& z = particles.GetPositions(2);
+    for (size_t slot = 0; slot < count; ++slot) {
+      particle_cells_[slot] += LayerOf(z[index_of(slot)]) * columns_ * rows_;
+    }
+  }
+  for (size_t slot = 0; slot < count; ++slot) {
+    ++cell_starts_[particle_cells_[slot] + 1];
+  }
+  for (size_t cell = 1; cell < cell_starts_.size(); ++cell) {
+    cell_starts_[cell] += cell_starts_[cell - 1];
+  }
+
+  // Scatter the particle indices into their cells' contiguous ranges
+  cell_cursors_.assign(cell_starts_.begin(), cell_starts_.end() - 1);
+  for (size_t slot = 0; slot < count; ++slot) {
+    cell_particles_[cell_cursors_[particle_cells_[slot]]++] = index_of(slot);
+  }
+
+  // Sort the occupied cells into colors by layer, row and column modulo
+  // three
+  for (size_t cell = 0; cell < GetCellCount(); ++cell) {
+    if (cell_starts_[cell] != cell_starts_[cell + 1]) {
+      color_cells_[GetColorOf(cell)].push_back(cell);
+    }
+  }
+}
+
+size_t CellGrid::LocateCell(const ParticleStore& particles,
+                            size_t index) const {
+  size_t cell = CellIndexOf(particles.GetPositions(0)[index],
+                            particles.GetPositions(1)[index]);
+  if (layers_ > 1) {
+    cell += LayerOf(particles.GetPositions(2)[index]) * columns_ * rows_;
+  }
+  return cell;
+}
+
+size_t CellGrid::GetColorOf(size_t cell) const {
+  return (cell / (columns_ * rows_) % 3) * 9 +
+         (cell / columns_ % rows_ % 3) * 3 + cell % columns_ % 3;
+}
+
+const vector<size_t>& CellGrid::GetCellsOfColor(size_t color) const {
+  return color_cells_.at(color);
+}
+
+size_t CellGrid::GetColorCount() const {
+  return layers_ > 1 ? kColorCount : kColorCount / 3;
+}
+
+float CellGrid::GetCellSize() const {
+  return cell_size_;
+}
+
+size_t CellGrid::GetCellCount() const {
+  return columns_ * rows_ * layers_;
+}
+
+void CellGrid::SizeAxis(float lower, float upper, float period,
+                        size_t& count, float& width, bool& wraps) const {
+  if (period <= 0) {
+    count = (size_t)(floor((upper - lower) / cell_size_) + 1);
+    width = cell_size_;
+    wraps = false;
+    return;
+  }
+
+  // Every cell of a periodic axis is at least the cell size wide. With too
+  // few cells, a cell would meet the same neighbor on both sides, so the
+  // axis becomes one cell instead.
+  count = (size_t)(period / cell_size_);
+  wraps = count >= kMinPeriodicCells;
+  count = wraps ? count - count % 3 : 1;
+  width = period / count;
+}
+
+size_t CellGrid::CellIndexOf(float x, float y) const {
+  // Periodic positions may sit just below zero within rounding
+  size_t column =
+      min((size_t)max((x - origin_.x) / cell_sides_.x, 0.0f), columns_ - 1);
+  size_t row =
+      min((size_t)max((y - origin_.y) / cell_sides_.y, 0.0f), rows_ - 1);
+  return row * columns_ + column;
+}
+
+size_t CellGrid::LayerOf(float z) const {
+  return min((size_t)max((z - origin_.z) / cell_sides_.z, 0.0f),
+             layers_ - 1);
+}
+
+size_t CellGrid::FindSurroundingCells(size_t cell,
+                                      size_t* surrounding_cells) const {
+  size_t row = cell / columns_;
+  size_t column = cell - row * columns_;
+  size_t layer = row / rows_;
+  row -= layer * rows_;
+
+  // Offsets past an edge that does not wrap are skipped, and an axis that
+  // wraps has at least three cells, so no cell is found twice
+  size_t surrounding_count = 0;
+  long layer_offset = layers_ > 1 ? 1 : 0;
+  for (long dz = -layer_offset; dz <= layer_offset; ++dz) {
+    for (long dy = -1; dy <= 1; ++dy) {
+      for (long dx = -1; dx <= 1; ++dx) {
+        long neighbor_column = (long)column + dx;
+        long neighbor_row = (long)row + dy;
+        long neighbor_layer = (long)layer + dz;
+        if (wraps_[0]) {
+          neighbor_column =
+              (neighbor_column + (long)columns_) % (long)columns_;
+        }
+        if (wraps_[1]) {
+          neighbor_row = (neighbor_row + (long)rows_) % (long)rows_;
+        }
+        if (wraps_[2]) {
+          neighbor_layer = (neighbor_layer + (long)layers_) % (long)layers_;
+        }
+        if (neighbor_column < 0 || neighbor_column >= (long)columns_ ||
+            neighbor_row < 0 || neighbor_row >= (long)rows_ ||
+            neighbor_layer < 0 || neighbor_layer >= (long)layers_) {
+          continue;
+        }
+        surrounding_cells[surrounding_count++] =
+            (neighbor_layer * rows_ + neighbor_row) * columns_ +
+            neighbor_column;
+      }
+    }
+  }
+  return surrounding_count;
+}
+
+size_t CellGrid::FindNeighborCells(size_t cell, size_t* neighbor_cells) const {
+  // Only the forward half of the neighborhood is visited so that each pair of
+  // cells is checked once: right, bottom left, bottom and bottom right, then
+  // the nine cells of the next layer, which only several layers have
+  static constexpr int kNeighborOffsets[kMaxNeighborCells][3] = {
+      {1, 0, 0},  {-1, 1, 0}, {0, 1, 0},  {1, 1, 0},  {-1, -1, 1},
+      {0, -1, 1}, {1, -1, 1}, {-1, 0, 1}, {0, 0, 1},  {1, 0, 1},
+      {-1, 1, 1}, {0, 1, 1},  {1, 1, 1}};
+  size_t row = cell / columns_;
+  size_t column = cell - row * columns_;
+  // A single layer, as in two dimensions, needs neither the layer nor the
+  // offsets into the next one
+  size_t layer = 0;
+  size_t offset_count = 4;
+  if (layers_ > 1) {
+    layer = row / rows_;
+    row -= layer * rows_;
+    offset_count = kMaxNeighborCells;
+  }
+
+  size_t neighbor_count = 0;
+  for (size_t index = 0; index < offset_count; ++index) {
+    const int* offset = kNeighborOffsets[index];
+    long neighbor_column = (long)column + offset[0];
+    long neighbor_row = (long)row + offset[1];
+    long neighbor_layer = (long)layer + offset[2];
+    if (wraps_[0]) {
+      neighbor_column = (neighbor_column + (long)columns_) % (long)columns_;
+    }
+    if (wraps_[1]) {
+      neighbor_row = (neighbor_row + (long)rows_) % (long)rows_;
+    }
+    if (wraps_[2]) {
+      neighbor_layer %= (long)layers_;
+    }
+    if (neighbor_column < 0 || neighbor_column >= (long)columns_ ||
+        neighbor_row < 0 || neighbor_row >= (long)rows_ ||
+        neighbor_layer >= (long)layers_) {
+      continue;
+    }
+    neighbor_cells[neighbor_count++] =
+        (neighbor_layer * rows_ + neighbor_row) * columns_ + neighbor_column;
+  }
+  return neighbor_count;
+}
+
+}  // namespace idealgas
@@ -0,0 +1,415 @@
+#include "core/checkpoint.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "core/mapped_file.h"
+
+using idealgas::CheckpointState;
+using idealgas::CheckpointTimer;
+using idealgas::MappedFile;
+using idealgas::ParticleStore;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The first bytes of every checkpoint
+const char kMagic[8] = {'I', 'G', 'A', 'S', 'C', 'K', 'P', 'T'};
+// The layout version, raised whenever the layout changes
+const uint32_t kVersion = 4;
+// Written in native byte order, so it reads differently on a machine of the
+// other byte order
+const uint32_t kByteOrderMark = 0x01020304;
+// The boundary every section starts on
+const size_t kAlignment = 64;
+
+/**
+ * @brief The fixed header at the start of a checkpoint.
+ *
+ */
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t particle_count;
+  uint32_t species_count;
+  uint32_t dimensions;
+  uint64_t species_table_size;
+  uint64_t seed;
+  double simulated_time;
+  float time_step;
+  uint32_t simulation_mode;
+  uint64_t width;
+  uint64_t height;
+  uint64_t depth;
+  uint32_t precision;
+};
+
+static_assert(std::is_trivially_copyable<Header>::value,
+              "The header is written as raw bytes");
+static_assert(sizeof(ColorT<float>) == 3 * sizeof(float) &&
+                  std::is_trivially_copyable<ColorT<float>>::value,
+              "Colors are written as raw bytes");
+
+/**
+ * @brief Rounds an offset up to the next section boundary.
+ *
+ * @param offset the byte offset
+ * @return the aligned size_t offset
+ */
+size_t Align(size_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+/**
+ * @brief Writes zero bytes up to the next section boundary.
+ *
+ * @param output the stream to pad
+ * @param offset the current byte offset, advanced to the boundary
+ */
+void Pad(std::ofstream& output, size_t& offset) {
+  static const char kZeros[kAlignment] = {};
+  size_t aligned = Align(offset);
+  output.write(kZeros, aligned - offset);
+  offset = aligned;
+}
+
+/**
+ * @brief Writes one particle array as a section.
+ *
+ * @param output the stream to write to
+ * @param offset the current byte offset, advanced past the section
+ * @param array the array to write
+ */
+template <typename T>
+void WriteSection(std::ofstream& output, size_t& offset,
+                  const vector<T>& array) {
+  Pad(output, offset);
+  output.write((const char*)array.data(), array.size() * sizeof(T));
+  offset += array.size() * sizeof(T);
+}
+
+/**
+ * @brief Writes one axis of double copies as a section, widening the floats
+ * when the copies were not taken yet.
+ *
+ * @param output the stream to write to
+ * @param offset the current byte offset, advanced past the section
+ * @param precise the double copies
+ * @param values the float components they round to
+ */
+void WritePreciseSection(std::ofstream& output, size_t& offset,
+                         const vector<double>& precise,
+                         const vector<float>& values) {
+  if (precise.size() == values.size()) {
+    WriteSection(output, offset, precise);
+  } else {
+    WriteSection(output, offset, vector<double>(values.begin(), values.end()));
+  }
+}
+
+/**
+ * @brief The MappedReader class walks the sections of a mapped checkpoint,
+ * checking each against the size of the file.
+ *
+ */
+class MappedReader {
+ public:
+  MappedReader(const MappedFile& file, const string& path)
+      : file_(file), path_(path) {}
+
+  /**
+   * @brief Takes the next section, starting on a section boundary.
+   *
+   * @throws std::runtime_error when the file ends before the section does
+   * @param bytes the size of the section
+   * @return a pointer to the section's bytes
+   */
+  const char* Section(size_t bytes) {
+    offset_ = Align(offset_);
+    if (offset_ > file_.size() || bytes > file_.size() - offset_) {
+      throw std::runtime_error(path_ + " is truncated.");
+    }
+    const char* section = file_.data() + offset_;
+    offset_ += bytes;
+    return section;
+  }
+
+  /**
+   * @brief Copies the next section into a particle array.
+   *
+   * @throws std::runtime_error when the count is too large to be a section
+   * @param array the array to fill
+   * @param count the number of elements in the section
+   */
+  template <typename T>
+  void ReadArray(vector<T>& array, size_t count) {
+    // A corrupt count would wrap around and pass the check in Section
+    if (count > SIZE_MAX / sizeof(T)) {
+      throw std::runtime_error(path_ + " has a corrupt particle count.");
+    }
+    const T* section = (const T*)Section(count * sizeof(T));
+    array.assign(section, section + count);
+  }
+
+ private:
+  // The mapped checkpoint
+  const MappedFile& file_;
+  // The path of the checkpoint, for error messages
+  const string& path_;
+  // The offset of the next section
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+void WriteCheckpoint(const string& path, const CheckpointState& state,
+                     const ParticleStore& particles,
+                     const PreciseArrays& precise_positions,
+                     const PreciseArrays& precise_velocities) {
+  const vector<string>& names = particles.GetSpeciesNames();
+
+  // Each species is its name's length, the name, its base color, then
+  // whether it is visible and enabled
+  vector<char> species_table;
+  for (size_t id = 0; id < names.size(); ++id) {
+    uint32_t name_size = (uint32_t)names[id].size();
+    const ColorT<float>& color = particles.GetSpeciesColor((SpeciesId)id);
+    uint8_t flags[2] = {particles.IsSpeciesVisible((SpeciesId)id),
+                        particles.IsSpeciesEnabled((SpeciesId)id)};
+    size_t entry = species_table.size();
+    species_table.resize(entry + sizeof(name_size) + name_size +
+                         sizeof(color) + sizeof(flags));
+    std::memcpy(&species_table[entry], &name_size, sizeof(name_size));
+    entry += sizeof(name_size);
+    std::memcpy(&species_table[entry], names[id].data(), name_size);
+    entry += name_size;
+    std::memcpy(&species_table[entry], &color, sizeof(color));
+    entry += sizeof(color);
+    std::memcpy(&species_table[entry], flags, sizeof(flags));
+  }
+
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrderMark;
+  header.particle_count = particles.size();
+  header.species_count = (uint32_t)names.size();
+  header.dimensions = (uint32_t)particles.GetDimensions();
+  header.species_table_size = species_table.size();
+  header.seed = state.seed;
+  header.simulated_time = state.simulated_time;
+  header.time_step = state.time_step;
+  header.simulation_mode = (uint32_t)state.simulation_mode;
+  header.width = state.width;
+  header.height = state.height;
+  header.depth = state.depth;
+  header.precision = (uint32_t)state.precision;
+
+  // Write beside the checkpoint so the previous one survives a failed write
+  string temporary_path = path + ".tmp";
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("Could not open " + temporary_path + ".");
+    }
+
+    size_t offset = 0;
+    output.write((const char*)&header, sizeof(header));
+    offset += sizeof(header);
+    Pad(output, offset);
+    output.write(species_table.data(), species_table.size());
+    offset += species_table.size();
+
+    for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+      WriteSection(output, offset, particles.GetPositions(axis));
+    }
+    for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+      WriteSection(output, offset, particles.GetVelocities(axis));
+    }
+    WriteSection(output, offset, particles.GetMasses());
+    WriteSection(output, offset, particles.GetRadii());
+    WriteSection(output, offset, particles.GetColors());
+    WriteSection(output, offset, particles.GetSpecies());
+    if (state.precision != PrecisionMode::kSingle) {
+      for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+        WritePreciseSection(output, offset, precise_positions[axis],
+                            particles.GetPositions(axis));
+      }
+    }
+    if (state.precision == PrecisionMode::kDouble) {
+      for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+        WritePreciseSection(output, offset, precise_velocities[axis],
+                            particles.GetVelocities(axis));
+      }
+    }
+
+    output.close();
+    if (!output) {
+      std::remove(temporary_path.c_str());
+      throw std::runtime_error("Could not write " + temporary_path + ".");
+    }
+  }
+
+#ifdef _WIN32
+  // Windows will not rename over an existing file
+  std::remove(path.c_str());
+#endif
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Could not replace " + path + ".");
+  }
+}
+
+CheckpointState ReadCheckpoint(const string& path, ParticleStore& particles) {
+  PreciseArrays precise_positions;
+  PreciseArrays precise_velocities;
+  return ReadCheckpoint(path, particles, precise_positions, precise_velocities);
+}
+
+CheckpointState ReadCheckpoint(const string& path, ParticleStore& particles,
+                               PreciseArrays& precise_positions,
+                               PreciseArrays& precise_velocities) {
+  MappedFile file(path);
+  MappedReader reader(file, path);
+
+  if (file.size() < sizeof(Header) ||
+      std::memcmp(file.data(), kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error(path + " is not a checkpoint.");
+  }
+  Header header;
+  std::memcpy(&header, reader.Section(sizeof(header)), sizeof(header));
+  if (header.byte_order != kByteOrderMark) {
+    throw std::runtime_error(path +
+                             " was written on a machine of another byte "
+                             "order.");
+  }
+  if (header.version != kVersion) {
+    throw std::runtime_error(path + " has checkpoint version " +
+                             std::to_string(header.version) + ", expected " +
+                             std::to_string(kVersion) + ".");
+  }
+  if (header.simulation_mode > (uint32_t)SimulationMode::kEventDriven) {
+    throw std::runtime_error(path + " has an unknown simulation mode.");
+  }
+  if (header.precision > (uint32_t)PrecisionMode::kDouble) {
+    throw std::runtime_error(path + " has an unknown precision.");
+  }
+  if (header.dimensions != 2 && header.dimensions != 3) {
+    throw std::runtime_error(path + " has " +
+                             std::to_string(header.dimensions) +
+                             " dimensions, expected 2 or 3.");
+  }
+
+  ParticleStore loaded;
+  loaded.SetDimensions(header.dimensions);
+  const char* species_table = reader.Section(header.species_table_size);
+  size_t entry = 0;
+  for (uint32_t id = 0; id < header.species_count; ++id) {
+    uint32_t name_size;
+    ColorT<float> color;
+    uint8_t flags[2];
+    if (header.species_table_size - entry < sizeof(name_size)) {
+      throw std::runtime_error(path + " has a corrupt species table.");
+    }
+    std::memcpy(&name_size, species_table + entry, sizeof(name_size));
+    entry += sizeof(name_size);
+    if (header.species_table_size - entry <
+        (size_t)name_size + sizeof(color) + sizeof(flags)) {
+      throw std::runtime_error(path + " has a corrupt species table.");
+    }
+    string name(species_table + entry, name_size);
+    entry += name_size;
+    std::memcpy(&color, species_table + entry, sizeof(color));
+    entry += sizeof(color);
+    std::memcpy(flags, species_table + entry, sizeof(flags));
+    entry += sizeof(flags);
+
+    // Repeated names would shift every later species ID
+    if (loaded.InternSpecies(name, color) != id) {
+      throw std::runtime_error(path + " repeats the species " + name + ".");
+    }
+    loaded.SetSpeciesVisible(id, flags[0] != 0);
+    loaded.SetSpeciesEnabled(id, flags[1] != 0);
+  }
+
+  size_t count = header.particle_count;
+  for (size_t axis = 0; axis < header.dimensions; ++axis) {
+    reader.ReadArray(loaded.GetPositions(axis), count);
+  }
+  for (size_t axis = 0; axis < header.dimensions; ++axis) {
+    reader.ReadArray(loaded.GetVelocities(axis), count);
+  }
+  reader.ReadArray(loaded.GetMasses(), count);
+  reader.ReadArray(loaded.GetRadii(), count);
+  reader.ReadArray(loaded.GetColors(), count);
+  reader.ReadArray(loaded.GetSpecies(), count);
+  PrecisionMode precision = (PrecisionMode)header.precision;
+  PreciseArrays loaded_positions;
+  PreciseArrays loaded_velocities;
+  if (precision != PrecisionMode::kSingle) {
+    for (size_t axis = 0; axis < header.dimensions; ++axis) {
+      reader.ReadArray(loaded_positions[axis], count);
+    }
+  }
+  if (precision == PrecisionMode::kDouble) {
+    for (size_t axis = 0; axis < header.dimensions; ++axis) {
+      reader.ReadArray(loaded_velocities[axis], count);
+    }
+  }
+
+  for (SpeciesId species : loaded.GetSpecies()) {
+    if (species >= header.species_count) {
+      throw std::runtime_error(path + " has a particle of unknown species.");
+    }
+  }
+  // Checkpoints are written grouped, so this only finds the species ranges
+  loaded.GroupBySpecies();
+
+  CheckpointState state;
+  state.seed = header.seed;
+  state.simulated_time = header.simulated_time;
+  state.time_step = header.time_step;
+  state.simulation_mode = (SimulationMode)header.simulation_mode;
+  state.width = header.width;
+  state.height = header.height;
+  state.depth = header.depth;
+  state.precision = precision;
+  particles = std::move(loaded);
+  precise_positions = std::move(loaded_positions);
+  precise_velocities = std::move(loaded_velocities);
+  return state;
+}
+
+CheckpointTimer::CheckpointTimer(const string& path, double interval_seconds)
+    : path_(path),
+      interval_(interval_seconds),
+      last_save_(std::chrono::steady_clock::now()) {}
+
+bool CheckpointTimer::Update(const ParticleContainer& container) {
+  if (interval_.count() <= 0) {
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_save_ < interval_) {
+    return false;
+  }
+  container.SaveCheckpoint(path_);
+  last_save_ = now;
+  return true;
+}
+
+const string& CheckpointTimer::GetPath() const {
+  return path_;
+}
+
+}  // namespace idealgas
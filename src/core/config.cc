@@ -0,0 +1,389 @@
+#include "core/config.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using idealgas::AdaptiveStepOptions;
+using idealgas::BoundaryMode;
+using idealgas::BroadphaseMode;
+using idealgas::NeighborListOptions;
+using idealgas::ParticleContainer;
+using idealgas::PlacementMode;
+using idealgas::PrecisionMode;
+using idealgas::SimulationConfig;
+using idealgas::SimulationMode;
+using idealgas::SpeciesConfig;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+/**
+ * @brief Gets a setting of a JSON object, or null when the object or the
+ * setting is missing, so that reading it as a number or string throws
+ * json::type_error as a missing setting always has.
+ *
+ * @param object the JSON object holding the setting
+ * @param key the name of the setting
+ * @return the json setting, or null
+ */
+json Setting(const json& object, const string& key) {
+  if (!object.is_object() || !object.contains(key)) {
+    return json();
+  }
+  return object[key];
+}
+
+/**
+ * @brief Reads a number given as a JSON number or as a string holding one.
+ *
+ * @throws json::type_error when the setting is neither
+ * @throws std::invalid_argument when a string is not a whole number, or a
+ * count is negative
+ * @param value the setting
+ * @param name the name of the setting, for error messages
+ * @return the number
+ */
+template <typename T>
+T ReadNumber(const json& value, const string& name) {
+  if (!value.is_string()) {
+    if (std::is_unsigned<T>::value && value.is_number() &&
+        value.get<double>() < 0) {
+      throw std::invalid_argument(name + " must not be negative.");
+    }
+    return value.get<T>();
+  }
+
+  const string& text = value.get_ref<const string&>();
+  T number = 0;
+  const char* end = text.data();
+  if constexpr (std::is_floating_point<T>::value) {
+    // Not every standard library parses floating point with from_chars
+    char* parsed_end = nullptr;
+    number = (T)std::strtod(text.c_str(), &parsed_end);
+    end = text.empty() ? end : parsed_end;
+  } else {
+    std::from_chars_result parsed =
+        std::from_chars(text.data(), text.data() + text.size(), number);
+    end = parsed.ec == std::errc() ? parsed.ptr : text.data();
+  }
+  if (end != text.data() + text.size() || text.empty()) {
+    throw std::invalid_argument(name + " must be a number, not \"" + text +
+                                "\".");
+  }
+  return number;
+}
+
+/**
+ * @brief Reads an optional number, which has a default when missing.
+ *
+ * @param object the JSON object that may hold the setting
+ * @param key the name of the setting
+ * @param fallback the value of a missing setting
+ * @return the number
+ */
+template <typename T>
+T ReadOptionalNumber(const json& object, const string& key, T fallback) {
+  json value = Setting(object, key);
+  return value.is_null() ? fallback : ReadNumber<T>(value, key);
+}
+
+/**
+ * @brief Reads a color given as a hexadecimal string, such as "0xFFBFBF", or
+ * as a number.
+ *
+ * @throws json::type_error when the setting is neither
+ * @throws std::invalid_argument when the color is not 0xRRGGBB
+ * @param value the setting
+ * @param name the name of the setting, for error messages
+ * @return the uint32_t color
+ */
+uint32_t ReadColor(const json& value, const string& name) {
+  uint32_t color = 0;
+  if (value.is_string()) {
+    const string& text = value.get_ref<const string&>();
+    size_t digits = text.compare(0, 2, "0x") == 0 ||
+                            text.compare(0, 2, "0X") == 0
+                        ? 2
+                        : 0;
+    std::from_chars_result parsed = std::from_chars(
+        text.data() + digits, text.data() + text.size(), color, 16);
+    if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+      throw std::invalid_argument(name +
+                                  " must be a hexadecimal color, not \"" +
+                                  text + "\".");
+    }
+  } else {
+    color = ReadNumber<uint32_t>(value, name);
+  }
+  if (color > 0xFFFFFF) {
+    throw std::invalid_argument(name + " must be a color from 0x000000 to "
+                                "0xFFFFFF.");
+  }
+  return color;
+}
+
+/**
+ * @brief Reads a range of a species' settings, checking its order.
+ *
+ * @throws std::invalid_argument when the minimum is above the maximum
+ * @param settings the settings of the species
+ * @param name the name of the species, for error messages
+ * @param quantity the quantity of the range, such as "velocity"
+ * @param min the minimum to fill in
+ * @param max the maximum to fill in
+ */
+void ReadRange(const json& settings, const string& name,
+               const string& quantity, size_t& min, size_t& max) {
+  min = ReadNumber<size_t>(Setting(settings, "min " + quantity),
+                           name + " min " + quantity);
+  max = ReadNumber<size_t>(Setting(settings, "max " + quantity),
+                           name + " max " + quantity);
+  if (min > max) {
+    throw std::invalid_argument(name + " has a min " + quantity +
+                                " above its max " + quantity + ".");
+  }
+}
+
+}  // namespace
+
+SimulationConfig ParseConfig(const json& config) {
+  SimulationConfig parsed;
+  json window = Setting(config, "window");
+  json histogram = Setting(config, "histogram");
+  json container = Setting(config, "container");
+
+  parsed.window_width = ReadNumber<size_t>(Setting(window, "width"), "width");
+  parsed.window_height =
+      ReadNumber<size_t>(Setting(window, "height"), "height");
+  parsed.margin = ReadNumber<size_t>(Setting(window, "margin"), "margin");
+  parsed.stroke = ReadNumber<size_t>(Setting(window, "stroke"), "stroke");
+  parsed.background_color = ReadColor(Setting(window, "background color"),
+                                      "background color");
+  parsed.stroke_color =
+      ReadColor(Setting(window, "stroke color"), "stroke color");
+  parsed.text_color = ReadColor(Setting(window, "text color"), "text color");
+  parsed.font = Setting(window, "font").get<string>();
+
+  // The container takes three quarters of the window's width, less the
+  // margins
+  if (parsed.window_width * 3 / 4 <= parsed.margin ||
+      parsed.window_height <= 2 * parsed.margin) {
+    throw std::invalid_argument(
+        "The window is too small for its margin. Please edit your "
+        "configuration file.");
+  }
+  parsed.container_width = parsed.window_width * 3 / 4 - parsed.margin;
+  parsed.container_height = parsed.window_height - 2 * parsed.margin;
+
+  // Runs are two-dimensional unless configured, and a third axis is as deep
+  // as the container is high unless configured
+  parsed.dimensions = ReadOptionalNumber<size_t>(container, "dimensions", 2);
+  if (parsed.dimensions != 2 && parsed.dimensions != 3) {
+    throw std::invalid_argument(
+        "The dimensions must be 2 or 3. Please edit your configuration file.");
+  }
+  parsed.container_depth = ReadOptionalNumber<size_t>(
+      container, "depth", parsed.container_height);
+
+  parsed.histogram_bin_count =
+      ReadNumber<size_t>(Setting(histogram, "bin count"), "bin count");
+  if (parsed.histogram_bin_count == 0) {
+    throw std::invalid_argument("A histogram needs at least one bin.");
+  }
+  // The window is optional and defaults to every step so far
+  parsed.histogram_window_steps = ReadOptionalNumber<size_t>(
+      histogram, "window steps", parsed.histogram_window_steps);
+
+  // The step rate is optional and defaults to the visualizer's frame rate
+  parsed.steps_per_second = ReadOptionalNumber<double>(
+      container, "steps per second", parsed.steps_per_second);
+  // The observable history is optional and defaults to ten seconds at 60
+  // steps per second
+  parsed.observable_history_steps = ReadOptionalNumber<size_t>(
+      container, "observable history steps", parsed.observable_history_steps);
+
+  // Adaptive time steps are optional, and every setting has a default
+  json adaptive = Setting(container, "adaptive time step");
+  if (!adaptive.is_null()) {
+    AdaptiveStepOptions& options = parsed.adaptive_step;
+    options.enabled = adaptive.value("enabled", true);
+    options.max_displacement = ReadOptionalNumber<float>(
+        adaptive, "max displacement", options.max_displacement);
+    options.max_substeps = ReadOptionalNumber<size_t>(
+        adaptive, "max substeps", options.max_substeps);
+    options.per_species = adaptive.value("per species", options.per_species);
+  }
+
+  // The neighbor list is optional, and its skin has a default
+  json neighbor_list = Setting(container, "neighbor list");
+  if (!neighbor_list.is_null()) {
+    NeighborListOptions& options = parsed.neighbor_list;
+    options.enabled = neighbor_list.value("enabled", true);
+    options.skin = ReadOptionalNumber<float>(neighbor_list, "skin",
+                                             options.skin);
+    if (!(options.skin >= 0)) {
+      throw std::invalid_argument(
+          "The neighbor list skin must not be negative. Please edit your "
+          "configuration file.");
+    }
+  }
+
+  // The thread count is optional and defaults to a single thread
+  parsed.thread_count = ReadOptionalNumber<size_t>(container, "threads", 1);
+
+  // Without a seed every run starts differently, as it always has
+  parsed.seed = ReadOptionalNumber<uint64_t>(
+      container, "seed", (uint64_t)std::random_device()());
+
+  // The engine is optional and defaults to fixed time steps
+  string engine = container.value("engine", "time step");
+  if (engine == "event driven") {
+    parsed.simulation_mode = SimulationMode::kEventDriven;
+  } else if (engine == "time step") {
+    parsed.simulation_mode = SimulationMode::kTimeStep;
+  } else {
+    throw std::invalid_argument("Unknown engine: " + engine +
+                                ". Please edit your configuration file.");
+  }
+
+  // Precision is optional and defaults to floats throughout
+  string precision = container.value("precision", "single");
+  if (precision == "mixed") {
+    parsed.precision = PrecisionMode::kMixed;
+  } else if (precision == "double") {
+    parsed.precision = PrecisionMode::kDouble;
+  } else if (precision != "single") {
+    throw std::invalid_argument("Unknown precision: " + precision +
+                                ". Please edit your configuration file.");
+  }
+
+  // The broadphase is optional and defaults to a single uniform grid
+  string broadphase = container.value("broadphase", "grid");
+  if (broadphase == "hierarchical grid") {
+    parsed.broadphase = BroadphaseMode::kHierarchicalGrid;
+  } else if (broadphase != "grid") {
+    throw std::invalid_argument("Unknown broadphase: " + broadphase +
+                                ". Please edit your configuration file.");
+  }
+
+  // Boundaries are optional and default to walls on every axis
+  json boundaries = container.value("boundaries", json::object());
+  const char* axis_names[3] = {"x", "y", "z"};
+  for (size_t axis = 0; axis < parsed.dimensions; ++axis) {
+    string boundary = boundaries.value(axis_names[axis], "reflecting");
+    if (boundary == "periodic") {
+      parsed.boundaries[axis] = BoundaryMode::kPeriodic;
+    } else if (boundary != "reflecting") {
+      throw std::invalid_argument("Unknown " + string(axis_names[axis]) +
+                                  " boundary: " + boundary +
+                                  ". Please edit your configuration file.");
+    }
+  }
+  if (parsed.simulation_mode == SimulationMode::kEventDriven &&
+      (parsed.boundaries[0] == BoundaryMode::kPeriodic ||
+       parsed.boundaries[1] == BoundaryMode::kPeriodic)) {
+    throw std::invalid_argument(
+        "The event-driven engine needs reflecting boundaries. Please edit "
+        "your configuration file.");
+  }
+  if (parsed.simulation_mode == SimulationMode::kEventDriven &&
+      parsed.dimensions != 2) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in two dimensions. Please edit "
+        "your configuration file.");
+  }
+  if (parsed.simulation_mode == SimulationMode::kEventDriven &&
+      parsed.precision != PrecisionMode::kSingle) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in single precision. Please edit "
+        "your configuration file.");
+  }
+
+  // Trajectories are optional, and every setting but the path has a default
+  json trajectory = container.value("trajectory", json::object());
+  parsed.trajectory.dimensions = parsed.dimensions;
+  if (trajectory.contains("path")) {
+    TrajectoryOptions& options = parsed.trajectory;
+    parsed.trajectory_path = trajectory["path"].get<string>();
+    options.stride =
+        ReadOptionalNumber<size_t>(trajectory, "stride", options.stride);
+    options.keyframe_interval = ReadOptionalNumber<size_t>(
+        trajectory, "keyframe interval", options.keyframe_interval);
+    options.position_quantum = ReadOptionalNumber<double>(
+        trajectory, "position precision", options.position_quantum);
+    options.velocity_quantum = ReadOptionalNumber<double>(
+        trajectory, "velocity precision", options.velocity_quantum);
+    options.compression_level = ReadOptionalNumber<int>(
+        trajectory, "compression level", options.compression_level);
+  }
+
+  // Checkpoints are optional
+  json checkpoint = container.value("checkpoint", json::object());
+  parsed.checkpoint_path = checkpoint.value("path", "");
+  parsed.checkpoint_interval_seconds =
+      ReadOptionalNumber<double>(checkpoint, "interval seconds", 0.0);
+  parsed.resume_checkpoint = checkpoint.value("resume", false);
+
+  // Explicit particles are optional
+  parsed.initial_conditions_path = container.value("initial conditions", "");
+
+  // Placement is optional and defaults to uniform positions, which may
+  // overlap
+  string placement = container.value("placement", "uniform");
+  if (placement == "lattice") {
+    parsed.placement = PlacementMode::kLattice;
+  } else if (placement != "uniform") {
+    throw std::invalid_argument("Unknown placement: " + placement +
+                                ". Please edit your configuration file.");
+  }
+
+  json particles = Setting(container, "particles");
+  if (!particles.is_null() && !particles.is_object()) {
+    throw std::invalid_argument("The particles must be an object of species.");
+  }
+  for (auto it = particles.begin(); it != particles.end(); ++it) {
+    SpeciesConfig species;
+    species.name = it.key();
+    const json& settings = it.value();
+    species.particle_count =
+        ReadNumber<size_t>(Setting(settings, "particle count"),
+                           species.name + " particle count");
+    ReadRange(settings, species.name, "velocity", species.min_velocity,
+              species.max_velocity);
+    ReadRange(settings, species.name, "mass", species.min_mass,
+              species.max_mass);
+    ReadRange(settings, species.name, "radius", species.min_radius,
+              species.max_radius);
+    species.color =
+        ReadColor(Setting(settings, "color"), species.name + " color");
+
+    // Check if radius argument is too large for visualizer
+    if (species.max_radius > ParticleContainer::kRadiusLimit) {
+      throw std::invalid_argument(
+          "The maximum allowed radius is: " +
+          std::to_string(ParticleContainer::kRadiusLimit) +
+          ". Please edit your configuration file.");
+    }
+    parsed.species.push_back(species);
+  }
+
+  return parsed;
+}
+
+SimulationConfig LoadConfig(const string& path) {
+  std::ifstream input(path);
+  json config;
+  input >> config;
+  return ParseConfig(config);
+}
+
+}  // namespace idealgas
@@ -0,0 +1,333 @@
+#include "core/ensemble.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "core/config.h"
+#include "core/observables.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/philox.h"
+#include "core/thread_pool.h"
+
+using idealgas::Ensemble;
+using idealgas::EnsembleResult;
+using idealgas::Estimate;
+using idealgas::Observables;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::Philox;
+using idealgas::SpeedDistribution;
+using idealgas::ThreadPool;
+using std::function;
+using std::pair;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The Philox stream replica seeds are drawn from, apart from every species'
+const uint32_t kReplicaSeedStream = 0xFFFFFFFF;
+// The most masses of one species kept for the expected distribution
+const size_t kMaxMassSamples = 4096;
+// The upper edge of the bins in RMS speeds of the lightest particle
+const double kRmsSpeedsPerRange = 4;
+// Pi, which the standard library names only from C++20
+const double kPi = 3.14159265358979323846;
+
+/**
+ * @brief What one replica leaves behind once its container is gone.
+ *
+ */
+struct ReplicaSummary {
+  // The fraction of each species' sampled speeds in each bin, the overflow
+  // fraction last
+  vector<vector<double>> fractions;
+  // The mean temperature of each species over the measured steps
+  vector<double> temperatures;
+  // The mean pressure over the measured steps
+  double pressure = 0;
+  // The mean kinetic energy over the measured steps
+  double kinetic_energy = 0;
+};
+
+/**
+ * @brief Finds the mean of one quantity over the replicas, and the half width
+ * of its confidence interval. The replicas are summed in order, so the result
+ * does not depend on which thread ran which replica.
+ *
+ * @param summaries the summary of every replica
+ * @param value gets the quantity from a summary
+ * @param z the half width of the interval in standard errors
+ * @return the Estimate
+ */
+Estimate Combine(const vector<ReplicaSummary>& summaries,
+                 const function<double(const ReplicaSummary&)>& value,
+                 double z) {
+  Estimate estimate;
+  size_t count = summaries.size();
+  if (count == 0) {
+    return estimate;
+  }
+
+  for (const ReplicaSummary& summary : summaries) {
+    estimate.mean += value(summary);
+  }
+  estimate.mean /= count;
+  if (count == 1) {
+    return estimate;
+  }
+
+  double squares = 0;
+  for (const ReplicaSummary& summary : summaries) {
+    double deviation = value(summary) - estimate.mean;
+    squares += deviation * deviation;
+  }
+  double standard_error = std::sqrt(squares / (count - 1) / count);
+  estimate.half_width = z * standard_error;
+  return estimate;
+}
+
+/**
+ * @brief Finds the probability that a particle is slower than a speed under
+ * the three-dimensional Maxwell-Boltzmann distribution.
+ *
+ * @param speed the speed
+ * @param mass the mass of the particle
+ * @param temperature the temperature, above zero
+ * @return the double probability
+ */
+double SlowerFraction3D(double speed, double mass, double temperature) {
+  // The speed in units of the spread of each velocity component
+  double scaled = speed * std::sqrt(mass / temperature);
+  return std::erf(scaled / std::sqrt(2.0)) -
+         std::sqrt(2 / kPi) * scaled * std::exp(-scaled * scaled / 2);
+}
+
+}  // namespace
+
+Ensemble::Ensemble(const json& config, const EnsembleOptions& options)
+    : config_(config), options_(options) {
+  // Replicas run on one thread each and must not share files
+  config_["container"]["threads"] = 1;
+  config_["container"]["observable history steps"] = 1;
+  config_["container"].erase("checkpoint");
+  config_["container"].erase("trajectory");
+
+  // Without a seed every ensemble starts differently, as a single run does
+  seed_ = config_["container"].value("seed",
+                                     (uint64_t)std::random_device()());
+  options_.bin_count = std::max<size_t>(options_.bin_count, 1);
+  options_.sample_stride = std::max<size_t>(options_.sample_stride, 1);
+
+  ChooseBins();
+}
+
+uint64_t Ensemble::GetReplicaSeed(size_t replica) const {
+  Philox random(seed_, kReplicaSeedStream, replica);
+  uint64_t high = random.NextUint();
+  return high << 32 | random.NextUint();
+}
+
+uint64_t Ensemble::GetSeed() const {
+  return seed_;
+}
+
+void Ensemble::ChooseBins() {
+  // The first replica's particles, configured with every thread but not run
+  json config = config_;
+  config["container"]["seed"] = GetReplicaSeed(0);
+  config["container"]["threads"] = options_.thread_count;
+  ParticleContainer container;
+  container.ConfigureFromJson(config);
+  const ParticleStore& particles = container.GetParticles();
+
+  // Collisions share the energy out until every particle has the same mean
+  // kinetic energy, which is the temperature times half the dimensions
+  dimensions_ = particles.GetDimensions();
+  double kinetic_energy = 0;
+  for (size_t index = 0; index < particles.size(); ++index) {
+    float squared_speed = 0;
+    for (size_t axis = 0; axis < dimensions_; ++axis) {
+      float velocity = particles.GetVelocities(axis)[index];
+      squared_speed += velocity * velocity;
+    }
+    kinetic_energy += 0.5 * particles.GetMasses()[index] * squared_speed;
+  }
+  double temperature =
+      particles.size() > 0
+          ? kinetic_energy / particles.size() / (dimensions_ / 2.0)
+          : 0;
+
+  species_names_ = particles.GetSpeciesNames();
+  max_speeds_.assign(species_names_.size(), 1);
+  species_masses_.assign(species_names_.size(), {});
+  for (SpeciesId species = 0; species < species_names_.size(); ++species) {
+    pair<size_t, size_t> range = particles.GetSpeciesRange(species);
+    if (range.first == range.second) {
+      continue;
+    }
+
+    float lightest = *std::min_element(
+        particles.GetMasses().begin() + range.first,
+        particles.GetMasses().begin() + range.second);
+    double max_speed =
+        kRmsSpeedsPerRange * std::sqrt(dimensions_ * temperature / lightest);
+    if (std::isfinite(max_speed) && max_speed > 0) {
+      max_speeds_[species] = max_speed;
+    }
+
+    size_t stride =
+        (range.second - range.first + kMaxMassSamples - 1) / kMaxMassSamples;
+    for (size_t index = range.first; index < range.second; index += stride) {
+      species_masses_[species].push_back(particles.GetMasses()[index]);
+    }
+  }
+}
+
+EnsembleResult Ensemble::Run() const {
+  size_t species_count = species_names_.size();
+  size_t bin_count = options_.bin_count;
+  vector<ReplicaSummary> summaries(options_.replicas);
+
+  // Each replica writes only its own summary, so they need no locking
+  ThreadPool pool(options_.thread_count);
+  pool.ParallelFor(
+      options_.replicas,
+      [&](size_t begin, size_t end) {
+        for (size_t replica = begin; replica < end; ++replica) {
+          json config = config_;
+          config["container"]["seed"] = GetReplicaSeed(replica);
+          ParticleContainer container;
+          container.ConfigureFromJson(config);
+          const ParticleStore& particles = container.GetParticles();
+
+          vector<vector<size_t>> counts(species_count,
+                                        vector<size_t>(bin_count + 1, 0));
+          ReplicaSummary& summary = summaries[replica];
+          summary.temperatures.assign(species_count, 0);
+          size_t measured_steps = 0;
+
+          for (size_t step = 1; step <= options_.steps; ++step) {
+            container.Increment();
+            if (step <= options_.warmup_steps) {
+              continue;
+            }
+
+            const Observables& observables =
+                container.GetObservableHistory().back();
+            for (size_t species = 0;
+                 species < observables.temperatures.size(); ++species) {
+              summary.temperatures[species] +=
+                  observables.temperatures[species];
+            }
+            summary.pressure += observables.pressure;
+            summary.kinetic_energy += observables.kinetic_energy;
+            ++measured_steps;
+
+            if ((step - options_.warmup_steps) % options_.sample_stride != 0) {
+              continue;
+            }
+            for (SpeciesId species = 0; species < species_count; ++species) {
+              pair<size_t, size_t> range = particles.GetSpeciesRange(species);
+              double bins_per_speed = bin_count / max_speeds_[species];
+              for (size_t index = range.first; index < range.second; ++index) {
+                double bin = particles.GetSpeed(index) * bins_per_speed;
+                ++counts[species][bin < bin_count ? (size_t)bin : bin_count];
+              }
+            }
+          }
+
+          if (measured_steps > 0) {
+            for (double& temperature : summary.temperatures) {
+              temperature /= measured_steps;
+            }
+            summary.pressure /= measured_steps;
+            summary.kinetic_energy /= measured_steps;
+          }
+          summary.fractions.assign(species_count,
+                                   vector<double>(bin_count + 1, 0));
+          for (size_t species = 0; species < species_count; ++species) {
+            size_t total = 0;
+            for (size_t count : counts[species]) {
+              total += count;
+            }
+            for (size_t bin = 0; total > 0 && bin <= bin_count; ++bin) {
+              summary.fractions[species][bin] =
+                  (double)counts[species][bin] / total;
+            }
+          }
+        }
+      },
+      1);
+
+  EnsembleResult result;
+  result.seed = seed_;
+  result.replicas = options_.replicas;
+  double z = options_.confidence_z;
+  result.pressure = Combine(
+      summaries, [](const ReplicaSummary& s) { return s.pressure; }, z);
+  result.kinetic_energy = Combine(
+      summaries, [](const ReplicaSummary& s) { return s.kinetic_energy; }, z);
+
+  for (size_t species = 0; species < species_count; ++species) {
+    result.temperatures.push_back(Combine(
+        summaries,
+        [species](const ReplicaSummary& s) {
+          return s.temperatures[species];
+        },
+        z));
+
+    SpeedDistribution distribution;
+    distribution.title = species_names_[species];
+    double temperature = result.temperatures[species].mean;
+    double lower = 0;
+    for (size_t bin = 0; bin < bin_count; ++bin) {
+      double upper = max_speeds_[species] * (bin + 1) / bin_count;
+      distribution.bin_cutoffs.push_back((float)upper);
+      distribution.fractions.push_back(Combine(
+          summaries,
+          [species, bin](const ReplicaSummary& s) {
+            return s.fractions[species][bin];
+          },
+          z));
+
+      // In two dimensions a particle of mass m is slower than v with
+      // probability 1 - exp(-m v^2 / 2T), averaged here over the masses, and
+      // in three dimensions with the probability SlowerFraction3D finds
+      double expected = 0;
+      for (float mass : species_masses_[species]) {
+        if (temperature > 0 && dimensions_ == 3) {
+          expected += SlowerFraction3D(upper, mass, temperature) -
+                      SlowerFraction3D(lower, mass, temperature);
+        } else if (temperature > 0) {
+          expected += std::exp(-mass * lower * lower / (2 * temperature)) -
+                      std::exp(-mass * upper * upper / (2 * temperature));
+        } else {
+          expected += bin == 0 ? 1 : 0;
+        }
+      }
+      distribution.maxwell_boltzmann.push_back(
+          species_masses_[species].empty()
+              ? 0
+              : expected / species_masses_[species].size());
+      lower = upper;
+    }
+    distribution.overflow = Combine(
+        summaries,
+        [species, bin_count](const ReplicaSummary& s) {
+          return s.fractions[species][bin_count];
+        },
+        z);
+    result.speeds.push_back(distribution);
+  }
+  return result;
+}
+
+}  // namespace idealgas
@@ -0,0 +1,329 @@
+#include "core/event_driven_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "core/particle_store.h"
+
+using glm::dot;
+using glm::vec2;
+using idealgas::EventDrivenEngine;
+using idealgas::ParticleStore;
+using std::max;
+using std::min;
+using std::vector;
+
+namespace idealgas {
+
+void EventDrivenEngine::Advance(ParticleStore& particles, float duration,
+                                float width, float height) {
+  if (!built_ || NeedsRebuild(particles, width, height)) {
+    Rebuild(particles, width, height);
+  }
+
+  wall_impulse_ = 0;
+  double target = now_ + duration;
+  size_t event_limit = kMaxEventsPerParticle * max<size_t>(particles.size(), 1);
+  size_t events_this_call = 0;
+
+  while (!events_.empty() && events_.top().time <= target &&
+         events_this_call < event_limit) {
+    Event event = events_.top();
+    events_.pop();
+
+    // Skip events made stale by a later event since they were predicted
+    if (event.first_count != counts_[event.first] ||
+        (event.type == EventType::kParticle &&
+         event.second_count != counts_[event.second])) {
+      continue;
+    }
+
+    now_ = event.time;
+    ++processed_events_;
+    ++events_this_call;
+    MoveTo(particles, event.first, now_);
+
+    switch (event.type) {
+      case EventType::kParticle: {
+        MoveTo(particles, event.second, now_);
+        Collide(particles, event.first, event.second);
+        Predict(particles, event.first, false);
+        Predict(particles, event.second, false);
+        break;
+      }
+      case EventType::kWall: {
+        vector<float>& velocities = particles.GetVelocities(event.second);
+        wall_impulse_ += 2.0 * particles.GetMasses()[event.first] *
+                         std::abs(velocities[event.first]);
+        velocities[event.first] = -velocities[event.first];
+        ++counts_[event.first];
+        // If collision with wall occurs, then make particle redder (feature)
+        vector<ColorT<float>>& colors = particles.GetColors();
+        colors[event.first] = colors[event.first] * ColorT<float>(1, 0.95, 0.95);
+        Predict(particles, event.first, false);
+        break;
+      }
+      case EventType::kCell: {
+        // Predicting again brings in the new neighbors, so the particle's
+        // earlier events are retired to keep each one from running twice
+        size_t cell = particle_cells_[event.first];
+        size_t stride = event.second == 0 ? 1 : cell_counts_[0];
+        MoveToCell(event.first,
+                   event.direction > 0 ? cell + stride : cell - stride);
+        ++counts_[event.first];
+        Predict(particles, event.first, false);
+        break;
+      }
+    }
+
+    // Stale events pile up in the queue, so start over when it grows large
+    if (events_.size() > kMaxQueuedEventsPerParticle * particles.size() +
+                             kMinCellLimit) {
+      for (uint32_t index = 0; index < particles.size(); ++index) {
+        MoveTo(particles, index, now_);
+      }
+      Rebuild(particles, width, height);
+    }
+  }
+
+  // Events up to the end of the span may be left over when the limit stops
+  // the call. Moving past them would carry particles through walls, so the
+  // particles stay where the last event left them and the queue is predicted
+  // again from the end of the span.
+  if (events_this_call == event_limit) {
+    for (uint32_t index = 0; index < particles.size(); ++index) {
+      MoveTo(particles, index, now_);
+    }
+    now_ = target;
+    Rebuild(particles, width, height);
+    return;
+  }
+
+  // Bring every particle to the end of the span
+  now_ = target;
+  for (uint32_t index = 0; index < particles.size(); ++index) {
+    MoveTo(particles, index, now_);
+  }
+}
+
+void EventDrivenEngine::Reset() {
+  built_ = false;
+}
+
+size_t EventDrivenEngine::GetProcessedEventCount() const {
+  return processed_events_;
+}
+
+double EventDrivenEngine::GetWallImpulse() const {
+  return wall_impulse_;
+}
+
+bool EventDrivenEngine::NeedsRebuild(const ParticleStore& particles,
+                                     float width, float height) const {
+  return particles.size() != times_.size() || width != width_ ||
+         height != height_;
+}
+
+void EventDrivenEngine::Rebuild(const ParticleStore& particles, float width,
+                                float height) {
+  built_ = true;
+  width_ = width;
+  height_ = height;
+  times_.assign(particles.size(), now_);
+  counts_.assign(particles.size(), 0);
+  events_ = decltype(events_)();
+
+  // Cells at least one diameter wide put every touching pair in adjacent
+  // cells, coarsened when the container is large compared to the particles
+  float max_radius = 0;
+  for (float radius : particles.GetRadii()) {
+    max_radius = max(max_radius, radius);
+  }
+  cell_size_ = max(2 * max_radius, 1.0f);
+  size_t cell_limit =
+      max(kMinCellLimit, kCellsPerParticle * particles.size());
+  while ((double)std::ceil(width / cell_size_) * std::ceil(height / cell_size_) >
+         cell_limit) {
+    cell_size_ *= 2;
+  }
+  cell_counts_[0] = max<size_t>((size_t)std::ceil(width / cell_size_), 1);
+  cell_counts_[1] = max<size_t>((size_t)std::ceil(height / cell_size_), 1);
+
+  cell_members_.assign(cell_counts_[0] * cell_counts_[1], {});
+  particle_cells_.assign(particles.size(), 0);
+  particle_slots_.assign(particles.size(), 0);
+  for (uint32_t index = 0; index < particles.size(); ++index) {
+    size_t column = CellCoordinate(particles.GetPositions(0)[index], 0);
+    size_t row = CellCoordinate(particles.GetPositions(1)[index], 1);
+    size_t cell = row * cell_counts_[0] + column;
+    particle_cells_[index] = cell;
+    particle_slots_[index] = cell_members_[cell].size();
+    cell_members_[cell].push_back(index);
+  }
+
+  for (uint32_t index = 0; index < particles.size(); ++index) {
+    Predict(particles, index, true);
+  }
+}
+
+void EventDrivenEngine::MoveTo(ParticleStore& particles, uint32_t index,
+                               double time) {
+  float elapsed = (float)(time - times_[index]);
+  // Disabled particles stay where they are
+  if (elapsed != 0 && particles.IsEnabled(index)) {
+    for (size_t axis = 0; axis < 2; ++axis) {
+      particles.GetPositions(axis)[index] +=
+          elapsed * particles.GetVelocities(axis)[index];
+    }
+  }
+  times_[index] = time;
+}
+
+void EventDrivenEngine::Predict(const ParticleStore& particles, uint32_t index,
+                                bool later_only) {
+  // Disabled particles have no events, and nothing collides with them
+  if (!particles.IsEnabled(index)) {
+    return;
+  }
+
+  float radius = particles.GetRadii()[index];
+  float limits[2] = {width_, height_};
+  size_t cell = particle_cells_[index];
+  size_t coordinates[2] = {cell % cell_counts_[0], cell / cell_counts_[0]};
+
+  for (uint32_t axis = 0; axis < 2; ++axis) {
+    float position = particles.GetPositions(axis)[index];
+    float velocity = particles.GetVelocities(axis)[index];
+    if (velocity == 0) {
+      continue;
+    }
+
+    // The next wall in the direction of travel, immediately if already past it
+    double wall_time = velocity > 0 ? (limits[axis] - radius - position) / velocity
+                                    : (radius - position) / velocity;
+    events_.push({now_ + max(0.0, wall_time), index, axis, counts_[index], 0,
+                  EventType::kWall, 0});
+
+    // The next cell boundary, unless the particle is in the last cell
+    size_t coordinate = coordinates[axis];
+    if (velocity > 0 && coordinate + 1 < cell_counts_[axis]) {
+      double boundary = (double)(coordinate + 1) * cell_size_;
+      events_.push({now_ + max(0.0, (boundary - position) / velocity), index,
+                    axis, counts_[index], 0, EventType::kCell, 1});
+    } else if (velocity < 0 && coordinate > 0) {
+      double boundary = (double)coordinate * cell_size_;
+      events_.push({now_ + max(0.0, (boundary - position) / velocity), index,
+                    axis, counts_[index], 0, EventType::kCell, -1});
+    }
+  }
+
+  // Collisions with every particle in the surrounding three by three cells
+  for (long row = (long)coordinates[1] - 1; row <= (long)coordinates[1] + 1;
+       ++row) {
+    for (long column = (long)coordinates[0] - 1;
+         column <= (long)coordinates[0] + 1; ++column) {
+      if (row < 0 || column < 0 || row >= (long)cell_counts_[1] ||
+          column >= (long)cell_counts_[0]) {
+        continue;
+      }
+      for (uint32_t other : cell_members_[row * cell_counts_[0] + column]) {
+        if (other != index && (!later_only || other > index) &&
+            particles.IsEnabled(other)) {
+          PredictPair(particles, index, other);
+        }
+      }
+    }
+  }
+}
+
+void EventDrivenEngine::PredictPair(const ParticleStore& particles,
+                                    uint32_t first, uint32_t second) {
+  // The second particle may still be at an earlier time
+  double lag = now_ - times_[second];
+  double displacement[2];
+  double relative_velocity[2];
+  for (size_t axis = 0; axis < 2; ++axis) {
+    const vector<float>& positions = particles.GetPositions(axis);
+    const vector<float>& velocities = particles.GetVelocities(axis);
+    displacement[axis] = (double)positions[first] -
+                         (positions[second] + velocities[second] * lag);
+    relative_velocity[axis] = (double)velocities[first] - velocities[second];
+  }
+
+  // Solve |displacement + relative_velocity * t| = the sum of the radii
+  double approach = displacement[0] * relative_velocity[0] +
+                    displacement[1] * relative_velocity[1];
+  if (approach >= 0) {
+    return;
+  }
+  double speed_squared = relative_velocity[0] * relative_velocity[0] +
+                         relative_velocity[1] * relative_velocity[1];
+  double contact = (double)particles.GetRadii()[first] +
+                   particles.GetRadii()[second];
+  double gap = displacement[0] * displacement[0] +
+               displacement[1] * displacement[1] - contact * contact;
+  double discriminant = approach * approach - speed_squared * gap;
+  if (discriminant < 0) {
+    return;
+  }
+
+  // Overlapping particles that are approaching collide at once, as in the
+  // fixed-step model
+  double time = gap <= 0 ? 0 : gap / (-approach + std::sqrt(discriminant));
+  events_.push({now_ + time, first, second, counts_[first], counts_[second],
+                EventType::kParticle, 0});
+}
+
+void EventDrivenEngine::Collide(ParticleStore& particles, uint32_t first,
+                                uint32_t second) {
+  vec2 x1 = particles.GetPosition(first);
+  vec2 x2 = particles.GetPosition(second);
+  vec2 v1 = particles.GetVelocity(first);
+  vec2 v2 = particles.GetVelocity(second);
+  float m1 = particles.GetMasses()[first];
+  float m2 = particles.GetMasses()[second];
+
+  ++counts_[first];
+  ++counts_[second];
+
+  vec2 normal = x1 - x2;
+  float distance_squared = dot(normal, normal);
+  if (distance_squared == 0) {
+    return;
+  }
+
+  // The same elastic collision as the fixed-step model, at the contact point
+  vec2 impulse = dot(v1 - v2, normal) / distance_squared * normal;
+  particles.SetVelocity(first, v1 - 2 * m2 / (m1 + m2) * impulse);
+  particles.SetVelocity(second, v2 + 2 * m1 / (m1 + m2) * impulse);
+
+  // If collision occurs, make particle bluer (feature)
+  vector<ColorT<float>>& colors = particles.GetColors();
+  uint32_t base = min(first, second);
+  colors[base] = colors[base] * ColorT<float>(0.99, 0.99, 1);
+}
+
+size_t EventDrivenEngine::CellCoordinate(float position, size_t axis) const {
+  // Particles outside the container are kept in the edge cells
+  if (!(position > 0)) {
+    return 0;
+  }
+  return min((size_t)(position / cell_size_), cell_counts_[axis] - 1);
+}
+
+void EventDrivenEngine::MoveToCell(uint32_t index, size_t cell) {
+  // Swap the particle with the last member of its old cell and pop it
+  vector<uint32_t>& old_members = cell_members_[particle_cells_[index]];
+  uint32_t last = old_members.back();
+  old_members[particle_slots_[index]] = last;
+  particle_slots_[last] = particle_slots_[index];
+  old_members.pop_back();
+
+  particle_cells_[index] = cell;
+  particle_slots_[index] = cell_members_[cell].size();
+  cell_members_[cell].push_back(index);
+}
+
+}  // namespace idealgas
@@ -0,0 +1,142 @@
+#include "core/hierarchical_grid.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+using idealgas::CellGrid;
+using idealgas::HierarchicalGrid;
+using idealgas::ParticleStore;
+using std::max;
+using std::vector;
+
+namespace idealgas {
+
+void HierarchicalGrid::Build(const ParticleStore& particles,
+                             const array<float, 3>& periods, float skin) {
+  const vector<float>& radii = particles.GetRadii();
+  for (Level& level : all_levels_) {
+    level.particles.clear();
+  }
+  levels_.clear();
+  color_cells_.clear();
+  if (particles.empty()) {
+    return;
+  }
+
+  // Each level holds radii up to kLevelRatio times the largest of the level
+  // before, the first up to kLevelRatio times the smallest radius present
+  float min_radius = *std::min_element(radii.begin(), radii.end());
+  float first_bound = max(min_radius, kMinRadius) * kLevelRatio;
+  for (size_t index = 0; index < particles.size(); ++index) {
+    size_t level = 0;
+    float bound = first_bound;
+    while (radii[index] > bound && level + 1 < kMaxLevels) {
+      bound *= kLevelRatio;
+      ++level;
+    }
+    all_levels_[level].particles.push_back(index);
+  }
+
+  size_t cell_count = 0;
+  for (size_t level = 0; level < kMaxLevels; ++level) {
+    Level& bounds = all_levels_[level];
+    if (bounds.particles.empty()) {
+      continue;
+    }
+    bounds.grid.Build(particles, periods, bounds.particles, skin);
+    bounds.first_cell = cell_count;
+    cell_count += bounds.grid.GetCellCount();
+    levels_.push_back(level);
+    LocateVisitors(particles, level);
+
+    // A color's cells are those holding the level's particles or visitors,
+    // in increasing order
+    size_t first_color = color_cells_.size();
+    color_cells_.resize(first_color + bounds.grid.GetColorCount());
+    vector<vector<size_t>> visited(bounds.grid.GetColorCount());
+    for (size_t cell = 0; cell + 1 < bounds.visitor_starts.size(); ++cell) {
+      if (bounds.visitor_starts[cell] != bounds.visitor_starts[cell + 1]) {
+        visited[bounds.grid.GetColorOf(cell)].push_back(cell);
+      }
+    }
+    for (size_t color = 0; color < visited.size(); ++color) {
+      const vector<size_t>& occupied = bounds.grid.GetCellsOfColor(color);
+      vector<size_t>& cells = color_cells_[first_color + color];
+      std::set_union(occupied.begin(), occupied.end(), visited[color].begin(),
+                     visited[color].end(), std::back_inserter(cells));
+      for (size_t& cell : cells) {
+        cell += bounds.first_cell;
+      }
+    }
+  }
+}
+
+void HierarchicalGrid::LocateVisitors(const ParticleStore& particles,
+                                      size_t level) {
+  Level& bounds = all_levels_[level];
+  bounds.visitors.clear();
+  bounds.visitor_cells.clear();
+  bounds.visitor_starts.clear();
+  if (levels_.size() < 2) {
+    return;
+  }
+
+  // Count the finer particles in each cell, offset by one for the prefix sum
+  bounds.visitor_starts.assign(bounds.grid.GetCellCount() + 1, 0);
+  for (size_t finer : levels_) {
+    if (finer == level) {
+      break;
+    }
+    for (size_t index : all_levels_[finer].particles) {
+      size_t cell = bounds.grid.LocateCell(particles, index);
+      bounds.visitor_cells.push_back(cell);
+      ++bounds.visitor_starts[cell + 1];
+    }
+  }
+  for (size_t cell = 1; cell < bounds.visitor_starts.size(); ++cell) {
+    bounds.visitor_starts[cell] += bounds.visitor_starts[cell - 1];
+  }
+
+  // Scatter the visitors into their cells' contiguous ranges
+  vector<size_t> cursors(bounds.visitor_starts.begin(),
+                         bounds.visitor_starts.end() - 1);
+  bounds.visitors.resize(bounds.visitor_cells.size());
+  size_t slot = 0;
+  for (size_t finer : levels_) {
+    if (finer == level) {
+      break;
+    }
+    for (size_t index : all_levels_[finer].particles) {
+      bounds.visitors[cursors[bounds.visitor_cells[slot++]]++] = index;
+    }
+  }
+}
+
+const vector<size_t>& HierarchicalGrid::GetCellsOfColor(size_t color) const {
+  return color_cells_.at(color);
+}
+
+size_t HierarchicalGrid::GetColorCount() const {
+  return color_cells_.size();
+}
+
+size_t HierarchicalGrid::GetLevelCount() const {
+  return levels_.size();
+}
+
+const CellGrid& HierarchicalGrid::GetLevel(size_t level) const {
+  return all_levels_[levels_.at(level)].grid;
+}
+
+size_t HierarchicalGrid::LevelOf(size_t cell) const {
+  // There are only a few levels, so a linear search is fastest
+  size_t level = 0;
+  while (level + 1 < levels_.size() &&
+         all_levels_[levels_[level + 1]].first_cell <= cell) {
+    ++level;
+  }
+  return level;
+}
+
+}  // namespace idealgas
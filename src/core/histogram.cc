@@ -1,27 +1,18 @@
 #include "core/histogram.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <numeric>
+#include <string>
 #include <vector>
 
-#include "cinder/gl/gl.h"
-#include "core/particle.h"
-
-using ci::ColorT;
-using ci::Font;
-using ci::Rectf;
-using ci::gl::color;
-using ci::gl::drawSolidRoundedRect;
-using ci::gl::drawString;
-using ci::gl::drawStringCentered;
-using ci::gl::drawStringRight;
-using ci::gl::drawStrokedRect;
-using glm::vec2;
 using idealgas::Histogram;
-using idealgas::Particle;
 using std::accumulate;
 using std::begin;
 using std::end;
 using std::max_element;
+using std::minmax_element;
 using std::min_element;
 using std::sort;
 using std::to_string;
@@ -29,95 +20,110 @@ using std::vector;
 
 namespace idealgas {
 
-Histogram::Histogram(const string& title, size_t bin_count)
-    : title_(title), bin_count_(bin_count) {}
-
-Histogram::Histogram(const string& title, size_t bin_count, size_t width,
-                     size_t height, const vec2& offset, size_t stroke,
-                     const ColorT<float>& stroke_color,
-                     const ColorT<float>& bar_color,
-                     const ColorT<float>& text_color, const string& font)
-    // Uses an initializer list to set all the private variables
-    : title_(title),
-      bin_count_(bin_count),
-      width_(width),
-      height_(height),
-      offset_(offset),
-      stroke_(stroke),
-      stroke_color_(stroke_color),
-      bar_color_(bar_color),
-      text_color_(text_color),
-      font_family_(font) {
-
-  graph_offset_ = offset_ + vec2(stroke_ / 2, 0) + vec2(width_ / 10, 0);
-  graph_width_ = width_ * 8.5 / 10;
-  bin_width_ = graph_width_ / bin_count_;
-  title_font_ = Font(font_family_, height_ / 20);
-  label_font_ = Font(font_family_, height_ / 25);
+Histogram::Histogram(const string& title, size_t bin_count,
+                     size_t window_steps)
+    : window_steps_(window_steps),
+      title_(title),
+      bin_count_(std::max<size_t>(bin_count, 1)) {
+  step_counts_.assign(bin_count_, 0);
+  window_counts_.assign(bin_count_, 0);
+  step_min_ = std::numeric_limits<float>::infinity();
+  step_max_ = -std::numeric_limits<float>::infinity();
+
+  // The ring of past steps is allocated once, up front
+  history_counts_.assign(window_steps_ * bin_count_, 0);
+  history_min_.assign(window_steps_, 0);
+  history_max_.assign(window_steps_, 0);
 }
 
-void Histogram::Draw() {
-  // Calls each heartbeat function in order to draw the graph
-  CalculateFrequencies();
-
-  NormalizeBins();
-
-  DrawFrame();
-
-  DrawBins();
+void Histogram::Update(float value) {
+  if (!std::isfinite(value)) {
+    return;
+  }
+  step_min_ = std::min(step_min_, value);
+  step_max_ = std::max(step_max_, value);
+
+  // Hold values back until there are enough to choose a range from
+  if (!has_range_) {
+    pending_values_.push_back(value);
+    if (pending_values_.size() >= kMaxPendingValues) {
+      EstablishRange();
+    }
+    return;
+  }
 
-  DrawText();
+  Bin(value);
 }
 
-void Histogram::Update(float value) {
-  values_.push_back(value);
+void Histogram::EndStep() {
+  // Without a window, every step keeps adding to the same counts
+  if (window_steps_ == 0) {
+    return;
+  }
+  if (!has_range_) {
+    EstablishRange();
+  }
+
+  // Overwrite the oldest step once the ring is full
+  size_t* slot = &history_counts_[history_next_ * bin_count_];
+  if (history_size_ == window_steps_) {
+    for (size_t bin = 0; bin < bin_count_; ++bin) {
+      window_counts_[bin] -= slot[bin];
+    }
+  } else {
+    ++history_size_;
+  }
+  std::copy(step_counts_.begin(), step_counts_.end(), slot);
+  history_min_[history_next_] = step_min_;
+  history_max_[history_next_] = step_max_;
+  history_next_ = (history_next_ + 1) % window_steps_;
+
+  std::fill(step_counts_.begin(), step_counts_.end(), 0);
+  step_min_ = std::numeric_limits<float>::infinity();
+  step_max_ = -std::numeric_limits<float>::infinity();
 }
 
 void Histogram::CalculateFrequencies() {
-  if (values_.size() == 0) {
-    return;
-  }
   // Clear bin vectors before each calculation
   bin_heights_.clear();
   bin_cutoffs_.clear();
 
-  // Order all values for sequential binning
-  sort(values_.begin(), values_.end());
+  if (!has_range_) {
+    EstablishRange();
+  }
+  size_t value_count = GetValueCount();
+  if (value_count == 0) {
+    return;
+  }
 
-  float min_speed = values_.front();
-  float max_speed = values_.back();
+  float min_speed = step_min_;
+  float max_speed = step_max_;
+  for (size_t step = 0; step < history_size_; ++step) {
+    min_speed = std::min(min_speed, history_min_[step]);
+    max_speed = std::max(max_speed, history_max_[step]);
+  }
 
+  // A single repeated value fills every bin, as it has no spread to show
   if (min_speed == max_speed) {
-    vector<float> cutoffs(bin_count_, min_speed);
-    bin_cutoffs_ = cutoffs;
-    vector<float> heights(bin_count_, (int) values_.size() / min_speed);
-    bin_heights_ = heights;
+    bin_cutoffs_.assign(bin_count_, min_speed);
+    bin_heights_.assign(bin_count_, value_count);
     return;
   }
 
-  float bin_increment = (max_speed - min_speed) / bin_count_;
-  float bin_cutoff = bin_increment;
-
-  float sum = 0;
-
-  for (size_t value = 0; value < values_.size(); ++value) {
-    // If value is within bin, increment
-    if (values_.at(value) < min_speed + bin_cutoff) {
-      sum += 1;
-    } 
-    // Otherwise, shift to the next bin and redo value
-    else {
-      bin_cutoffs_.push_back(bin_cutoff);
-      bin_heights_.push_back(sum);
-      sum = 0;
-      bin_cutoff += bin_increment;
-      --value;
-    }
+  for (size_t bin = 0; bin < bin_count_; ++bin) {
+    bin_cutoffs_.push_back(lower_edge_ + (bin + 1) * bin_width_);
+    bin_heights_.push_back(window_counts_[bin]);
   }
 }
 
 void Histogram::NormalizeBins() {
+  if (bin_heights_.empty()) {
+    return;
+  }
   float max_bin = *max_element(bin_heights_.begin(), bin_heights_.end());
+  if (max_bin == 0) {
+    return;
+  }
 
   // Divide each by max element
   for (size_t index = 0; index < bin_heights_.size(); ++index) {
@@ -129,90 +135,92 @@ vector<float> Histogram::GetBinHeights() const {
   return bin_heights_;
 }
 
-void Histogram::DrawFrame() {
-  vec2 top_left = offset_;
+vector<float> Histogram::GetBinCutoffs() const {
+  return bin_cutoffs_;
+}
 
-  vec2 bottom_right = offset_ + vec2(width_, height_);
+const string& Histogram::GetTitle() const {
+  return title_;
+}
 
-  Rectf bounding_box(top_left, bottom_right);
+size_t Histogram::GetValueCount() const {
+  return accumulate(window_counts_.begin(), window_counts_.end(), size_t(0)) +
+         pending_values_.size();
+}
 
-  color(stroke_color_);
+void Histogram::EstablishRange() {
+  if (pending_values_.empty()) {
+    return;
+  }
+  has_range_ = true;
+
+  auto extremes = minmax_element(pending_values_.begin(), pending_values_.end());
+  float min_value = *extremes.first;
+  float max_value = *extremes.second;
+  lower_edge_ = min_value;
+
+  if (min_value == max_value) {
+    // Any width fits a single value, and later values widen the range
+    bin_width_ = 1;
+    upper_edge_ = lower_edge_ + bin_count_;
+    step_counts_[0] += pending_values_.size();
+    window_counts_[0] += pending_values_.size();
+  } else {
+    bin_width_ = ((double)max_value - min_value) / bin_count_;
+    upper_edge_ = max_value;
+    for (float value : pending_values_) {
+      if (value == max_value) {
+        continue;
+      }
+      size_t bin = std::min(
+          (size_t)((value - lower_edge_) / bin_width_), bin_count_ - 1);
+      ++step_counts_[bin];
+      ++window_counts_[bin];
+    }
+  }
 
-  // Draw the box frame of each histogram
-  drawStrokedRect(bounding_box, stroke_);
+  // The raw values are never needed again
+  vector<float>().swap(pending_values_);
 }
 
-void Histogram::DrawText() {
-  // The "magic numbers" in the following function are necessary, as setting
-  // private variables for all of them would be poor design.
-
-  // Draws the title on the bottom middle
-  drawStringCentered(title_, offset_ + vec2(width_ / 2, height_ * 9.3 / 10),
-                     text_color_, title_font_);
-
-  // Sorts bins by heights to label axes
-  sort(bin_heights_.begin(), bin_heights_.end());
-
-
-  // Draws the y axis labels
-  drawString(to_string((int)bin_heights_.front()),
-             graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.8),
-             text_color_, label_font_);
-  drawString(to_string((int)bin_heights_.back()),
-             graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.05),
-             text_color_, label_font_);
-  drawString(
-      to_string(((int)bin_heights_.front() + (int)bin_heights_.back()) / 2),
-      graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.45), text_color_,
-      label_font_);
-
-  // Draws the x axis labels
-  drawString(to_string(bin_cutoffs_.front()),
-             graph_offset_ + vec2(stroke_, height_ * 0.85), text_color_,
-             label_font_);
-
-  drawString(to_string((bin_cutoffs_.front() + bin_cutoffs_.back()) / 2),
-             graph_offset_ + vec2(graph_width_ / 2, height_ * 8.5 / 10),
-             text_color_, label_font_);
-
-  drawStringRight(to_string(bin_cutoffs_.back()),
-                  graph_offset_ + vec2(graph_width_, height_ * 0.85),
-                  text_color_, label_font_);
-
-  // Draw the axis label
-  drawStringCentered("x = Speed, y = Frequency",
-                     graph_offset_ + vec2(graph_width_ / 2, height_ * 0.025),
-                     text_color_, label_font_);
+void Histogram::Bin(float value) {
+  while (value < lower_edge_) {
+    Widen(true);
+  }
+  // Values on the upper edge fall in the last bin, and only values above it
+  // widen the range, each time by doubling
+  while (value > upper_edge_) {
+    Widen(false);
+  }
+  size_t bin = std::min((size_t)((value - lower_edge_) / bin_width_),
+                        bin_count_ - 1);
+
+  ++step_counts_[bin];
+  ++window_counts_[bin];
 }
 
-void Histogram::DrawBins() {
-  // The "magic numbers" in the following function are necessary, as setting
-  // private variables for all of them would be poor design.
-  size_t max_bar_height = height_ * 8 / 10;
-  color(bar_color_);
-
-  for (size_t bin = 0; bin < bin_heights_.size(); ++bin) {
-    size_t proportional_height = bin_heights_.at(bin) * max_bar_height;
-
-    vec2 top_left;
-
-    // If statement ensures that low-level bar does not go "negative"
-    if (max_bar_height + stroke_ <
-        max_bar_height - proportional_height + stroke_ * 3) {
-      top_left = graph_offset_ +
-                 vec2(bin * bin_width_, max_bar_height - proportional_height);
-    } else {
-      top_left = graph_offset_ +
-                 vec2(bin * bin_width_,
-                      max_bar_height - proportional_height + stroke_ * 3);
-    }
+void Histogram::Widen(bool downward) {
+  MergeCounts(step_counts_.data(), downward);
+  MergeCounts(window_counts_.data(), downward);
+  for (size_t step = 0; step < history_size_; ++step) {
+    MergeCounts(&history_counts_[step * bin_count_], downward);
+  }
 
-    vec2 bottom_right =
-        graph_offset_ + vec2((bin + 1) * bin_width_, max_bar_height + stroke_);
+  if (downward) {
+    lower_edge_ -= bin_count_ * bin_width_;
+  } else {
+    upper_edge_ += bin_count_ * bin_width_;
+  }
+  bin_width_ *= 2;
+}
 
-    Rectf bounding_box(top_left, bottom_right);
-    drawSolidRoundedRect(bounding_box, 1);
+void Histogram::MergeCounts(size_t* counts, bool downward) const {
+  // Old bin j lands in new bin j / 2, shifted by the bins added below
+  vector<size_t> merged(bin_count_, 0);
+  for (size_t bin = 0; bin < bin_count_; ++bin) {
+    merged[downward ? (bin + bin_count_) / 2 : bin / 2] += counts[bin];
   }
+  std::copy(merged.begin(), merged.end(), counts);
 }
 
 }  // namespace idealgas
\ No newline at end of file
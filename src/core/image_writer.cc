@@ -0,0 +1,185 @@
+#include "core/image_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef IDEALGAS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The eight bytes every PNG starts with
+const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+/**
+ * @brief Computes the CRC-32 that ends every PNG chunk.
+ *
+ * @param bytes the bytes to check
+ * @param size the number of bytes
+ * @param crc the CRC of the bytes before, to continue from
+ * @return the uint32_t CRC
+ */
+uint32_t Crc32(const uint8_t* bytes, size_t size, uint32_t crc = 0) {
+  static const std::array<uint32_t, 256> kTable = [] {
+    std::array<uint32_t, 256> table;
+    for (uint32_t entry = 0; entry < 256; ++entry) {
+      uint32_t value = entry;
+      for (size_t bit = 0; bit < 8; ++bit) {
+        value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+      }
+      table[entry] = value;
+    }
+    return table;
+  }();
+
+  crc = ~crc;
+  for (size_t index = 0; index < size; ++index) {
+    crc = kTable[(crc ^ bytes[index]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Appends a 32-bit big-endian number to a byte buffer.
+ *
+ * @param bytes the buffer
+ * @param value the number to append
+ */
+void AppendBigEndian(vector<uint8_t>& bytes, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    bytes.push_back((uint8_t)(value >> shift));
+  }
+}
+
+#ifndef IDEALGAS_HAVE_ZLIB
+// The most bytes in one uncompressed deflate block
+const size_t kMaxStoredBlock = 65535;
+
+/**
+ * @brief Wraps bytes in a zlib stream of uncompressed deflate blocks, for
+ * builds without zlib.
+ *
+ * @param raw the bytes to wrap
+ * @return the zlib stream
+ */
+vector<uint8_t> StoreZlib(const vector<uint8_t>& raw) {
+  vector<uint8_t> stream = {0x78, 0x01};
+  size_t offset = 0;
+  do {
+    size_t block = std::min(kMaxStoredBlock, raw.size() - offset);
+    bool last = offset + block == raw.size();
+    stream.push_back(last ? 1 : 0);
+    stream.push_back((uint8_t)block);
+    stream.push_back((uint8_t)(block >> 8));
+    stream.push_back((uint8_t)~block);
+    stream.push_back((uint8_t)(~block >> 8));
+    stream.insert(stream.end(), raw.begin() + offset,
+                  raw.begin() + offset + block);
+    offset += block;
+  } while (offset < raw.size());
+
+  // The Adler-32 of the raw bytes ends the stream
+  uint32_t low = 1;
+  uint32_t high = 0;
+  for (uint8_t byte : raw) {
+    low = (low + byte) % 65521;
+    high = (high + low) % 65521;
+  }
+  AppendBigEndian(stream, (high << 16) | low);
+  return stream;
+}
+#endif
+
+/**
+ * @brief Appends a PNG chunk to a byte buffer.
+ *
+ * @param png the buffer
+ * @param type the four-letter chunk type
+ * @param data the chunk's data
+ */
+void AppendChunk(vector<uint8_t>& png, const char* type,
+                 const vector<uint8_t>& data) {
+  AppendBigEndian(png, (uint32_t)data.size());
+  size_t type_offset = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  AppendBigEndian(png, Crc32(&png[type_offset], png.size() - type_offset));
+}
+
+/**
+ * @brief Writes bytes to a file.
+ *
+ * @throws std::runtime_error when the file cannot be written
+ * @param path the path of the file
+ * @param header bytes to write first
+ * @param bytes the bytes to write after the header
+ * @param size the number of bytes
+ */
+void WriteFile(const string& path, const string& header, const uint8_t* bytes,
+               size_t size) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write(header.data(), header.size());
+  output.write((const char*)bytes, size);
+  output.close();
+  if (!output) {
+    throw std::runtime_error("Could not write " + path + ".");
+  }
+}
+
+}  // namespace
+
+void WritePng(const string& path, const Image& image, int compression_level) {
+  // Each row starts with its filter type, 0 for none
+  size_t row_size = image.width * 3;
+  vector<uint8_t> raw(image.height * (row_size + 1));
+  for (size_t row = 0; row < image.height; ++row) {
+    raw[row * (row_size + 1)] = 0;
+    std::copy(image.pixels.begin() + row * row_size,
+              image.pixels.begin() + (row + 1) * row_size,
+              raw.begin() + row * (row_size + 1) + 1);
+  }
+
+  vector<uint8_t> compressed;
+#ifdef IDEALGAS_HAVE_ZLIB
+  uLongf compressed_size = compressBound(raw.size());
+  compressed.resize(compressed_size);
+  if (compress2(compressed.data(), &compressed_size, raw.data(), raw.size(),
+                compression_level) != Z_OK) {
+    throw std::runtime_error("Could not compress " + path + ".");
+  }
+  compressed.resize(compressed_size);
+#else
+  (void)compression_level;
+  compressed = StoreZlib(raw);
+#endif
+
+  vector<uint8_t> header;
+  AppendBigEndian(header, (uint32_t)image.width);
+  AppendBigEndian(header, (uint32_t)image.height);
+  // 8-bit RGB, deflated, filtered per row, not interlaced
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+
+  vector<uint8_t> png(kPngSignature, kPngSignature + sizeof(kPngSignature));
+  AppendChunk(png, "IHDR", header);
+  AppendChunk(png, "IDAT", compressed);
+  AppendChunk(png, "IEND", {});
+  WriteFile(path, "", png.data(), png.size());
+}
+
+void WritePpm(const string& path, const Image& image) {
+  string header = "P6\n" + std::to_string(image.width) + " " +
+                  std::to_string(image.height) + "\n255\n";
+  WriteFile(path, header, image.pixels.data(), image.pixels.size());
+}
+
+}  // namespace idealgas
@@ -0,0 +1,532 @@
+#include "core/initial_conditions.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/checkpoint.h"
+#include "core/mapped_file.h"
+#include "core/particle_container.h"
+
+using idealgas::MappedFile;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::ThreadPool;
+using std::array;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The bytes of text given to one thread at a time, extended to a line break
+const size_t kBytesPerChunk = 1 << 20;
+// The numeric columns of a particle, in the order they are stored in a Row.
+// The z axis comes last, since only three-dimensional stores read it.
+const array<const char*, 8> kNumberColumns = {
+    "x", "y", "vx", "vy", "mass", "radius", "z", "vz"};
+// The first column of the z axis
+const size_t kFirstDepthColumn = 6;
+// The field of a column that is not read
+const size_t kUnreadField = std::numeric_limits<size_t>::max();
+
+/**
+ * @brief Where each column of a particle is in a line.
+ *
+ */
+struct Columns {
+  // The number of fields in the header
+  size_t count = 0;
+  // The field of the species name
+  size_t species = 0;
+  // The field of each number, in the order of kNumberColumns, or
+  // kUnreadField for the z axis of a two-dimensional store
+  array<size_t, kNumberColumns.size()> numbers = {};
+};
+
+/**
+ * @brief One particle as read from a line.
+ *
+ */
+struct Row {
+  // The species name, pointing into the file or into species_text
+  const char* species = nullptr;
+  size_t species_size = 0;
+  // The unquoted species name, when it was quoted
+  string species_text;
+  // The numbers, in the order of kNumberColumns
+  array<float, kNumberColumns.size()> numbers = {};
+};
+
+/**
+ * @brief What the first pass learns about one chunk of lines.
+ *
+ */
+struct Chunk {
+  // The first byte of the chunk
+  const char* begin = nullptr;
+  // The byte after the last
+  const char* end = nullptr;
+  // The rows of each species in the chunk, by first appearance
+  vector<pair<string, size_t>> species_rows;
+  // The SpeciesId of each entry of species_rows
+  vector<SpeciesId> species_ids;
+  // The index of the next particle of each entry of species_rows
+  vector<size_t> next_index;
+  // The number of lines, blank ones included
+  size_t lines = 0;
+  // The line of the first error, counted within the chunk
+  size_t error_line = 0;
+  // The first error, or empty
+  string error;
+};
+
+/**
+ * @brief Reads one field of a line, which may be quoted.
+ *
+ * @param cursor the start of the field, moved past it and its comma
+ * @param end the end of the line
+ * @param scratch where an unquoted copy of a quoted field is kept
+ * @param field_begin set to the first byte of the field's text
+ * @param field_size set to the size of the field's text
+ * @param more set to whether another field follows
+ * @return false when a quoted field is never closed
+ */
+bool ReadField(const char*& cursor, const char* end, string& scratch,
+               const char*& field_begin, size_t& field_size, bool& more) {
+  if (cursor < end && *cursor == '"') {
+    scratch.clear();
+    ++cursor;
+    while (true) {
+      if (cursor >= end) {
+        return false;
+      }
+      if (*cursor == '"') {
+        // Two quotes stand for one
+        if (cursor + 1 < end && cursor[1] == '"') {
+          scratch += '"';
+          cursor += 2;
+          continue;
+        }
+        ++cursor;
+        break;
+      }
+      scratch += *cursor++;
+    }
+    field_begin = scratch.data();
+    field_size = scratch.size();
+    while (cursor < end && *cursor != ',') {
+      ++cursor;
+    }
+  } else {
+    field_begin = cursor;
+    while (cursor < end && *cursor != ',') {
+      ++cursor;
+    }
+    field_size = cursor - field_begin;
+  }
+  more = cursor < end;
+  if (more) {
+    ++cursor;
+  }
+  return true;
+}
+
+/**
+ * @brief Parses a number, ignoring spaces around it.
+ *
+ * @param begin the first byte of the field
+ * @param size the size of the field
+ * @param number set to the number
+ * @return false when the field is not a finite number
+ */
+bool ParseNumber(const char* begin, size_t size, float& number) {
+  const char* end = begin + size;
+  while (begin < end && *begin == ' ') {
+    ++begin;
+  }
+  while (end > begin && end[-1] == ' ') {
+    --end;
+  }
+#if defined(__cpp_lib_to_chars)
+  std::from_chars_result parsed = std::from_chars(begin, end, number);
+  return parsed.ec == std::errc() && parsed.ptr == end &&
+         std::isfinite(number);
+#else
+  // Without floating point from_chars, the field is copied so that strtof
+  // stops at its end
+  char text[64];
+  size_t length = end - begin;
+  if (length == 0 || length >= sizeof(text)) {
+    return false;
+  }
+  std::memcpy(text, begin, length);
+  text[length] = '\0';
+  char* parsed_end = nullptr;
+  number = std::strtof(text, &parsed_end);
+  return parsed_end == text + length && std::isfinite(number);
+#endif
+}
+
+/**
+ * @brief Parses one line into a row.
+ *
+ * @param begin the first byte of the line
+ * @param end the end of the line, before its line break
+ * @param columns where each column is
+ * @param scratch where quoted numbers are unquoted
+ * @param row the Row to fill in
+ * @return the error, or empty when the line is a particle
+ */
+string ParseRow(const char* begin, const char* end, const Columns& columns,
+                string& scratch, Row& row) {
+  const char* cursor = begin;
+  bool more = true;
+  for (size_t field = 0; field < columns.count; ++field) {
+    const char* field_begin;
+    size_t field_size;
+    if (!more) {
+      return "has " + std::to_string(field) + " fields, expected " +
+             std::to_string(columns.count) + ".";
+    }
+    string& unquoted = field == columns.species ? row.species_text : scratch;
+    if (!ReadField(cursor, end, unquoted, field_begin, field_size, more)) {
+      return "has an unclosed quote.";
+    }
+
+    if (field == columns.species) {
+      row.species = field_begin;
+      row.species_size = field_size;
+      continue;
+    }
+    for (size_t number = 0; number < kNumberColumns.size(); ++number) {
+      if (field == columns.numbers[number] &&
+          !ParseNumber(field_begin, field_size, row.numbers[number])) {
+        return "has a " + string(kNumberColumns[number]) +
+               " that is not a number.";
+      }
+    }
+  }
+  if (more) {
+    return "has more fields than the header.";
+  }
+
+  // Masses and radii of zero would divide by zero in collisions
+  if (row.numbers[4] <= 0 || row.numbers[5] <= 0) {
+    return "has a mass or radius that is not positive.";
+  }
+  // The same limit as configured particles, which the visualizer relies on
+  if (row.numbers[5] > ParticleContainer::kRadiusLimit) {
+    return "has a radius above the maximum allowed radius of " +
+           std::to_string(ParticleContainer::kRadiusLimit) + ".";
+  }
+  return "";
+}
+
+/**
+ * @brief Reads the header line and finds each column.
+ *
+ * @throws std::runtime_error when a column is missing
+ * @param begin the first byte of the header
+ * @param end the end of the header, before its line break
+ * @param path the path of the file, for error messages
+ * @param dimensions the number of axes of the store, which needs the z and
+ * vz columns in three dimensions
+ * @return the Columns
+ */
+Columns ReadHeader(const char* begin, const char* end, const string& path,
+                   size_t dimensions) {
+  vector<string> names;
+  string scratch;
+  const char* cursor = begin;
+  bool more = true;
+  while (more) {
+    const char* field_begin;
+    size_t field_size;
+    if (!ReadField(cursor, end, scratch, field_begin, field_size, more)) {
+      throw std::runtime_error(path +
+                               " has an unclosed quote in its header.");
+    }
+    string name(field_begin, field_size);
+    size_t first = name.find_first_not_of(' ');
+    size_t last = name.find_last_not_of(' ');
+    names.push_back(first == string::npos
+                        ? ""
+                        : name.substr(first, last - first + 1));
+  }
+
+  auto find = [&](const string& column) {
+    for (size_t field = 0; field < names.size(); ++field) {
+      if (names[field] == column) {
+        return field;
+      }
+    }
+    throw std::runtime_error(path + " has no " + column + " column.");
+  };
+  Columns columns;
+  columns.count = names.size();
+  columns.species = find("species");
+  for (size_t number = 0; number < kNumberColumns.size(); ++number) {
+    columns.numbers[number] = number < kFirstDepthColumn || dimensions == 3
+                                  ? find(kNumberColumns[number])
+                                  : kUnreadField;
+  }
+  return columns;
+}
+
+/**
+ * @brief Calls a function on every non-blank line of a chunk, with its line
+ * number within the chunk, until the function returns false.
+ *
+ * @param chunk the chunk to read
+ * @param body a callable taking the line's first byte, its end before the
+ * line break, and its line number
+ * @return the number of lines read
+ */
+template <typename Body>
+size_t ForEachLine(const Chunk& chunk, const Body& body) {
+  size_t line = 0;
+  const char* cursor = chunk.begin;
+  while (cursor < chunk.end) {
+    const char* line_end = (const char*)std::memchr(cursor, '\n',
+                                                    chunk.end - cursor);
+    const char* next = line_end ? line_end + 1 : chunk.end;
+    line_end = line_end ? line_end : chunk.end;
+    if (line_end > cursor && line_end[-1] == '\r') {
+      --line_end;
+    }
+    if (line_end > cursor && !body(cursor, line_end, line)) {
+      return line + 1;
+    }
+    ++line;
+    cursor = next;
+  }
+  return line;
+}
+
+/**
+ * @brief Reads the particles of a CSV file into a store.
+ *
+ * @param path the path of the file
+ * @param particles the store to add the particles to
+ * @param thread_pool the threads that parse the text
+ */
+void ReadCsv(const string& path, ParticleStore& particles,
+             ThreadPool& thread_pool) {
+  MappedFile file(path);
+  const char* data = file.data();
+  const char* end = data + file.size();
+  if (file.size() == 0) {
+    throw std::runtime_error(path + " has no header.");
+  }
+
+  const char* header_end = (const char*)std::memchr(data, '\n', file.size());
+  header_end = header_end ? header_end : end;
+  const char* body = header_end < end ? header_end + 1 : end;
+  Columns columns = ReadHeader(
+      data, header_end > data && header_end[-1] == '\r' ? header_end - 1
+                                                        : header_end,
+      path, particles.GetDimensions());
+
+  // Chunks end on line breaks, so no line is split between threads
+  vector<Chunk> chunks;
+  for (const char* begin = body; begin < end;) {
+    const char* chunk_end = end;
+    if ((size_t)(end - begin) > kBytesPerChunk) {
+      const char* line_break = (const char*)std::memchr(
+          begin + kBytesPerChunk, '\n', end - begin - kBytesPerChunk);
+      chunk_end = line_break ? line_break + 1 : end;
+    }
+    chunks.emplace_back();
+    chunks.back().begin = begin;
+    chunks.back().end = chunk_end;
+    begin = chunk_end;
+  }
+
+  // The first pass counts each species' rows and checks every line
+  thread_pool.ParallelFor(
+      chunks.size(),
+      [&](size_t begin, size_t end) {
+        string scratch;
+        Row row;
+        for (size_t index = begin; index < end; ++index) {
+          Chunk& chunk = chunks[index];
+          chunk.lines = ForEachLine(chunk, [&](const char* line,
+                                               const char* line_end,
+                                               size_t number) {
+            chunk.error = ParseRow(line, line_end, columns, scratch, row);
+            if (!chunk.error.empty()) {
+              chunk.error_line = number;
+              return false;
+            }
+            for (pair<string, size_t>& species : chunk.species_rows) {
+              if (species.first.size() == row.species_size &&
+                  std::memcmp(species.first.data(), row.species,
+                              row.species_size) == 0) {
+                ++species.second;
+                return true;
+              }
+            }
+            chunk.species_rows.emplace_back(
+                string(row.species, row.species_size), 1);
+            return true;
+          });
+        }
+      },
+      1);
+
+  // Lines are numbered from one, the header being the first
+  size_t first_line = 2;
+  for (const Chunk& chunk : chunks) {
+    if (!chunk.error.empty()) {
+      throw std::runtime_error(path + ":" +
+                               std::to_string(first_line + chunk.error_line) +
+                               ": the particle " + chunk.error);
+    }
+    first_line += chunk.lines;
+  }
+
+  // Each species grows once, to its final size, in SpeciesId order so that
+  // growing one never moves a species already grown
+  vector<size_t> species_rows;
+  for (Chunk& chunk : chunks) {
+    for (const pair<string, size_t>& species : chunk.species_rows) {
+      SpeciesId id = particles.InternSpecies(species.first,
+                                             ColorT<float>(1, 1, 1));
+      chunk.species_ids.push_back(id);
+      species_rows.resize(particles.GetSpeciesNames().size(), 0);
+      species_rows[id] += species.second;
+    }
+  }
+  vector<size_t> next_index(species_rows.size(), 0);
+  for (SpeciesId id = 0; id < species_rows.size(); ++id) {
+    if (species_rows[id] > 0) {
+      next_index[id] = particles.Append(id, species_rows[id]);
+    }
+  }
+  for (Chunk& chunk : chunks) {
+    for (size_t species = 0; species < chunk.species_rows.size(); ++species) {
+      SpeciesId id = chunk.species_ids[species];
+      chunk.next_index.push_back(next_index[id]);
+      next_index[id] += chunk.species_rows[species].second;
+    }
+  }
+
+  // The second pass writes each row into its place
+  thread_pool.ParallelFor(
+      chunks.size(),
+      [&](size_t begin, size_t end) {
+        string scratch;
+        Row row;
+        for (size_t index = begin; index < end; ++index) {
+          Chunk& chunk = chunks[index];
+          ForEachLine(chunk, [&](const char* line, const char* line_end,
+                                 size_t) {
+            ParseRow(line, line_end, columns, scratch, row);
+            size_t species = 0;
+            while (chunk.species_rows[species].first.size() !=
+                       row.species_size ||
+                   std::memcmp(chunk.species_rows[species].first.data(),
+                               row.species, row.species_size) != 0) {
+              ++species;
+            }
+            size_t particle = chunk.next_index[species]++;
+            particles.GetPositions(0)[particle] = row.numbers[0];
+            particles.GetPositions(1)[particle] = row.numbers[1];
+            particles.GetVelocities(0)[particle] = row.numbers[2];
+            particles.GetVelocities(1)[particle] = row.numbers[3];
+            particles.GetMasses()[particle] = row.numbers[4];
+            particles.GetRadii()[particle] = row.numbers[5];
+            if (particles.GetDimensions() == 3) {
+              particles.GetPositions(2)[particle] = row.numbers[6];
+              particles.GetVelocities(2)[particle] = row.numbers[7];
+            }
+            return true;
+          });
+        }
+      },
+      1);
+}
+
+/**
+ * @brief Reads the particles of a checkpoint into a store, species by
+ * species. Species already in the store keep their color and flags, and new
+ * species take the checkpoint's. The particles keep their saved colors.
+ *
+ * @throws std::runtime_error when the checkpoint has other dimensions
+ * @param path the path of the checkpoint
+ * @param particles the store to add the particles to
+ */
+void ReadCheckpointParticles(const string& path, ParticleStore& particles) {
+  ParticleStore loaded;
+  ReadCheckpoint(path, loaded);
+  if (loaded.GetDimensions() != particles.GetDimensions()) {
+    throw std::runtime_error(
+        path + " has " + std::to_string(loaded.GetDimensions()) +
+        " dimensions, but the run has " +
+        std::to_string(particles.GetDimensions()) + ".");
+  }
+
+  for (SpeciesId species = 0; species < loaded.GetSpeciesNames().size();
+       ++species) {
+    size_t species_count = particles.GetSpeciesNames().size();
+    SpeciesId id = particles.InternSpecies(loaded.GetSpeciesNames()[species],
+                                           loaded.GetSpeciesColor(species));
+    if (particles.GetSpeciesNames().size() > species_count) {
+      particles.SetSpeciesVisible(id, loaded.IsSpeciesVisible(species));
+      particles.SetSpeciesEnabled(id, loaded.IsSpeciesEnabled(species));
+    }
+
+    pair<size_t, size_t> range = loaded.GetSpeciesRange(species);
+    if (range.first == range.second) {
+      continue;
+    }
+    size_t first = particles.Append(id, range.second - range.first);
+    auto copy = [&](const auto& from, auto& to) {
+      std::copy(from.begin() + range.first, from.begin() + range.second,
+                to.begin() + first);
+    };
+    for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+      copy(loaded.GetPositions(axis), particles.GetPositions(axis));
+      copy(loaded.GetVelocities(axis), particles.GetVelocities(axis));
+    }
+    copy(loaded.GetMasses(), particles.GetMasses());
+    copy(loaded.GetRadii(), particles.GetRadii());
+    copy(loaded.GetColors(), particles.GetColors());
+  }
+}
+
+/**
+ * @brief Checks whether a path ends in a suffix.
+ *
+ * @param path the path
+ * @param suffix the suffix, such as ".csv"
+ * @return true when the path ends in the suffix
+ */
+bool EndsWith(const string& path, const string& suffix) {
+  return path.size() >= suffix.size() &&
+         path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+void ReadInitialConditions(const string& path, ParticleStore& particles,
+                           ThreadPool& thread_pool) {
+  if (EndsWith(path, ".csv") || EndsWith(path, ".CSV")) {
+    ReadCsv(path, particles, thread_pool);
+  } else {
+    ReadCheckpointParticles(path, particles);
+  }
+}
+
+}  // namespace idealgas
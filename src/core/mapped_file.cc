@@ -0,0 +1,109 @@
+#include "core/mapped_file.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using idealgas::MappedFile;
+using std::string;
+
+namespace idealgas {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Could not open " + path + ".");
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Could not read the size of " + path + ".");
+  }
+  size_ = (size_t)file_size.QuadPart;
+
+  // Empty files cannot be mapped, and have nothing to map
+  if (size_ > 0) {
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr) {
+      data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+  }
+  // The mapping keeps the file open on its own
+  CloseHandle(file);
+  if (size_ > 0 && data_ == nullptr) {
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    throw std::runtime_error("Could not map " + path + ".");
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Could not open " + path + ".");
+  }
+
+  struct stat file_stat;
+  if (fstat(file, &file_stat) != 0) {
+    close(file);
+    throw std::runtime_error("Could not read the size of " + path + ".");
+  }
+  size_ = (size_t)file_stat.st_size;
+
+  // Empty files cannot be mapped, and have nothing to map
+  if (size_ > 0) {
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapped == MAP_FAILED) {
+      close(file);
+      throw std::runtime_error("Could not map " + path + ".");
+    }
+    data_ = (const char*)mapped;
+    // The whole file is about to be read, so ask for it ahead of time
+    madvise(mapped, size_, MADV_WILLNEED);
+  }
+  // The mapping keeps the file open on its own
+  close(file);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap((void*)data_, size_);
+  }
+}
+
+#endif
+
+const char* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
+}  // namespace idealgas
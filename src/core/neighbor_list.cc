@@ -0,0 +1,114 @@
+#include "core/neighbor_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using idealgas::NeighborList;
+using idealgas::ParticleStore;
+using idealgas::ThreadPool;
+using std::max;
+using std::vector;
+
+namespace idealgas {
+
+bool NeighborList::IsStale(const ParticleStore& particles,
+                           const array<float, 3>& periods, float skin,
+                           ThreadPool& thread_pool) const {
+  size_t dimensions = particles.GetDimensions();
+  if (!built_ || reference_radii_.size() != particles.size() ||
+      reference_dimensions_ != dimensions || reference_periods_ != periods ||
+      reference_skin_ != skin) {
+    return true;
+  }
+
+  // Each chunk of particles finds its largest drift, and the chunks have a
+  // fixed size so that the result does not depend on the threads
+  const vector<float>& radii = particles.GetRadii();
+  size_t chunk_count =
+      (particles.size() + kMinParticlesPerChunk - 1) / kMinParticlesPerChunk;
+  vector<float> max_drifts(chunk_count, 0);
+  thread_pool.ParallelFor(
+      chunk_count,
+      [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+          size_t first = chunk * kMinParticlesPerChunk;
+          size_t last =
+              std::min(first + kMinParticlesPerChunk, particles.size());
+          float max_drift = 0;
+          for (size_t index = first; index < last; ++index) {
+            float squared_distance = 0;
+            for (size_t axis = 0; axis < dimensions; ++axis) {
+              float offset = particles.GetPositions(axis)[index] -
+                             reference_positions_[axis][index];
+              // A particle that wrapped around moved by the short way
+              float period = periods[axis];
+              if (period > 0 && std::abs(offset) > period / 2) {
+                offset -= std::copysign(period, offset);
+              }
+              squared_distance += offset * offset;
+            }
+            float growth = max(radii[index] - reference_radii_[index], 0.0f);
+            max_drift = max(max_drift, std::sqrt(squared_distance) + growth);
+          }
+          max_drifts[chunk] = max_drift;
+        }
+      },
+      1);
+
+  for (float max_drift : max_drifts) {
+    if (max_drift > skin / 2) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void NeighborList::Clear() {
+  built_ = false;
+}
+
+size_t NeighborList::GetColorCount() const {
+  return color_starts_.empty() ? 0 : color_starts_.size() - 1;
+}
+
+pair<size_t, size_t> NeighborList::GetSegmentsOfColor(size_t color) const {
+  return {color_starts_.at(color), color_starts_.at(color + 1)};
+}
+
+size_t NeighborList::GetPairCount() const {
+  size_t pair_count = 0;
+  for (size_t segment = 0; segment < segment_count_; ++segment) {
+    pair_count += segments_[segment].neighbors.size();
+  }
+  return pair_count;
+}
+
+size_t NeighborList::GetMemoryBytes() const {
+  size_t bytes = segments_.capacity() * sizeof(Segment) +
+                 color_starts_.capacity() * sizeof(size_t);
+  for (const Segment& segment : segments_) {
+    bytes += (segment.particles.capacity() + segment.starts.capacity() +
+              segment.neighbors.capacity()) *
+             sizeof(uint32_t);
+  }
+  return bytes;
+}
+
+void NeighborList::SetReference(const ParticleStore& particles,
+                                const array<float, 3>& periods, float skin) {
+  for (size_t axis = 0; axis < ParticleStore::kMaxDimensions; ++axis) {
+    if (axis < particles.GetDimensions()) {
+      reference_positions_[axis] = particles.GetPositions(axis);
+    } else {
+      reference_positions_[axis].clear();
+    }
+  }
+  reference_radii_ = particles.GetRadii();
+  reference_dimensions_ = particles.GetDimensions();
+  reference_periods_ = periods;
+  reference_skin_ = skin;
+  built_ = true;
+}
+
+}  // namespace idealgas
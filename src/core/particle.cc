@@ -1,7 +1,5 @@
 #include "core/particle.h"
 
-using ci::ColorT;
-
 namespace idealgas {
 
 Particle::Particle() {
@@ -20,7 +18,7 @@ Particle::Particle(const string& name, const vec2& position,
       color_(color) {
 }
 
-string Particle::GetName() const {
+const string& Particle::GetName() const {
   return name_;
 }
 
@@ -60,7 +58,7 @@ void Particle::SetRadius(float radius) {
   radius_ = radius;
 }
 
-ColorT<float> Particle::GetColor() const {
+const ColorT<float>& Particle::GetColor() const {
   return color_;
 }
 
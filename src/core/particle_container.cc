@@ -1,70 +1,207 @@
 #include "core/particle_container.h"
 
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
-#include "cinder/gl/gl.h"
+#include "core/checkpoint.h"
+#include "core/config.h"
+#include "core/initial_conditions.h"
 #include "core/particle.h"
+#include "core/particle_store.h"
+#include "core/philox.h"
+#include "core/placement.h"
+#include "core/trajectory.h"
+#include "core/wall_kernel.h"
 #include "nlohmann/json.hpp"
 
-using ci::ColorT;
 using glm::dot;
 using glm::vec2;
 using idealgas::Particle;
 using idealgas::ParticleContainer;
-using std::stoi;
+using idealgas::ParticleStore;
+using std::pair;
 using std::string;
 using std::vector;
 
 namespace idealgas {
 
-std::unordered_map<string, string> ParticleContainer::Configure(const string& config_path) {
-  // Read in JSON configuration file information
-  std::ifstream input(config_path);
-  nlohmann::json config;
-  input >> config;
+namespace {
 
-  // Create mapping between variable names and values
-  std::unordered_map<string, string> visualizer_info;
+/**
+ * @brief Checks whether particles wrap around along any axis they move along.
+ *
+ * @param modes the BoundaryMode of the x, y and z axes
+ * @param dimensions the number of axes the particles move along
+ * @return true when any of those axes is periodic
+ */
+bool HasPeriodicAxis(const array<BoundaryMode, 3>& modes, size_t dimensions) {
+  for (size_t axis = 0; axis < dimensions; ++axis) {
+    if (modes[axis] == BoundaryMode::kPeriodic) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  visualizer_info["window width"] = config["window"]["width"];
-  visualizer_info["window height"] = config["window"]["height"];
-  visualizer_info["margin"] = config["window"]["margin"];
-  visualizer_info["stroke"] = config["window"]["stroke"];
-  visualizer_info["background color"] = config["window"]["background color"];
-  visualizer_info["stroke color"] = config["window"]["stroke color"];
-  visualizer_info["text color"] = config["window"]["text color"];
-  visualizer_info["font"] = config["window"]["font"];
+/**
+ * @brief Replaces every double in a range that no longer rounds to its float
+ * component, which was then written from outside, with that component.
+ *
+ * @param values the float components
+ * @param precise the double copies to update
+ * @param begin the first particle
+ * @param end the particle after the last
+ */
+void AdoptFloatWrites(const vector<float>& values, vector<double>& precise,
+                      size_t begin, size_t end) {
+  for (size_t index = begin; index < end; ++index) {
+    if ((float)precise[index] != values[index]) {
+      precise[index] = values[index];
+    }
+  }
+}
 
-  // Cast width and height to strings, others are cast in visualizer class
-  width_ = stoi(visualizer_info["window width"]) * 3 / 4 -
-           stoi(visualizer_info["margin"]);
-  visualizer_info["container width"] = std::to_string(width_);
-  height_ = stoi(visualizer_info["window height"]) -
-            2 * stoi(visualizer_info["margin"]);
-  visualizer_info["container height"] = std::to_string(height_);
-  
-  visualizer_info["histogram bin count"] = config["histogram"]["bin count"];
+}  // namespace
 
-  for (auto it = config["container"]["particles"].begin();
-       it != config["container"]["particles"].end(); ++it) {
-    // Iterating through, initialie particles of each type
-    ColorT<float> color =
-        ColorT<float>().hex(std::stoull(string(it.value()["color"]), 0, 16));
+template <>
+vector<float>& ParticleContainer::PositionsOf<float>(size_t axis) {
+  return particles_.GetPositions(axis);
+}
 
-    particle_names_.push_back(it.key());
+template <>
+const vector<float>& ParticleContainer::PositionsOf<float>(size_t axis) const {
+  return particles_.GetPositions(axis);
+}
+
+template <>
+vector<double>& ParticleContainer::PositionsOf<double>(size_t axis) {
+  return precise_positions_[axis];
+}
+
+template <>
+const vector<double>& ParticleContainer::PositionsOf<double>(
+    size_t axis) const {
+  return precise_positions_[axis];
+}
+
+template <>
+vector<float>& ParticleContainer::VelocitiesOf<float>(size_t axis) {
+  return particles_.GetVelocities(axis);
+}
+
+template <>
+const vector<float>& ParticleContainer::VelocitiesOf<float>(
+    size_t axis) const {
+  return particles_.GetVelocities(axis);
+}
+
+template <>
+vector<double>& ParticleContainer::VelocitiesOf<double>(size_t axis) {
+  return precise_velocities_[axis];
+}
+
+template <>
+const vector<double>& ParticleContainer::VelocitiesOf<double>(
+    size_t axis) const {
+  return precise_velocities_[axis];
+}
+
+SimulationConfig ParticleContainer::Configure(const string& config_path) {
+  SimulationConfig config = LoadConfig(config_path);
+  Configure(config);
+
+  // A checkpoint brings its own container size and dimensions
+  config.container_width = width_;
+  config.container_height = height_;
+  config.container_depth = depth_;
+  config.dimensions = GetDimensions();
+  config.precision = GetPrecisionMode();
+  return config;
+}
+
+SimulationConfig ParticleContainer::ConfigureFromJson(const json& config) {
+  SimulationConfig parsed = ParseConfig(config);
+  Configure(parsed);
+  parsed.container_width = width_;
+  parsed.container_height = height_;
+  parsed.container_depth = depth_;
+  parsed.dimensions = GetDimensions();
+  parsed.precision = GetPrecisionMode();
+  return parsed;
+}
+
+void ParticleContainer::Configure(const SimulationConfig& config) {
+  width_ = config.container_width;
+  height_ = config.container_height;
+  depth_ = config.container_depth;
+  SetObservableHistoryLength(config.observable_history_steps);
+  SetAdaptiveStepOptions(config.adaptive_step);
+  SetNeighborListOptions(config.neighbor_list);
+  SetThreadCount(config.thread_count);
+  SetSeed(config.seed);
+  SetBroadphaseMode(config.broadphase);
+  // Walls in two dimensions and single precision first, since the last
+  // configuration's periodic axes, dimensions and precision may not suit this
+  // one's engine
+  SetBoundaryModes({});
+  SetDimensions(2);
+  SetPrecisionMode(PrecisionMode::kSingle);
+  SetSimulationMode(config.simulation_mode);
+  SetDimensions(config.dimensions);
+  SetPrecisionMode(config.precision);
+  SetBoundaryModes(config.boundaries);
+  if (!config.trajectory_path.empty()) {
+    SetTrajectoryWriter(std::make_shared<TrajectoryWriter>(
+        config.trajectory_path, config.trajectory));
+  }
+
+  // A run resumes from its last checkpoint instead of creating new particles
+  // when asked to
+  if (config.resume_checkpoint &&
+      std::ifstream(config.checkpoint_path).good()) {
+    LoadCheckpoint(config.checkpoint_path);
+    return;
+  }
+
+  if (!config.initial_conditions_path.empty()) {
+    // Rows of a configured species take its color
+    for (const SpeciesConfig& species : config.species) {
+      particles_.InternSpecies(species.name,
+                               ColorT<float>::hex(species.color));
+    }
+    ReadInitialConditions(config.initial_conditions_path, particles_,
+                          *thread_pool_);
+  }
 
-    InitializeParticles(it.key(), it.value()["particle count"],
-                        it.value()["min velocity"], it.value()["max velocity"],
-                        it.value()["min mass"], it.value()["max mass"],
-                        it.value()["min radius"], it.value()["max radius"],
-                        color);
+  for (const SpeciesConfig& species : config.species) {
+    InitializeParticles(species.name, species.particle_count,
+                        species.min_velocity, species.max_velocity,
+                        species.min_mass, species.max_mass,
+                        species.min_radius, species.max_radius,
+                        ColorT<float>::hex(species.color));
   }
 
-  return visualizer_info;
+  // Each species' random particles were appended to the end of its range
+  if (config.placement == PlacementMode::kLattice) {
+    vector<pair<size_t, size_t>> ranges;
+    for (const SpeciesConfig& species : config.species) {
+      pair<size_t, size_t> range = particles_.GetSpeciesRange(
+          particles_.InternSpecies(species.name, ColorT<float>()));
+      ranges.emplace_back(range.second - species.particle_count,
+                          range.second);
+    }
+    PlaceWithoutOverlaps(particles_, ranges,
+                         {(float)width_, (float)height_, (float)depth_},
+                         seed_, *thread_pool_);
+  }
 }
 
 void ParticleContainer::InitializeParticles(
@@ -78,50 +215,148 @@ void ParticleContainer::InitializeParticles(
          ". Please edit your configuration file."));
   }
 
-  // Used to obtain a seed for the random number engine
-  std::random_device rd;   
-  // Gets random position from distribution
-  std::mt19937 gen(rd());  
-  // Distribution of possible x values
-  std::uniform_int_distribution<> width_dist(0, width_);
-  // Distribution of y values
-  std::uniform_int_distribution<> height_dist(0, height_);
-  // Distribution of velocities
-  std::uniform_real_distribution<> velocity_dist(min_velocity, max_velocity);
-  // Distribution of masses
-  std::uniform_real_distribution<> mass_dist(min_mass, max_mass);
-  // Distribution of radii
-  std::uniform_real_distribution<> radius_dist(min_radius, max_radius);
+  engine_.Reset();
+  SpeciesId species = particles_.InternSpecies(name, color);
 
-  for (size_t i = 0; i < particle_count; ++i) {
-    // Create particle and add it to vector
-    particles_.push_back(Particle(name, vec2(width_dist(gen), height_dist(gen)),
-                                  vec2(velocity_dist(gen), velocity_dist(gen)),
-                                  mass_dist(gen), radius_dist(gen), color));
-  }
+  // Particles already of this species keep their indices within it, so that
+  // adding more later continues the same sequence
+  pair<size_t, size_t> range = particles_.GetSpeciesRange(species);
+  uint64_t first_index = range.second - range.first;
+  size_t first_particle = particles_.Append(species, particle_count);
+
+  // Every particle draws from its own counter, so any split across threads
+  // gives the same numbers
+  thread_pool_->ParallelFor(
+      particle_count,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          Philox random(seed_, species, first_index + i);
+          size_t index = first_particle + i;
+          // Whole-pixel positions, as the integer distribution gave before
+          particles_.GetPositions(0)[index] =
+              std::floor(random.NextUniform(0, (double)width_ + 1));
+          particles_.GetPositions(1)[index] =
+              std::floor(random.NextUniform(0, (double)height_ + 1));
+          particles_.GetVelocities(0)[index] =
+              random.NextUniform(min_velocity, max_velocity);
+          particles_.GetVelocities(1)[index] =
+              random.NextUniform(min_velocity, max_velocity);
+          particles_.GetMasses()[index] = random.NextUniform(min_mass, max_mass);
+          particles_.GetRadii()[index] =
+              random.NextUniform(min_radius, max_radius);
+          if (particles_.GetDimensions() == 3) {
+            particles_.GetPositions(2)[index] =
+                std::floor(random.NextUniform(0, (double)depth_ + 1));
+            particles_.GetVelocities(2)[index] =
+                random.NextUniform(min_velocity, max_velocity);
+          }
+        }
+      },
+      kMinParticlesPerChunk);
 }
 
 void ParticleContainer::InitializeParticle(const Particle& particle) {
   // Add singular particle
-  particles_.push_back(particle);
+  engine_.Reset();
+  particles_.Add(particle);
 }
 
 void ParticleContainer::Increment() {
-  IncrementParticleCollisions();
+  simulated_time_ += time_step_;
+  if (simulation_mode_ == SimulationMode::kEventDriven) {
+    engine_.Advance(particles_, time_step_, (float)width_, (float)height_);
+
+    // The engine moves particles one event at a time, so they are measured in
+    // their own pass
+    FindEnabledBlocks();
+    thread_pool_->ParallelFor(
+        blocks_.size(),
+        [this](size_t begin, size_t end) {
+          for (size_t block = begin; block < end; ++block) {
+            for (size_t index = blocks_[block].begin;
+                 index < blocks_[block].end; ++index) {
+              MeasureParticle<float>(blocks_[block], index);
+            }
+          }
+        },
+        1);
+    RecordObservables(engine_.GetWallImpulse());
+  } else if (adaptive_options_.enabled) {
+    SyncPrecise();
+    IncrementSubsteps();
+  } else {
+    SyncPrecise();
+    CollideParticles();
+
+    MoveParticles();
+  }
+
+  if (trajectory_writer_) {
+    trajectory_writer_->Capture(particles_, simulated_time_);
+  }
+}
 
-  IncrementWallCollisions();
+ParticleStore& ParticleContainer::GetParticles() {
+  // The caller may write the particles, which the engine does not watch
+  engine_.Reset();
+  return particles_;
 }
 
-vector<Particle>& ParticleContainer::GetParticles() {
+const ParticleStore& ParticleContainer::GetParticles() const {
   return particles_;
 }
 
+void ParticleContainer::SetSpeciesVisible(SpeciesId species, bool visible) {
+  particles_.SetSpeciesVisible(species, visible);
+}
+
+void ParticleContainer::SetSpeciesEnabled(SpeciesId species, bool enabled) {
+  if (particles_.IsSpeciesEnabled(species) != enabled) {
+    engine_.Reset();
+  }
+  particles_.SetSpeciesEnabled(species, enabled);
+}
+
 void ParticleContainer::SetParticles(const vector<Particle>& particles) {
-  particles_ = particles;
+  engine_.Reset();
+  neighbor_list_.Clear();
+  particles_.Clear();
+  particles_.Reserve(particles.size());
+
+  // Adding the particles species by species puts each one at the end of the
+  // arrays, rather than shifting the species after it
+  vector<SpeciesId> species(particles.size());
+  vector<size_t> order(particles.size());
+  for (size_t index = 0; index < particles.size(); ++index) {
+    species[index] = particles_.InternSpecies(particles[index].GetName(),
+                                              particles[index].GetColor());
+    order[index] = index;
+  }
+  std::stable_sort(order.begin(), order.end(), [&species](size_t a, size_t b) {
+    return species[a] < species[b];
+  });
+  for (size_t index : order) {
+    particles_.Add(particles[index]);
+  }
+}
+
+void ParticleContainer::Reset() {
+  particles_.Reset();
+  overlapping_pairs_.clear();
+  validation_pairs_.clear();
+  engine_.Reset();
+  boundaries_ = {};
+  particles_.SetDimensions(2);
+  SetPrecisionMode(PrecisionMode::kSingle);
+  SetAdaptiveStepOptions(AdaptiveStepOptions());
+  SetNeighborListOptions(NeighborListOptions());
+  observable_history_.Clear();
+  trajectory_writer_.reset();
+  simulated_time_ = 0;
 }
 
-vector<string> ParticleContainer::GetParticleNames() const {
-  return particle_names_;
+const vector<string>& ParticleContainer::GetParticleNames() const {
+  return particles_.GetSpeciesNames();
 }
 
 float ParticleContainer::GetTimeStep() const {
@@ -132,97 +367,866 @@ void ParticleContainer::SetTimeStep(float time_step) {
   time_step_ = time_step;
 }
 
-void ParticleContainer::IncrementParticleCollisions() {
-  // First sort particles for more efficient searching
-  std::sort(particles_.begin(), particles_.end(),
-       [](const Particle& lhs, const Particle& rhs) {
-         if (lhs.GetPosition().x != rhs.GetPosition().x) { return lhs.GetPosition().x < rhs.GetPosition().x; }
-         else { return lhs.GetPosition().y < rhs.GetPosition().y; }
-       });
-    
-  for (size_t base = 0; base < particles_.size(); ++base) {
-    // Search only the first few particle pairings nearby, with no overlaps
-    size_t cutoff = base + kNearbyLimit;
-    // Prevent excess index
-    if (cutoff > particles_.size() - 1) {
-      cutoff = particles_.size();
-    }
-    // Check for collision between each pairing
-    for (size_t neighbor = base + 1; neighbor < cutoff; ++neighbor) {
-      // If collision occurs, make particle bluer (feature)
-      if (ExecuteParticleCollision(base, neighbor)) {
-        particles_.at(base).SetColor(particles_.at(base).GetColor() *
-                                     ColorT<float>(0.99, 0.99, 1));
+const AdaptiveStepOptions& ParticleContainer::GetAdaptiveStepOptions() const {
+  return adaptive_options_;
+}
+
+void ParticleContainer::SetAdaptiveStepOptions(
+    const AdaptiveStepOptions& options) {
+  adaptive_options_ = options;
+  substep_count_ = 1;
+}
+
+const NeighborListOptions& ParticleContainer::GetNeighborListOptions() const {
+  return neighbor_list_options_;
+}
+
+void ParticleContainer::SetNeighborListOptions(
+    const NeighborListOptions& options) {
+  neighbor_list_options_ = options;
+  neighbor_list_.Clear();
+  neighbor_list_stats_ = NeighborListStats();
+}
+
+const NeighborListStats& ParticleContainer::GetNeighborListStats() const {
+  return neighbor_list_stats_;
+}
+
+size_t ParticleContainer::GetSubstepCount() const {
+  return substep_count_;
+}
+
+double ParticleContainer::GetSimulatedTime() const {
+  return simulated_time_;
+}
+
+void ParticleContainer::SaveCheckpoint(const string& path) const {
+  CheckpointState state;
+  state.seed = seed_;
+  state.simulated_time = simulated_time_;
+  state.time_step = time_step_;
+  state.simulation_mode = simulation_mode_;
+  state.width = width_;
+  state.height = height_;
+  state.depth = depth_;
+  state.precision = precision_mode_;
+  WriteCheckpoint(path, state, particles_, precise_positions_,
+                  precise_velocities_);
+}
+
+void ParticleContainer::LoadCheckpoint(const string& path) {
+  PreciseArrays positions;
+  PreciseArrays velocities;
+  CheckpointState state =
+      ReadCheckpoint(path, particles_, positions, velocities);
+  seed_ = state.seed;
+  simulated_time_ = state.simulated_time;
+  time_step_ = state.time_step;
+  width_ = state.width;
+  height_ = state.height;
+  depth_ = state.depth;
+  // The neighbor list's pairs index the replaced particles
+  neighbor_list_.Clear();
+  // The event-driven engine only runs in single precision, so single
+  // precision is set before the engine and the others after it. Setting the
+  // engine also forgets its events, which belong to the replaced particles.
+  if (state.precision == PrecisionMode::kSingle) {
+    SetPrecisionMode(state.precision);
+    SetSimulationMode(state.simulation_mode);
+  } else {
+    SetSimulationMode(state.simulation_mode);
+    SetPrecisionMode(state.precision);
+  }
+  // The saved doubles round to the saved floats, so the next step keeps them
+  precise_positions_ = std::move(positions);
+  precise_velocities_ = std::move(velocities);
+}
+
+const RingBuffer<Observables>& ParticleContainer::GetObservableHistory()
+    const {
+  return observable_history_;
+}
+
+void ParticleContainer::SetObservableHistoryLength(size_t steps) {
+  observable_history_.SetCapacity(steps);
+}
+
+std::shared_ptr<TrajectoryWriter> ParticleContainer::GetTrajectoryWriter()
+    const {
+  return trajectory_writer_;
+}
+
+void ParticleContainer::SetTrajectoryWriter(
+    std::shared_ptr<TrajectoryWriter> writer) {
+  trajectory_writer_ = std::move(writer);
+}
+
+uint64_t ParticleContainer::GetSeed() const {
+  return seed_;
+}
+
+void ParticleContainer::SetSeed(uint64_t seed) {
+  seed_ = seed;
+}
+
+size_t ParticleContainer::GetThreadCount() const {
+  return thread_pool_->GetThreadCount();
+}
+
+void ParticleContainer::SetThreadCount(size_t thread_count) {
+  thread_pool_ = std::make_shared<ThreadPool>(thread_count);
+}
+
+SimdLevel ParticleContainer::GetSimdLevel() const {
+  return simd_level_;
+}
+
+void ParticleContainer::SetSimdLevel(SimdLevel level) {
+  if (level > GetSupportedSimdLevel()) {
+    throw std::invalid_argument("This processor does not support " +
+                                GetSimdLevelName(level) + ".");
+  }
+  simd_level_ = level;
+}
+
+BroadphaseMode ParticleContainer::GetBroadphaseMode() const {
+  return broadphase_mode_;
+}
+
+void ParticleContainer::SetBroadphaseMode(BroadphaseMode mode) {
+  broadphase_mode_ = mode;
+  // The list's segments follow the colors of the grid it was built from
+  neighbor_list_.Clear();
+}
+
+SimulationMode ParticleContainer::GetSimulationMode() const {
+  return simulation_mode_;
+}
+
+void ParticleContainer::SetSimulationMode(SimulationMode mode) {
+  if (mode == SimulationMode::kEventDriven &&
+      HasPeriodicAxis(boundaries_, GetDimensions())) {
+    throw std::invalid_argument(
+        "The event-driven engine needs reflecting boundaries.");
+  }
+  if (mode == SimulationMode::kEventDriven && GetDimensions() != 2) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in two dimensions.");
+  }
+  if (mode == SimulationMode::kEventDriven &&
+      precision_mode_ != PrecisionMode::kSingle) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in single precision.");
+  }
+  simulation_mode_ = mode;
+  engine_.Reset();
+}
+
+size_t ParticleContainer::GetDimensions() const {
+  return particles_.GetDimensions();
+}
+
+void ParticleContainer::SetDimensions(size_t dimensions) {
+  if (simulation_mode_ == SimulationMode::kEventDriven && dimensions != 2) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in two dimensions.");
+  }
+  engine_.Reset();
+  particles_.SetDimensions(dimensions);
+}
+
+PrecisionMode ParticleContainer::GetPrecisionMode() const {
+  return precision_mode_;
+}
+
+void ParticleContainer::SetPrecisionMode(PrecisionMode mode) {
+  if (simulation_mode_ == SimulationMode::kEventDriven &&
+      mode != PrecisionMode::kSingle) {
+    throw std::invalid_argument(
+        "The event-driven engine only runs in single precision.");
+  }
+  precision_mode_ = mode;
+
+  // The copies a mode does not keep are dropped, and those it newly keeps
+  // are taken at the next step
+  for (size_t axis = 0; axis < ParticleStore::kMaxDimensions; ++axis) {
+    if (mode == PrecisionMode::kSingle) {
+      precise_positions_[axis].clear();
+    }
+    if (mode != PrecisionMode::kDouble) {
+      precise_velocities_[axis].clear();
+    }
+  }
+}
+
+const array<BoundaryMode, 3>& ParticleContainer::GetBoundaryModes() const {
+  return boundaries_;
+}
+
+void ParticleContainer::SetBoundaryModes(
+    const array<BoundaryMode, 3>& modes) {
+  if (simulation_mode_ == SimulationMode::kEventDriven &&
+      HasPeriodicAxis(modes, GetDimensions())) {
+    throw std::invalid_argument(
+        "The event-driven engine needs reflecting boundaries.");
+  }
+  boundaries_ = modes;
+}
+
+size_t ParticleContainer::GetProcessedEventCount() const {
+  return engine_.GetProcessedEventCount();
+}
+
+const vector<pair<size_t, size_t>>& ParticleContainer::FindOverlappingPairs() {
+  SyncPrecise();
+  bool precise = precision_mode_ == PrecisionMode::kDouble;
+  if (GetDimensions() == 3) {
+    precise ? CollectOverlappingPairs<3, double>()
+            : CollectOverlappingPairs<3, float>();
+  } else {
+    precise ? CollectOverlappingPairs<2, double>()
+            : CollectOverlappingPairs<2, float>();
+  }
+  return overlapping_pairs_;
+}
+
+template <size_t Dims, typename Scalar>
+void ParticleContainer::CollectOverlappingPairs() {
+  switch (broadphase_mode_) {
+    case BroadphaseMode::kGrid: {
+      FindGridPairs<Dims, Scalar>(grid_, overlapping_pairs_);
+      break;
+    }
+    case BroadphaseMode::kHierarchicalGrid: {
+      FindGridPairs<Dims, Scalar>(hierarchical_grid_, overlapping_pairs_);
+      break;
+    }
+    case BroadphaseMode::kBruteForce: {
+      FindBruteForcePairs<Dims, Scalar>(overlapping_pairs_);
+      break;
+    }
+    case BroadphaseMode::kValidated: {
+      FindGridPairs<Dims, Scalar>(grid_, overlapping_pairs_);
+      FindBruteForcePairs<Dims, Scalar>(validation_pairs_);
+
+      // Compare as sets, since the grid visits pairs in cell order
+      vector<pair<size_t, size_t>> grid_pairs = overlapping_pairs_;
+      std::sort(grid_pairs.begin(), grid_pairs.end());
+      if (grid_pairs != validation_pairs_) {
+        throw std::logic_error(
+            "The grid broadphase found " + std::to_string(grid_pairs.size()) +
+            " overlapping pairs, but brute force found " +
+            std::to_string(validation_pairs_.size()) + ".");
       }
+      break;
+    }
+  }
+}
+
+void ParticleContainer::IncrementParticleCollisions() {
+  SyncPrecise();
+  CollideParticles();
+}
+
+void ParticleContainer::CollideParticles() {
+  // The dimensions and precision are picked once per step, rather than once
+  // per pair. Mixed precision finds and resolves collisions in float.
+  bool precise = precision_mode_ == PrecisionMode::kDouble;
+  if (GetDimensions() == 3) {
+    precise ? ResolveParticleCollisions<3, double>()
+            : ResolveParticleCollisions<3, float>();
+  } else {
+    precise ? ResolveParticleCollisions<2, double>()
+            : ResolveParticleCollisions<2, float>();
+  }
+}
+
+template <size_t Dims, typename Scalar>
+void ParticleContainer::ResolveParticleCollisions() {
+  if (neighbor_list_options_.enabled &&
+      (broadphase_mode_ == BroadphaseMode::kGrid ||
+       broadphase_mode_ == BroadphaseMode::kHierarchicalGrid)) {
+    ResolveListedCollisions<Dims, Scalar>();
+    return;
+  }
+  if (broadphase_mode_ == BroadphaseMode::kGrid) {
+    grid_.Build(particles_, GetGridPeriods());
+    ResolveGridCollisions<Dims, Scalar>(grid_);
+    return;
+  }
+  if (broadphase_mode_ == BroadphaseMode::kHierarchicalGrid) {
+    hierarchical_grid_.Build(particles_, GetGridPeriods());
+    ResolveGridCollisions<Dims, Scalar>(hierarchical_grid_);
+    return;
+  }
+
+  CollectOverlappingPairs<Dims, Scalar>();
+  for (const auto& pair : overlapping_pairs_) {
+    if (IsActivePair(pair.first, pair.second)) {
+      ResolveCollision<Dims, Scalar>(pair.first, pair.second);
+    }
+  }
+}
+
+template <size_t Dims, typename Scalar, typename Grid>
+void ParticleContainer::ResolveGridCollisions(const Grid& grid) {
+  // Cells of one color share no particles, so each color is resolved in
+  // parallel, and the colors always run in the same order so that the result
+  // does not depend on the thread count
+  for (size_t color = 0; color < grid.GetColorCount(); ++color) {
+    const vector<size_t>& cells = grid.GetCellsOfColor(color);
+    thread_pool_->ParallelFor(
+        cells.size(),
+        [this, &grid, &cells](size_t begin, size_t end) {
+          for (size_t index = begin; index < end; ++index) {
+            grid.ForEachCandidatePairInCell(
+                cells[index], [this](size_t first, size_t second) {
+                  if (IsActivePair(first, second) &&
+                      AreOverlapping<Dims, Scalar>(first, second)) {
+                    ResolveCollision<Dims, Scalar>(std::min(first, second),
+                                                   std::max(first, second));
+                  }
+                });
+          }
+        },
+        kMinCellsPerChunk);
+  }
+}
+
+template <size_t Dims, typename Scalar>
+void ParticleContainer::ResolveListedCollisions() {
+  ++neighbor_list_stats_.passes;
+  array<float, 3> periods = GetGridPeriods();
+  float skin = neighbor_list_options_.skin;
+  if (neighbor_list_.IsStale(particles_, periods, skin, *thread_pool_)) {
+    auto is_near = [this](size_t base, size_t neighbor) {
+      return AreNear<Dims, Scalar>(base, neighbor);
+    };
+    if (broadphase_mode_ == BroadphaseMode::kHierarchicalGrid) {
+      hierarchical_grid_.Build(particles_, periods, skin);
+      neighbor_list_.Build(particles_, periods, skin, hierarchical_grid_,
+                           is_near, *thread_pool_);
+    } else {
+      grid_.Build(particles_, periods, skin);
+      neighbor_list_.Build(particles_, periods, skin, grid_, is_near,
+                           *thread_pool_);
     }
+    ++neighbor_list_stats_.builds;
+    neighbor_list_stats_.pair_count = neighbor_list_.GetPairCount();
+    neighbor_list_stats_.memory_bytes = neighbor_list_.GetMemoryBytes();
+  }
+
+  // Segments of one color share no particles, as the cells they hold do
+  for (size_t color = 0; color < neighbor_list_.GetColorCount(); ++color) {
+    pair<size_t, size_t> segments = neighbor_list_.GetSegmentsOfColor(color);
+    thread_pool_->ParallelFor(
+        segments.second - segments.first,
+        [this, &segments](size_t begin, size_t end) {
+          for (size_t segment = segments.first + begin;
+               segment < segments.first + end; ++segment) {
+            neighbor_list_.ForEachPairInSegment(
+                segment, [this](size_t first, size_t second) {
+                  if (IsActivePair(first, second) &&
+                      AreOverlapping<Dims, Scalar>(first, second)) {
+                    ResolveCollision<Dims, Scalar>(std::min(first, second),
+                                                   std::max(first, second));
+                  }
+                });
+          }
+        },
+        1);
   }
 }
 
 void ParticleContainer::IncrementWallCollisions() {
-  for (size_t index = 0; index < particles_.size(); ++index) {
-    if (ExecuteWallCollision(index)) {
-      // If collision with wall occurs, then make particle redder (feature)
-      particles_.at(index).SetColor(particles_.at(index).GetColor() *
-                                    ColorT<float>(1, 0.95, 0.95));
+  SyncPrecise();
+  MoveParticles();
+}
+
+void ParticleContainer::MoveParticles() {
+  // Every species moves once, by the whole step
+  FindEnabledBlocks();
+  species_strides_.assign(particles_.GetSpeciesNames().size(), 1);
+  species_active_.assign(particles_.GetSpeciesNames().size(), true);
+  IntegrateBlocks(time_step_, true);
+  RecordObservables(0);
+}
+
+void ParticleContainer::IncrementSubsteps() {
+  FindEnabledBlocks();
+  PlanSubsteps();
+  float substep_time = time_step_ / substep_count_;
+
+  // Every species moves in the last sub-step, so each is measured once, at
+  // the end of the step, while wall impulses add up over every sub-step
+  substepping_ = true;
+  for (size_t substep = 1; substep <= substep_count_; ++substep) {
+    for (size_t species = 0; species < species_strides_.size(); ++species) {
+      species_active_[species] = substep % species_strides_[species] == 0;
+    }
+    CollideParticles();
+    IntegrateBlocks(substep_time, substep == substep_count_);
+  }
+  substepping_ = false;
+  RecordObservables(0);
+}
+
+void ParticleContainer::PlanSubsteps() {
+  const vector<float>& radii = particles_.GetRadii();
+  size_t dimensions = GetDimensions();
+  thread_pool_->ParallelFor(
+      blocks_.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+          ParticleBlock& bounds = blocks_[block];
+          float max_squared_speed = 0;
+          for (size_t index = bounds.begin; index < bounds.end; ++index) {
+            float squared_speed = 0;
+            for (size_t axis = 0; axis < dimensions; ++axis) {
+              float velocity = particles_.GetVelocities(axis)[index];
+              squared_speed += velocity * velocity;
+            }
+            max_squared_speed = std::max(max_squared_speed, squared_speed);
+            bounds.min_radius = std::min(bounds.min_radius, radii[index]);
+          }
+          bounds.max_speed = std::sqrt(max_squared_speed);
+        }
+      },
+      1);
+
+  // The largest power of two allowed
+  size_t max_substeps = 1;
+  while (max_substeps * 2 <= adaptive_options_.max_substeps) {
+    max_substeps *= 2;
+  }
+
+  // Each block needs its fastest particle to move at most the allowed
+  // fraction of its smallest radius per sub-step. The strides hold each
+  // species' sub-step count until the step's count is known.
+  size_t species_count = particles_.GetSpeciesNames().size();
+  vector<size_t>& needed = species_strides_;
+  needed.assign(species_count, 1);
+  for (const ParticleBlock& bounds : blocks_) {
+    float limit = adaptive_options_.max_displacement * bounds.min_radius;
+    float distance = bounds.max_speed * std::abs(time_step_);
+    size_t substeps = max_substeps;
+    if (distance <= limit * max_substeps) {
+      substeps = 1;
+      while (distance > limit * substeps) {
+        substeps *= 2;
+      }
+    }
+    needed[bounds.species] = std::max(needed[bounds.species], substeps);
+  }
+
+  substep_count_ =
+      needed.empty() ? 1 : *std::max_element(needed.begin(), needed.end());
+  for (size_t species = 0; species < species_count; ++species) {
+    needed[species] = adaptive_options_.per_species
+                          ? substep_count_ / needed[species]
+                          : 1;
+  }
+  species_active_.assign(species_count, true);
+}
+
+void ParticleContainer::IntegrateBlocks(float substep_time, bool measure) {
+  switch (precision_mode_) {
+    case PrecisionMode::kDouble:
+      IntegrateBlocksAs<double, double>(substep_time, measure);
+      return;
+    case PrecisionMode::kMixed:
+      IntegrateBlocksAs<double, float>(substep_time, measure);
+      return;
+    default:
+      IntegrateBlocksAs<float, float>(substep_time, measure);
+  }
+}
+
+template <typename Position, typename Velocity>
+void ParticleContainer::IntegrateBlocksAs(float substep_time, bool measure) {
+  size_t dimensions = GetDimensions();
+  array<Position*, kMaxKernelAxes> positions = {};
+  array<Velocity*, kMaxKernelAxes> velocities = {};
+  for (size_t axis = 0; axis < dimensions; ++axis) {
+    positions[axis] = PositionsOf<Position>(axis).data();
+    velocities[axis] = VelocitiesOf<Velocity>(axis).data();
+  }
+  const array<float, kMaxKernelAxes> lengths = {
+      (float)width_, (float)height_, (float)depth_};
+  const float* radii = particles_.GetRadii().data();
+  const float* masses = particles_.GetMasses().data();
+  vector<ColorT<float>>& colors = particles_.GetColors();
+  wall_hits_.resize(particles_.size());
+
+  // Every particle is independent here, so any split across threads works.
+  // Each block is measured while it is still in cache, rather than in a
+  // second pass over every particle.
+  thread_pool_->ParallelFor(
+      blocks_.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+          ParticleBlock& sums = blocks_[block];
+          if (!species_active_[sums.species]) {
+            continue;
+          }
+          size_t first = sums.begin;
+          float time_step = substep_time * species_strides_[sums.species];
+          array<Position*, kMaxKernelAxes> block_positions = {};
+          array<Velocity*, kMaxKernelAxes> block_velocities = {};
+          for (size_t axis = 0; axis < dimensions; ++axis) {
+            block_positions[axis] = positions[axis] + first;
+            block_velocities[axis] = velocities[axis] + first;
+          }
+          // Only float positions have vector kernels, and double ones are
+          // rounded into the store as soon as they move
+          if constexpr (std::is_same<Position, float>::value) {
+            ReflectAndIntegrate(simd_level_, dimensions, block_positions,
+                                block_velocities, radii + first,
+                                sums.end - first, lengths, time_step,
+                                wall_hits_.data() + first, boundaries_);
+          } else {
+            ReflectAndIntegrate(dimensions, block_positions, block_velocities,
+                                radii + first, sums.end - first, lengths,
+                                time_step, wall_hits_.data() + first,
+                                boundaries_);
+            RoundPrecise(first, sums.end);
+          }
+
+          for (size_t index = first; index < sums.end; ++index) {
+            if (measure) {
+              MeasureParticle<Velocity>(sums, index);
+            }
+            uint8_t hits = wall_hits_[index];
+            if (hits) {
+              // If collision with wall occurs, then make particle redder
+              // (feature)
+              colors[index] = colors[index] * ColorT<float>(1, 0.95, 0.95);
+              // Each wall reverses one velocity component
+              double speed = 0;
+              for (size_t axis = 0; axis < dimensions; ++axis) {
+                if (hits & (kWallHitX << axis)) {
+                  speed += std::abs(velocities[axis][index]);
+                }
+              }
+              sums.wall_impulse += 2.0 * masses[index] * speed;
+            }
+          }
+        }
+      },
+      1);
+}
+
+void ParticleContainer::SyncPrecise() {
+  // Every time-step path starts here before writing the particles outside
+  // the engine
+  engine_.Reset();
+  if (precision_mode_ == PrecisionMode::kSingle) {
+    return;
+  }
+  size_t dimensions = GetDimensions();
+  bool velocities = precision_mode_ == PrecisionMode::kDouble;
+
+  // A changed particle count or axis makes whole copies, which then match
+  for (size_t axis = 0; axis < ParticleStore::kMaxDimensions; ++axis) {
+    if (axis >= dimensions) {
+      precise_positions_[axis].clear();
+      precise_velocities_[axis].clear();
+      continue;
     }
-    // Increment particle position based on velocity
-    particles_.at(index).SetPosition(particles_.at(index).GetPosition() +
-                                     time_step_ * particles_.at(index).GetVelocity());
+    const vector<float>& axis_positions = particles_.GetPositions(axis);
+    if (precise_positions_[axis].size() != axis_positions.size()) {
+      precise_positions_[axis].assign(axis_positions.begin(),
+                                      axis_positions.end());
+    }
+    const vector<float>& axis_velocities = particles_.GetVelocities(axis);
+    if (velocities &&
+        precise_velocities_[axis].size() != axis_velocities.size()) {
+      precise_velocities_[axis].assign(axis_velocities.begin(),
+                                       axis_velocities.end());
+    }
+  }
+
+  thread_pool_->ParallelFor(
+      particles_.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t axis = 0; axis < dimensions; ++axis) {
+          AdoptFloatWrites(particles_.GetPositions(axis),
+                           precise_positions_[axis], begin, end);
+          if (velocities) {
+            AdoptFloatWrites(particles_.GetVelocities(axis),
+                             precise_velocities_[axis], begin, end);
+          }
+        }
+      },
+      kMinParticlesPerChunk);
+}
+
+void ParticleContainer::RoundPrecise(size_t begin, size_t end) {
+  bool velocities = precision_mode_ == PrecisionMode::kDouble;
+  for (size_t axis = 0; axis < GetDimensions(); ++axis) {
+    float* axis_positions = particles_.GetPositions(axis).data();
+    float* axis_velocities = particles_.GetVelocities(axis).data();
+    for (size_t index = begin; index < end; ++index) {
+      axis_positions[index] = (float)precise_positions_[axis][index];
+    }
+    if (velocities) {
+      for (size_t index = begin; index < end; ++index) {
+        axis_velocities[index] = (float)precise_velocities_[axis][index];
+      }
+    }
+  }
+}
+
+bool ParticleContainer::IsActivePair(size_t base, size_t neighbor) const {
+  if (!substepping_) {
+    return true;
+  }
+  const vector<SpeciesId>& species = particles_.GetSpecies();
+  return species_active_[species[base]] || species_active_[species[neighbor]];
+}
+
+void ParticleContainer::FindEnabledBlocks() {
+  blocks_.clear();
+  for (size_t species = 0; species < particles_.GetSpeciesNames().size();
+       ++species) {
+    if (!particles_.IsSpeciesEnabled((SpeciesId)species)) {
+      continue;
+    }
+    // Blocks have a fixed size, so their sums do not depend on the threads
+    pair<size_t, size_t> range = particles_.GetSpeciesRange((SpeciesId)species);
+    for (size_t begin = range.first; begin < range.second;
+         begin += kMinParticlesPerChunk) {
+      blocks_.push_back({begin,
+                         std::min(begin + kMinParticlesPerChunk, range.second),
+                         (SpeciesId)species, 0, {}, 0, 0,
+                         std::numeric_limits<float>::infinity()});
+    }
+  }
+}
+
+template <typename Velocity>
+void ParticleContainer::MeasureParticle(ParticleBlock& block,
+                                        size_t index) const {
+  double mass = particles_.GetMasses()[index];
+  double squared_speed = 0;
+  for (size_t axis = 0; axis < particles_.GetDimensions(); ++axis) {
+    double velocity = VelocitiesOf<Velocity>(axis)[index];
+    squared_speed += velocity * velocity;
+    block.momentum[axis] += mass * velocity;
+  }
+  block.kinetic_energy += 0.5 * mass * squared_speed;
+}
+
+void ParticleContainer::RecordObservables(double wall_impulse) {
+  Observables& observables = observable_history_.Push();
+  observables.time = simulated_time_;
+  observables.kinetic_energy = 0;
+  observables.momentum = {};
+  observables.temperatures.assign(particles_.GetSpeciesNames().size(), 0);
+  species_counts_.assign(particles_.GetSpeciesNames().size(), 0);
+
+  for (const ParticleBlock& block : blocks_) {
+    observables.kinetic_energy += block.kinetic_energy;
+    for (size_t axis = 0; axis < GetDimensions(); ++axis) {
+      observables.momentum[axis] += block.momentum[axis];
+    }
+    observables.temperatures[block.species] += block.kinetic_energy;
+    species_counts_[block.species] += block.end - block.begin;
+    wall_impulse += block.wall_impulse;
+  }
+
+  // Each particle holds kT/2 of kinetic energy on average per axis
+  size_t dimensions = GetDimensions();
+  for (size_t species = 0; species < species_counts_.size(); ++species) {
+    if (species_counts_[species] > 0) {
+      observables.temperatures[species] /=
+          species_counts_[species] * (dimensions / 2.0);
+    }
+  }
+
+  // Only walls feel pressure, and a periodic axis has none. The two walls
+  // across an axis each span every other axis: a length in two dimensions
+  // and an area in three.
+  const array<double, 3> lengths = {(double)width_, (double)height_,
+                                    (double)depth_};
+  double wall_area = 0;
+  for (size_t axis = 0; axis < dimensions; ++axis) {
+    if (boundaries_[axis] == BoundaryMode::kReflecting) {
+      double area = 2.0;
+      for (size_t other = 0; other < dimensions; ++other) {
+        area *= other == axis ? 1 : lengths[other];
+      }
+      wall_area += area;
+    }
+  }
+  observables.pressure = time_step_ > 0 && wall_area > 0
+                             ? wall_impulse / (time_step_ * wall_area)
+                             : 0;
+}
+
+template <size_t Dims, typename Scalar>
+void ParticleContainer::ResolveCollision(size_t base, size_t neighbor) {
+  // If collision occurs, make particle bluer (feature)
+  if (ExecuteParticleCollision<Dims, Scalar>(base, neighbor)) {
+    vector<ColorT<float>>& colors = particles_.GetColors();
+    colors[base] = colors[base] * ColorT<float>(0.99, 0.99, 1);
   }
 }
 
+template <size_t Dims, typename Scalar>
 bool ParticleContainer::ExecuteParticleCollision(size_t base, size_t neighbor) {
-  auto p1 = particles_.at(base);
-  auto p2 = particles_.at(neighbor);
-  float distance_cutoff = p1.GetRadius() + p2.GetRadius();
-  vec2 x1 = p1.GetPosition();
-  vec2 x2 = p2.GetPosition();
-  vec2 v1 = p1.GetVelocity();
-  vec2 v2 = p2.GetVelocity();
-  float m1 = p1.GetMass();
-  float m2 = p2.GetMass();
-  float distance_between = glm::distance(x1, x2);
-  float displacement_threshold = dot(v1 - v2, x1 - x2);
+  using Vec = glm::vec<Dims, Scalar>;
+  array<Scalar*, Dims> velocities;
+  Vec x1;
+  Vec v1;
+  Vec v2;
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    velocities[axis] = VelocitiesOf<Scalar>(axis).data();
+    x1[axis] = PositionsOf<Scalar>(axis)[base];
+    v1[axis] = velocities[axis][base];
+    v2[axis] = velocities[axis][neighbor];
+  }
+  const vector<float>& masses = particles_.GetMasses();
+  const vector<float>& radii = particles_.GetRadii();
+
+  Scalar distance_cutoff = (Scalar)radii[base] + radii[neighbor];
+  // The neighbor's nearest image stands in for it across a periodic seam
+  Vec x2 = NearestImage<Dims, Scalar>(base, neighbor);
+  Scalar m1 = masses[base];
+  Scalar m2 = masses[neighbor];
+  Scalar distance_between = glm::distance(x1, x2);
+  Scalar displacement_threshold = dot(v1 - v2, x1 - x2);
 
   // Use directional check to ensure that particles won't get stuck or frozen
   if (distance_between <= distance_cutoff && displacement_threshold < 0) {
     // Calculate new velocity for p1
-    float mass_term_1 = 2 * m2 / (m1 + m2);
-    vec2 interaction_term_1 =
+    Scalar mass_term_1 = 2 * m2 / (m1 + m2);
+    Vec interaction_term_1 =
         dot(v1 - v2, x1 - x2) / length(x1 - x2) / length(x1 - x2) * (x1 - x2);
-    vec2 new_velocity_1 = v1 - mass_term_1 * interaction_term_1;
-    particles_.at(base).SetVelocity(new_velocity_1);
+    Vec new_velocity_1 = v1 - mass_term_1 * interaction_term_1;
 
     // Calculate new velocity for p2
-    float mass_term_2 = 2 * m1 / (m1 + m2);
-    vec2 interaction_term_2 =
+    Scalar mass_term_2 = 2 * m1 / (m1 + m2);
+    Vec interaction_term_2 =
         dot(v2 - v1, x2 - x1) / length(x2 - x1) / length(x2 - x1) * (x2 - x1);
-    vec2 new_velocity_2 = v2 - mass_term_2 * interaction_term_2;
-    particles_.at(neighbor).SetVelocity(new_velocity_2);
+    Vec new_velocity_2 = v2 - mass_term_2 * interaction_term_2;
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      velocities[axis][base] = new_velocity_1[axis];
+      velocities[axis][neighbor] = new_velocity_2[axis];
+      // The store keeps the rounded velocities, so that it reads the same as
+      // the double copies
+      if constexpr (!std::is_same<Scalar, float>::value) {
+        particles_.GetVelocities(axis)[base] = (float)new_velocity_1[axis];
+        particles_.GetVelocities(axis)[neighbor] = (float)new_velocity_2[axis];
+      }
+    }
     return true;
   }
   return false;
 }
 
-bool ParticleContainer::ExecuteWallCollision(size_t index) {
-  auto position = particles_.at(index).GetPosition();
-  auto velocity = particles_.at(index).GetVelocity();
-  auto radius = particles_.at(index).GetRadius();
+template <size_t Dims, typename Scalar>
+bool ParticleContainer::AreOverlapping(size_t base, size_t neighbor) const {
+  if (!particles_.IsEnabled(base) || !particles_.IsEnabled(neighbor)) {
+    return false;
+  }
+  const vector<float>& radii = particles_.GetRadii();
+  Scalar distance_cutoff = (Scalar)radii[base] + radii[neighbor];
+  return SquaredDistance<Dims, Scalar>(base, neighbor) <=
+         distance_cutoff * distance_cutoff;
+}
+
+template <size_t Dims, typename Scalar>
+bool ParticleContainer::AreNear(size_t base, size_t neighbor) const {
+  const vector<float>& radii = particles_.GetRadii();
+  Scalar distance_cutoff =
+      (Scalar)radii[base] + radii[neighbor] + neighbor_list_options_.skin;
+  return SquaredDistance<Dims, Scalar>(base, neighbor) <=
+         distance_cutoff * distance_cutoff;
+}
 
-  // Check each of the four walls for near or close collision and reverse velocity as necessary
-  if (position.x <= radius && velocity.x < 0) {
-    particles_.at(index).SetVelocity(velocity * vec2(-1, 1));
+template <size_t Dims, typename Scalar>
+Scalar ParticleContainer::SquaredDistance(size_t base, size_t neighbor) const {
+  array<const Scalar*, Dims> positions;
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    positions[axis] = PositionsOf<Scalar>(axis).data();
+  }
+
+  glm::vec<Dims, Scalar> displacement;
+  // Every candidate pair passes through here, so walls skip the image
+  if (HasPeriodicAxis(boundaries_, Dims)) {
+    glm::vec<Dims, Scalar> image = NearestImage<Dims, Scalar>(base, neighbor);
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      displacement[axis] = positions[axis][base] - image[axis];
+    }
+  } else {
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      displacement[axis] = positions[axis][base] - positions[axis][neighbor];
+    }
   }
-  if (position.x >= width_ - radius && velocity.x > 0) {
-    particles_.at(index).SetVelocity(velocity * vec2(-1, 1));
+  Scalar squared_distance = displacement[0] * displacement[0];
+  for (size_t axis = 1; axis < Dims; ++axis) {
+    squared_distance += displacement[axis] * displacement[axis];
   }
-  if (position.y <= radius && velocity.y < 0) {
-    particles_.at(index).SetVelocity(velocity * vec2(1, -1));
+  return squared_distance;
+}
+
+array<float, 3> ParticleContainer::GetGridPeriods() const {
+  const array<size_t, 3> lengths = {width_, height_, depth_};
+  array<float, 3> periods = {0, 0, 0};
+  for (size_t axis = 0; axis < GetDimensions(); ++axis) {
+    if (boundaries_[axis] == BoundaryMode::kPeriodic) {
+      periods[axis] = (float)lengths[axis];
+    }
+  }
+  return periods;
+}
+
+template <size_t Dims, typename Scalar>
+glm::vec<Dims, Scalar> ParticleContainer::NearestImage(size_t base,
+                                                       size_t neighbor) const {
+  glm::vec<Dims, Scalar> image;
+  array<float, 3> periods = GetGridPeriods();
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    const vector<Scalar>& positions = PositionsOf<Scalar>(axis);
+    image[axis] = positions[neighbor];
+    Scalar period = periods[axis];
+    if (period > 0) {
+      // Positions stay within one period, so one shift is always enough
+      Scalar offset = positions[base] - image[axis];
+      if (offset > period / 2) {
+        image[axis] += period;
+      } else if (offset < -period / 2) {
+        image[axis] -= period;
+      }
+    }
   }
-  if (position.y >= height_ - radius && velocity.y > 0) {
-    particles_.at(index).SetVelocity(velocity * vec2(1, -1));
+  return image;
+}
+
+template <size_t Dims, typename Scalar, typename Grid>
+void ParticleContainer::FindGridPairs(Grid& grid,
+                                      vector<pair<size_t, size_t>>& pairs) {
+  pairs.clear();
+  grid.Build(particles_, GetGridPeriods());
+  grid.ForEachCandidatePair([this, &pairs](size_t base, size_t neighbor) {
+    if (AreOverlapping<Dims, Scalar>(base, neighbor)) {
+      pairs.emplace_back(std::min(base, neighbor), std::max(base, neighbor));
+    }
+  });
+}
+
+template <size_t Dims, typename Scalar>
+void ParticleContainer::FindBruteForcePairs(
+    vector<pair<size_t, size_t>>& pairs) const {
+  pairs.clear();
+  for (size_t base = 0; base < particles_.size(); ++base) {
+    for (size_t neighbor = base + 1; neighbor < particles_.size(); ++neighbor) {
+      if (AreOverlapping<Dims, Scalar>(base, neighbor)) {
+        pairs.emplace_back(base, neighbor);
+      }
+    }
   }
-  return particles_.at(index).GetVelocity() != velocity;
 }
 
-}  // namespace idealgas
\ No newline at end of file
+}  // namespace idealgas
@@ -0,0 +1,380 @@
+#include "core/particle_store.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/particle.h"
+
+using glm::vec2;
+using idealgas::Particle;
+using idealgas::ParticleStore;
+using idealgas::ParticleView;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+ParticleView::ParticleView(ParticleStore* store, size_t index)
+    : store_(store), index_(index) {}
+
+ParticleView::operator Particle() const {
+  return Particle(GetName(), GetPosition(), GetVelocity(), GetMass(),
+                  GetRadius(), GetColor());
+}
+
+const string& ParticleView::GetName() const {
+  return store_->GetSpeciesName(store_->GetSpecies()[index_]);
+}
+
+void ParticleView::SetName(const string& name) {
+  SpeciesId species = store_->InternSpecies(name, GetColor());
+  if (species != store_->GetSpecies()[index_]) {
+    store_->GetSpecies()[index_] = species;
+    store_->GroupBySpecies();
+  }
+}
+
+vec2 ParticleView::GetPosition() const {
+  return store_->GetPosition(index_);
+}
+
+void ParticleView::SetPosition(const vec2& position) {
+  store_->SetPosition(index_, position);
+}
+
+vec2 ParticleView::GetVelocity() const {
+  return store_->GetVelocity(index_);
+}
+
+void ParticleView::SetVelocity(const vec2& velocity) {
+  store_->SetVelocity(index_, velocity);
+}
+
+float ParticleView::GetMass() const {
+  return store_->GetMasses()[index_];
+}
+
+void ParticleView::SetMass(float mass) {
+  store_->GetMasses()[index_] = mass;
+}
+
+float ParticleView::GetRadius() const {
+  return store_->GetRadii()[index_];
+}
+
+void ParticleView::SetRadius(float radius) {
+  store_->GetRadii()[index_] = radius;
+}
+
+const ColorT<float>& ParticleView::GetColor() const {
+  return store_->GetColors()[index_];
+}
+
+void ParticleView::SetColor(const ColorT<float>& color) {
+  store_->GetColors()[index_] = color;
+}
+
+ParticleStore::Iterator::Iterator(ParticleStore* store, size_t index)
+    : store_(store), index_(index) {}
+
+ParticleView ParticleStore::Iterator::operator*() const {
+  return ParticleView(store_, index_);
+}
+
+ParticleStore::Iterator& ParticleStore::Iterator::operator++() {
+  ++index_;
+  return *this;
+}
+
+bool ParticleStore::Iterator::operator==(const Iterator& other) const {
+  return store_ == other.store_ && index_ == other.index_;
+}
+
+bool ParticleStore::Iterator::operator!=(const Iterator& other) const {
+  return !(*this == other);
+}
+
+size_t ParticleStore::GetDimensions() const {
+  return dimensions_;
+}
+
+void ParticleStore::SetDimensions(size_t dimensions) {
+  if (dimensions < 2 || dimensions > kMaxDimensions) {
+    throw std::invalid_argument("Particles need 2 or 3 dimensions, not " +
+                                std::to_string(dimensions) + ".");
+  }
+  for (size_t axis = 2; axis < kMaxDimensions; ++axis) {
+    size_t length = axis < dimensions ? size() : 0;
+    positions_[axis].resize(length, 0);
+    velocities_[axis].resize(length, 0);
+  }
+  dimensions_ = dimensions;
+}
+
+SpeciesId ParticleStore::InternSpecies(const string& name,
+                                       const ColorT<float>& color) {
+  // Species counts are small, so a linear search beats hashing here
+  auto existing = std::find(species_names_.begin(), species_names_.end(), name);
+  if (existing != species_names_.end()) {
+    return (SpeciesId)(existing - species_names_.begin());
+  }
+
+  if (species_names_.size() > std::numeric_limits<SpeciesId>::max()) {
+    throw std::length_error("Too many particle species.");
+  }
+  species_names_.push_back(name);
+  species_colors_.push_back(color);
+  species_starts_.push_back(size());
+  species_visible_.push_back(true);
+  species_enabled_.push_back(true);
+  return (SpeciesId)(species_names_.size() - 1);
+}
+
+const string& ParticleStore::GetSpeciesName(SpeciesId species) const {
+  return species_names_.at(species);
+}
+
+const ColorT<float>& ParticleStore::GetSpeciesColor(SpeciesId species) const {
+  return species_colors_.at(species);
+}
+
+const vector<string>& ParticleStore::GetSpeciesNames() const {
+  return species_names_;
+}
+
+pair<size_t, size_t> ParticleStore::GetSpeciesRange(SpeciesId species) const {
+  return {species_starts_.at(species), species_starts_.at(species + 1)};
+}
+
+bool ParticleStore::IsSpeciesVisible(SpeciesId species) const {
+  return species_visible_.at(species);
+}
+
+void ParticleStore::SetSpeciesVisible(SpeciesId species, bool visible) {
+  species_visible_.at(species) = visible;
+}
+
+bool ParticleStore::IsSpeciesEnabled(SpeciesId species) const {
+  return species_enabled_.at(species);
+}
+
+void ParticleStore::SetSpeciesEnabled(SpeciesId species, bool enabled) {
+  species_enabled_.at(species) = enabled;
+}
+
+void ParticleStore::Add(const Particle& particle) {
+  SpeciesId species = InternSpecies(particle.GetName(), particle.GetColor());
+  size_t index = Insert(species, 1);
+  SetPosition(index, particle.GetPosition());
+  SetVelocity(index, particle.GetVelocity());
+  masses_[index] = particle.GetMass();
+  radii_[index] = particle.GetRadius();
+  // Keep the particle's own color, which may differ from its species'
+  colors_[index] = particle.GetColor();
+}
+
+void ParticleStore::Add(SpeciesId species, const vec2& position,
+                        const vec2& velocity, float mass, float radius) {
+  size_t index = Insert(species, 1);
+  SetPosition(index, position);
+  SetVelocity(index, velocity);
+  masses_[index] = mass;
+  radii_[index] = radius;
+}
+
+size_t ParticleStore::Append(SpeciesId species, size_t count) {
+  return Insert(species, count);
+}
+
+size_t ParticleStore::Insert(SpeciesId species, size_t count) {
+  const ColorT<float>& color = species_colors_.at(species);
+
+  // The last species, which is the usual case, only grows the arrays
+  size_t index = species_starts_[species + 1];
+  for (size_t axis = 0; axis < dimensions_; ++axis) {
+    positions_[axis].insert(positions_[axis].begin() + index, count, 0);
+    velocities_[axis].insert(velocities_[axis].begin() + index, count, 0);
+  }
+  masses_.insert(masses_.begin() + index, count, 0);
+  radii_.insert(radii_.begin() + index, count, 0);
+  species_.insert(species_.begin() + index, count, species);
+  colors_.insert(colors_.begin() + index, count, color);
+
+  for (size_t later = species + 1; later < species_starts_.size(); ++later) {
+    species_starts_[later] += count;
+  }
+  return index;
+}
+
+void ParticleStore::GroupBySpecies() {
+  // Count each species, then place each particle after those before it
+  species_starts_.assign(species_names_.size() + 1, 0);
+  for (SpeciesId species : species_) {
+    ++species_starts_[species + 1];
+  }
+  for (size_t species = 0; species < species_names_.size(); ++species) {
+    species_starts_[species + 1] += species_starts_[species];
+  }
+  if (std::is_sorted(species_.begin(), species_.end())) {
+    return;
+  }
+
+  vector<size_t> next(species_starts_.begin(), species_starts_.end() - 1);
+  vector<size_t> destinations(size());
+  for (size_t index = 0; index < size(); ++index) {
+    destinations[index] = next[species_[index]]++;
+  }
+  auto reorder = [&destinations](auto& values) {
+    auto reordered = values;
+    for (size_t index = 0; index < values.size(); ++index) {
+      reordered[destinations[index]] = values[index];
+    }
+    values.swap(reordered);
+  };
+  for (size_t axis = 0; axis < dimensions_; ++axis) {
+    reorder(positions_[axis]);
+    reorder(velocities_[axis]);
+  }
+  reorder(masses_);
+  reorder(radii_);
+  reorder(species_);
+  reorder(colors_);
+}
+
+void ParticleStore::Clear() {
+  for (size_t axis = 0; axis < dimensions_; ++axis) {
+    positions_[axis].clear();
+    velocities_[axis].clear();
+  }
+  masses_.clear();
+  radii_.clear();
+  species_.clear();
+  colors_.clear();
+  species_starts_.assign(species_names_.size() + 1, 0);
+}
+
+void ParticleStore::Reset() {
+  Clear();
+  species_names_.clear();
+  species_colors_.clear();
+  species_visible_.clear();
+  species_enabled_.clear();
+  species_starts_.assign(1, 0);
+}
+
+void ParticleStore::Reserve(size_t capacity) {
+  for (size_t axis = 0; axis < dimensions_; ++axis) {
+    positions_[axis].reserve(capacity);
+    velocities_[axis].reserve(capacity);
+  }
+  masses_.reserve(capacity);
+  radii_.reserve(capacity);
+  species_.reserve(capacity);
+  colors_.reserve(capacity);
+}
+
+size_t ParticleStore::size() const {
+  return masses_.size();
+}
+
+bool ParticleStore::empty() const {
+  return masses_.empty();
+}
+
+ParticleView ParticleStore::operator[](size_t index) {
+  return ParticleView(this, index);
+}
+
+Particle ParticleStore::operator[](size_t index) const {
+  return Particle(species_names_[species_[index]], GetPosition(index),
+                  GetVelocity(index), masses_[index], radii_[index],
+                  colors_[index]);
+}
+
+ParticleStore::Iterator ParticleStore::begin() {
+  return Iterator(this, 0);
+}
+
+ParticleStore::Iterator ParticleStore::end() {
+  return Iterator(this, size());
+}
+
+vec2 ParticleStore::GetPosition(size_t index) const {
+  return vec2(positions_[0][index], positions_[1][index]);
+}
+
+void ParticleStore::SetPosition(size_t index, const vec2& position) {
+  positions_[0][index] = position.x;
+  positions_[1][index] = position.y;
+}
+
+vec2 ParticleStore::GetVelocity(size_t index) const {
+  return vec2(velocities_[0][index], velocities_[1][index]);
+}
+
+void ParticleStore::SetVelocity(size_t index, const vec2& velocity) {
+  velocities_[0][index] = velocity.x;
+  velocities_[1][index] = velocity.y;
+}
+
+float ParticleStore::GetSpeed(size_t index) const {
+  float squared_speed = 0;
+  for (size_t axis = 0; axis < dimensions_; ++axis) {
+    squared_speed += velocities_[axis][index] * velocities_[axis][index];
+  }
+  return std::sqrt(squared_speed);
+}
+
+vector<float>& ParticleStore::GetPositions(size_t axis) {
+  return positions_[axis];
+}
+
+const vector<float>& ParticleStore::GetPositions(size_t axis) const {
+  return positions_[axis];
+}
+
+vector<float>& ParticleStore::GetVelocities(size_t axis) {
+  return velocities_[axis];
+}
+
+const vector<float>& ParticleStore::GetVelocities(size_t axis) const {
+  return velocities_[axis];
+}
+
+vector<float>& ParticleStore::GetMasses() {
+  return masses_;
+}
+
+const vector<float>& ParticleStore::GetMasses() const {
+  return masses_;
+}
+
+vector<float>& ParticleStore::GetRadii() {
+  return radii_;
+}
+
+const vector<float>& ParticleStore::GetRadii() const {
+  return radii_;
+}
+
+vector<SpeciesId>& ParticleStore::GetSpecies() {
+  return species_;
+}
+
+const vector<SpeciesId>& ParticleStore::GetSpecies() const {
+  return species_;
+}
+
+vector<ColorT<float>>& ParticleStore::GetColors() {
+  return colors_;
+}
+
+const vector<ColorT<float>>& ParticleStore::GetColors() const {
+  return colors_;
+}
+
+}  // namespace idealgas
@@ -0,0 +1,61 @@
+#include "core/philox.h"
+
+#include <cstdint>
+
+using idealgas::Philox;
+
+namespace idealgas {
+
+namespace {
+
+// The round multipliers of Philox4x32
+const uint32_t kMultiplier0 = 0xD2511F53;
+const uint32_t kMultiplier1 = 0xCD9E8D57;
+// The key increments between rounds, from the golden ratio and sqrt(3)
+const uint32_t kWeyl0 = 0x9E3779B9;
+const uint32_t kWeyl1 = 0xBB67AE85;
+// The number of rounds, the recommended Philox4x32-10
+const size_t kRounds = 10;
+
+}  // namespace
+
+Philox::Block Philox::Generate(const Block& counter, const Key& key) {
+  Block block = counter;
+  Key round_key = key;
+  for (size_t round = 0; round < kRounds; ++round) {
+    uint64_t product0 = (uint64_t)kMultiplier0 * block[0];
+    uint64_t product1 = (uint64_t)kMultiplier1 * block[2];
+    block = {(uint32_t)(product1 >> 32) ^ block[1] ^ round_key[0],
+             (uint32_t)product1,
+             (uint32_t)(product0 >> 32) ^ block[3] ^ round_key[1],
+             (uint32_t)product0};
+    round_key[0] += kWeyl0;
+    round_key[1] += kWeyl1;
+  }
+  return block;
+}
+
+Philox::Philox(uint64_t seed, uint32_t stream, uint64_t index)
+    : counter_({(uint32_t)index, (uint32_t)(index >> 32), stream, 0}),
+      key_({(uint32_t)seed, (uint32_t)(seed >> 32)}),
+      next_word_(block_.size()) {}
+
+uint32_t Philox::NextUint() {
+  // Draw a new block once the current one is used up
+  if (next_word_ == block_.size()) {
+    block_ = Generate(counter_, key_);
+    ++counter_[3];
+    next_word_ = 0;
+  }
+  return block_[next_word_++];
+}
+
+float Philox::NextFloat() {
+  return (NextUint() >> 8) * (1.0f / (1 << 24));
+}
+
+double Philox::NextUniform(double min, double max) {
+  return min + (max - min) * NextFloat();
+}
+
+}  // namespace idealgas
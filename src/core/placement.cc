@@ -0,0 +1,202 @@
+#include "core/placement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/philox.h"
+
+using idealgas::ParticleStore;
+using idealgas::Philox;
+using idealgas::ThreadPool;
+using std::array;
+using std::max;
+using std::min;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The Philox streams of the cell shuffle and the jitter, apart from every
+// species' and the ensemble's
+const uint32_t kShuffleStream = 0xFFFFFFFE;
+const uint32_t kJitterStream = 0xFFFFFFFD;
+// The gap kept between a particle and the edge of its sub-cell, as a
+// fraction of its radius, so that neighbors never start touching
+const float kGap = 0.01f;
+// The smallest sub-cell, so that particles without radius still spread out
+const float kMinCellSize = 1;
+// Pi, which the standard library names only from C++20
+const double kPi = 3.14159265358979323846;
+// Below this many particles a chunk is not worth handing to another thread
+const size_t kMinParticlesPerChunk = 4096;
+
+/**
+ * @brief How one range of particles fills its cells.
+ *
+ */
+struct RangeLayout {
+  // The sub-cells along each side of a cell
+  size_t sub_cells = 1;
+  // The index of the range's first cell among the shuffled free cells
+  size_t first_cell = 0;
+};
+
+}  // namespace
+
+void PlaceWithoutOverlaps(ParticleStore& particles,
+                          const vector<pair<size_t, size_t>>& ranges,
+                          const array<float, 3>& extents, uint64_t seed,
+                          ThreadPool& thread_pool) {
+  size_t dimensions = particles.GetDimensions();
+  const vector<float>& radii = particles.GetRadii();
+
+  // Each cell fits the widest particle placed, with its gap
+  vector<float> diameters(ranges.size(), kMinCellSize);
+  vector<uint8_t> placed(particles.size(), 0);
+  float cell_size = kMinCellSize;
+  for (size_t range = 0; range < ranges.size(); ++range) {
+    for (size_t index = ranges[range].first; index < ranges[range].second;
+         ++index) {
+      diameters[range] =
+          max(diameters[range], 2 * radii[index] * (1 + kGap));
+      placed[index] = 1;
+    }
+    cell_size = max(cell_size, diameters[range]);
+  }
+  // The columns, rows and layers of cells, with a single layer in two
+  // dimensions
+  array<size_t, 3> counts = {1, 1, 1};
+  size_t cell_count = 1;
+  double container_volume = 1;
+  for (size_t axis = 0; axis < dimensions; ++axis) {
+    counts[axis] = extents[axis] > cell_size
+                       ? (size_t)(extents[axis] / cell_size)
+                       : 0;
+    cell_count *= counts[axis];
+    container_volume *= extents[axis];
+  }
+
+  // The particles left in place block every cell they reach into
+  vector<uint8_t> blocked(cell_count, 0);
+  double particle_volume = 0;
+  for (size_t index = 0; index < particles.size(); ++index) {
+    float radius = radii[index];
+    particle_volume += dimensions == 3
+                           ? 4 * kPi * radius * radius * radius / 3
+                           : kPi * radius * radius;
+    if (placed[index] || cell_count == 0) {
+      continue;
+    }
+    float reach = radius * (1 + kGap);
+    array<size_t, 3> first = {0, 0, 0};
+    array<size_t, 3> last = {0, 0, 0};
+    bool inside = true;
+    for (size_t axis = 0; axis < dimensions; ++axis) {
+      float position = particles.GetPositions(axis)[index];
+      float lower = (position - reach) / cell_size;
+      float upper = (position + reach) / cell_size;
+      inside = inside && upper >= 0 && lower < counts[axis];
+      if (inside) {
+        first[axis] = (size_t)max(lower, 0.0f);
+        last[axis] = min((size_t)upper, counts[axis] - 1);
+      }
+    }
+    if (!inside) {
+      continue;
+    }
+    for (size_t layer = first[2]; layer <= last[2]; ++layer) {
+      for (size_t row = first[1]; row <= last[1]; ++row) {
+        for (size_t column = first[0]; column <= last[0]; ++column) {
+          blocked[(layer * counts[1] + row) * counts[0] + column] = 1;
+        }
+      }
+    }
+  }
+  vector<size_t> free_cells;
+  free_cells.reserve(blocked.size());
+  for (size_t cell = 0; cell < blocked.size(); ++cell) {
+    if (!blocked[cell]) {
+      free_cells.push_back(cell);
+    }
+  }
+
+  // Small particles share a cell, one to a sub-cell, so a range needs only
+  // as many cells as its sub-cells require
+  vector<RangeLayout> layouts(ranges.size());
+  size_t needed_cells = 0;
+  for (size_t range = 0; range < ranges.size(); ++range) {
+    size_t sub_cells = max((size_t)(cell_size / diameters[range]), (size_t)1);
+    size_t per_cell = dimensions == 3 ? sub_cells * sub_cells * sub_cells
+                                      : sub_cells * sub_cells;
+    size_t count = ranges[range].second - ranges[range].first;
+    layouts[range].sub_cells = sub_cells;
+    layouts[range].first_cell = needed_cells;
+    needed_cells += (count + per_cell - 1) / per_cell;
+  }
+
+  // Fail before moving anything
+  if (needed_cells > free_cells.size()) {
+    double packing_fraction = particle_volume / container_volume;
+    throw std::invalid_argument(
+        "The particles cannot be placed without overlaps: they cover " +
+        std::to_string((int)std::round(100 * packing_fraction)) +
+        "% of the container and need " + std::to_string(needed_cells) +
+        " lattice cells, but only " + std::to_string(free_cells.size()) +
+        " are free. Please edit your configuration file.");
+  }
+
+  // Shuffle the free cells so that every range is spread over the container
+  Philox shuffle(seed, kShuffleStream, 0);
+  for (size_t cell = free_cells.size(); cell > 1; --cell) {
+    std::swap(free_cells[cell - 1], free_cells[shuffle.NextUint() % cell]);
+  }
+
+  for (size_t range = 0; range < ranges.size(); ++range) {
+    const RangeLayout& layout = layouts[range];
+    size_t first = ranges[range].first;
+    size_t sub_cells = layout.sub_cells;
+    size_t per_cell = dimensions == 3 ? sub_cells * sub_cells * sub_cells
+                                      : sub_cells * sub_cells;
+    float sub_cell_size = cell_size / sub_cells;
+    thread_pool.ParallelFor(
+        ranges[range].second - first,
+        [&](size_t begin, size_t end) {
+          for (size_t offset = begin; offset < end; ++offset) {
+            size_t index = first + offset;
+            size_t cell = free_cells[layout.first_cell + offset / per_cell];
+            size_t sub_cell = offset % per_cell;
+            // The column, row and layer of the cell and of the sub-cell
+            // within it
+            const array<size_t, 3> cells = {cell % counts[0],
+                                            cell / counts[0] % counts[1],
+                                            cell / (counts[0] * counts[1])};
+            const array<size_t, 3> subs = {sub_cell % sub_cells,
+                                           sub_cell / sub_cells % sub_cells,
+                                           sub_cell / (sub_cells * sub_cells)};
+
+            // The particle and its gap stay inside its sub-cell, and the
+            // z axis draws last so that x and y match a two-dimensional run
+            float slack =
+                max(sub_cell_size / 2 - radii[index] * (1 + kGap), 0.0f);
+            Philox random(seed, kJitterStream, index);
+            for (size_t axis = 0; axis < dimensions; ++axis) {
+              float center = cells[axis] * cell_size +
+                             (subs[axis] + 0.5f) * sub_cell_size;
+              particles.GetPositions(axis)[index] =
+                  center + (float)random.NextUniform(-slack, slack);
+            }
+          }
+        },
+        kMinParticlesPerChunk);
+  }
+}
+
+}  // namespace idealgas
@@ -0,0 +1,169 @@
+#include "core/simulation_thread.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using idealgas::Histogram;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::SimulationSnapshot;
+using idealgas::SimulationThread;
+using std::function;
+using std::pair;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The most steps a simulation that fell behind takes to catch up
+const double kMaxCatchUpSteps = 4;
+
+}  // namespace
+
+SimulationThread::SimulationThread(ParticleContainer& container,
+                                   size_t histogram_bin_count,
+                                   size_t histogram_window_steps,
+                                   double steps_per_second)
+    : container_(container),
+      histogram_bin_count_(histogram_bin_count),
+      histogram_window_steps_(histogram_window_steps),
+      step_seconds_(steps_per_second > 0 ? 1 / steps_per_second : 0) {}
+
+SimulationThread::~SimulationThread() {
+  Stop();
+}
+
+void SimulationThread::Start() {
+  if (running_) {
+    return;
+  }
+  // The thread has not started, so this thread can still produce
+  PublishSnapshot();
+  running_ = true;
+  thread_ = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  RunCommands();
+}
+
+void SimulationThread::Post(function<void(ParticleContainer&)> command) {
+  std::lock_guard<std::mutex> lock(commands_mutex_);
+  commands_.push_back(std::move(command));
+}
+
+const SimulationSnapshot& SimulationThread::AcquireSnapshot() {
+  return snapshots_.Acquire();
+}
+
+void SimulationThread::Run() {
+  using Clock = std::chrono::steady_clock;
+  std::chrono::duration<double> step_time(step_seconds_);
+  Clock::time_point next_step = Clock::now();
+
+  while (running_) {
+    RunCommands();
+    container_.Increment();
+    UpdateHistograms();
+    ++step_;
+    PublishSnapshot();
+
+    if (step_seconds_ > 0) {
+      // After a slow stretch, catch up a little rather than racing ahead
+      Clock::time_point now = Clock::now();
+      next_step += std::chrono::duration_cast<Clock::duration>(step_time);
+      if (now - next_step > kMaxCatchUpSteps * step_time) {
+        next_step = now;
+      }
+      std::this_thread::sleep_until(next_step);
+    }
+  }
+}
+
+void SimulationThread::RunCommands() {
+  {
+    std::lock_guard<std::mutex> lock(commands_mutex_);
+    std::swap(commands_, running_commands_);
+  }
+  for (auto& command : running_commands_) {
+    command(container_);
+  }
+  running_commands_.clear();
+}
+
+void SimulationThread::UpdateHistograms() {
+  const ParticleStore& particles =
+      std::as_const(container_).GetParticles();
+
+  // Species added since the last step get their own histograms
+  for (size_t id = histograms_.size(); id < particles.GetSpeciesNames().size();
+       ++id) {
+    histograms_.emplace_back(particles.GetSpeciesName((SpeciesId)id),
+                             histogram_bin_count_, histogram_window_steps_);
+  }
+
+  // Hidden species are left out of the statistics, but their windows still
+  // move on
+  for (size_t id = 0; id < histograms_.size(); ++id) {
+    if (!particles.IsSpeciesVisible((SpeciesId)id)) {
+      continue;
+    }
+    pair<size_t, size_t> range = particles.GetSpeciesRange((SpeciesId)id);
+    for (size_t index = range.first; index < range.second; ++index) {
+      histograms_[id].Update(particles.GetSpeed(index));
+    }
+  }
+  for (Histogram& histogram : histograms_) {
+    histogram.EndStep();
+  }
+}
+
+void SimulationThread::PublishSnapshot() {
+  const ParticleStore& particles =
+      std::as_const(container_).GetParticles();
+  SimulationSnapshot& snapshot = snapshots_.GetWriteBuffer();
+
+  // Assigning reuses each buffer's memory once it is large enough
+  snapshot.step = step_;
+  for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+    snapshot.positions[axis] = particles.GetPositions(axis);
+  }
+  snapshot.radii = particles.GetRadii();
+  snapshot.colors = particles.GetColors();
+  snapshot.visible_ranges.clear();
+  for (size_t id = 0; id < particles.GetSpeciesNames().size(); ++id) {
+    if (particles.IsSpeciesVisible((SpeciesId)id)) {
+      snapshot.visible_ranges.push_back(
+          particles.GetSpeciesRange((SpeciesId)id));
+    }
+  }
+
+  if (!container_.GetObservableHistory().empty()) {
+    snapshot.observables = container_.GetObservableHistory().back();
+  }
+
+  snapshot.histograms.resize(histograms_.size());
+  for (size_t id = 0; id < histograms_.size(); ++id) {
+    Histogram& histogram = histograms_[id];
+    histogram.CalculateFrequencies();
+    histogram.NormalizeBins();
+    snapshot.histograms[id].title = histogram.GetTitle();
+    snapshot.histograms[id].visible =
+        particles.IsSpeciesVisible((SpeciesId)id);
+    snapshot.histograms[id].bin_heights = histogram.GetBinHeights();
+    snapshot.histograms[id].bin_cutoffs = histogram.GetBinCutoffs();
+  }
+
+  snapshots_.Publish();
+}
+
+}  // namespace idealgas
@@ -0,0 +1,297 @@
+#include "core/software_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+using idealgas::Histogram;
+using idealgas::Image;
+using idealgas::ParticleStore;
+using idealgas::SoftwareRenderer;
+using std::max;
+using std::min;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+/**
+ * @brief Converts a color to the three bytes of a pixel.
+ *
+ * @param color the color, each component from 0 to 1
+ * @param bytes the three bytes to fill
+ */
+void ToBytes(const ColorT<float>& color, uint8_t bytes[3]) {
+  const float components[3] = {color.r, color.g, color.b};
+  for (size_t channel = 0; channel < 3; ++channel) {
+    float clamped = min(max(components[channel], 0.0f), 1.0f);
+    bytes[channel] = (uint8_t)(clamped * 255 + 0.5f);
+  }
+}
+
+}  // namespace
+
+SoftwareRenderer::SoftwareRenderer(const SimulationConfig& config,
+                                   size_t thread_count)
+    : margin_(config.margin),
+      stroke_(config.stroke),
+      container_width_(config.container_width),
+      container_height_(config.container_height),
+      background_color_(ColorT<float>::hex(config.background_color)),
+      stroke_color_(ColorT<float>::hex(config.stroke_color)),
+      bar_color_(ColorT<float>::hex(config.text_color)),
+      histogram_bin_count_(config.histogram_bin_count),
+      histogram_window_steps_(config.histogram_window_steps),
+      thread_pool_(std::make_unique<ThreadPool>(thread_count)) {
+  image_.width = config.window_width;
+  image_.height = config.window_height;
+  image_.pixels.resize(image_.width * image_.height * 3);
+}
+
+void SoftwareRenderer::UpdateHistograms(const ParticleStore& particles) {
+  // Species added since the last step get their own histograms
+  for (size_t id = histograms_.size(); id < particles.GetSpeciesNames().size();
+       ++id) {
+    histograms_.emplace_back(particles.GetSpeciesName((SpeciesId)id),
+                             histogram_bin_count_, histogram_window_steps_);
+  }
+
+  // Hidden species are left out, as the visualizer leaves them out
+  for (size_t id = 0; id < histograms_.size(); ++id) {
+    if (!particles.IsSpeciesVisible((SpeciesId)id)) {
+      continue;
+    }
+    pair<size_t, size_t> range = particles.GetSpeciesRange((SpeciesId)id);
+    for (size_t index = range.first; index < range.second; ++index) {
+      histograms_[id].Update(particles.GetSpeed(index));
+    }
+  }
+  for (Histogram& histogram : histograms_) {
+    histogram.EndStep();
+  }
+}
+
+void SoftwareRenderer::Render(const ParticleStore& particles) {
+  back_rects_.clear();
+  AddStrokedRect(back_rects_, margin_, margin_, margin_ + container_width_,
+                 margin_ + container_height_, stroke_color_);
+  LayOutHistograms(particles);
+  BinParticles(particles);
+
+  size_t band_count = band_starts_.size() - 1;
+  thread_pool_->ParallelFor(
+      band_count,
+      [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; ++band) {
+          DrawBand(band, particles);
+        }
+      },
+      1);
+}
+
+const Image& SoftwareRenderer::GetImage() const {
+  return image_;
+}
+
+void SoftwareRenderer::AddStrokedRect(vector<Rect>& rects, float left,
+                                      float top, float right, float bottom,
+                                      const ColorT<float>& color) const {
+  float half = stroke_ / 2.0f;
+  rects.push_back({left - half, top - half, right + half, top + half, color});
+  rects.push_back(
+      {left - half, bottom - half, right + half, bottom + half, color});
+  rects.push_back({left - half, top + half, left + half, bottom - half, color});
+  rects.push_back(
+      {right - half, top + half, right + half, bottom - half, color});
+}
+
+void SoftwareRenderer::LayOutHistograms(const ParticleStore& particles) {
+  front_rects_.clear();
+  size_t species_count = particles.GetSpeciesNames().size();
+
+  // The "magic numbers" below match HistogramPlot and the visualizer's setup
+  for (size_t id = 0; id < min(species_count, histograms_.size()); ++id) {
+    Histogram& histogram = histograms_[id];
+    histogram.CalculateFrequencies();
+    if (histogram.GetBinHeights().empty() ||
+        !particles.IsSpeciesVisible((SpeciesId)id)) {
+      continue;
+    }
+    histogram.NormalizeBins();
+
+    size_t width = margin_ * 3;
+    size_t height = container_height_ / species_count;
+    glm::vec2 offset(container_width_ + 2 * margin_,
+                     margin_ + id * (container_height_ / species_count));
+    AddStrokedRect(front_rects_, offset.x, offset.y, offset.x + width,
+                   offset.y + height, stroke_color_);
+
+    glm::vec2 graph_offset = offset + glm::vec2(stroke_ / 2, 0) +
+                             glm::vec2(width / 10, 0);
+    size_t graph_width = width * 8.5 / 10;
+    size_t bin_width = graph_width / histogram_bin_count_;
+    size_t max_bar_height = height * 8 / 10;
+
+    const vector<float>& bin_heights = histogram.GetBinHeights();
+    for (size_t bin = 0; bin < bin_heights.size(); ++bin) {
+      size_t proportional_height = bin_heights[bin] * max_bar_height;
+      float top = graph_offset.y + max_bar_height - proportional_height;
+      // Low bars are drawn from lower down, as HistogramPlot draws them
+      if (!(max_bar_height + stroke_ <
+            max_bar_height - proportional_height + stroke_ * 3)) {
+        top += stroke_ * 3;
+      }
+      front_rects_.push_back({graph_offset.x + bin * bin_width, top,
+                              graph_offset.x + (bin + 1) * bin_width,
+                              graph_offset.y + max_bar_height + stroke_,
+                              bar_color_});
+    }
+  }
+}
+
+void SoftwareRenderer::BinParticles(const ParticleStore& particles) {
+  size_t band_count = (image_.height + kBandRows - 1) / kBandRows;
+  band_starts_.assign(band_count + 1, 0);
+
+  // Finds the bands a particle reaches, or returns false when it is off
+  // screen or hidden
+  const vector<float>& x = particles.GetPositions(0);
+  const vector<float>& y = particles.GetPositions(1);
+  const vector<float>& radii = particles.GetRadii();
+  const vector<SpeciesId>& species = particles.GetSpecies();
+  auto find_bands = [&](size_t index, size_t& first, size_t& last) {
+    if (!particles.IsSpeciesVisible(species[index])) {
+      return false;
+    }
+    float center_x = margin_ + x[index];
+    float center_y = margin_ + y[index];
+    float radius = radii[index];
+    if (!(radius > 0) || !(center_x + radius >= 0) ||
+        !(center_x - radius <= image_.width) || !(center_y + radius >= 0) ||
+        !(center_y - radius <= image_.height)) {
+      return false;
+    }
+    first = (size_t)max(center_y - radius, 0.0f) / kBandRows;
+    last = min((size_t)(center_y + radius) / kBandRows, band_count - 1);
+    return true;
+  };
+
+  // Count each band's particles, then place them, keeping index order
+  size_t first;
+  size_t last;
+  for (size_t index = 0; index < particles.size(); ++index) {
+    if (find_bands(index, first, last)) {
+      for (size_t band = first; band <= last; ++band) {
+        ++band_starts_[band + 1];
+      }
+    }
+  }
+  for (size_t band = 0; band < band_count; ++band) {
+    band_starts_[band + 1] += band_starts_[band];
+  }
+  band_particles_.resize(band_starts_[band_count]);
+  vector<size_t> next(band_starts_.begin(), band_starts_.end() - 1);
+  for (size_t index = 0; index < particles.size(); ++index) {
+    if (find_bands(index, first, last)) {
+      for (size_t band = first; band <= last; ++band) {
+        band_particles_[next[band]++] = (uint32_t)index;
+      }
+    }
+  }
+}
+
+void SoftwareRenderer::DrawBand(size_t band, const ParticleStore& particles) {
+  size_t row_begin = band * kBandRows;
+  size_t row_end = min(row_begin + kBandRows, image_.height);
+
+  uint8_t background[3];
+  ToBytes(background_color_, background);
+  for (size_t pixel = row_begin * image_.width; pixel < row_end * image_.width;
+       ++pixel) {
+    std::copy(background, background + 3, &image_.pixels[pixel * 3]);
+  }
+
+  for (const Rect& rect : back_rects_) {
+    FillRect(rect, row_begin, row_end);
+  }
+
+  const vector<ColorT<float>>& colors = particles.GetColors();
+  for (size_t slot = band_starts_[band]; slot < band_starts_[band + 1];
+       ++slot) {
+    uint32_t index = band_particles_[slot];
+    FillCircle(margin_ + particles.GetPositions(0)[index],
+               margin_ + particles.GetPositions(1)[index],
+               particles.GetRadii()[index], colors[index], row_begin, row_end);
+  }
+
+  for (const Rect& rect : front_rects_) {
+    FillRect(rect, row_begin, row_end);
+  }
+}
+
+void SoftwareRenderer::FillRect(const Rect& rect, size_t row_begin,
+                                size_t row_end) {
+  // A pixel is filled when its center is inside the rectangle
+  float first_row = max(std::ceil(rect.top - 0.5f), (float)row_begin);
+  float end_row = min(std::ceil(rect.bottom - 0.5f), (float)row_end);
+  float first_column = max(std::ceil(rect.left - 0.5f), 0.0f);
+  float end_column = min(std::ceil(rect.right - 0.5f), (float)image_.width);
+  if (!(first_row < end_row) || !(first_column < end_column)) {
+    return;
+  }
+
+  uint8_t color[3];
+  ToBytes(rect.color, color);
+  for (size_t row = first_row; row < end_row; ++row) {
+    uint8_t* pixel = &image_.pixels[(row * image_.width + first_column) * 3];
+    for (size_t column = first_column; column < end_column; ++column) {
+      pixel[0] = color[0];
+      pixel[1] = color[1];
+      pixel[2] = color[2];
+      pixel += 3;
+    }
+  }
+}
+
+void SoftwareRenderer::FillCircle(float center_x, float center_y,
+                                  float radius, const ColorT<float>& color,
+                                  size_t row_begin, size_t row_end) {
+  uint8_t bytes[3];
+  ToBytes(color, bytes);
+
+  // A pixel is filled when its center is inside the circle, so each row is
+  // one span
+  float first_row = max(std::ceil(center_y - radius - 0.5f), (float)row_begin);
+  float end_row = min(std::floor(center_y + radius - 0.5f) + 1, (float)row_end);
+  for (float row = first_row; row < end_row; ++row) {
+    float dy = row + 0.5f - center_y;
+    float squared_half_width = radius * radius - dy * dy;
+    if (squared_half_width < 0) {
+      continue;
+    }
+    float half_width = std::sqrt(squared_half_width);
+    float first_column = max(std::ceil(center_x - half_width - 0.5f), 0.0f);
+    float end_column = min(std::floor(center_x + half_width - 0.5f) + 1,
+                           (float)image_.width);
+    if (!(first_column < end_column)) {
+      continue;
+    }
+
+    uint8_t* pixel =
+        &image_.pixels[((size_t)row * image_.width + (size_t)first_column) * 3];
+    for (size_t column = first_column; column < end_column; ++column) {
+      pixel[0] = bytes[0];
+      pixel[1] = bytes[1];
+      pixel[2] = bytes[2];
+      pixel += 3;
+    }
+  }
+}
+
+}  // namespace idealgas
@@ -0,0 +1,325 @@
+#include "core/sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/config.h"
+#include "core/observables.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/ring_buffer.h"
+#include "core/thread_pool.h"
+
+using idealgas::Observables;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::RingBuffer;
+using idealgas::SpeciesId;
+using idealgas::Sweep;
+using idealgas::SweepResult;
+using idealgas::ThreadPool;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+/**
+ * @brief Turns a path of dot-joined keys into a JSON pointer, leaving JSON
+ * pointers as they are.
+ *
+ * @throws std::invalid_argument when the path is not a valid pointer
+ * @param path the path of a setting
+ * @return the string JSON pointer
+ */
+string ToPointer(const string& path) {
+  string pointer;
+  if (!path.empty() && path[0] == '/') {
+    pointer = path;
+  } else {
+    pointer = "/";
+    for (char character : path) {
+      if (character == '.') {
+        pointer += '/';
+      } else if (character == '~') {
+        pointer += "~0";
+      } else if (character == '/') {
+        pointer += "~1";
+      } else {
+        pointer += character;
+      }
+    }
+  }
+
+  try {
+    json::json_pointer checked(pointer);
+  } catch (const std::exception& error) {
+    throw std::invalid_argument("Invalid sweep path " + path + ": " +
+                                error.what());
+  }
+  return pointer;
+}
+
+/**
+ * @brief Quotes a CSV field when it holds a comma, quote or line break.
+ *
+ * @param field the text of the field
+ * @return the string field, quoted if needed
+ */
+string CsvField(const string& field) {
+  if (field.find_first_of(",\"\n") == string::npos) {
+    return field;
+  }
+  string quoted = "\"";
+  for (char character : field) {
+    quoted += character;
+    if (character == '"') {
+      quoted += '"';
+    }
+  }
+  return quoted + "\"";
+}
+
+/**
+ * @brief Formats a number for the table.
+ *
+ * @param value the number
+ * @return the string number, with six significant digits
+ */
+string FormatNumber(double value) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.6g", value);
+  return text;
+}
+
+/**
+ * @brief Runs one job in a container left over from the last job.
+ *
+ * @param container the container to reset and configure
+ * @param config the configuration of the job
+ * @param steps the number of steps to take
+ * @param result the SweepResult to fill in
+ */
+void RunJob(ParticleContainer& container, const json& config, size_t steps,
+            SweepResult& result) {
+  try {
+    container.Reset();
+    container.ConfigureFromJson(config);
+  } catch (const std::exception& error) {
+    result.error = error.what();
+    return;
+  }
+
+  result.particle_count = container.GetParticles().size();
+  result.steps = steps;
+  result.seed = container.GetSeed();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t step = 0; step < steps; ++step) {
+    container.Increment();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  result.throughput = result.seconds > 0
+                          ? result.particle_count * steps / result.seconds
+                          : 0;
+
+  const RingBuffer<Observables>& history = container.GetObservableHistory();
+  if (history.empty()) {
+    return;
+  }
+  const Observables& last = history.back();
+  result.kinetic_energy = last.kinetic_energy;
+  // The species' temperatures are weighted by their simulated particles, so
+  // disabled species are left out as they are from the observables
+  const ParticleStore& particles = container.GetParticles();
+  double weighted_temperature = 0;
+  size_t simulated_count = 0;
+  for (SpeciesId species = 0; species < last.temperatures.size(); ++species) {
+    if (!particles.IsSpeciesEnabled(species)) {
+      continue;
+    }
+    pair<size_t, size_t> range = particles.GetSpeciesRange(species);
+    weighted_temperature +=
+        last.temperatures[species] * (range.second - range.first);
+    simulated_count += range.second - range.first;
+  }
+  result.temperature =
+      simulated_count > 0 ? weighted_temperature / simulated_count : 0;
+  for (size_t step = 0; step < history.size(); ++step) {
+    result.pressure += history[step].pressure;
+  }
+  result.pressure /= history.size();
+}
+
+}  // namespace
+
+Sweep::Sweep(const json& config, const json& spec) : config_(config) {
+  if (!spec.is_object()) {
+    throw std::invalid_argument("A sweep must be a JSON object.");
+  }
+  steps_ = spec.value("steps", kDefaultSteps);
+
+  // The product's settings, each with the values it takes
+  vector<pair<string, vector<json>>> product;
+  for (const json& entry : spec.value("product", json::array())) {
+    if (!entry.contains("path") || !entry["path"].is_string() ||
+        !entry.contains("values") || !entry["values"].is_array() ||
+        entry["values"].empty()) {
+      throw std::invalid_argument(
+          "Every product entry needs a path and a list of values.");
+    }
+    product.emplace_back(ToPointer(entry["path"]),
+                         entry["values"].get<vector<json>>());
+  }
+
+  // Without points, the product alone is swept
+  vector<vector<pair<string, json>>> points;
+  for (const json& entry : spec.value("points", json::array())) {
+    if (!entry.is_object()) {
+      throw std::invalid_argument("Every point must map paths to values.");
+    }
+    vector<pair<string, json>> overrides;
+    for (auto it = entry.begin(); it != entry.end(); ++it) {
+      overrides.emplace_back(ToPointer(it.key()), it.value());
+    }
+    points.push_back(overrides);
+  }
+  if (points.empty()) {
+    points.emplace_back();
+  }
+
+  for (const pair<string, vector<json>>& setting : product) {
+    if (std::find(columns_.begin(), columns_.end(), setting.first) ==
+        columns_.end()) {
+      columns_.push_back(setting.first);
+    }
+  }
+  for (const vector<pair<string, json>>& point : points) {
+    for (const pair<string, json>& setting : point) {
+      if (std::find(columns_.begin(), columns_.end(), setting.first) ==
+          columns_.end()) {
+        columns_.push_back(setting.first);
+      }
+    }
+  }
+
+  size_t combinations = 1;
+  for (const pair<string, vector<json>>& setting : product) {
+    combinations *= setting.second.size();
+  }
+  for (const vector<pair<string, json>>& point : points) {
+    for (size_t combination = 0; combination < combinations; ++combination) {
+      // The combination's index counts in mixed radix, the last setting
+      // varying fastest
+      vector<pair<string, json>> overrides = point;
+      size_t remainder = combination;
+      size_t first_override = overrides.size();
+      for (size_t setting = product.size(); setting-- > 0;) {
+        const vector<json>& values = product[setting].second;
+        overrides.insert(overrides.begin() + first_override,
+                         {product[setting].first,
+                          values[remainder % values.size()]});
+        remainder /= values.size();
+      }
+      jobs_.push_back(overrides);
+    }
+  }
+}
+
+const vector<string>& Sweep::GetColumns() const {
+  return columns_;
+}
+
+size_t Sweep::GetJobCount() const {
+  return jobs_.size();
+}
+
+size_t Sweep::GetSteps() const {
+  return steps_;
+}
+
+void Sweep::SetSteps(size_t steps) {
+  steps_ = steps;
+}
+
+json Sweep::GetJobConfig(size_t job) const {
+  json config = config_;
+  for (const pair<string, json>& setting : jobs_[job]) {
+    config[json::json_pointer(setting.first)] = setting.second;
+  }
+
+  // Jobs already run side by side, and must not share files
+  config["container"]["threads"] = 1;
+  config["container"].erase("checkpoint");
+  config["container"].erase("trajectory");
+  return config;
+}
+
+vector<SweepResult> Sweep::Run(size_t thread_count) const {
+  vector<SweepResult> results(jobs_.size());
+  for (size_t job = 0; job < jobs_.size(); ++job) {
+    json config = GetJobConfig(job);
+    for (const string& column : columns_) {
+      json::json_pointer pointer(column);
+      results[job].values.push_back(config.contains(pointer) ? config[pointer]
+                                                             : json());
+    }
+  }
+
+  // Each thread takes jobs from the shared queue until it is empty, stepping
+  // them all in the same container
+  std::atomic<size_t> next_job{0};
+  ThreadPool pool(thread_count);
+  pool.ParallelFor(
+      pool.GetThreadCount(),
+      [&](size_t begin, size_t end) {
+        for (size_t worker = begin; worker < end; ++worker) {
+          ParticleContainer container;
+          for (size_t job = next_job++; job < jobs_.size();
+               job = next_job++) {
+            RunJob(container, GetJobConfig(job), steps_, results[job]);
+          }
+        }
+      },
+      1);
+  return results;
+}
+
+void Sweep::WriteTable(std::ostream& output,
+                       const vector<SweepResult>& results) const {
+  output << "job";
+  for (const string& column : columns_) {
+    output << ',' << CsvField(column);
+  }
+  output << ",particles,steps,seed,seconds,particle steps per second,"
+            "kinetic energy,temperature,pressure,error\n";
+
+  for (size_t job = 0; job < results.size(); ++job) {
+    const SweepResult& result = results[job];
+    output << job;
+    for (const json& value : result.values) {
+      output << ','
+             << CsvField(value.is_string() ? value.get<string>()
+                                           : value.dump());
+    }
+    output << ',' << result.particle_count << ',' << result.steps << ','
+           << result.seed << ',' << FormatNumber(result.seconds) << ','
+           << FormatNumber(result.throughput) << ','
+           << FormatNumber(result.kinetic_energy) << ','
+           << FormatNumber(result.temperature) << ','
+           << FormatNumber(result.pressure) << ',' << CsvField(result.error)
+           << '\n';
+  }
+}
+
+}  // namespace idealgas
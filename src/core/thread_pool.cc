@@ -0,0 +1,142 @@
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using idealgas::ThreadPool;
+using std::function;
+using std::max;
+using std::min;
+
+namespace idealgas {
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  // The caller counts as one of the threads
+  for (size_t index = 1; index < thread_count; ++index) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const function<void(size_t, size_t)>& body,
+                             size_t min_chunk) {
+  if (count == 0) {
+    return;
+  }
+
+  // Run short loops inline, where waking the workers would cost more than the
+  // loop itself
+  size_t thread_count = GetThreadCount();
+  if (thread_count == 1 || count <= min_chunk) {
+    body(0, count);
+    return;
+  }
+
+  // A few chunks per thread balances uneven chunks without much contention
+  size_t chunk_size = max(min_chunk, (count + thread_count * 4 - 1) /
+                                         (thread_count * 4));
+  size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+  // Loops started from several threads at once take turns
+  std::lock_guard<std::mutex> loop_lock(loop_mutex_);
+  {
+    // Workers still leaving the previous loop must not see this one's chunks
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] { return active_workers_ == 0; });
+    body_ = &body;
+    count_ = count;
+    chunk_size_ = chunk_size;
+    chunk_count_ = chunk_count;
+    next_chunk_ = 0;
+    finished_chunks_ = 0;
+    ++generation_;
+  }
+  work_ready_.notify_all();
+
+  RunChunks(body, count, chunk_size, chunk_count);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [this] { return finished_chunks_ == chunk_count_; });
+  // Workers waking after the loop is over find nothing left to run
+  body_ = nullptr;
+}
+
+size_t ThreadPool::GetThreadCount() const {
+  return workers_.size() + 1;
+}
+
+void ThreadPool::WorkerLoop() {
+  size_t seen_generation = 0;
+  while (true) {
+    const function<void(size_t, size_t)>* body;
+    size_t count;
+    size_t chunk_size;
+    size_t chunk_count;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this, seen_generation] {
+        return stopping_ || generation_ != seen_generation;
+      });
+      if (stopping_) {
+        return;
+      }
+      seen_generation = generation_;
+      if (body_ == nullptr) {
+        continue;
+      }
+      body = body_;
+      count = count_;
+      chunk_size = chunk_size_;
+      chunk_count = chunk_count_;
+      ++active_workers_;
+    }
+
+    RunChunks(*body, count, chunk_size, chunk_count);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --active_workers_;
+    }
+    work_done_.notify_all();
+  }
+}
+
+void ThreadPool::RunChunks(const function<void(size_t, size_t)>& body,
+                           size_t count, size_t chunk_size,
+                           size_t chunk_count) {
+  while (true) {
+    size_t chunk = next_chunk_++;
+    if (chunk >= chunk_count) {
+      return;
+    }
+
+    size_t begin = chunk * chunk_size;
+    size_t end = min(begin + chunk_size, count);
+    body(begin, end);
+
+    // The last chunk to finish wakes the caller
+    if (++finished_chunks_ == chunk_count) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      work_done_.notify_all();
+    }
+  }
+}
+
+}  // namespace idealgas
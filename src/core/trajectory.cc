@@ -0,0 +1,568 @@
+#include "core/trajectory.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef IDEALGAS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using idealgas::ParticleStore;
+using idealgas::TrajectoryFrame;
+using idealgas::TrajectoryReader;
+using idealgas::TrajectoryWriter;
+using std::string;
+using std::vector;
+
+namespace idealgas {
+
+namespace {
+
+// The first bytes of every trajectory
+const char kFileMagic[8] = {'I', 'G', 'A', 'S', 'T', 'R', 'A', 'J'};
+// The first bytes of every frame
+const char kFrameMagic[4] = {'F', 'R', 'A', 'M'};
+// The last bytes of a trajectory with a frame index
+const char kIndexMagic[8] = {'I', 'G', 'A', 'S', 'T', 'I', 'D', 'X'};
+// The layout version, raised whenever the layout changes
+const uint32_t kVersion = 1;
+// Written in native byte order, so it reads differently on a machine of the
+// other byte order
+const uint32_t kByteOrderMark = 0x01020304;
+// The frame flag of a frame stored whole
+const uint32_t kKeyframeFlag = 1;
+// The frame flag of a frame compressed with zlib
+const uint32_t kCompressedFlag = 2;
+
+/**
+ * @brief The header at the start of a trajectory.
+ *
+ */
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t dimensions;
+  uint32_t keyframe_interval;
+  double position_quantum;
+  double velocity_quantum;
+};
+
+/**
+ * @brief The header before the bytes of each frame.
+ *
+ */
+struct FrameHeader {
+  char magic[4];
+  uint32_t flags;
+  uint64_t step;
+  double time;
+  uint64_t particle_count;
+  uint64_t raw_size;
+  uint64_t stored_size;
+};
+
+/**
+ * @brief The footer after the frame index.
+ *
+ */
+struct Footer {
+  uint64_t index_offset;
+  uint64_t frame_count;
+  char magic[8];
+};
+
+/**
+ * @brief Rounds a value to a whole number of quanta, saturating at the range
+ * of int32_t. Values that are not finite round to 0.
+ *
+ * @param value the value to round
+ * @param inverse_quantum the number of quanta per unit
+ * @return the int32_t number of quanta
+ */
+int32_t Quantize(float value, double inverse_quantum) {
+  double scaled = std::nearbyint(value * inverse_quantum);
+  if (!std::isfinite(scaled)) {
+    return 0;
+  }
+  if (scaled >= std::numeric_limits<int32_t>::max()) {
+    return std::numeric_limits<int32_t>::max();
+  }
+  if (scaled <= std::numeric_limits<int32_t>::min()) {
+    return std::numeric_limits<int32_t>::min();
+  }
+  return (int32_t)scaled;
+}
+
+/**
+ * @brief Maps a signed difference to an unsigned one, small magnitudes to
+ * small numbers, so that the high bytes of most differences are zero.
+ *
+ * @param delta the difference, wrapped to 32 bits
+ * @return the uint32_t zigzag code
+ */
+uint32_t ZigZag(uint32_t delta) {
+  return (delta << 1) ^ (0u - (delta >> 31));
+}
+
+/**
+ * @brief Reverses ZigZag.
+ *
+ * @param code the uint32_t zigzag code
+ * @return the difference, wrapped to 32 bits
+ */
+uint32_t UnZigZag(uint32_t code) {
+  return (code >> 1) ^ (0u - (code & 1));
+}
+
+}  // namespace
+
+TrajectoryWriter::TrajectoryWriter(const string& path,
+                                   const TrajectoryOptions& options)
+    : options_(options), field_count_(2 * options.dimensions), path_(path) {
+  if (options_.stride == 0 || options_.keyframe_interval == 0) {
+    throw std::invalid_argument(
+        "The trajectory stride and keyframe interval must be positive.");
+  }
+  if (!(options_.position_quantum > 0) || !(options_.velocity_quantum > 0)) {
+    throw std::invalid_argument("The trajectory precisions must be positive.");
+  }
+  if (options_.compression_level < 0 || options_.compression_level > 9) {
+    throw std::invalid_argument(
+        "The trajectory compression level must be from 0 to 9.");
+  }
+  if (options_.dimensions < 2 ||
+      options_.dimensions > ParticleStore::kMaxDimensions) {
+    throw std::invalid_argument("The trajectory dimensions must be 2 or 3.");
+  }
+
+  output_.open(path_, std::ios::binary | std::ios::trunc);
+  FileHeader header = {};
+  std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrderMark;
+  header.dimensions = (uint32_t)options_.dimensions;
+  header.keyframe_interval = (uint32_t)options_.keyframe_interval;
+  header.position_quantum = options_.position_quantum;
+  header.velocity_quantum = options_.velocity_quantum;
+  output_.write((const char*)&header, sizeof(header));
+  if (!output_) {
+    throw std::runtime_error("Could not create " + path_ + ".");
+  }
+
+  for (size_t slot = 0; slot < kStagingFrames; ++slot) {
+    free_.push_back(slot);
+  }
+  thread_ = std::thread(&TrajectoryWriter::WriterLoop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+  try {
+    Close();
+  } catch (const std::exception&) {
+    // Destructors cannot report errors, and Close was not called to see them
+  }
+}
+
+void TrajectoryWriter::Capture(const ParticleStore& particles, double time) {
+  if (particles.GetDimensions() != options_.dimensions) {
+    throw std::invalid_argument(
+        "The particles have " + std::to_string(particles.GetDimensions()) +
+        " dimensions, but the trajectory has " +
+        std::to_string(options_.dimensions) + ".");
+  }
+  uint64_t step = step_count_++;
+  if (step % options_.stride != 0) {
+    return;
+  }
+
+  size_t slot;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closing_) {
+      return;
+    }
+    if (free_.empty()) {
+      ++stall_count_;
+      changed_.wait(lock, [this] { return !free_.empty(); });
+    }
+    if (!error_.empty()) {
+      throw std::runtime_error(error_);
+    }
+    slot = free_.back();
+    free_.pop_back();
+  }
+
+  // The slot belongs to this thread until it is queued, so copy unlocked
+  TrajectoryFrame& staged = staging_[slot];
+  staged.step = step;
+  staged.time = time;
+  for (size_t axis = 0; axis < options_.dimensions; ++axis) {
+    staged.positions[axis] = particles.GetPositions(axis);
+    staged.velocities[axis] = particles.GetVelocities(axis);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    staged_.push_back(slot);
+    ++frame_count_;
+  }
+  changed_.notify_all();
+}
+
+void TrajectoryWriter::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closing_ = true;
+    closed_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+
+  if (!error_.empty()) {
+    output_.close();
+    throw std::runtime_error(error_);
+  }
+
+  Footer footer = {};
+  footer.index_offset = (uint64_t)output_.tellp();
+  footer.frame_count = index_.size();
+  std::memcpy(footer.magic, kIndexMagic, sizeof(kIndexMagic));
+  output_.write((const char*)index_.data(), index_.size() * sizeof(IndexEntry));
+  output_.write((const char*)&footer, sizeof(footer));
+  output_.close();
+  if (!output_) {
+    throw std::runtime_error("Could not write the frame index of " + path_ +
+                             ".");
+  }
+}
+
+size_t TrajectoryWriter::GetFrameCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frame_count_;
+}
+
+size_t TrajectoryWriter::GetStallCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stall_count_;
+}
+
+void TrajectoryWriter::WriterLoop() {
+  while (true) {
+    size_t slot;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this] { return !staged_.empty() || closing_; });
+      if (staged_.empty()) {
+        return;
+      }
+      slot = staged_.front();
+      staged_.pop_front();
+    }
+
+    // After an error, frames are dropped so that captures never block
+    bool failed;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      failed = !error_.empty();
+    }
+    if (!failed) {
+      try {
+        WriteFrame(staging_[slot]);
+      } catch (const std::exception& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = error.what();
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(slot);
+    }
+    changed_.notify_all();
+  }
+}
+
+void TrajectoryWriter::WriteFrame(const TrajectoryFrame& frame) {
+  size_t particle_count = frame.positions[0].size();
+  size_t value_count = field_count_ * particle_count;
+
+  // Round every value to a whole number of quanta
+  values_.resize(value_count);
+  for (size_t field = 0; field < field_count_; ++field) {
+    bool is_position = field < options_.dimensions;
+    const vector<float>& source =
+        is_position ? frame.positions[field]
+                    : frame.velocities[field - options_.dimensions];
+    double inverse_quantum = 1.0 / (is_position ? options_.position_quantum
+                                                : options_.velocity_quantum);
+    int32_t* destination = values_.data() + field * particle_count;
+    for (size_t index = 0; index < particle_count; ++index) {
+      destination[index] = Quantize(source[index], inverse_quantum);
+    }
+  }
+
+  // Particles added or removed break the differences, so start over
+  bool keyframe = index_.size() % options_.keyframe_interval == 0 ||
+                  previous_values_.size() != value_count;
+
+  // Split the zigzagged differences into byte planes, so that the mostly zero
+  // high bytes sit together for the compressor
+  planes_.resize(value_count * sizeof(uint32_t));
+  for (size_t index = 0; index < value_count; ++index) {
+    uint32_t previous = keyframe ? 0 : (uint32_t)previous_values_[index];
+    uint32_t code = ZigZag((uint32_t)values_[index] - previous);
+    for (size_t byte = 0; byte < sizeof(uint32_t); ++byte) {
+      planes_[byte * value_count + index] = (uint8_t)(code >> (8 * byte));
+    }
+  }
+
+  FrameHeader header = {};
+  std::memcpy(header.magic, kFrameMagic, sizeof(kFrameMagic));
+  header.flags = keyframe ? kKeyframeFlag : 0;
+  header.step = frame.step;
+  header.time = frame.time;
+  header.particle_count = particle_count;
+  header.raw_size = planes_.size();
+
+  const uint8_t* stored = planes_.data();
+  header.stored_size = planes_.size();
+#ifdef IDEALGAS_HAVE_ZLIB
+  if (options_.compression_level > 0 && !planes_.empty()) {
+    uLongf compressed_size = compressBound(planes_.size());
+    compressed_.resize(compressed_size);
+    if (compress2(compressed_.data(), &compressed_size, planes_.data(),
+                  planes_.size(), options_.compression_level) != Z_OK) {
+      throw std::runtime_error("Could not compress a frame of " + path_ + ".");
+    }
+    // Keep the raw planes when compression does not pay off
+    if (compressed_size < planes_.size()) {
+      header.flags |= kCompressedFlag;
+      stored = compressed_.data();
+      header.stored_size = compressed_size;
+    }
+  }
+#endif
+
+  IndexEntry entry = {};
+  entry.offset = (uint64_t)output_.tellp();
+  entry.step = frame.step;
+  entry.time = frame.time;
+  entry.keyframe = keyframe ? 1 : 0;
+
+  output_.write((const char*)&header, sizeof(header));
+  output_.write((const char*)stored, header.stored_size);
+  if (!output_) {
+    throw std::runtime_error("Could not write a frame of " + path_ + ".");
+  }
+  index_.push_back(entry);
+  std::swap(previous_values_, values_);
+}
+
+TrajectoryReader::TrajectoryReader(const string& path)
+    : path_(path), input_(path, std::ios::binary) {
+  if (!input_) {
+    throw std::runtime_error("Could not open " + path_ + ".");
+  }
+  input_.seekg(0, std::ios::end);
+  uint64_t file_size = (uint64_t)input_.tellg();
+  input_.seekg(0);
+
+  FileHeader header;
+  if (!input_.read((char*)&header, sizeof(header)) ||
+      std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0) {
+    throw std::runtime_error(path_ + " is not a trajectory.");
+  }
+  if (header.byte_order != kByteOrderMark) {
+    throw std::runtime_error(path_ +
+                             " was written on a machine of another byte "
+                             "order.");
+  }
+  if (header.version != kVersion || header.dimensions < 2 ||
+      header.dimensions > ParticleStore::kMaxDimensions) {
+    throw std::runtime_error(path_ + " has trajectory version " +
+                             std::to_string(header.version) + " with " +
+                             std::to_string(header.dimensions) +
+                             " dimensions, which cannot be read.");
+  }
+  position_quantum_ = header.position_quantum;
+  velocity_quantum_ = header.velocity_quantum;
+  dimensions_ = header.dimensions;
+  field_count_ = 2 * dimensions_;
+
+  // Use the frame index when the writer finished, and it fits the file
+  Footer footer = {};
+  if (file_size >= sizeof(header) + sizeof(footer)) {
+    input_.seekg(file_size - sizeof(footer));
+    input_.read((char*)&footer, sizeof(footer));
+  }
+  using IndexEntry = TrajectoryWriter::IndexEntry;
+  bool has_index =
+      std::memcmp(footer.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+      footer.index_offset >= sizeof(header) &&
+      footer.index_offset <= file_size - sizeof(footer) &&
+      (file_size - sizeof(footer) - footer.index_offset) / sizeof(IndexEntry) ==
+          footer.frame_count;
+  if (!has_index) {
+    ScanFrames(file_size);
+    return;
+  }
+
+  vector<IndexEntry> index(footer.frame_count);
+  input_.seekg(footer.index_offset);
+  input_.read((char*)index.data(), index.size() * sizeof(IndexEntry));
+  if (!input_) {
+    throw std::runtime_error("Could not read the frame index of " + path_ +
+                             ".");
+  }
+  for (const IndexEntry& entry : index) {
+    frames_.push_back({entry.offset, entry.keyframe != 0});
+  }
+}
+
+size_t TrajectoryReader::GetFrameCount() const {
+  return frames_.size();
+}
+
+size_t TrajectoryReader::GetDimensions() const {
+  return dimensions_;
+}
+
+void TrajectoryReader::ReadFrame(size_t frame_number, TrajectoryFrame& frame) {
+  if (frame_number >= frames_.size()) {
+    throw std::out_of_range("Frame " + std::to_string(frame_number) +
+                            " is past the end of " + path_ + ".");
+  }
+
+  // Find the keyframe the frame is built on
+  size_t keyframe = frame_number;
+  while (!frames_[keyframe].keyframe) {
+    if (keyframe == 0) {
+      throw std::runtime_error(path_ + " does not start with a keyframe.");
+    }
+    --keyframe;
+  }
+
+  // Continue from the frame decoded last when it is on the way
+  size_t first = keyframe;
+  if (decoded_frame_ >= (long long)keyframe &&
+      decoded_frame_ <= (long long)frame_number) {
+    first = (size_t)decoded_frame_ + 1;
+  }
+  for (size_t current = first; current <= frame_number; ++current) {
+    DecodeFrame(current);
+  }
+
+  size_t particle_count = values_.size() / field_count_;
+  frame.step = decoded_step_;
+  frame.time = decoded_time_;
+  for (size_t axis = dimensions_; axis < ParticleStore::kMaxDimensions;
+       ++axis) {
+    frame.positions[axis].clear();
+    frame.velocities[axis].clear();
+  }
+  for (size_t field = 0; field < field_count_; ++field) {
+    bool is_position = field < dimensions_;
+    vector<float>& destination =
+        is_position ? frame.positions[field]
+                    : frame.velocities[field - dimensions_];
+    double quantum = is_position ? position_quantum_ : velocity_quantum_;
+    const int32_t* source = values_.data() + field * particle_count;
+    destination.resize(particle_count);
+    for (size_t index = 0; index < particle_count; ++index) {
+      destination[index] = (float)(source[index] * quantum);
+    }
+  }
+}
+
+void TrajectoryReader::ScanFrames(uint64_t file_size) {
+  uint64_t offset = sizeof(FileHeader);
+  FrameHeader header;
+  while (offset + sizeof(header) <= file_size) {
+    input_.clear();
+    input_.seekg(offset);
+    if (!input_.read((char*)&header, sizeof(header)) ||
+        std::memcmp(header.magic, kFrameMagic, sizeof(kFrameMagic)) != 0 ||
+        header.stored_size > file_size - offset - sizeof(header)) {
+      break;
+    }
+    frames_.push_back({offset, (header.flags & kKeyframeFlag) != 0});
+    offset += sizeof(header) + header.stored_size;
+  }
+}
+
+void TrajectoryReader::DecodeFrame(size_t frame_number) {
+  FrameHeader header;
+  input_.clear();
+  input_.seekg(frames_[frame_number].offset);
+  if (!input_.read((char*)&header, sizeof(header)) ||
+      std::memcmp(header.magic, kFrameMagic, sizeof(kFrameMagic)) != 0) {
+    throw std::runtime_error("Could not read frame " +
+                             std::to_string(frame_number) + " of " + path_ +
+                             ".");
+  }
+
+  size_t value_count = field_count_ * header.particle_count;
+  bool keyframe = (header.flags & kKeyframeFlag) != 0;
+  if (header.raw_size != value_count * sizeof(uint32_t) ||
+      (!keyframe && values_.size() != value_count)) {
+    throw std::runtime_error("Frame " + std::to_string(frame_number) + " of " +
+                             path_ + " is corrupt.");
+  }
+
+  stored_.resize(header.stored_size);
+  if (!input_.read((char*)stored_.data(), stored_.size())) {
+    throw std::runtime_error("Could not read frame " +
+                             std::to_string(frame_number) + " of " + path_ +
+                             ".");
+  }
+  if (header.flags & kCompressedFlag) {
+#ifdef IDEALGAS_HAVE_ZLIB
+    planes_.resize(header.raw_size);
+    uLongf raw_size = planes_.size();
+    if (uncompress(planes_.data(), &raw_size, stored_.data(),
+                   stored_.size()) != Z_OK ||
+        raw_size != planes_.size()) {
+      throw std::runtime_error("Could not decompress frame " +
+                               std::to_string(frame_number) + " of " + path_ +
+                               ".");
+    }
+#else
+    throw std::runtime_error(path_ +
+                             " is compressed, but zlib was not available "
+                             "when this program was built.");
+#endif
+  } else {
+    if (header.stored_size != header.raw_size) {
+      throw std::runtime_error("Frame " + std::to_string(frame_number) +
+                               " of " + path_ + " is corrupt.");
+    }
+    std::swap(planes_, stored_);
+  }
+
+  if (keyframe) {
+    values_.assign(value_count, 0);
+  }
+  for (size_t index = 0; index < value_count; ++index) {
+    uint32_t code = 0;
+    for (size_t byte = 0; byte < sizeof(uint32_t); ++byte) {
+      code |= (uint32_t)planes_[byte * value_count + index] << (8 * byte);
+    }
+    values_[index] = (int32_t)((uint32_t)values_[index] + UnZigZag(code));
+  }
+
+  decoded_frame_ = frame_number;
+  decoded_step_ = header.step;
+  decoded_time_ = header.time;
+}
+
+}  // namespace idealgas
@@ -0,0 +1,432 @@
+#include "core/wall_kernel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define IDEALGAS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each vector function for its own instruction set so
+// that the rest of the build does not require it. MSVC allows the intrinsics
+// anywhere.
+#if defined(IDEALGAS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define IDEALGAS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define IDEALGAS_TARGET(isa)
+#endif
+
+using idealgas::BoundaryMode;
+using idealgas::SimdLevel;
+using std::string;
+
+namespace idealgas {
+
+namespace {
+
+/**
+ * @brief Wraps a position that left a periodic axis by at most one length
+ * back into [0, length).
+ *
+ */
+template <typename Scalar>
+inline Scalar Wrap(Scalar position, Scalar length) {
+  if (position < 0) {
+    position += length;
+  }
+  if (position >= length) {
+    position -= length;
+  }
+  return position;
+}
+
+/**
+ * @brief The arrays and bounds of each axis a kernel moves particles along.
+ *
+ * @tparam Dims the number of axes, so that the loops over them unroll
+ * @tparam Position the type of the positions and lengths
+ * @tparam Velocity the type of the velocities
+ */
+template <size_t Dims, typename Position = float, typename Velocity = float>
+struct KernelAxes {
+  // The positions along each axis, updated in place
+  array<Position*, Dims> positions;
+  // The velocities along each axis, updated in place
+  array<Velocity*, Dims> velocities;
+  // The length of the container along each axis
+  array<Position, Dims> lengths;
+  // Whether each axis wraps around instead of reflecting
+  array<bool, Dims> periodic;
+};
+
+/**
+ * @brief Reflects and integrates particles one at a time, at the precision
+ * of their positions.
+ *
+ */
+template <size_t Dims, typename Position, typename Velocity>
+void ReflectAndIntegrateScalar(const KernelAxes<Dims, Position, Velocity>& axes,
+                               const float* radii, size_t begin, size_t end,
+                               Position time_step, uint8_t* wall_hits) {
+  for (size_t index = begin; index < end; ++index) {
+    Position radius = radii[index];
+    uint8_t hits = 0;
+    // Each axis reflects and moves on its own
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      Position& position = axes.positions[axis][index];
+      Velocity& velocity = axes.velocities[axis][index];
+      bool hit = !axes.periodic[axis] &&
+                 ((position <= radius && velocity < 0) ||
+                  (position >= axes.lengths[axis] - radius && velocity > 0));
+      if (hit) {
+        velocity = -velocity;
+        hits |= (uint8_t)(kWallHitX << axis);
+      }
+
+      position += time_step * velocity;
+      if (axes.periodic[axis]) {
+        position = Wrap(position, axes.lengths[axis]);
+      }
+    }
+    wall_hits[index] = hits;
+  }
+}
+
+#if defined(IDEALGAS_X86)
+
+/**
+ * @brief Wraps four positions as Wrap does.
+ *
+ */
+IDEALGAS_TARGET("sse2")
+inline __m128 WrapSse2(__m128 positions, __m128 lengths) {
+  // Selecting rather than adding zero keeps negative zero, as Wrap does
+  __m128 below = _mm_cmplt_ps(positions, _mm_setzero_ps());
+  positions = _mm_or_ps(_mm_and_ps(below, _mm_add_ps(positions, lengths)),
+                        _mm_andnot_ps(below, positions));
+  __m128 above = _mm_cmpge_ps(positions, lengths);
+  return _mm_or_ps(_mm_and_ps(above, _mm_sub_ps(positions, lengths)),
+                   _mm_andnot_ps(above, positions));
+}
+
+/**
+ * @brief Reflects and integrates particles four at a time with SSE2.
+ *
+ */
+template <size_t Dims>
+IDEALGAS_TARGET("sse2")
+void ReflectAndIntegrateSse2(const KernelAxes<Dims>& axes, const float* radii,
+                             size_t count, float time_step,
+                             uint8_t* wall_hits) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 time_steps = _mm_set1_ps(time_step);
+  __m128 lengths[Dims];
+  __m128 reflects[Dims];
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    lengths[axis] = _mm_set1_ps(axes.lengths[axis]);
+    reflects[axis] = axes.periodic[axis] ? zero : all;
+  }
+
+  size_t index = 0;
+  for (; index + 4 <= count; index += 4) {
+    __m128 r = _mm_loadu_ps(radii + index);
+    int hits[Dims];
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      float* positions = axes.positions[axis] + index;
+      float* velocities = axes.velocities[axis] + index;
+      __m128 p = _mm_loadu_ps(positions);
+      __m128 v = _mm_loadu_ps(velocities);
+
+      // The same four comparisons as the scalar checks, as lane masks
+      __m128 hit = _mm_or_ps(
+          _mm_and_ps(_mm_cmple_ps(p, r), _mm_cmplt_ps(v, zero)),
+          _mm_and_ps(_mm_cmpge_ps(p, _mm_sub_ps(lengths[axis], r)),
+                     _mm_cmpgt_ps(v, zero)));
+      hit = _mm_and_ps(hit, reflects[axis]);
+
+      // Flipping the sign bit is exactly scalar negation
+      v = _mm_xor_ps(v, _mm_and_ps(hit, sign));
+      _mm_storeu_ps(velocities, v);
+      p = _mm_add_ps(p, _mm_mul_ps(time_steps, v));
+      _mm_storeu_ps(positions,
+                    axes.periodic[axis] ? WrapSse2(p, lengths[axis]) : p);
+      hits[axis] = _mm_movemask_ps(hit);
+    }
+
+    for (size_t lane = 0; lane < 4; ++lane) {
+      uint8_t lane_hits = 0;
+      for (size_t axis = 0; axis < Dims; ++axis) {
+        lane_hits |= (uint8_t)(((hits[axis] >> lane) & 1) << axis);
+      }
+      wall_hits[index + lane] = lane_hits;
+    }
+  }
+
+  ReflectAndIntegrateScalar(axes, radii, index, count, time_step, wall_hits);
+}
+
+/**
+ * @brief Wraps eight positions as Wrap does.
+ *
+ */
+IDEALGAS_TARGET("avx2")
+inline __m256 WrapAvx2(__m256 positions, __m256 lengths) {
+  positions = _mm256_blendv_ps(
+      positions, _mm256_add_ps(positions, lengths),
+      _mm256_cmp_ps(positions, _mm256_setzero_ps(), _CMP_LT_OQ));
+  return _mm256_blendv_ps(positions, _mm256_sub_ps(positions, lengths),
+                          _mm256_cmp_ps(positions, lengths, _CMP_GE_OQ));
+}
+
+/**
+ * @brief Reflects and integrates particles eight at a time with AVX2.
+ *
+ */
+template <size_t Dims>
+IDEALGAS_TARGET("avx2")
+void ReflectAndIntegrateAvx2(const KernelAxes<Dims>& axes, const float* radii,
+                             size_t count, float time_step,
+                             uint8_t* wall_hits) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  const __m256 time_steps = _mm256_set1_ps(time_step);
+  __m256 lengths[Dims];
+  __m256 reflects[Dims];
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    lengths[axis] = _mm256_set1_ps(axes.lengths[axis]);
+    reflects[axis] = axes.periodic[axis] ? zero : all;
+  }
+
+  size_t index = 0;
+  for (; index + 8 <= count; index += 8) {
+    __m256 r = _mm256_loadu_ps(radii + index);
+    int hits[Dims];
+    for (size_t axis = 0; axis < Dims; ++axis) {
+      float* positions = axes.positions[axis] + index;
+      float* velocities = axes.velocities[axis] + index;
+      __m256 p = _mm256_loadu_ps(positions);
+      __m256 v = _mm256_loadu_ps(velocities);
+
+      // Ordered comparisons are false for NaN, like the scalar operators
+      __m256 hit = _mm256_or_ps(
+          _mm256_and_ps(_mm256_cmp_ps(p, r, _CMP_LE_OQ),
+                        _mm256_cmp_ps(v, zero, _CMP_LT_OQ)),
+          _mm256_and_ps(
+              _mm256_cmp_ps(p, _mm256_sub_ps(lengths[axis], r), _CMP_GE_OQ),
+              _mm256_cmp_ps(v, zero, _CMP_GT_OQ)));
+      hit = _mm256_and_ps(hit, reflects[axis]);
+      v = _mm256_xor_ps(v, _mm256_and_ps(hit, sign));
+
+      // A separate multiply and add, never fused, to round like the scalar
+      // code
+      _mm256_storeu_ps(velocities, v);
+      p = _mm256_add_ps(p, _mm256_mul_ps(time_steps, v));
+      _mm256_storeu_ps(positions,
+                       axes.periodic[axis] ? WrapAvx2(p, lengths[axis]) : p);
+      hits[axis] = _mm256_movemask_ps(hit);
+    }
+
+    for (size_t lane = 0; lane < 8; ++lane) {
+      uint8_t lane_hits = 0;
+      for (size_t axis = 0; axis < Dims; ++axis) {
+        lane_hits |= (uint8_t)(((hits[axis] >> lane) & 1) << axis);
+      }
+      wall_hits[index + lane] = lane_hits;
+    }
+  }
+
+  ReflectAndIntegrateScalar(axes, radii, index, count, time_step, wall_hits);
+}
+
+#endif
+
+/**
+ * @brief Runs the kernel of an instruction set over the first Dims axes.
+ *
+ */
+template <size_t Dims>
+void ReflectAndIntegrateAxes(
+    SimdLevel level, const array<float*, kMaxKernelAxes>& positions,
+    const array<float*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    float time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  KernelAxes<Dims> axes;
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    axes.positions[axis] = positions[axis];
+    axes.velocities[axis] = velocities[axis];
+    axes.lengths[axis] = lengths[axis];
+    axes.periodic[axis] = boundaries[axis] == BoundaryMode::kPeriodic;
+  }
+
+  switch (level) {
+#if defined(IDEALGAS_X86)
+    case SimdLevel::kAvx2:
+      ReflectAndIntegrateAvx2(axes, radii, count, time_step, wall_hits);
+      return;
+    case SimdLevel::kSse2:
+      ReflectAndIntegrateSse2(axes, radii, count, time_step, wall_hits);
+      return;
+#endif
+    default:
+      ReflectAndIntegrateScalar(axes, radii, 0, count, time_step, wall_hits);
+  }
+}
+
+/**
+ * @brief Runs the scalar kernel over the first Dims axes of positions kept
+ * in double precision.
+ *
+ */
+template <size_t Dims, typename Velocity>
+void ReflectAndIntegratePrecise(
+    const array<double*, kMaxKernelAxes>& positions,
+    const array<Velocity*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  KernelAxes<Dims, double, Velocity> axes;
+  for (size_t axis = 0; axis < Dims; ++axis) {
+    axes.positions[axis] = positions[axis];
+    axes.velocities[axis] = velocities[axis];
+    axes.lengths[axis] = lengths[axis];
+    axes.periodic[axis] = boundaries[axis] == BoundaryMode::kPeriodic;
+  }
+  ReflectAndIntegrateScalar(axes, radii, 0, count, time_step, wall_hits);
+}
+
+/**
+ * @brief Picks the precise kernel for a number of axes.
+ *
+ */
+template <typename Velocity>
+void ReflectAndIntegratePreciseAxes(
+    size_t dimensions, const array<double*, kMaxKernelAxes>& positions,
+    const array<Velocity*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  switch (dimensions) {
+    case 2:
+      ReflectAndIntegratePrecise<2>(positions, velocities, radii, count,
+                                    lengths, time_step, wall_hits, boundaries);
+      return;
+    case 3:
+      ReflectAndIntegratePrecise<3>(positions, velocities, radii, count,
+                                    lengths, time_step, wall_hits, boundaries);
+      return;
+    default:
+      throw std::invalid_argument("The wall kernel moves 2 or 3 axes, not " +
+                                  std::to_string(dimensions) + ".");
+  }
+}
+
+}  // namespace
+
+SimdLevel GetSupportedSimdLevel() {
+#if defined(IDEALGAS_X86) && (defined(__GNUC__) || defined(__clang__))
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::kAvx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SimdLevel::kSse2;
+  }
+#elif defined(IDEALGAS_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+  __cpuid(info, 1);
+  bool has_sse2 = (info[3] & (1 << 26)) != 0;
+  // AVX also needs the operating system to save the wide registers
+  bool has_avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 &&
+                 (_xgetbv(0) & 0x6) == 0x6;
+  if (has_avx && max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 5)) != 0) {
+      return SimdLevel::kAvx2;
+    }
+  }
+  if (has_sse2) {
+    return SimdLevel::kSse2;
+  }
+#endif
+  return SimdLevel::kScalar;
+}
+
+string GetSimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kAvx2:
+      return "avx2";
+    case SimdLevel::kSse2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+void ReflectAndIntegrate(SimdLevel level, float* x, float* y,
+                         float* velocity_x, float* velocity_y,
+                         const float* radii, size_t count, float width,
+                         float height, float time_step, uint8_t* wall_hits,
+                         const array<BoundaryMode, 2>& boundaries) {
+  ReflectAndIntegrateAxes<2>(level, {x, y, nullptr},
+                             {velocity_x, velocity_y, nullptr}, radii, count,
+                             {width, height, 0}, time_step, wall_hits,
+                             {boundaries[0], boundaries[1]});
+}
+
+void ReflectAndIntegrate(
+    SimdLevel level, size_t dimensions,
+    const array<float*, kMaxKernelAxes>& positions,
+    const array<float*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    float time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  switch (dimensions) {
+    case 2:
+      ReflectAndIntegrateAxes<2>(level, positions, velocities, radii, count,
+                                 lengths, time_step, wall_hits, boundaries);
+      return;
+    case 3:
+      ReflectAndIntegrateAxes<3>(level, positions, velocities, radii, count,
+                                 lengths, time_step, wall_hits, boundaries);
+      return;
+    default:
+      throw std::invalid_argument("The wall kernel moves 2 or 3 axes, not " +
+                                  std::to_string(dimensions) + ".");
+  }
+}
+
+void ReflectAndIntegrate(
+    size_t dimensions, const array<double*, kMaxKernelAxes>& positions,
+    const array<float*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  ReflectAndIntegratePreciseAxes(dimensions, positions, velocities, radii,
+                                 count, lengths, time_step, wall_hits,
+                                 boundaries);
+}
+
+void ReflectAndIntegrate(
+    size_t dimensions, const array<double*, kMaxKernelAxes>& positions,
+    const array<double*, kMaxKernelAxes>& velocities, const float* radii,
+    size_t count, const array<float, kMaxKernelAxes>& lengths,
+    double time_step, uint8_t* wall_hits,
+    const array<BoundaryMode, kMaxKernelAxes>& boundaries) {
+  ReflectAndIntegratePreciseAxes(dimensions, positions, velocities, radii,
+                                 count, lengths, time_step, wall_hits,
+                                 boundaries);
+}
+
+}  // namespace idealgas
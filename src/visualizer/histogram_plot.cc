@@ -0,0 +1,154 @@
+#include "visualizer/histogram_plot.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cinder/gl/gl.h"
+#include "core/simulation_thread.h"
+
+using ci::Font;
+using ci::Rectf;
+using ci::gl::color;
+using ci::gl::drawSolidRoundedRect;
+using ci::gl::drawString;
+using ci::gl::drawStringCentered;
+using ci::gl::drawStringRight;
+using ci::gl::drawStrokedRect;
+using glm::vec2;
+using idealgas::HistogramPlot;
+using idealgas::HistogramSnapshot;
+using std::sort;
+using std::to_string;
+using std::vector;
+
+namespace idealgas {
+
+HistogramPlot::HistogramPlot(size_t bin_count, size_t width, size_t height,
+                             const vec2& offset, size_t stroke,
+                             const ci::ColorT<float>& stroke_color,
+                             const ci::ColorT<float>& bar_color,
+                             const ci::ColorT<float>& text_color,
+                             const string& font)
+    // Uses an initializer list to set all the private variables
+    : width_(width),
+      height_(height),
+      offset_(offset),
+      stroke_(stroke),
+      stroke_color_(stroke_color),
+      bar_color_(bar_color),
+      text_color_(text_color),
+      font_family_(font) {
+  graph_offset_ = offset_ + vec2(stroke_ / 2, 0) + vec2(width_ / 10, 0);
+  graph_width_ = width_ * 8.5 / 10;
+  bin_width_ = graph_width_ / bin_count;
+  title_font_ = Font(font_family_, height_ / 20);
+  label_font_ = Font(font_family_, height_ / 25);
+}
+
+void HistogramPlot::Draw(const HistogramSnapshot& histogram) {
+  // There is nothing to plot before the first value
+  if (histogram.bin_heights.empty()) {
+    return;
+  }
+
+  // The labels sort the heights, so the plot works on its own copies
+  bin_heights_ = histogram.bin_heights;
+  bin_cutoffs_ = histogram.bin_cutoffs;
+
+  // Calls each heartbeat function in order to draw the graph
+  DrawFrame();
+
+  DrawBins();
+
+  DrawText(histogram.title);
+}
+
+void HistogramPlot::DrawFrame() {
+  vec2 top_left = offset_;
+
+  vec2 bottom_right = offset_ + vec2(width_, height_);
+
+  Rectf bounding_box(top_left, bottom_right);
+
+  color(stroke_color_);
+
+  // Draw the box frame of each histogram
+  drawStrokedRect(bounding_box, stroke_);
+}
+
+void HistogramPlot::DrawText(const string& title) {
+  // The "magic numbers" in the following function are necessary, as setting
+  // private variables for all of them would be poor design.
+
+  // Draws the title on the bottom middle
+  drawStringCentered(title,
+                     offset_ + vec2(width_ / 2, height_ * 9.3 / 10),
+                     text_color_, title_font_);
+
+  // Sorts bins by heights to label axes
+  sort(bin_heights_.begin(), bin_heights_.end());
+
+
+  // Draws the y axis labels
+  drawString(to_string((int)bin_heights_.front()),
+             graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.8),
+             text_color_, label_font_);
+  drawString(to_string((int)bin_heights_.back()),
+             graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.05),
+             text_color_, label_font_);
+  drawString(
+      to_string(((int)bin_heights_.front() + (int)bin_heights_.back()) / 2),
+      graph_offset_ + vec2(-(int)stroke_ * 2, height_ * 0.45), text_color_,
+      label_font_);
+
+  // Draws the x axis labels
+  drawString(to_string(bin_cutoffs_.front()),
+             graph_offset_ + vec2(stroke_, height_ * 0.85), text_color_,
+             label_font_);
+
+  drawString(to_string((bin_cutoffs_.front() + bin_cutoffs_.back()) / 2),
+             graph_offset_ + vec2(graph_width_ / 2, height_ * 8.5 / 10),
+             text_color_, label_font_);
+
+  drawStringRight(to_string(bin_cutoffs_.back()),
+                  graph_offset_ + vec2(graph_width_, height_ * 0.85),
+                  text_color_, label_font_);
+
+  // Draw the axis label
+  drawStringCentered("x = Speed, y = Frequency",
+                     graph_offset_ + vec2(graph_width_ / 2, height_ * 0.025),
+                     text_color_, label_font_);
+}
+
+void HistogramPlot::DrawBins() {
+  // The "magic numbers" in the following function are necessary, as setting
+  // private variables for all of them would be poor design.
+  size_t max_bar_height = height_ * 8 / 10;
+  color(bar_color_);
+
+  for (size_t bin = 0; bin < bin_heights_.size(); ++bin) {
+    size_t proportional_height = bin_heights_.at(bin) * max_bar_height;
+
+    vec2 top_left;
+
+    // If statement ensures that low-level bar does not go "negative"
+    if (max_bar_height + stroke_ <
+        max_bar_height - proportional_height + stroke_ * 3) {
+      top_left = graph_offset_ +
+                 vec2(bin * bin_width_, max_bar_height - proportional_height);
+    } else {
+      top_left = graph_offset_ +
+                 vec2(bin * bin_width_,
+                      max_bar_height - proportional_height + stroke_ * 3);
+    }
+
+    vec2 bottom_right =
+        graph_offset_ + vec2((bin + 1) * bin_width_, max_bar_height + stroke_);
+
+    Rectf bounding_box(top_left, bottom_right);
+    drawSolidRoundedRect(bounding_box, 1);
+  }
+}
+
+}  // namespace idealgas
@@ -1,11 +1,19 @@
 #include "visualizer/ideal_gas_visualizer.h"
 
-#include "core/histogram.h"
-#include "core/particle.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/config.h"
 #include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "visualizer/histogram_plot.h"
 
 using ci::Color;
-using ci::ColorT;
 using ci::Font;
 using ci::Rectf;
 using ci::app::setFullScreen;
@@ -14,40 +22,48 @@ using ci::app::setWindowSize;
 using ci::gl::clear;
 using ci::gl::color;
 using ci::gl::drawSolidCircle;
+using ci::gl::drawString;
 using ci::gl::drawStringCentered;
 using ci::gl::drawStrokedRect;
 using glm::vec2;
-using idealgas::Histogram;
-using idealgas::Particle;
+using idealgas::HistogramPlot;
+using idealgas::Observables;
 using idealgas::ParticleContainer;
-using std::stoi;
-using std::stoull;
-using std::uint32_t;
-using std::unordered_map;
+using idealgas::ParticleStore;
+using idealgas::ParticleView;
+using idealgas::SimulationConfig;
+using idealgas::SimulationSnapshot;
+using idealgas::SimulationThread;
+using std::to_string;
 
 namespace idealgas {
 
 IdealGasVisualizer::IdealGasVisualizer() {
-  // Gets map of configuration variables read from JSON
-  unordered_map<string, string> config = container_.Configure(config_path_);
-  window_width_ = stoi(config["window width"]);
-  window_height_ = stoi(config["window height"]);
-  margin_ = stoi(config["margin"]);
-  stroke_ = stoi(config["stroke"]);
+  // Gets the configuration read from JSON
+  SimulationConfig config = container_.Configure(config_path_);
+  window_width_ = config.window_width;
+  window_height_ = config.window_height;
+  margin_ = config.margin;
+  stroke_ = config.stroke;
 
   // Set box width and height to appropriate margins (not a magic number)
-  container_width_ = stoi(config["container width"]);
-  container_height_ = stoi(config["container height"]);
-  histogram_bin_count_ = stoi(config["histogram bin count"]);
+  container_width_ = config.container_width;
+  container_height_ = config.container_height;
+  histogram_bin_count_ = config.histogram_bin_count;
+  histogram_window_steps_ = config.histogram_window_steps;
+  steps_per_second_ = config.steps_per_second;
 
   // Set draw colors
-  background_color_ =
-      ColorT<float>().hex(uint32_t(stoull(config["background color"], 0, 16)));
-  stroke_color_ =
-      ColorT<float>().hex(uint32_t(stoull(config["stroke color"], 0, 16)));
-  text_color_ =
-      ColorT<float>().hex(uint32_t(stoull(config["text color"], 0, 16)));
-  font_family_ = config["font"];
+  background_color_ = Color::hex(config.background_color);
+  stroke_color_ = Color::hex(config.stroke_color);
+  text_color_ = Color::hex(config.text_color);
+  font_family_ = config.font;
+
+  // Only save checkpoints when there is somewhere to save them
+  if (!config.checkpoint_path.empty()) {
+    checkpoint_timer_ = CheckpointTimer(config.checkpoint_path,
+                                        config.checkpoint_interval_seconds);
+  }
 }
 
 void IdealGasVisualizer::setup() {
@@ -57,37 +73,50 @@ void IdealGasVisualizer::setup() {
 
   size_t num_particle_types = container_.GetParticleNames().size();
   for (size_t index = 0; index < num_particle_types; ++index) {
-    string name = container_.GetParticleNames().at(index);
-
     // Create histogram object for each type of particle present
-    Histogram hist(
-        name, histogram_bin_count_, margin_ * 3,
+    histograms_.emplace_back(
+        histogram_bin_count_, margin_ * 3,
         container_height_ / num_particle_types,
         vec2(container_width_ + 2 * margin_,
              margin_ + index * (container_height_ / num_particle_types)),
         stroke_, stroke_color_, text_color_, text_color_, font_family_);
-
-    // Insert into list of histograms
-    histograms_.insert({{name, hist}});
   }
+
+  // From here on the container belongs to the simulation thread
+  simulation_ = std::make_unique<SimulationThread>(
+      container_, histogram_bin_count_, histogram_window_steps_,
+      steps_per_second_);
+  simulation_->Start();
 }
 
 void IdealGasVisualizer::mouseDown(MouseEvent event) {
 }
 
 void IdealGasVisualizer::update() {
-  container_.Increment();
-  UpdateHistograms();
+  simulation_->Post([this](ParticleContainer& container) {
+    // A failed checkpoint should not stop the simulation on screen
+    try {
+      checkpoint_timer_.Update(container);
+    } catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+    }
+  });
 }
 
 void IdealGasVisualizer::draw() {
+  const SimulationSnapshot& snapshot = simulation_->AcquireSnapshot();
+
   DrawContainer();
 
   DrawMessage();
 
-  DrawParticles();
+  DrawParticles(snapshot);
+
+  DrawHistograms(snapshot);
 
-  DrawHistograms();
+  if (show_observables_) {
+    DrawObservables(snapshot);
+  }
 }
 
 void IdealGasVisualizer::keyDown(KeyEvent event) {
@@ -95,132 +124,101 @@ void IdealGasVisualizer::keyDown(KeyEvent event) {
   // Increase or decrease size for up and down
   switch (event.getCode()) {
     case KeyEvent::KEY_DOWN: {
-      for (auto& particle : container_.GetParticles()) {
-        particle.SetRadius(particle.GetRadius() * 0.9);
-      }
+      simulation_->Post([](ParticleContainer& container) {
+        for (ParticleView particle : container.GetParticles()) {
+          particle.SetRadius(particle.GetRadius() * 0.9);
+        }
+      });
       break;
     }
     case KeyEvent::KEY_UP: {
-      for (auto& particle : container_.GetParticles()) {
-        particle.SetRadius(particle.GetRadius() * 1.1);
-      }
+      simulation_->Post([](ParticleContainer& container) {
+        for (ParticleView particle : container.GetParticles()) {
+          particle.SetRadius(particle.GetRadius() * 1.1);
+        }
+      });
       break;
     }
     case KeyEvent::KEY_LEFT: {
-      for (auto& particle : container_.GetParticles()) {
-        particle.SetVelocity(particle.GetVelocity() * vec2(0.90, 0.90));
-      }
-
+      simulation_->Post([](ParticleContainer& container) {
+        for (ParticleView particle : container.GetParticles()) {
+          particle.SetVelocity(particle.GetVelocity() * vec2(0.90, 0.90));
+        }
+      });
       break;
     }
     case KeyEvent::KEY_RIGHT: {
-      for (auto& particle : container_.GetParticles()) {
-        particle.SetVelocity(particle.GetVelocity() * vec2(1.1, 1.1));
-      }
-      break;
-    }
-    case KeyEvent::KEY_p: {
-      if (container_.GetTimeStep() > 0) {
-        container_.SetTimeStep(0);
-      } else {
-        container_.SetTimeStep(1);
-      }
-      break;
-    }
-    case KeyEvent::KEY_1: {
-      if (container_.GetParticleNames().size() < 1) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(0);
-      HideParticles(name);
-      break;
-    }
-    case KeyEvent::KEY_2: {
-      if (container_.GetParticleNames().size() < 2) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(1);
-      HideParticles(name);
+      simulation_->Post([](ParticleContainer& container) {
+        for (ParticleView particle : container.GetParticles()) {
+          particle.SetVelocity(particle.GetVelocity() * vec2(1.1, 1.1));
+        }
+      });
       break;
     }
-    case KeyEvent::KEY_3: {
-      if (container_.GetParticleNames().size() < 3) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(2);
-      HideParticles(name);
-      break;
-    }
-        case KeyEvent::KEY_4: {
-      if (container_.GetParticleNames().size() < 4) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(3);
-      HideParticles(name);
-      break;
-    }
-        case KeyEvent::KEY_5: {
-      if (container_.GetParticleNames().size() < 5) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(4);
-      HideParticles(name);
-      break;
-    }
-        case KeyEvent::KEY_6: {
-      if (container_.GetParticleNames().size() < 6) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(5);
-      HideParticles(name);
-      break;
-    }
-    case KeyEvent::KEY_7: {
-      if (container_.GetParticleNames().size() < 7) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(6);
-      HideParticles(name);
+    case KeyEvent::KEY_o: {
+      show_observables_ = !show_observables_;
       break;
     }
-    case KeyEvent::KEY_8: {
-      if (container_.GetParticleNames().size() < 8) {
-        break;
-      }
-      string name = container_.GetParticleNames().at(7);
-      HideParticles(name);
+    case KeyEvent::KEY_p: {
+      simulation_->Post([](ParticleContainer& container) {
+        if (container.GetTimeStep() > 0) {
+          container.SetTimeStep(0);
+        } else {
+          container.SetTimeStep(1);
+        }
+      });
       break;
     }
+    case KeyEvent::KEY_1:
+    case KeyEvent::KEY_2:
+    case KeyEvent::KEY_3:
+    case KeyEvent::KEY_4:
+    case KeyEvent::KEY_5:
+    case KeyEvent::KEY_6:
+    case KeyEvent::KEY_7:
+    case KeyEvent::KEY_8:
     case KeyEvent::KEY_9: {
-      if (container_.GetParticleNames().size() < 9) {
-        break;
+      size_t index = event.getCode() - KeyEvent::KEY_1;
+      if (event.isShiftDown()) {
+        ToggleSpeciesEnabled(index);
+      } else {
+        IsolateSpecies(index);
       }
-      string name = container_.GetParticleNames().at(8);
-      HideParticles(name);
       break;
     }
     case KeyEvent::KEY_r: {
-      auto combined = hidden_particles_;
-      for (auto& particle : container_.GetParticles()) {
-        combined.push_back(particle);
-      }
-      container_.SetParticles(combined);
-      hidden_particles_.clear();
+      simulation_->Post([](ParticleContainer& container) {
+        size_t species_count = container.GetParticleNames().size();
+        for (size_t id = 0; id < species_count; ++id) {
+          container.SetSpeciesVisible((SpeciesId)id, true);
+          container.SetSpeciesEnabled((SpeciesId)id, true);
+        }
+      });
     }
   }
 }
 
-void IdealGasVisualizer::HideParticles(const string& name) {
-  vector<Particle> old_particles = container_.GetParticles();
-  vector<Particle> new_particles;
-  for (size_t index = 0; index < container_.GetParticles().size(); ++index) {
-    if (old_particles.at(index).GetName() == name) {
-      new_particles.push_back(old_particles.at(index));
-    } else {
-      hidden_particles_.push_back(old_particles.at(index));
+void IdealGasVisualizer::IsolateSpecies(size_t index) {
+  simulation_->Post([index](ParticleContainer& container) {
+    size_t species_count = container.GetParticleNames().size();
+    if (species_count <= index) {
+      return;
     }
-  }
-  container_.SetParticles(new_particles);
+    for (size_t id = 0; id < species_count; ++id) {
+      container.SetSpeciesVisible((SpeciesId)id, id == index);
+    }
+  });
+}
+
+void IdealGasVisualizer::ToggleSpeciesEnabled(size_t index) {
+  simulation_->Post([index](ParticleContainer& container) {
+    const ParticleStore& particles = std::as_const(container).GetParticles();
+    if (particles.GetSpeciesNames().size() <= index) {
+      return;
+    }
+    container.SetSpeciesEnabled(
+        (SpeciesId)index, !particles.IsSpeciesEnabled((SpeciesId)index));
+  });
 }
 
 void IdealGasVisualizer::DrawContainer() {
@@ -246,31 +244,52 @@ void IdealGasVisualizer::DrawMessage() {
       Font(font_family_, margin_ / 4));
 }
 
-void IdealGasVisualizer::DrawParticles() {
-  // Draw an appropriately colored circle for each particle
-  vector<Particle> particles = container_.GetParticles();
-  for (auto particle : particles) {
-    color(particle.GetColor());
-    drawSolidCircle(vec2(margin_, margin_) + particle.GetPosition(),
-                    particle.GetRadius());
+void IdealGasVisualizer::DrawParticles(const SimulationSnapshot& snapshot) {
+  // Draw an appropriately colored circle for each visible particle
+  for (const auto& range : snapshot.visible_ranges) {
+    for (size_t index = range.first; index < range.second; ++index) {
+      const ColorT<float>& particle_color = snapshot.colors[index];
+      color(particle_color.r, particle_color.g, particle_color.b);
+      drawSolidCircle(vec2(margin_ + snapshot.positions[0][index],
+                           margin_ + snapshot.positions[1][index]),
+                      snapshot.radii[index]);
+    }
   }
 }
 
-void IdealGasVisualizer::UpdateHistograms() {
-  // Updates the appropriate histogram with the velocity from its particle of
-  // matching type
-  for (auto& particle : container_.GetParticles()) {
-    string name = particle.GetName();
-    float speed = length(particle.GetVelocity());
-    histograms_.at(name).Update(speed);
+void IdealGasVisualizer::DrawObservables(const SimulationSnapshot& snapshot) {
+  const Observables& observables = snapshot.observables;
+  vector<string> lines = {
+      "time " + to_string(observables.time),
+      "kinetic energy " + to_string(observables.kinetic_energy),
+      "momentum (" + to_string(observables.momentum[0]) + ", " +
+          to_string(observables.momentum[1]) + ")",
+      "pressure " + to_string(observables.pressure)};
+  size_t count =
+      std::min(observables.temperatures.size(), snapshot.histograms.size());
+  for (size_t id = 0; id < count; ++id) {
+    lines.push_back(snapshot.histograms[id].title + " temperature " +
+                    to_string(observables.temperatures[id]));
+  }
+
+  // One line of text per line of margin / 4 pixels, inside the frame
+  Font font(font_family_, margin_ / 4);
+  for (size_t line = 0; line < lines.size(); ++line) {
+    drawString(lines[line],
+               vec2(margin_ + stroke_ * 2,
+                    margin_ + stroke_ * 2 + line * (margin_ / 4)),
+               text_color_, font);
   }
 }
 
-void IdealGasVisualizer::DrawHistograms() {
+void IdealGasVisualizer::DrawHistograms(const SimulationSnapshot& snapshot) {
   // Draws the histograms to the screen
-  for (auto& hist : histograms_) {
-    hist.second.Draw();
+  size_t count = std::min(histograms_.size(), snapshot.histograms.size());
+  for (size_t id = 0; id < count; ++id) {
+    if (snapshot.histograms[id].visible) {
+      histograms_[id].Draw(snapshot.histograms[id]);
+    }
   }
 }
 
-}  // namespace idealgas
\ No newline at end of file
+}  // namespace idealgas
@@ -0,0 +1,394 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/cell_grid.h"
+#include "core/color.h"
+#include "core/config.h"
+#include "core/hierarchical_grid.h"
+#include "core/neighbor_list.h"
+#include "core/particle.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using idealgas::ColorT;
+using idealgas::BoundaryMode;
+using idealgas::BroadphaseMode;
+using idealgas::CellGrid;
+using idealgas::HierarchicalGrid;
+using idealgas::NeighborList;
+using idealgas::NeighborListOptions;
+using idealgas::NeighborListStats;
+using idealgas::Particle;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::ThreadPool;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief Fills a container with particles of mixed radii, packed densely
+ * enough that many of them overlap.
+ *
+ * @param container the container to fill
+ * @param particle_count the number of particles to add
+ * @param seed the seed for the particle layout
+ */
+void FillContainer(ParticleContainer& container, size_t particle_count,
+                   unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> position_dist(0, 400);
+  std::uniform_real_distribution<float> velocity_dist(-2, 2);
+  std::uniform_real_distribution<float> radius_dist(1, 12);
+
+  for (size_t index = 0; index < particle_count; ++index) {
+    container.InitializeParticle(
+        Particle("Test", vec2(position_dist(gen), position_dist(gen)),
+                 vec2(velocity_dist(gen), velocity_dist(gen)), 1,
+                 radius_dist(gen), ColorT<float>().hex(0xFFFFFF)));
+  }
+}
+
+/**
+ * @brief Finds the overlapping pairs of a container with a given broadphase,
+ * sorted so that different broadphases can be compared.
+ *
+ * @param container the container to search
+ * @param mode the broadphase to search with
+ * @return the sorted vector of overlapping index pairs
+ */
+vector<pair<size_t, size_t>> SortedPairs(ParticleContainer& container,
+                                         BroadphaseMode mode) {
+  container.SetBroadphaseMode(mode);
+  vector<pair<size_t, size_t>> pairs = container.FindOverlappingPairs();
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+}  // namespace
+
+TEST_CASE("Grid broadphase", "[broadphase]") {
+  SECTION("Matches brute force on a dense mixed-radius layout") {
+    ParticleContainer container;
+    FillContainer(container, 600, 7);
+
+    auto grid_pairs = SortedPairs(container, BroadphaseMode::kGrid);
+    auto brute_force_pairs = SortedPairs(container, BroadphaseMode::kBruteForce);
+
+    REQUIRE(!brute_force_pairs.empty());
+    REQUIRE(grid_pairs == brute_force_pairs);
+  }
+
+  SECTION("Validated mode agrees with brute force over many steps") {
+    ParticleContainer container;
+    FillContainer(container, 300, 11);
+    container.SetBroadphaseMode(BroadphaseMode::kValidated);
+
+    for (size_t step = 0; step < 50; ++step) {
+      REQUIRE_NOTHROW(container.Increment());
+    }
+  }
+
+  SECTION("Finds touching pairs across a cell boundary") {
+    ParticleContainer container;
+    container.InitializeParticle(Particle("Test", vec2(0, 0), vec2(0, 0), 1, 1,
+                                          ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Test", vec2(2, 0), vec2(0, 0), 1, 1,
+                                          ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Test", vec2(3, 1.7), vec2(0, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+
+    auto pairs = SortedPairs(container, BroadphaseMode::kGrid);
+
+    REQUIRE(pairs == vector<pair<size_t, size_t>>{{0, 1}, {1, 2}});
+  }
+
+  SECTION("Finds pairs across periodic seams") {
+    std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+    json config;
+    input >> config;
+    config["container"]["boundaries"] = {{"x", "periodic"},
+                                         {"y", "periodic"}};
+    ParticleContainer container;
+    container.ConfigureFromJson(config);
+
+    // One pair straddles the left and right edges, one the top and bottom
+    vector<Particle> particles;
+    for (vec2 position : {vec2(1, 50), vec2(199, 50), vec2(100, 0.5),
+                          vec2(100, 99), vec2(100, 50)}) {
+      particles.emplace_back("Test", position, vec2(0, 0), 1, 2,
+                             ColorT<float>().hex(0xFFFFFF));
+    }
+    container.SetParticles(particles);
+    auto pairs = SortedPairs(container, BroadphaseMode::kGrid);
+    REQUIRE(pairs == vector<pair<size_t, size_t>>{{0, 1}, {2, 3}});
+
+    // A few cells along an axis, or just one when it is too short for three
+    for (float radius : {12.0f, 40.0f}) {
+      std::mt19937 gen(5);
+      std::uniform_real_distribution<float> x_dist(0, 200);
+      std::uniform_real_distribution<float> y_dist(0, 100);
+      std::uniform_real_distribution<float> velocity_dist(-3, 3);
+      particles.clear();
+      for (size_t index = 0; index < 60; ++index) {
+        particles.emplace_back("Test", vec2(x_dist(gen), y_dist(gen)),
+                               vec2(velocity_dist(gen), velocity_dist(gen)), 1,
+                               radius, ColorT<float>().hex(0xFFFFFF));
+      }
+      container.SetParticles(particles);
+      container.SetBroadphaseMode(BroadphaseMode::kValidated);
+      for (size_t step = 0; step < 30; ++step) {
+        REQUIRE_NOTHROW(container.Increment());
+      }
+    }
+  }
+
+  SECTION("Coarsens cells around distant outliers") {
+    ParticleStore particles;
+    particles.Add(Particle("Test", vec2(0, 0), vec2(0, 0), 1, 1,
+                                 ColorT<float>().hex(0xFFFFFF)));
+    particles.Add(Particle("Test", vec2(1e7, 1e7), vec2(0, 0), 1, 1,
+                                 ColorT<float>().hex(0xFFFFFF)));
+
+    CellGrid grid;
+    grid.Build(particles);
+    size_t pair_count = 0;
+    grid.ForEachCandidatePair([&pair_count](size_t, size_t) { ++pair_count; });
+
+    REQUIRE(grid.GetCellCount() <= 1024);
+    REQUIRE(grid.GetCellSize() >= 2);
+    REQUIRE(pair_count <= 1);
+  }
+}
+
+TEST_CASE("Hierarchical grid broadphase", "[broadphase][hierarchical]") {
+  // Many small particles among a few large ones, as in the visualizer's mix
+  // of radius 15 and 70
+  std::mt19937 gen(13);
+  std::uniform_real_distribution<float> position_dist(0, 400);
+  std::uniform_real_distribution<float> velocity_dist(-2, 2);
+  vector<Particle> particles;
+  for (size_t index = 0; index < 500; ++index) {
+    float radius = index % 50 == 0 ? 60 : index % 5 == 0 ? 12 : 2;
+    particles.emplace_back("Test", vec2(position_dist(gen), position_dist(gen)),
+                           vec2(velocity_dist(gen), velocity_dist(gen)), 1,
+                           radius, ColorT<float>().hex(0xFFFFFF));
+  }
+
+  SECTION("Splits radii into levels with cells sized for each") {
+    ParticleStore store;
+    for (const Particle& particle : particles) {
+      store.Add(particle);
+    }
+    HierarchicalGrid grid;
+    grid.Build(store, {0, 0, 0});
+    REQUIRE(grid.GetLevelCount() == 3);
+    // The smallest particles are numerous enough for their cells to coarsen
+    REQUIRE(grid.GetLevel(0).GetCellSize() < 24);
+    REQUIRE(grid.GetLevel(1).GetCellSize() == 24);
+    REQUIRE(grid.GetLevel(2).GetCellSize() == 120);
+  }
+
+  SECTION("Matches brute force within and across levels, without duplicates") {
+    ParticleContainer container;
+    container.SetParticles(particles);
+    auto hierarchical_pairs =
+        SortedPairs(container, BroadphaseMode::kHierarchicalGrid);
+    auto brute_force_pairs = SortedPairs(container, BroadphaseMode::kBruteForce);
+    REQUIRE(!brute_force_pairs.empty());
+    REQUIRE(hierarchical_pairs == brute_force_pairs);
+  }
+
+  SECTION("Matches brute force across periodic seams and in three dimensions") {
+    std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+    json config;
+    input >> config;
+    config["container"]["boundaries"] = {{"x", "periodic"},
+                                         {"y", "periodic"}};
+    config["container"]["dimensions"] = 3;
+    ParticleContainer container;
+    container.ConfigureFromJson(config);
+    std::uniform_real_distribution<float> z_dist(0, 100);
+    for (Particle& particle : particles) {
+      vec2 position = particle.GetPosition();
+      particle.SetPosition(
+          vec2(std::fmod(position.x, 200.0f), std::fmod(position.y, 100.0f)));
+    }
+    container.SetParticles(particles);
+    for (float& z : container.GetParticles().GetPositions(2)) {
+      z = z_dist(gen);
+    }
+    for (size_t step = 0; step < 10; ++step) {
+      auto hierarchical_pairs =
+          SortedPairs(container, BroadphaseMode::kHierarchicalGrid);
+      auto brute_force_pairs =
+          SortedPairs(container, BroadphaseMode::kBruteForce);
+      REQUIRE(hierarchical_pairs == brute_force_pairs);
+      container.SetBroadphaseMode(BroadphaseMode::kHierarchicalGrid);
+      container.Increment();
+    }
+  }
+
+  SECTION("Threads resolve the same collisions as one thread") {
+    ParticleContainer serial;
+    serial.SetParticles(particles);
+    serial.SetBroadphaseMode(BroadphaseMode::kHierarchicalGrid);
+    ParticleContainer parallel;
+    parallel.SetParticles(particles);
+    parallel.SetBroadphaseMode(BroadphaseMode::kHierarchicalGrid);
+    parallel.SetThreadCount(4);
+    for (size_t step = 0; step < 20; ++step) {
+      serial.Increment();
+      parallel.Increment();
+    }
+    REQUIRE(parallel.GetParticles().GetVelocities(0) ==
+            serial.GetParticles().GetVelocities(0));
+    REQUIRE(parallel.GetParticles().GetPositions(1) ==
+            serial.GetParticles().GetPositions(1));
+  }
+}
+
+TEST_CASE("Neighbor list", "[broadphase][neighbor list]") {
+  const float skin = 4;
+
+  SECTION("Holds every touching pair until a particle drifts half the skin") {
+    ParticleContainer container;
+    FillContainer(container, 400, 17);
+    ParticleStore store = container.GetParticles();
+    vector<float>& x = store.GetPositions(0);
+    vector<float>& y = store.GetPositions(1);
+    const vector<float>& radii = store.GetRadii();
+    auto squared_gap = [&](size_t base, size_t neighbor) {
+      float dx = x[base] - x[neighbor];
+      float dy = y[base] - y[neighbor];
+      return dx * dx + dy * dy;
+    };
+
+    CellGrid grid;
+    grid.Build(store, {0, 0, 0}, skin);
+    ThreadPool thread_pool(1);
+    NeighborList list;
+    list.Build(
+        store, {0, 0, 0}, skin, grid,
+        [&](size_t base, size_t neighbor) {
+          float cutoff = radii[base] + radii[neighbor] + skin;
+          return squared_gap(base, neighbor) <= cutoff * cutoff;
+        },
+        thread_pool);
+    REQUIRE(!list.IsStale(store, {0, 0, 0}, skin, thread_pool));
+    REQUIRE(list.IsStale(store, {0, 0, 0}, 2 * skin, thread_pool));
+
+    // Every particle moves just under half the skin
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> angle_dist(0, 6.28f);
+    for (size_t index = 0; index < store.size(); ++index) {
+      float angle = angle_dist(gen);
+      x[index] += 0.49f * skin * std::cos(angle);
+      y[index] += 0.49f * skin * std::sin(angle);
+    }
+    REQUIRE(!list.IsStale(store, {0, 0, 0}, skin, thread_pool));
+
+    vector<pair<size_t, size_t>> listed;
+    list.ForEachPair([&listed](size_t base, size_t neighbor) {
+      listed.emplace_back(std::min(base, neighbor), std::max(base, neighbor));
+    });
+    std::sort(listed.begin(), listed.end());
+    REQUIRE(listed.size() == list.GetPairCount());
+    REQUIRE(std::adjacent_find(listed.begin(), listed.end()) == listed.end());
+    size_t touching = 0;
+    for (size_t base = 0; base < store.size(); ++base) {
+      for (size_t neighbor = base + 1; neighbor < store.size(); ++neighbor) {
+        float cutoff = radii[base] + radii[neighbor];
+        if (squared_gap(base, neighbor) <= cutoff * cutoff) {
+          ++touching;
+          REQUIRE(std::binary_search(listed.begin(), listed.end(),
+                                     pair<size_t, size_t>(base, neighbor)));
+        }
+      }
+    }
+    REQUIRE(touching > 0);
+
+    x[0] += 0.6f * skin;
+    REQUIRE(list.IsStale(store, {0, 0, 0}, skin, thread_pool));
+  }
+
+  SECTION("Steps rebuild the list only after particles drift") {
+    ParticleContainer container;
+    FillContainer(container, 400, 23);
+    // Particles move at most 0.75 per step, so several steps share a list
+    container.SetTimeStep(0.25f);
+    NeighborListOptions options;
+    options.enabled = true;
+    options.skin = skin;
+    container.SetNeighborListOptions(options);
+    for (size_t step = 0; step < 20; ++step) {
+      container.Increment();
+    }
+    const NeighborListStats& stats = container.GetNeighborListStats();
+    REQUIRE(stats.passes == 20);
+    REQUIRE(stats.builds > 1);
+    REQUIRE(stats.builds < stats.passes);
+    REQUIRE(stats.pair_count > 0);
+    REQUIRE(stats.memory_bytes > 0);
+
+    container.SetNeighborListOptions(NeighborListOptions());
+    container.Increment();
+    REQUIRE(container.GetNeighborListStats().passes == 0);
+  }
+
+  SECTION("Loading a checkpoint rebuilds the list") {
+    const string checkpoint_path = "test_neighbor_list.bin";
+    ParticleContainer container;
+    FillContainer(container, 400, 23);
+    container.SetTimeStep(0.25f);
+    NeighborListOptions options;
+    options.enabled = true;
+    options.skin = skin;
+    container.SetNeighborListOptions(options);
+    container.Increment();
+    container.SaveCheckpoint(checkpoint_path);
+
+    // The saved particles have barely drifted from the list's, so only
+    // loading them can make the list stale
+    container.LoadCheckpoint(checkpoint_path);
+    std::remove(checkpoint_path.c_str());
+    size_t builds = container.GetNeighborListStats().builds;
+    container.Increment();
+    REQUIRE(container.GetNeighborListStats().builds == builds + 1);
+  }
+
+  SECTION("Threads resolve the same collisions as one thread") {
+    NeighborListOptions options;
+    options.enabled = true;
+    options.skin = skin;
+    ParticleContainer serial;
+    FillContainer(serial, 400, 29);
+    serial.SetBroadphaseMode(BroadphaseMode::kHierarchicalGrid);
+    serial.SetNeighborListOptions(options);
+    ParticleContainer parallel;
+    FillContainer(parallel, 400, 29);
+    parallel.SetBroadphaseMode(BroadphaseMode::kHierarchicalGrid);
+    parallel.SetNeighborListOptions(options);
+    parallel.SetThreadCount(4);
+    for (size_t step = 0; step < 20; ++step) {
+      serial.Increment();
+      parallel.Increment();
+    }
+    REQUIRE(serial.GetNeighborListStats().builds ==
+            parallel.GetNeighborListStats().builds);
+    REQUIRE(parallel.GetParticles().GetVelocities(0) ==
+            serial.GetParticles().GetVelocities(0));
+    REQUIRE(parallel.GetParticles().GetPositions(1) ==
+            serial.GetParticles().GetPositions(1));
+  }
+}
@@ -0,0 +1,198 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/color.h"
+#include "core/config.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+
+using idealgas::ColorT;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::PrecisionMode;
+using idealgas::SimulationMode;
+using idealgas::SpeciesId;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The checkpoint written by the tests, removed after each one
+const string kCheckpointPath = "test_checkpoint.bin";
+
+/**
+ * @brief Checks that two float arrays hold exactly the same bits.
+ *
+ * @param lhs the first array
+ * @param rhs the second array
+ * @return true when every bit matches
+ */
+bool BitEqual(const vector<float>& lhs, const vector<float>& rhs) {
+  return lhs.size() == rhs.size() &&
+         std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(float)) == 0;
+}
+
+/**
+ * @brief Checks that two stores hold the same species, species flags and
+ * particles.
+ *
+ * @param lhs the first store
+ * @param rhs the second store
+ * @return true when every array matches
+ */
+bool StoresEqual(const ParticleStore& lhs, const ParticleStore& rhs) {
+  if (lhs.GetDimensions() != rhs.GetDimensions()) {
+    return false;
+  }
+  for (size_t axis = 0; axis < lhs.GetDimensions(); ++axis) {
+    if (!BitEqual(lhs.GetPositions(axis), rhs.GetPositions(axis)) ||
+        !BitEqual(lhs.GetVelocities(axis), rhs.GetVelocities(axis))) {
+      return false;
+    }
+  }
+  for (SpeciesId species = 0; species < lhs.GetSpeciesNames().size() &&
+                              species < rhs.GetSpeciesNames().size();
+       ++species) {
+    if (lhs.IsSpeciesVisible(species) != rhs.IsSpeciesVisible(species) ||
+        lhs.IsSpeciesEnabled(species) != rhs.IsSpeciesEnabled(species)) {
+      return false;
+    }
+  }
+  return BitEqual(lhs.GetMasses(), rhs.GetMasses()) &&
+         BitEqual(lhs.GetRadii(), rhs.GetRadii()) &&
+         lhs.GetSpecies() == rhs.GetSpecies() &&
+         lhs.GetColors() == rhs.GetColors() &&
+         lhs.GetSpeciesNames() == rhs.GetSpeciesNames();
+}
+
+}  // namespace
+
+TEST_CASE("Checkpoints", "[checkpoint]") {
+  ParticleContainer container;
+  container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  container.SetSeed(7);
+  container.InitializeParticles("Extra", 500, 1, 3, 1, 2, 1, 4,
+                                ColorT<float>(0, 1, 0));
+  container.SetTimeStep(0.5);
+  for (size_t step = 0; step < 20; ++step) {
+    container.Increment();
+  }
+  container.SaveCheckpoint(kCheckpointPath);
+
+  SECTION("Restores the particles and state exactly") {
+    ParticleContainer restored;
+    restored.LoadCheckpoint(kCheckpointPath);
+    REQUIRE(StoresEqual(restored.GetParticles(), container.GetParticles()));
+    REQUIRE(restored.GetSeed() == 7);
+    REQUIRE(restored.GetTimeStep() == 0.5);
+    REQUIRE(restored.GetSimulatedTime() == container.GetSimulatedTime());
+    REQUIRE(restored.GetSimulationMode() == SimulationMode::kTimeStep);
+  }
+
+  SECTION("A restored run continues exactly like the original") {
+    ParticleContainer restored;
+    restored.LoadCheckpoint(kCheckpointPath);
+    for (size_t step = 0; step < 20; ++step) {
+      container.Increment();
+      restored.Increment();
+    }
+    REQUIRE(StoresEqual(restored.GetParticles(), container.GetParticles()));
+  }
+
+  SECTION("Double precision resumes from its double state") {
+    ParticleContainer precise;
+    precise.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+    precise.SetSeed(7);
+    precise.InitializeParticles("Extra", 500, 1, 3, 1, 2, 1, 4,
+                                ColorT<float>(0, 1, 0));
+    precise.SetPrecisionMode(PrecisionMode::kDouble);
+    precise.SetTimeStep(0.01f);
+    for (size_t step = 0; step < 20; ++step) {
+      precise.Increment();
+    }
+    precise.SaveCheckpoint(kCheckpointPath);
+
+    ParticleContainer restored;
+    restored.LoadCheckpoint(kCheckpointPath);
+    REQUIRE(restored.GetPrecisionMode() == PrecisionMode::kDouble);
+    REQUIRE(StoresEqual(restored.GetParticles(), precise.GetParticles()));
+    // Small steps in double leave positions between the floats, which a
+    // resumed run only keeps when it restored the doubles
+    for (size_t step = 0; step < 200; ++step) {
+      precise.Increment();
+      restored.Increment();
+    }
+    REQUIRE(StoresEqual(restored.GetParticles(), precise.GetParticles()));
+  }
+
+  SECTION("Hidden and disabled species stay so after a restart") {
+    container.SetSpeciesVisible(0, false);
+    container.SetSpeciesEnabled(1, false);
+    container.SaveCheckpoint(kCheckpointPath);
+
+    ParticleContainer restored;
+    restored.LoadCheckpoint(kCheckpointPath);
+    const ParticleStore& particles = restored.GetParticles();
+    REQUIRE_FALSE(particles.IsSpeciesVisible(0));
+    REQUIRE(particles.IsSpeciesEnabled(0));
+    REQUIRE(particles.IsSpeciesVisible(1));
+    REQUIRE_FALSE(particles.IsSpeciesEnabled(1));
+
+    // The disabled species stays frozen in the resumed run as in the original
+    for (size_t step = 0; step < 20; ++step) {
+      container.Increment();
+      restored.Increment();
+    }
+    REQUIRE(StoresEqual(restored.GetParticles(), container.GetParticles()));
+  }
+
+  SECTION("Truncated checkpoints are rejected") {
+    std::ifstream input(kCheckpointPath, std::ios::binary);
+    string bytes((std::istreambuf_iterator<char>(input)),
+                 std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream(kCheckpointPath, std::ios::binary)
+        .write(bytes.data(), bytes.size() / 2);
+
+    ParticleContainer restored;
+    REQUIRE_THROWS_AS(restored.LoadCheckpoint(kCheckpointPath),
+                      std::runtime_error);
+  }
+
+  SECTION("Particle counts too large for memory are rejected") {
+    // The count follows the magic, version and byte order mark, and this one
+    // wraps around to a few bytes when multiplied by the size of a float
+    uint64_t count = SIZE_MAX / sizeof(float) + 2;
+    std::fstream file(kCheckpointPath,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(16);
+    file.write((const char*)&count, sizeof(count));
+    file.close();
+
+    // Without the check, the count passes as a few bytes and the arrays are
+    // cut short, or too long for the rest of the file
+    ParticleContainer restored;
+    try {
+      restored.LoadCheckpoint(kCheckpointPath);
+      FAIL("The corrupt count was read");
+    } catch (const std::runtime_error& error) {
+      REQUIRE(string(error.what()).find("corrupt particle count") !=
+              string::npos);
+    }
+  }
+
+  SECTION("Other files are rejected") {
+    ParticleContainer restored;
+    REQUIRE_THROWS_AS(
+        restored.LoadCheckpoint(IDEALGAS_CONFIG_DIR "/test/config_test.json"),
+        std::runtime_error);
+  }
+
+  std::remove(kCheckpointPath.c_str());
+}
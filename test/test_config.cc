@@ -0,0 +1,313 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/config.h"
+#include "core/initial_conditions.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/thread_pool.h"
+
+using glm::vec2;
+using idealgas::ColorT;
+using idealgas::ParseConfig;
+using idealgas::Particle;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::PrecisionMode;
+using idealgas::ReadInitialConditions;
+using idealgas::SimulationConfig;
+using idealgas::SimulationMode;
+using idealgas::ThreadPool;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The initial conditions written by the tests, removed after each one
+const string kInitialConditionsPath = "test_initial_conditions.csv";
+
+/**
+ * @brief Reads the configuration the other tests use.
+ *
+ * @return the parsed json configuration
+ */
+json ReadTestConfig() {
+  std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  json config;
+  input >> config;
+  return config;
+}
+
+/**
+ * @brief Writes text to the initial conditions file.
+ *
+ * @param text the whole file
+ */
+void WriteInitialConditions(const string& text) {
+  std::ofstream output(kInitialConditionsPath, std::ios::binary);
+  output << text;
+}
+
+}  // namespace
+
+TEST_CASE("Simulation config", "[config]") {
+  json config = ReadTestConfig();
+
+  SECTION("Numbers may be strings or numbers") {
+    config["window"]["width"] = 400;
+    config["window"]["background color"] = 0x505050;
+    config["container"]["seed"] = "7";
+    config["container"]["steps per second"] = "30.5";
+    SimulationConfig parsed = ParseConfig(config);
+    REQUIRE(parsed.window_width == 400);
+    REQUIRE(parsed.window_height == 300);
+    REQUIRE(parsed.container_width == 200);
+    REQUIRE(parsed.container_height == 100);
+    REQUIRE(parsed.background_color == 0x505050);
+    REQUIRE(parsed.text_color == 0xFFBFBF);
+    REQUIRE(parsed.histogram_bin_count == 2);
+    REQUIRE(parsed.seed == 7);
+    REQUIRE(parsed.steps_per_second == 30.5);
+    REQUIRE(parsed.simulation_mode == SimulationMode::kTimeStep);
+    REQUIRE(parsed.species.size() == 1);
+    REQUIRE(parsed.species[0].name == "Solitary Particle");
+    REQUIRE(parsed.species[0].particle_count == 1);
+    REQUIRE(parsed.species[0].color == 0xFFFFFF);
+    REQUIRE(parsed.dimensions == 2);
+    REQUIRE(parsed.container_depth == 100);
+    REQUIRE(parsed.precision == PrecisionMode::kSingle);
+  }
+
+  SECTION("The broadphase is read by name") {
+    REQUIRE(ParseConfig(config).broadphase == idealgas::BroadphaseMode::kGrid);
+    config["container"]["broadphase"] = "hierarchical grid";
+    REQUIRE(ParseConfig(config).broadphase ==
+            idealgas::BroadphaseMode::kHierarchicalGrid);
+  }
+
+  SECTION("The neighbor list is enabled by its settings") {
+    REQUIRE(!ParseConfig(config).neighbor_list.enabled);
+    config["container"]["neighbor list"] = {{"skin", "1.5"}};
+    SimulationConfig parsed = ParseConfig(config);
+    REQUIRE(parsed.neighbor_list.enabled);
+    REQUIRE(parsed.neighbor_list.skin == 1.5f);
+  }
+
+  SECTION("Precision is read by name") {
+    config["container"]["precision"] = "mixed";
+    REQUIRE(ParseConfig(config).precision == PrecisionMode::kMixed);
+    config["container"]["precision"] = "double";
+    REQUIRE(ParseConfig(config).precision == PrecisionMode::kDouble);
+  }
+
+  SECTION("Three dimensions add a depth and a z boundary") {
+    config["container"]["dimensions"] = 3;
+    config["container"]["depth"] = "40";
+    config["container"]["boundaries"] = {{"z", "periodic"}};
+    SimulationConfig parsed = ParseConfig(config);
+    REQUIRE(parsed.dimensions == 3);
+    REQUIRE(parsed.container_depth == 40);
+    REQUIRE(parsed.boundaries[2] == idealgas::BoundaryMode::kPeriodic);
+    REQUIRE(parsed.trajectory.dimensions == 3);
+  }
+
+  SECTION("Bad values are rejected") {
+    json bad = config;
+    bad["window"]["width"] = "four hundred";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["window"]["stroke"] = -1;
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["window"]["text color"] = "0x1000000";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["histogram"]["bin count"] = 0;
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["engine"] = "leapfrog";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["boundaries"]["y"] = "absorbing";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["dimensions"] = 4;
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["dimensions"] = 3;
+    bad["container"]["engine"] = "event driven";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["broadphase"] = "octree";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["neighbor list"] = {{"skin", -1}};
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["precision"] = "quad";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["precision"] = "double";
+    bad["container"]["engine"] = "event driven";
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["particles"]["Solitary Particle"]["min mass"] = 2;
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+
+    bad = config;
+    bad["container"]["particles"]["Solitary Particle"]["max radius"] =
+        ParticleContainer::kRadiusLimit + 1;
+    REQUIRE_THROWS_AS(ParseConfig(bad), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Initial conditions", "[config]") {
+  ThreadPool thread_pool(1);
+
+  SECTION("Rows are read in any column order") {
+    WriteInitialConditions(
+        "id,radius,species,x,y,vx,vy,mass\n"
+        "0,2,\"Big, Slow\",10,20,1,-1,5\n"
+        "\n"
+        "1,1,Small,30.5,40,-2,0.25,1\r\n"
+        "2,3,\"Big, Slow\",50,60,0,0,7");
+    ParticleStore particles;
+    ReadInitialConditions(kInitialConditionsPath, particles, thread_pool);
+    REQUIRE(particles.size() == 3);
+    REQUIRE(particles.GetSpeciesNames() ==
+            vector<string>{"Big, Slow", "Small"});
+    REQUIRE(particles.GetSpeciesRange(0) == pair<size_t, size_t>(0, 2));
+    REQUIRE(particles.GetPositions(0) == vector<float>{10, 50, 30.5f});
+    REQUIRE(particles.GetVelocities(1) == vector<float>{-1, 0, 0.25f});
+    REQUIRE(particles.GetMasses() == vector<float>{5, 7, 1});
+    REQUIRE(particles.GetRadii() == vector<float>{2, 3, 1});
+  }
+
+  SECTION("Errors name their line") {
+    WriteInitialConditions(
+        "species,x,y,vx,vy,mass,radius\n"
+        "A,1,1,0,0,1,1\n"
+        "A,1,1,0,zero,1,1\n");
+    ParticleStore particles;
+    try {
+      ReadInitialConditions(kInitialConditionsPath, particles, thread_pool);
+      FAIL("The bad row was read");
+    } catch (const std::runtime_error& error) {
+      REQUIRE(string(error.what()).find(kInitialConditionsPath + ":3") !=
+              string::npos);
+    }
+
+    WriteInitialConditions("species,x,y,vx,vy,mass\nA,1,1,0,0,1\n");
+    REQUIRE_THROWS_AS(
+        ReadInitialConditions(kInitialConditionsPath, particles, thread_pool),
+        std::runtime_error);
+
+    WriteInitialConditions("species,x,y,vx,vy,mass,radius\nA,1,1,0,0,1,0\n");
+    REQUIRE_THROWS_AS(
+        ReadInitialConditions(kInitialConditionsPath, particles, thread_pool),
+        std::runtime_error);
+  }
+
+  SECTION("Radii above the configured limit are rejected") {
+    WriteInitialConditions(
+        "species,x,y,vx,vy,mass,radius\n"
+        "A,1,1,0,0,1,100\n"
+        "A,1,1,0,0,1,101\n");
+    ParticleStore particles;
+    try {
+      ReadInitialConditions(kInitialConditionsPath, particles, thread_pool);
+      FAIL("The large radius was read");
+    } catch (const std::runtime_error& error) {
+      REQUIRE(string(error.what()).find(kInitialConditionsPath + ":3") !=
+              string::npos);
+    }
+  }
+
+  SECTION("Threads read the same particles as one thread") {
+    // Enough rows to fill several chunks
+    string text = "species,x,y,vx,vy,mass,radius\n";
+    for (size_t row = 0; row < 60000; ++row) {
+      text += (row % 3 == 0 ? "Heavy," : "Light,") + std::to_string(row) +
+              ",2.5," + std::to_string(row % 17) + ",-1," +
+              std::to_string(1 + row % 5) + ",1\n";
+    }
+    WriteInitialConditions(text);
+
+    ParticleStore serial;
+    ReadInitialConditions(kInitialConditionsPath, serial, thread_pool);
+    ThreadPool parallel_pool(4);
+    ParticleStore parallel;
+    ReadInitialConditions(kInitialConditionsPath, parallel, parallel_pool);
+    REQUIRE(serial.size() == 60000);
+    REQUIRE(serial.GetSpeciesRange(0) == pair<size_t, size_t>(0, 20000));
+    REQUIRE(parallel.GetSpecies() == serial.GetSpecies());
+    REQUIRE(parallel.GetPositions(0) == serial.GetPositions(0));
+    REQUIRE(parallel.GetVelocities(0) == serial.GetVelocities(0));
+    REQUIRE(parallel.GetMasses() == serial.GetMasses());
+  }
+
+  SECTION("Configured species add to the file's particles") {
+    WriteInitialConditions(
+        "species,x,y,vx,vy,mass,radius\n"
+        "Solitary Particle,10,10,1,0,1,1\n"
+        "Wall Particle,50,50,0,0,100,5\n");
+    json config = ReadTestConfig();
+    config["container"]["initial conditions"] = kInitialConditionsPath;
+    ParticleContainer container;
+    container.ConfigureFromJson(config);
+    const ParticleStore& particles = container.GetParticles();
+    REQUIRE(particles.size() == 3);
+    REQUIRE(particles.GetSpeciesRange(0) == pair<size_t, size_t>(0, 2));
+    REQUIRE(particles.GetSpeciesColor(1) == ColorT<float>(1, 1, 1));
+  }
+
+  SECTION("Checkpoints add to the configured species too") {
+    const string checkpoint_path = "test_initial_conditions.bin";
+    ParticleContainer saved;
+    saved.InitializeParticle(Particle("Solitary Particle", vec2(10, 10),
+                                      vec2(1, 0), 1, 1,
+                                      ColorT<float>(1, 0, 0)));
+    saved.InitializeParticle(Particle("Wall Particle", vec2(50, 50),
+                                      vec2(0, 0), 100, 5,
+                                      ColorT<float>(0, 1, 0)));
+    saved.SetSpeciesEnabled(1, false);
+    saved.SaveCheckpoint(checkpoint_path);
+
+    json config = ReadTestConfig();
+    config["container"]["initial conditions"] = checkpoint_path;
+    ParticleContainer container;
+    container.ConfigureFromJson(config);
+    std::remove(checkpoint_path.c_str());
+    const ParticleStore& particles = container.GetParticles();
+    REQUIRE(particles.size() == 3);
+    REQUIRE(particles.GetSpeciesNames() ==
+            vector<string>{"Solitary Particle", "Wall Particle"});
+    REQUIRE(particles.GetSpeciesRange(0) == pair<size_t, size_t>(0, 2));
+    // The configured species keeps its color, and the new one its saved state
+    REQUIRE(particles.GetSpeciesColor(0) == ColorT<float>(1, 1, 1));
+    REQUIRE(particles.GetSpeciesColor(1) == ColorT<float>(0, 1, 0));
+    REQUIRE_FALSE(particles.IsSpeciesEnabled(1));
+    REQUIRE(particles.GetPositions(0)[0] == 10);
+    REQUIRE(particles.GetPositions(0)[2] == 50);
+  }
+
+  std::remove(kInitialConditionsPath.c_str());
+}
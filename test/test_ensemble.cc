@@ -0,0 +1,76 @@
+#include <catch2/catch.hpp>
+#include <fstream>
+#include <vector>
+
+#include "core/ensemble.h"
+
+using idealgas::Ensemble;
+using idealgas::EnsembleOptions;
+using idealgas::EnsembleResult;
+using idealgas::SpeedDistribution;
+using std::vector;
+
+TEST_CASE("Ensemble", "[ensemble]") {
+  std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  json config;
+  input >> config;
+  config["container"]["seed"] = 11;
+  config["container"]["particles"]["Solitary Particle"]["particle count"] = 60;
+  config["container"]["particles"]["Solitary Particle"]["max velocity"] = 3;
+
+  EnsembleOptions options;
+  options.replicas = 5;
+  options.steps = 40;
+  options.warmup_steps = 10;
+  options.sample_stride = 5;
+  options.bin_count = 8;
+  options.thread_count = 1;
+
+  SECTION("Replicas get distinct seeds derived from the configured one") {
+    Ensemble ensemble(config, options);
+    REQUIRE(ensemble.GetSeed() == 11);
+    REQUIRE(ensemble.GetReplicaSeed(0) != ensemble.GetReplicaSeed(1));
+    REQUIRE(ensemble.GetReplicaSeed(1) ==
+            Ensemble(config, options).GetReplicaSeed(1));
+  }
+
+  SECTION("Fractions of every species add up to one") {
+    EnsembleResult result = Ensemble(config, options).Run();
+    REQUIRE(result.replicas == 5);
+    REQUIRE(result.speeds.size() == 1);
+
+    const SpeedDistribution& speeds = result.speeds[0];
+    REQUIRE(speeds.bin_cutoffs.size() == 8);
+    double total = speeds.overflow.mean;
+    double expected = 0;
+    for (size_t bin = 0; bin < 8; ++bin) {
+      total += speeds.fractions[bin].mean;
+      expected += speeds.maxwell_boltzmann[bin];
+      REQUIRE(speeds.fractions[bin].half_width >= 0);
+    }
+    REQUIRE(total == Approx(1));
+    REQUIRE(expected == Approx(1).epsilon(0.001));
+    REQUIRE(result.temperatures[0].mean > 0);
+    REQUIRE(result.pressure.mean > 0);
+  }
+
+  SECTION("Results are the same for every thread count") {
+    EnsembleResult serial = Ensemble(config, options).Run();
+    options.thread_count = 3;
+    EnsembleResult parallel = Ensemble(config, options).Run();
+
+    REQUIRE(parallel.kinetic_energy.mean == serial.kinetic_energy.mean);
+    REQUIRE(parallel.pressure.half_width == serial.pressure.half_width);
+    for (size_t bin = 0; bin < 8; ++bin) {
+      REQUIRE(parallel.speeds[0].fractions[bin].mean ==
+              serial.speeds[0].fractions[bin].mean);
+    }
+  }
+
+  SECTION("A single replica has no confidence interval") {
+    options.replicas = 1;
+    EnsembleResult result = Ensemble(config, options).Run();
+    REQUIRE(result.kinetic_energy.mean > 0);
+    REQUIRE(result.kinetic_energy.half_width == 0);
+  }
+}
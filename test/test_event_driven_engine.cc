@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/color.h"
+#include "core/event_driven_engine.h"
+#include "core/particle_store.h"
+
+using idealgas::ColorT;
+using glm::vec2;
+using idealgas::EventDrivenEngine;
+using idealgas::ParticleStore;
+using idealgas::SpeciesId;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief Sums the kinetic energy of every particle.
+ *
+ * @param particles the particles to sum over
+ * @return the double total kinetic energy
+ */
+double KineticEnergy(const ParticleStore& particles) {
+  double energy = 0;
+  for (size_t index = 0; index < particles.size(); ++index) {
+    vec2 velocity = particles.GetVelocity(index);
+    energy += 0.5 * particles.GetMasses()[index] * dot(velocity, velocity);
+  }
+  return energy;
+}
+
+/**
+ * @brief Finds the smallest gap between any two particles, negative when some
+ * pair overlaps.
+ *
+ * @param particles the particles to check
+ * @return the float smallest gap between two surfaces
+ */
+float SmallestGap(const ParticleStore& particles) {
+  float smallest = INFINITY;
+  for (size_t first = 0; first < particles.size(); ++first) {
+    for (size_t second = first + 1; second < particles.size(); ++second) {
+      float gap = glm::distance(particles.GetPosition(first),
+                                particles.GetPosition(second)) -
+                  particles.GetRadii()[first] - particles.GetRadii()[second];
+      smallest = std::min(smallest, gap);
+    }
+  }
+  return smallest;
+}
+
+}  // namespace
+
+TEST_CASE("Event-driven engine", "[event driven]") {
+  ParticleStore particles;
+  SpeciesId species = particles.InternSpecies("Test", ColorT<float>(1, 1, 1));
+  EventDrivenEngine engine;
+
+  SECTION("Head-on collision happens at the exact contact time") {
+    particles.Add(species, vec2(10, 50), vec2(1, 0), 1, 2);
+    particles.Add(species, vec2(20, 50), vec2(-1, 0), 1, 2);
+
+    // The particles touch after 3 units of time and swap velocities
+    engine.Advance(particles, 4, 100, 100);
+
+    REQUIRE(particles.GetVelocity(0) == vec2(-1, 0));
+    REQUIRE(particles.GetVelocity(1) == vec2(1, 0));
+    REQUIRE(particles.GetPosition(0).x == Approx(12));
+    REQUIRE(particles.GetPosition(1).x == Approx(18));
+  }
+
+  SECTION("Fast particles do not tunnel through each other") {
+    // A fixed step of 10 would carry these straight past each other
+    particles.Add(species, vec2(490, 50), vec2(30, 0), 1, 1);
+    particles.Add(species, vec2(510, 50), vec2(-30, 0), 1, 1);
+
+    engine.Advance(particles, 10, 1000, 100);
+
+    REQUIRE(particles.GetVelocity(0).x < 0);
+    REQUIRE(particles.GetVelocity(1).x > 0);
+    REQUIRE(particles.GetPosition(0).x < particles.GetPosition(1).x);
+  }
+
+  SECTION("Walls reflect at the surface of the particle") {
+    particles.Add(species, vec2(10, 50), vec2(-2, 0), 1, 3);
+
+    // The particle reaches the wall after 3.5 units of time
+    engine.Advance(particles, 5, 100, 100);
+
+    REQUIRE(particles.GetVelocity(0) == vec2(2, 0));
+    REQUIRE(particles.GetPosition(0).x == Approx(6));
+  }
+
+  SECTION("Crowded gas conserves energy and never overlaps") {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> velocity_dist(-3, 3);
+    // A lattice start, so no particles overlap to begin with
+    for (size_t row = 0; row < 20; ++row) {
+      for (size_t column = 0; column < 20; ++column) {
+        particles.Add(species, vec2(5 + column * 10, 5 + row * 10),
+                      vec2(velocity_dist(gen), velocity_dist(gen)),
+                      1 + (row + column) % 3, 3);
+      }
+    }
+    double energy = KineticEnergy(particles);
+
+    for (size_t step = 0; step < 50; ++step) {
+      engine.Advance(particles, 1, 200, 200);
+    }
+
+    REQUIRE(engine.GetProcessedEventCount() > 0);
+    REQUIRE(KineticEnergy(particles) == Approx(energy).epsilon(1e-3));
+    REQUIRE(SmallestGap(particles) > -1e-2f);
+  }
+
+  SECTION("Jammed particles stay in the container when events run out") {
+    // Overlapping particles wedged between the walls collide again at once
+    // after every collision, until the event limit stops the call
+    particles.Add(species, vec2(3, 5), vec2(4, 0), 1, 3);
+    particles.Add(species, vec2(7, 5), vec2(-4, 0), 1, 3);
+
+    for (size_t step = 0; step < 3; ++step) {
+      engine.Advance(particles, 10, 10, 10);
+      for (size_t index = 0; index < particles.size(); ++index) {
+        vec2 position = particles.GetPosition(index);
+        REQUIRE(position.x >= 0);
+        REQUIRE(position.x <= 10);
+        REQUIRE(position.y == Approx(5));
+      }
+    }
+  }
+
+  SECTION("Outside changes to the particles are picked up") {
+    particles.Add(species, vec2(10, 50), vec2(1, 0), 1, 2);
+    engine.Advance(particles, 1, 100, 100);
+
+    particles.SetVelocity(0, vec2(0, 1));
+    engine.Advance(particles, 1, 100, 100);
+
+    REQUIRE(particles.GetPosition(0).x == Approx(11));
+    REQUIRE(particles.GetPosition(0).y == Approx(51));
+  }
+}
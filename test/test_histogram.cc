@@ -2,9 +2,12 @@
 #include <iostream>
 #include "core/histogram.h"
 #include "core/particle_container.h"
+#include <limits>
 #include <string>
+#include <vector>
 
 using std::string;
+using std::vector;
 using idealgas::ParticleContainer;
 using idealgas::Histogram;
 
@@ -53,4 +56,96 @@ TEST_CASE("Bin heights") {
     REQUIRE(heights[0] == 1);
     REQUIRE(heights[1] == 1);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Streaming bins") {
+  SECTION("Later values outside the range widen it without losing counts") {
+    Histogram hist("", 4);
+    for (int i = 0; i < 8; ++i) {
+      hist.Update(i);
+    }
+    hist.CalculateFrequencies();
+    // The first batch covers [0, 7), leaving out its maximum
+    REQUIRE(hist.GetBinHeights() == vector<float>{2, 2, 2, 1});
+
+    // [0, 7) doubles to [0, 14) and then to [0, 28)
+    hist.Update(20);
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{7, 0, 1, 0});
+    REQUIRE(hist.GetBinCutoffs() == vector<float>{7, 14, 21, 28});
+
+    // Below the range, [0, 28) doubles to [-28, 28)
+    hist.Update(-1);
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{0, 1, 7, 1});
+    REQUIRE(hist.GetValueCount() == 9);
+  }
+
+  SECTION("Later values on the upper edge fall in the last bin") {
+    Histogram hist("", 4);
+    for (int i = 0; i < 8; ++i) {
+      hist.Update(i);
+    }
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{2, 2, 2, 1});
+
+    // The edge of [0, 7) does not widen the range once it is chosen
+    hist.Update(7);
+    hist.Update(7);
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{2, 2, 2, 3});
+    REQUIRE(hist.GetBinCutoffs() == vector<float>{1.75f, 3.5f, 5.25f, 7});
+    REQUIRE(hist.GetValueCount() == 9);
+  }
+
+  SECTION("Repeating a batch keeps its range") {
+    Histogram hist("", 10);
+    for (size_t frame = 1; frame <= 3; ++frame) {
+      for (int speed = 0; speed < 100; ++speed) {
+        hist.Update(1 + speed * 0.1f);
+      }
+      hist.CalculateFrequencies();
+      // Only the first batch leaves out its maximum
+      REQUIRE(hist.GetValueCount() == 100 * frame - 1);
+      REQUIRE(hist.GetBinCutoffs().back() == Approx(10.9f));
+      vector<float> heights = hist.GetBinHeights();
+      for (size_t bin = 0; bin + 1 < heights.size(); ++bin) {
+        REQUIRE(heights[bin] == 10 * frame);
+      }
+      REQUIRE(heights.back() == 10 * frame - 1);
+    }
+  }
+
+  SECTION("A sliding window forgets old steps") {
+    Histogram hist("", 2, 2);
+    hist.Update(0);
+    hist.Update(10);
+    hist.Update(2);
+    hist.EndStep();
+    hist.Update(8);
+    hist.EndStep();
+    hist.Update(9);
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{2, 2});
+
+    // The first step leaves the window
+    hist.EndStep();
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights() == vector<float>{0, 2});
+    REQUIRE(hist.GetValueCount() == 2);
+
+    hist.EndStep();
+    hist.EndStep();
+    hist.CalculateFrequencies();
+    REQUIRE(hist.GetBinHeights().empty());
+  }
+
+  SECTION("Values that are not finite are ignored") {
+    Histogram hist("", 2);
+    hist.Update(1);
+    hist.Update(std::numeric_limits<float>::quiet_NaN());
+    hist.Update(std::numeric_limits<float>::infinity());
+    hist.Update(3);
+    REQUIRE(hist.GetValueCount() == 2);
+  }
+}
@@ -1,16 +1,28 @@
 #include <catch2/catch.hpp>
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
-#include "cinder/gl/gl.h"
+#include "core/color.h"
+#include "core/config.h"
 #include "core/histogram.h"
 #include "core/particle.h"
 #include "core/particle_container.h"
 
-using ci::ColorT;
+using idealgas::AdaptiveStepOptions;
+using idealgas::BroadphaseMode;
+using idealgas::ColorT;
 using idealgas::Histogram;
 using idealgas::ParticleContainer;
+using idealgas::Observables;
+using idealgas::ParticleStore;
+using idealgas::PrecisionMode;
+using idealgas::RingBuffer;
+using idealgas::SimulationMode;
+using std::pair;
 using std::string;
 using std::vector;
 
@@ -27,7 +39,7 @@ TEST_CASE("Setup", "[configure][initialize]") {
       // error for an improperly formatted file.
 
       string test_config_path =
-          "../../../../../../config/test/config_empty.json";
+          IDEALGAS_CONFIG_DIR "/test/config_empty.json";
       ParticleContainer container;
       REQUIRE_THROWS_AS(container.Configure(test_config_path),
                         json::parse_error);
@@ -35,7 +47,7 @@ TEST_CASE("Setup", "[configure][initialize]") {
 
     SECTION("Incomplete") {
       string test_config_path =
-          "../../../../../../config/test/config_invalid.json";
+          IDEALGAS_CONFIG_DIR "/test/config_invalid.json";
       ParticleContainer container;
       REQUIRE_THROWS_AS(container.Configure(test_config_path),
                         json::type_error);
@@ -43,7 +55,7 @@ TEST_CASE("Setup", "[configure][initialize]") {
 
     SECTION("Valid file") {
       string test_config_path =
-          "../../../../../../config/test/config_test.json";
+          IDEALGAS_CONFIG_DIR "/test/config_test.json";
       ParticleContainer container;
       container.Configure(test_config_path);
       REQUIRE(container.GetParticleNames() ==
@@ -53,7 +65,7 @@ TEST_CASE("Setup", "[configure][initialize]") {
   }
 
   SECTION("Parameterized particle initialization") {
-    string test_config_path = "../../../../../../config/test/config_test.json";
+    string test_config_path = IDEALGAS_CONFIG_DIR "/test/config_test.json";
     ParticleContainer container;
     container.Configure(test_config_path);
     auto particle = container.GetParticles()[0];
@@ -209,14 +221,14 @@ TEST_CASE("Incrementation", "[initialize][increment]") {
       // Increment again for second check
       
       REQUIRE(p1_new.GetPosition().x == Approx(2).epsilon(0.01));
-      REQUIRE(p1_new.GetPosition().y == Approx(1).epsilon(0.01));
+      REQUIRE(p1_new.GetPosition().y == Approx(3).epsilon(0.01));
       REQUIRE(p1_new.GetVelocity().x == Approx(0).epsilon(0.01));
-      REQUIRE(p1_new.GetVelocity().y == Approx(-1).epsilon(0.01));
+      REQUIRE(p1_new.GetVelocity().y == Approx(1).epsilon(0.01));
     }
 
     SECTION("Valid wall bottom") {
       ParticleContainer container;
-      container.Configure("../../../../../../config/test/config_test.json");
+      container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
       container.SetParticles(vector<Particle>());
 
       Particle p1("Test 1", vec2(2, 99), vec2(0, 1), 1, 1,
@@ -248,7 +260,7 @@ TEST_CASE("Incrementation", "[initialize][increment]") {
 
     SECTION("Valid wall left") {
       ParticleContainer container;
-      container.Configure("../../../../../../config/test/config_test.json");
+      container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
       container.SetParticles(vector<Particle>());
 
       Particle p1("Test 1", vec2(1, 30), vec2(-1, 0), 1, 1,
@@ -280,7 +292,7 @@ TEST_CASE("Incrementation", "[initialize][increment]") {
     
     SECTION("Valid wall right") {
       ParticleContainer container;
-      container.Configure("../../../../../../config/test/config_test.json");
+      container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
       container.SetParticles(vector<Particle>());
 
       Particle p1("Test 1", vec2(200, 30), vec2(1, 0), 1, 1,
@@ -331,4 +343,433 @@ TEST_CASE("Incrementation", "[initialize][increment]") {
       REQUIRE(p1_new.GetVelocity().y == Approx(1).epsilon(0.01));
     }
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Parallel incrementation", "[increment][threads]") {
+  // A dense layout with enough occupied cells to split every color's cells
+  // across threads
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<float> position_dist(0, 2000);
+  std::uniform_real_distribution<float> velocity_dist(-3, 3);
+  std::uniform_real_distribution<float> radius_dist(1, 4);
+  vector<Particle> particles;
+  for (size_t index = 0; index < 40000; ++index) {
+    particles.push_back(Particle("Test", vec2(position_dist(gen), position_dist(gen)),
+                                 vec2(velocity_dist(gen), velocity_dist(gen)),
+                                 radius_dist(gen), radius_dist(gen),
+                                 ColorT<float>().hex(0xFFFFFF)));
+  }
+
+  ParticleContainer serial;
+  serial.SetParticles(particles);
+  ParticleContainer parallel;
+  parallel.SetParticles(particles);
+  parallel.SetThreadCount(4);
+
+  for (size_t step = 0; step < 20; ++step) {
+    serial.Increment();
+    parallel.Increment();
+  }
+
+  REQUIRE(parallel.GetThreadCount() == 4);
+  for (size_t axis = 0; axis < 2; ++axis) {
+    REQUIRE(serial.GetParticles().GetPositions(axis) ==
+            parallel.GetParticles().GetPositions(axis));
+    REQUIRE(serial.GetParticles().GetVelocities(axis) ==
+            parallel.GetParticles().GetVelocities(axis));
+  }
+  REQUIRE(serial.GetParticles().GetColors() ==
+          parallel.GetParticles().GetColors());
+}
+
+TEST_CASE("Species masks", "[increment][species]") {
+  ParticleContainer container;
+  container.InitializeParticle(Particle("Moving", vec2(20, 20), vec2(1, 0), 1,
+                                        2, ColorT<float>().hex(0xFFFFFF)));
+  container.InitializeParticle(Particle("Still", vec2(23, 20), vec2(-1, 0), 1,
+                                        2, ColorT<float>().hex(0xFFFFFF)));
+  ParticleStore& particles = container.GetParticles();
+
+  SECTION("Hidden species are still simulated") {
+    particles.SetSpeciesVisible(1, false);
+    container.Increment();
+    REQUIRE(particles.GetVelocities(0)[0] == Approx(-1));
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(1));
+  }
+
+  SECTION("Disabled species neither move nor collide") {
+    container.SetSpeciesEnabled(1, false);
+    container.Increment();
+    REQUIRE(particles.GetPositions(0)[0] == Approx(21));
+    REQUIRE(particles.GetVelocities(0)[0] == Approx(1));
+    REQUIRE(particles.GetPositions(0)[1] == Approx(23));
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(-1));
+    REQUIRE(container.FindOverlappingPairs().empty());
+
+    container.SetSpeciesEnabled(1, true);
+    container.Increment();
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(1));
+  }
+
+  SECTION("Hidden species are still simulated in event-driven mode") {
+    container.SetSimulationMode(SimulationMode::kEventDriven);
+    container.SetSpeciesVisible(1, false);
+    container.Increment();
+    REQUIRE_FALSE(particles.IsSpeciesVisible(1));
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(1));
+    REQUIRE(particles.GetPositions(0)[1] == Approx(24));
+  }
+
+  SECTION("Disabled species are frozen in event-driven mode") {
+    container.SetSimulationMode(SimulationMode::kEventDriven);
+    container.SetSpeciesEnabled(1, false);
+    container.Increment();
+    REQUIRE(particles.GetPositions(0)[0] == Approx(21));
+    REQUIRE(particles.GetPositions(0)[1] == Approx(23));
+
+    container.SetSpeciesEnabled(1, true);
+    container.Increment();
+    REQUIRE(particles.GetVelocities(0)[1] > 0);
+  }
+}
+
+TEST_CASE("Observables", "[increment][observables]") {
+  ParticleContainer container;
+  container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+
+  SECTION("Energy, momentum and temperature match the particles") {
+    container.SetSeed(5);
+    container.InitializeParticles("Extra", 300, 1, 3, 1, 4, 1, 2,
+                                  ColorT<float>(0, 1, 0));
+    for (size_t step = 0; step < 30; ++step) {
+      container.Increment();
+    }
+
+    const ParticleStore& particles = container.GetParticles();
+    double kinetic_energy = 0;
+    double momentum_x = 0;
+    vector<double> species_energy(particles.GetSpeciesNames().size());
+    for (size_t index = 0; index < particles.size(); ++index) {
+      vec2 velocity = particles.GetVelocity(index);
+      float mass = particles.GetMasses()[index];
+      double energy = 0.5 * mass * glm::dot(velocity, velocity);
+      kinetic_energy += energy;
+      momentum_x += mass * velocity.x;
+      species_energy[particles.GetSpecies()[index]] += energy;
+    }
+
+    const Observables& observables = container.GetObservableHistory().back();
+    REQUIRE(observables.time == container.GetSimulatedTime());
+    REQUIRE(observables.kinetic_energy == Approx(kinetic_energy));
+    REQUIRE(observables.momentum[0] == Approx(momentum_x));
+    REQUIRE(observables.temperatures[1] == Approx(species_energy[1] / 300));
+    REQUIRE(observables.pressure > 0);
+  }
+
+  SECTION("Observables are the same for every thread count") {
+    container.SetSeed(5);
+    container.InitializeParticles("Extra", 20000, 1, 3, 1, 4, 1, 1,
+                                  ColorT<float>(0, 1, 0));
+    vector<Particle> copies;
+    for (size_t index = 0; index < container.GetParticles().size(); ++index) {
+      copies.push_back(container.GetParticles()[index]);
+    }
+    ParticleContainer parallel;
+    parallel.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+    parallel.SetParticles(copies);
+    parallel.SetThreadCount(4);
+    container.Increment();
+    parallel.Increment();
+
+    const Observables& serial = container.GetObservableHistory().back();
+    const Observables& threaded = parallel.GetObservableHistory().back();
+    REQUIRE(serial.kinetic_energy == threaded.kinetic_energy);
+    REQUIRE(serial.momentum == threaded.momentum);
+    REQUIRE(serial.pressure == threaded.pressure);
+    REQUIRE(serial.temperatures == threaded.temperatures);
+  }
+
+  SECTION("Pressure is the momentum given to the walls") {
+    // The container is 200 by 100, so its walls are 600 long
+    container.SetParticles({Particle("Solitary Particle", vec2(199, 50),
+                                     vec2(2, 0), 3, 1,
+                                     ColorT<float>().hex(0xFFFFFF))});
+    container.SetTimeStep(0.5);
+
+    SECTION("Time step") {
+      container.Increment();
+      REQUIRE(container.GetObservableHistory().back().pressure ==
+              Approx(12 / (0.5 * 600)));
+    }
+
+    SECTION("Event driven") {
+      container.SetSimulationMode(SimulationMode::kEventDriven);
+      container.Increment();
+      REQUIRE(container.GetObservableHistory().back().pressure ==
+              Approx(12 / (0.5 * 600)));
+    }
+  }
+
+  SECTION("The history keeps the most recent steps") {
+    container.SetObservableHistoryLength(3);
+    for (size_t step = 0; step < 5; ++step) {
+      container.Increment();
+    }
+
+    const RingBuffer<Observables>& history = container.GetObservableHistory();
+    REQUIRE(history.size() == 3);
+    REQUIRE(history[0].time == Approx(3));
+    REQUIRE(history.back().time == Approx(5));
+  }
+}
+
+TEST_CASE("Adaptive time step", "[increment][adaptive]") {
+  ParticleContainer container;
+  AdaptiveStepOptions options;
+  options.enabled = true;
+  ParticleStore& particles = container.GetParticles();
+
+  SECTION("Fast particles split the step into sub-steps") {
+    container.InitializeParticle(Particle("Fast", vec2(50, 50), vec2(10, 0), 1,
+                                          1, ColorT<float>().hex(0xFFFFFF)));
+    container.SetAdaptiveStepOptions(options);
+    container.Increment();
+    REQUIRE(container.GetSubstepCount() == 64);
+    REQUIRE(particles.GetPositions(0)[0] == Approx(60));
+
+    options.max_substeps = 20;
+    container.SetAdaptiveStepOptions(options);
+    container.Increment();
+    REQUIRE(container.GetSubstepCount() == 16);
+  }
+
+  SECTION("Sub-steps catch collisions a whole step would skip") {
+    container.InitializeParticle(Particle("Left", vec2(50, 50), vec2(8, 0), 1,
+                                          1, ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Right", vec2(60, 50), vec2(-8, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+
+    SECTION("Without sub-steps") {
+      container.Increment();
+      REQUIRE(particles.GetVelocities(0)[0] == Approx(8));
+    }
+
+    SECTION("With sub-steps") {
+      container.SetAdaptiveStepOptions(options);
+      container.Increment();
+      REQUIRE(particles.GetVelocities(0)[0] == Approx(-8));
+      REQUIRE(particles.GetVelocities(0)[1] == Approx(8));
+    }
+  }
+
+  SECTION("Slow species take fewer sub-steps") {
+    container.InitializeParticle(Particle("Slow", vec2(100, 100),
+                                          vec2(0.1, 0), 1, 2,
+                                          ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Fast", vec2(200, 200), vec2(10, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.SetAdaptiveStepOptions(options);
+    container.Increment();
+    REQUIRE(container.GetSubstepCount() == 64);
+    REQUIRE(particles.GetPositions(0)[0] == Approx(100.1));
+    REQUIRE(particles.GetPositions(0)[1] == Approx(210));
+    REQUIRE(container.GetObservableHistory().back().time == Approx(1));
+  }
+}
+
+TEST_CASE("Periodic boundaries", "[increment][periodic]") {
+  ParticleContainer container;
+  json config = {{"window",
+                  {{"width", 400},
+                   {"height", 300},
+                   {"margin", 100},
+                   {"stroke", 6},
+                   {"background color", "0x505050"},
+                   {"stroke color", "0x000000"},
+                   {"text color", "0xFFBFBF"},
+                   {"font", "IBM Plex Mono"}}},
+                 {"histogram", {{"bin count", 2}}},
+                 {"container",
+                  {{"particles", json::object()},
+                   {"boundaries", {{"x", "periodic"}}}}}};
+  container.ConfigureFromJson(config);
+  ParticleStore& particles = container.GetParticles();
+
+  SECTION("Particles leave one side and enter the other") {
+    container.InitializeParticle(Particle("Test", vec2(199, 50), vec2(3, 0), 1,
+                                          1, ColorT<float>().hex(0xFFFFFF)));
+    container.Increment();
+    REQUIRE(particles.GetPositions(0)[0] == Approx(2));
+    REQUIRE(particles.GetVelocities(0)[0] == Approx(3));
+  }
+
+  SECTION("Particles collide across the seam") {
+    container.InitializeParticle(Particle("Left", vec2(0.5, 50), vec2(-1, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Right", vec2(199, 50), vec2(1, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.Increment();
+    REQUIRE(particles.GetVelocities(0)[0] == Approx(1));
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(-1));
+  }
+
+  SECTION("Only the walls of the other axis feel pressure") {
+    container.InitializeParticle(Particle("Test", vec2(100, 99.5), vec2(0, 1),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.Increment();
+    // A momentum change of 2 spread over the top and bottom walls
+    REQUIRE(container.GetObservableHistory().back().pressure ==
+            Approx(2.0 / 400));
+  }
+
+  SECTION("The event-driven engine needs walls") {
+    REQUIRE_THROWS_AS(
+        container.SetSimulationMode(SimulationMode::kEventDriven),
+        std::invalid_argument);
+    config["container"]["engine"] = "event driven";
+    REQUIRE_THROWS_AS(container.ConfigureFromJson(config),
+                      std::invalid_argument);
+  }
+}
+
+TEST_CASE("Three dimensions", "[increment][3d]") {
+  ParticleContainer container;
+  json config = {{"window",
+                  {{"width", 400},
+                   {"height", 300},
+                   {"margin", 100},
+                   {"stroke", 6},
+                   {"background color", "0x505050"},
+                   {"stroke color", "0x000000"},
+                   {"text color", "0xFFBFBF"},
+                   {"font", "IBM Plex Mono"}}},
+                 {"histogram", {{"bin count", 2}}},
+                 {"container",
+                  {{"particles", json::object()},
+                   {"dimensions", 3},
+                   {"depth", 50}}}};
+  container.ConfigureFromJson(config);
+  ParticleStore& particles = container.GetParticles();
+  REQUIRE(container.GetDimensions() == 3);
+
+  SECTION("Particles collide along the z axis") {
+    container.InitializeParticle(Particle("Test", vec2(100, 50), vec2(0, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Test", vec2(100, 50), vec2(0, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    particles.GetPositions(2) = {20, 21.5f};
+    particles.GetVelocities(2) = {1, -1};
+    container.Increment();
+    REQUIRE(particles.GetVelocities(2)[0] == Approx(-1));
+    REQUIRE(particles.GetVelocities(2)[1] == Approx(1));
+    REQUIRE(particles.GetVelocities(0)[0] == Approx(0));
+  }
+
+  SECTION("The front and back walls reflect and feel pressure") {
+    container.InitializeParticle(Particle("Test", vec2(100, 50), vec2(0, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    particles.GetPositions(2) = {49.5f};
+    particles.GetVelocities(2) = {1};
+    container.Increment();
+    REQUIRE(particles.GetVelocities(2)[0] == Approx(-1));
+    REQUIRE(particles.GetPositions(2)[0] == Approx(48.5));
+    // A momentum change of 2 spread over the six walls of a 200 by 100 by
+    // 50 box
+    const Observables& observables = container.GetObservableHistory().back();
+    REQUIRE(observables.pressure == Approx(2.0 / 70000));
+    // The kinetic energy of 0.5 shared by three degrees of freedom
+    REQUIRE(observables.temperatures[0] == Approx(1.0 / 3));
+  }
+
+  SECTION("The grid finds the same pairs as brute force") {
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> position_dist(0, 50);
+    std::uniform_real_distribution<float> radius_dist(1, 6);
+    for (size_t index = 0; index < 400; ++index) {
+      container.InitializeParticle(
+          Particle("Test", vec2(position_dist(gen), position_dist(gen)),
+                   vec2(0, 0), 1, radius_dist(gen),
+                   ColorT<float>().hex(0xFFFFFF)));
+      particles.GetPositions(2)[index] = position_dist(gen);
+    }
+    container.SetBroadphaseMode(BroadphaseMode::kGrid);
+    vector<pair<size_t, size_t>> grid = container.FindOverlappingPairs();
+    container.SetBroadphaseMode(BroadphaseMode::kBruteForce);
+    vector<pair<size_t, size_t>> brute_force =
+        container.FindOverlappingPairs();
+    std::sort(grid.begin(), grid.end());
+    std::sort(brute_force.begin(), brute_force.end());
+    REQUIRE(!brute_force.empty());
+    REQUIRE(grid == brute_force);
+  }
+
+  SECTION("The event-driven engine stays two-dimensional") {
+    REQUIRE_THROWS_AS(
+        container.SetSimulationMode(SimulationMode::kEventDriven),
+        std::invalid_argument);
+  }
+}
+
+TEST_CASE("Precision", "[increment][precision]") {
+  ParticleContainer container;
+  // A container 4100 wide, where floats are 1/4096 apart near its right wall
+  json config = {{"window",
+                  {{"width", 5600},
+                   {"height", 300},
+                   {"margin", 100},
+                   {"stroke", 6},
+                   {"background color", "0x505050"},
+                   {"stroke color", "0x000000"},
+                   {"text color", "0xFFBFBF"},
+                   {"font", "IBM Plex Mono"}}},
+                 {"histogram", {{"bin count", 2}}},
+                 {"container", {{"particles", json::object()}}}};
+  container.ConfigureFromJson(config);
+  ParticleStore& particles = container.GetParticles();
+  container.InitializeParticle(Particle("Test", vec2(4000, 50),
+                                        vec2(0.0001f, 0), 1, 1,
+                                        ColorT<float>().hex(0xFFFFFF)));
+
+  SECTION("Single precision loses steps smaller than half a float apart") {
+    for (size_t step = 0; step < 100; ++step) {
+      container.Increment();
+    }
+    REQUIRE(particles.GetPositions(0)[0] == 4000);
+  }
+
+  SECTION("Mixed and double precision add up every step") {
+    auto mode = GENERATE(PrecisionMode::kMixed, PrecisionMode::kDouble);
+    container.SetPrecisionMode(mode);
+    for (size_t step = 0; step < 100; ++step) {
+      container.Increment();
+    }
+    REQUIRE(particles.GetPositions(0)[0] == Approx(4000.01).epsilon(1e-7));
+    REQUIRE(particles.GetVelocities(0)[0] == 0.0001f);
+
+    // A position written to the store is taken up by the next step
+    particles.GetPositions(0)[0] = 10;
+    container.Increment();
+    REQUIRE(particles.GetPositions(0)[0] == Approx(10.0001));
+  }
+
+  SECTION("Collisions match single precision at small coordinates") {
+    container.SetPrecisionMode(PrecisionMode::kDouble);
+    container.InitializeParticle(Particle("Test", vec2(20, 20), vec2(1, 0), 1,
+                                          1, ColorT<float>().hex(0xFFFFFF)));
+    container.InitializeParticle(Particle("Test", vec2(21.5, 20), vec2(-1, 0),
+                                          1, 1, ColorT<float>().hex(0xFFFFFF)));
+    container.Increment();
+    REQUIRE(particles.GetVelocities(0)[1] == Approx(-1));
+    REQUIRE(particles.GetVelocities(0)[2] == Approx(1));
+  }
+
+  SECTION("The event-driven engine stays in single precision") {
+    container.SetPrecisionMode(PrecisionMode::kMixed);
+    REQUIRE_THROWS_AS(
+        container.SetSimulationMode(SimulationMode::kEventDriven),
+        std::invalid_argument);
+    container.SetPrecisionMode(PrecisionMode::kSingle);
+    container.SetSimulationMode(SimulationMode::kEventDriven);
+    REQUIRE_THROWS_AS(container.SetPrecisionMode(PrecisionMode::kDouble),
+                      std::invalid_argument);
+  }
+}
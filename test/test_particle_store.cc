@@ -0,0 +1,109 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+#include "core/color.h"
+#include "core/particle.h"
+#include "core/particle_store.h"
+
+using idealgas::ColorT;
+using idealgas::Particle;
+using idealgas::ParticleStore;
+using idealgas::ParticleView;
+using idealgas::SpeciesId;
+using std::string;
+using std::vector;
+
+TEST_CASE("Particle store", "[store]") {
+  SECTION("Species are interned once by name") {
+    ParticleStore store;
+    SpeciesId first = store.InternSpecies("A", ColorT<float>().hex(0xFF0000));
+    SpeciesId second = store.InternSpecies("B", ColorT<float>().hex(0x00FF00));
+    SpeciesId repeat = store.InternSpecies("A", ColorT<float>().hex(0x0000FF));
+
+    REQUIRE(first == 0);
+    REQUIRE(second == 1);
+    REQUIRE(repeat == first);
+    REQUIRE(store.GetSpeciesNames() == vector<string>{"A", "B"});
+    REQUIRE(store.GetSpeciesColor(first) == ColorT<float>().hex(0xFF0000));
+  }
+
+  SECTION("Views write through to the arrays") {
+    ParticleStore store;
+    store.Add(Particle("A", vec2(1, 2), vec2(3, 4), 5, 6,
+                       ColorT<float>().hex(0xFFFFFF)));
+
+    for (ParticleView particle : store) {
+      particle.SetPosition(vec2(7, 8));
+      particle.SetRadius(9);
+    }
+
+    REQUIRE(store.GetPositions(0)[0] == 7);
+    REQUIRE(store.GetPositions(1)[0] == 8);
+    REQUIRE(store.GetRadii()[0] == 9);
+    REQUIRE(store[0].GetVelocity() == vec2(3, 4));
+    REQUIRE(store[0].GetMass() == 5);
+  }
+
+  SECTION("Clearing keeps the species table") {
+    ParticleStore store;
+    store.Add(Particle("A", vec2(0, 0), vec2(0, 0), 1, 1,
+                       ColorT<float>().hex(0xFFFFFF)));
+    store.Clear();
+
+    REQUIRE(store.empty());
+    REQUIRE(store.GetSpeciesNames() == vector<string>{"A"});
+  }
+
+  SECTION("Renaming moves a particle to another species") {
+    ParticleStore store;
+    store.Add(Particle("A", vec2(0, 0), vec2(0, 0), 1, 1,
+                       ColorT<float>().hex(0xFFFFFF)));
+    store[0].SetName("B");
+
+    REQUIRE(store[0].GetName() == "B");
+    REQUIRE(store.GetSpecies()[0] == 1);
+    Particle copy = store[0];
+    REQUIRE(copy.GetName() == "B");
+  }
+
+  SECTION("Each species keeps one contiguous range") {
+    ParticleStore store;
+    SpeciesId a = store.InternSpecies("A", ColorT<float>().hex(0xFFFFFF));
+    SpeciesId b = store.InternSpecies("B", ColorT<float>().hex(0xFFFFFF));
+    store.Add(b, vec2(1, 0), vec2(0, 0), 1, 1);
+    store.Add(a, vec2(2, 0), vec2(0, 0), 1, 1);
+    store.Append(b, 2);
+    store.Add(a, vec2(3, 0), vec2(0, 0), 1, 1);
+
+    REQUIRE(store.GetSpecies() == vector<SpeciesId>{a, a, b, b, b});
+    REQUIRE(store.GetSpeciesRange(a) == std::make_pair<size_t, size_t>(0, 2));
+    REQUIRE(store.GetSpeciesRange(b) == std::make_pair<size_t, size_t>(2, 5));
+    REQUIRE(store.GetPositions(0) == vector<float>{2, 3, 1, 0, 0});
+  }
+
+  SECTION("Grouping restores the ranges after writing species directly") {
+    ParticleStore store;
+    store.InternSpecies("A", ColorT<float>().hex(0xFFFFFF));
+    store.InternSpecies("B", ColorT<float>().hex(0xFFFFFF));
+    store.Append(0, 4);
+    store.GetSpecies() = {1, 0, 1, 0};
+    store.GetMasses() = {1, 2, 3, 4};
+    store.GroupBySpecies();
+
+    REQUIRE(store.GetSpecies() == vector<SpeciesId>{0, 0, 1, 1});
+    REQUIRE(store.GetMasses() == vector<float>{2, 4, 1, 3});
+    REQUIRE(store.GetSpeciesRange(1) == std::make_pair<size_t, size_t>(2, 4));
+  }
+
+  SECTION("Species start visible and enabled") {
+    ParticleStore store;
+    SpeciesId species = store.InternSpecies("A", ColorT<float>());
+    REQUIRE(store.IsSpeciesVisible(species));
+    REQUIRE(store.IsSpeciesEnabled(species));
+
+    store.SetSpeciesVisible(species, false);
+    REQUIRE_FALSE(store.IsSpeciesVisible(species));
+    REQUIRE(store.IsSpeciesEnabled(species));
+  }
+}
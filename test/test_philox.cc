@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <vector>
+
+#include "core/color.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/philox.h"
+
+using idealgas::ColorT;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::Philox;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief Initializes two species of particles with a seed and thread count.
+ *
+ * @param seed the seed of the initial states
+ * @param threads the number of threads to initialize with
+ * @return the ParticleStore of the particles
+ */
+ParticleStore InitializeStore(uint64_t seed, size_t threads) {
+  ParticleContainer container;
+  container.SetSeed(seed);
+  container.SetThreadCount(threads);
+  container.InitializeParticles("Slow", 5000, 1, 2, 5, 10, 1, 3,
+                                ColorT<float>(1, 1, 1));
+  container.InitializeParticles("Fast", 20000, 3, 6, 1, 2, 1, 2,
+                                ColorT<float>(1, 0, 0));
+  return container.GetParticles();
+}
+
+/**
+ * @brief Checks that two float arrays hold exactly the same bits.
+ *
+ * @param lhs the first array
+ * @param rhs the second array
+ * @return true when every bit matches
+ */
+bool BitEqual(const vector<float>& lhs, const vector<float>& rhs) {
+  return lhs.size() == rhs.size() &&
+         std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(float)) == 0;
+}
+
+}  // namespace
+
+TEST_CASE("Philox generator", "[random]") {
+  SECTION("Matches the Random123 known-answer vectors") {
+    REQUIRE(Philox::Generate({0, 0, 0, 0}, {0, 0}) ==
+            Philox::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    REQUIRE(Philox::Generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                             {0xffffffff, 0xffffffff}) ==
+            Philox::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+    REQUIRE(Philox::Generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                             {0xa4093822, 0x299f31d0}) ==
+            Philox::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+  }
+
+  SECTION("Floats stay in [0, 1)") {
+    Philox random(7, 0, 0);
+    for (size_t draw = 0; draw < 1000; ++draw) {
+      float value = random.NextFloat();
+      REQUIRE(value >= 0);
+      REQUIRE(value < 1);
+    }
+  }
+}
+
+TEST_CASE("Seeded initialization", "[random]") {
+  ParticleStore serial = InitializeStore(42, 1);
+
+  SECTION("Every thread count gives bit-identical particles") {
+    ParticleStore parallel = InitializeStore(42, 4);
+    for (size_t axis = 0; axis < serial.GetDimensions(); ++axis) {
+      REQUIRE(BitEqual(parallel.GetPositions(axis), serial.GetPositions(axis)));
+      REQUIRE(BitEqual(parallel.GetVelocities(axis),
+                       serial.GetVelocities(axis)));
+    }
+    REQUIRE(BitEqual(parallel.GetMasses(), serial.GetMasses()));
+    REQUIRE(BitEqual(parallel.GetRadii(), serial.GetRadii()));
+    REQUIRE(parallel.GetSpecies() == serial.GetSpecies());
+  }
+
+  SECTION("Different seeds give different particles") {
+    ParticleStore other = InitializeStore(43, 1);
+    REQUIRE_FALSE(BitEqual(other.GetPositions(0), serial.GetPositions(0)));
+  }
+
+  SECTION("Values stay within their ranges") {
+    for (size_t index = 0; index < 5000; ++index) {
+      REQUIRE(serial.GetMasses()[index] >= 5);
+      REQUIRE(serial.GetMasses()[index] < 10);
+      REQUIRE(serial.GetVelocities(0)[index] >= 1);
+      REQUIRE(serial.GetVelocities(0)[index] < 2);
+    }
+  }
+}
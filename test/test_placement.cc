@@ -0,0 +1,129 @@
+#include <catch2/catch.hpp>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/config.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/placement.h"
+#include "core/thread_pool.h"
+
+using idealgas::ColorT;
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::PlaceWithoutOverlaps;
+using idealgas::SpeciesId;
+using idealgas::ThreadPool;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief Counts the pairs of particles that touch, and the particles that
+ * reach past a wall.
+ *
+ * @param particles the particles to check
+ * @param width the width of the container
+ * @param height the height of the container
+ * @return the size_t number of overlaps
+ */
+size_t CountOverlaps(const ParticleStore& particles, float width,
+                     float height) {
+  const vector<float>& x = particles.GetPositions(0);
+  const vector<float>& y = particles.GetPositions(1);
+  const vector<float>& radii = particles.GetRadii();
+  size_t overlaps = 0;
+  for (size_t base = 0; base < particles.size(); ++base) {
+    if (x[base] < radii[base] || x[base] > width - radii[base] ||
+        y[base] < radii[base] || y[base] > height - radii[base]) {
+      ++overlaps;
+    }
+    for (size_t neighbor = base + 1; neighbor < particles.size(); ++neighbor) {
+      float dx = x[base] - x[neighbor];
+      float dy = y[base] - y[neighbor];
+      float cutoff = radii[base] + radii[neighbor];
+      if (dx * dx + dy * dy <= cutoff * cutoff) {
+        ++overlaps;
+      }
+    }
+  }
+  return overlaps;
+}
+
+/**
+ * @brief Adds particles of one radius at the origin, to be placed.
+ *
+ * @param particles the store to add them to
+ * @param name the name of their species
+ * @param count the number of particles
+ * @param radius their radius
+ * @return the index range of the new particles
+ */
+pair<size_t, size_t> AddParticles(ParticleStore& particles, const string& name,
+                                  size_t count, float radius) {
+  SpeciesId species = particles.InternSpecies(name, ColorT<float>(1, 1, 1));
+  for (size_t index = 0; index < count; ++index) {
+    particles.Add(species, vec2(0, 0), vec2(1, 0), 1, radius);
+  }
+  return particles.GetSpeciesRange(species);
+}
+
+}  // namespace
+
+TEST_CASE("Lattice placement", "[placement]") {
+  ThreadPool thread_pool(1);
+
+  SECTION("Mixed radii are placed without overlaps") {
+    ParticleStore particles;
+    vector<pair<size_t, size_t>> ranges = {
+        AddParticles(particles, "Large", 40, 8),
+        AddParticles(particles, "Small", 600, 1.5f)};
+    PlaceWithoutOverlaps(particles, ranges, {200, 150, 0}, 3, thread_pool);
+    REQUIRE(CountOverlaps(particles, 200, 150) == 0);
+
+    ParticleStore parallel = particles;
+    ThreadPool parallel_pool(4);
+    PlaceWithoutOverlaps(parallel, ranges, {200, 150, 0}, 3, parallel_pool);
+    REQUIRE(parallel.GetPositions(0) == particles.GetPositions(0));
+    REQUIRE(parallel.GetPositions(1) == particles.GetPositions(1));
+  }
+
+  SECTION("Particles left in place are avoided") {
+    ParticleStore particles;
+    SpeciesId wall = particles.InternSpecies("Wall", ColorT<float>(1, 1, 1));
+    particles.Add(wall, vec2(50, 50), vec2(0, 0), 100, 30);
+    pair<size_t, size_t> range = AddParticles(particles, "Gas", 200, 2);
+    PlaceWithoutOverlaps(particles, {range}, {100, 100, 0}, 5, thread_pool);
+    REQUIRE(particles.GetPosition(0) == vec2(50, 50));
+    REQUIRE(CountOverlaps(particles, 100, 100) == 0);
+  }
+
+  SECTION("Packings the lattice cannot reach fail before moving anything") {
+    ParticleStore particles;
+    pair<size_t, size_t> range = AddParticles(particles, "Dense", 120, 5);
+    REQUIRE_THROWS_AS(
+        PlaceWithoutOverlaps(particles, {range}, {100, 100, 0}, 5, thread_pool),
+        std::invalid_argument);
+    REQUIRE(particles.GetPosition(0) == vec2(0, 0));
+  }
+
+  SECTION("Configured particles start apart") {
+    std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+    json config;
+    input >> config;
+    config["container"]["placement"] = "lattice";
+    config["container"]["particles"]["Solitary Particle"]["particle count"] =
+        400;
+    config["container"]["particles"]["Solitary Particle"]["max radius"] = 3;
+    config["container"]["seed"] = 8;
+    ParticleContainer container;
+    container.ConfigureFromJson(config);
+    REQUIRE(container.GetParticles().size() == 400);
+    REQUIRE(container.FindOverlappingPairs().empty());
+  }
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "core/color.h"
+#include "core/config.h"
+#include "core/particle_container.h"
+#include "core/simulation_thread.h"
+#include "core/triple_buffer.h"
+
+using idealgas::ColorT;
+using idealgas::ParticleContainer;
+using idealgas::SimulationSnapshot;
+using idealgas::SimulationThread;
+using idealgas::TripleBuffer;
+using std::vector;
+
+TEST_CASE("Triple buffer", "[simulation thread]") {
+  TripleBuffer<vector<uint64_t>> buffer;
+
+  SECTION("Acquires the latest published value") {
+    buffer.GetWriteBuffer() = {1};
+    buffer.Publish();
+    buffer.GetWriteBuffer() = {2};
+    buffer.Publish();
+    REQUIRE(buffer.Acquire() == vector<uint64_t>{2});
+  }
+
+  SECTION("Keeps the held value until a newer one is published") {
+    buffer.GetWriteBuffer() = {1};
+    buffer.Publish();
+    REQUIRE(buffer.Acquire() == vector<uint64_t>{1});
+    REQUIRE(buffer.Acquire() == vector<uint64_t>{1});
+    buffer.GetWriteBuffer() = {3};
+    buffer.Publish();
+    REQUIRE(buffer.Acquire() == vector<uint64_t>{3});
+  }
+
+  SECTION("Hands over whole values in order across threads") {
+    const uint64_t kValues = 200000;
+    std::thread producer([&] {
+      for (uint64_t value = 1; value <= kValues; ++value) {
+        // Every element matches, so a torn value would show
+        buffer.GetWriteBuffer().assign(16, value);
+        buffer.Publish();
+      }
+    });
+
+    uint64_t last = 0;
+    bool whole = true;
+    bool ordered = true;
+    while (last < kValues) {
+      const vector<uint64_t>& value = buffer.Acquire();
+      if (value.empty()) {
+        continue;
+      }
+      for (uint64_t element : value) {
+        whole = whole && element == value[0];
+      }
+      ordered = ordered && value[0] >= last;
+      last = value[0];
+    }
+    producer.join();
+    REQUIRE(whole);
+    REQUIRE(ordered);
+  }
+}
+
+TEST_CASE("Simulation thread", "[simulation thread]") {
+  ParticleContainer container;
+  container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  container.SetSeed(3);
+  container.InitializeParticles("Extra", 50, 1, 3, 1, 2, 1, 4,
+                                ColorT<float>(0, 1, 0));
+  size_t particle_count = container.GetParticles().size();
+  SimulationThread simulation(container, 5, 0, 0);
+
+  SECTION("Publishes a snapshot before the first step") {
+    simulation.Start();
+    const SimulationSnapshot& snapshot = simulation.AcquireSnapshot();
+    REQUIRE(snapshot.radii.size() == particle_count);
+    REQUIRE(snapshot.positions[0].size() == particle_count);
+    REQUIRE(snapshot.colors.size() == particle_count);
+  }
+
+  SECTION("Steps on its own and fills each species' histogram") {
+    simulation.Start();
+    uint64_t step = 0;
+    while (step < 10) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      step = simulation.AcquireSnapshot().step;
+    }
+    const SimulationSnapshot& snapshot = simulation.AcquireSnapshot();
+    REQUIRE(snapshot.histograms.size() ==
+            container.GetParticleNames().size());
+    REQUIRE(snapshot.histograms.back().title == "Extra");
+    REQUIRE(snapshot.histograms.back().bin_heights.size() == 5);
+    simulation.Stop();
+    REQUIRE(container.GetSimulatedTime() > 0);
+  }
+
+  SECTION("Runs posted commands between steps") {
+    simulation.Start();
+    simulation.Post([](ParticleContainer& stepped) {
+      stepped.SetTimeStep(0.25);
+    });
+    simulation.Stop();
+    REQUIRE(container.GetTimeStep() == 0.25);
+  }
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+#include <random>
+#include <string>
+
+#include "core/color.h"
+#include "core/config.h"
+#include "core/image_writer.h"
+#include "core/particle_store.h"
+#include "core/software_renderer.h"
+
+using idealgas::ColorT;
+using idealgas::Image;
+using idealgas::ParticleStore;
+using idealgas::SimulationConfig;
+using idealgas::SoftwareRenderer;
+using idealgas::SpeciesId;
+using std::string;
+
+namespace {
+
+/**
+ * @brief Builds the configuration of a small window, as
+ * ParticleContainer::Configure returns it.
+ *
+ * @return the SimulationConfig
+ */
+SimulationConfig MakeConfig() {
+  SimulationConfig config;
+  config.window_width = 400;
+  config.window_height = 300;
+  config.margin = 20;
+  config.stroke = 4;
+  config.container_width = 280;
+  config.container_height = 260;
+  config.background_color = 0x000000;
+  config.stroke_color = 0x0000FF;
+  config.text_color = 0x00FF00;
+  config.histogram_bin_count = 5;
+  config.histogram_window_steps = 0;
+  return config;
+}
+
+/**
+ * @brief Reads the color of a pixel as a 0xRRGGBB number.
+ *
+ * @param image the image to read
+ * @param x the column of the pixel
+ * @param y the row of the pixel
+ * @return the uint32_t color
+ */
+uint32_t PixelAt(const Image& image, size_t x, size_t y) {
+  const uint8_t* pixel = &image.pixels[(y * image.width + x) * 3];
+  return (uint32_t)pixel[0] << 16 | (uint32_t)pixel[1] << 8 | pixel[2];
+}
+
+}  // namespace
+
+TEST_CASE("Software renderer", "[renderer]") {
+  ParticleStore particles;
+  SpeciesId species = particles.InternSpecies("Red", ColorT<float>(1, 0, 0));
+
+  SECTION("Draws the container, particles and histograms") {
+    particles.Add(species, vec2(100, 100), vec2(1, 0), 1, 10);
+    SoftwareRenderer renderer(MakeConfig());
+    renderer.UpdateHistograms(particles);
+    renderer.Render(particles);
+    const Image& image = renderer.GetImage();
+
+    REQUIRE(image.width == 400);
+    REQUIRE(image.height == 300);
+    // The particle, offset by the margin
+    REQUIRE(PixelAt(image, 120, 120) == 0xFF0000);
+    REQUIRE(PixelAt(image, 120 + 9, 120) == 0xFF0000);
+    REQUIRE(PixelAt(image, 120 + 11, 120) == 0x000000);
+    // The container frame, centered on its edges
+    REQUIRE(PixelAt(image, 20, 150) == 0x0000FF);
+    REQUIRE(PixelAt(image, 150, 281) == 0x0000FF);
+    // The frame of the histogram beside the container
+    REQUIRE(PixelAt(image, 320, 150) == 0x0000FF);
+    // One speed fills every bin, so the bars reach the top of the graph
+    REQUIRE(PixelAt(image, 340, 150) == 0x00FF00);
+  }
+
+  SECTION("Every thread count draws the same image") {
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> position_dist(-20, 300);
+    std::uniform_real_distribution<float> radius_dist(0, 30);
+    for (size_t index = 0; index < 2000; ++index) {
+      particles.Add(species, vec2(position_dist(gen), position_dist(gen)),
+                    vec2(1, 1), 1, radius_dist(gen));
+      particles.GetColors().back() = ColorT<float>(index % 2, 0.5, 0.25);
+    }
+
+    SoftwareRenderer serial(MakeConfig(), 1);
+    SoftwareRenderer parallel(MakeConfig(), 3);
+    serial.Render(particles);
+    parallel.Render(particles);
+    REQUIRE(serial.GetImage().pixels == parallel.GetImage().pixels);
+  }
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/sweep.h"
+
+using idealgas::Sweep;
+using idealgas::SweepResult;
+using std::string;
+using std::vector;
+
+TEST_CASE("Sweep", "[sweep]") {
+  std::ifstream input(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  json config;
+  input >> config;
+  config["container"]["seed"] = 4;
+  const string count = "/container/particles/Solitary Particle/particle count";
+
+  SECTION("Products and points expand into every combination") {
+    json spec = {
+        {"product",
+         {{{"path", count}, {"values", {10, 20, 30}}},
+          {{"path", "container.particles.Solitary Particle.max radius"},
+           {"values", {1, 2}}}}},
+        {"points", {{{"container.seed", 1}}, {{"container.seed", 2}}}}};
+    Sweep sweep(config, spec);
+    REQUIRE(sweep.GetJobCount() == 12);
+    REQUIRE(sweep.GetColumns() ==
+            vector<string>{count,
+                           "/container/particles/Solitary Particle/max radius",
+                           "/container/seed"});
+
+    json job = sweep.GetJobConfig(7);
+    REQUIRE(job["container"]["seed"] == 2);
+    REQUIRE(job[json::json_pointer(count)] == 10);
+    REQUIRE(job["container"]["particles"]["Solitary Particle"]["max radius"] ==
+            2);
+    REQUIRE(job["container"]["threads"] == 1);
+  }
+
+  SECTION("Malformed specifications are rejected") {
+    REQUIRE_THROWS_AS(Sweep(config, {{"product", {{{"path", count}}}}}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(Sweep(config, {{"points", {1}}}), std::invalid_argument);
+  }
+
+  SECTION("Jobs reuse containers without carrying state between them") {
+    json spec = {{"steps", 20},
+                 {"product", {{{"path", count}, {"values", {40, 5, 40}}}}}};
+    Sweep sweep(config, spec);
+    vector<SweepResult> serial = sweep.Run(1);
+    vector<SweepResult> parallel = sweep.Run(2);
+
+    REQUIRE(serial[0].particle_count == 40);
+    REQUIRE(serial[1].particle_count == 5);
+    REQUIRE(serial[0].kinetic_energy > 0);
+    REQUIRE(serial[0].kinetic_energy == serial[2].kinetic_energy);
+    for (size_t job = 0; job < 3; ++job) {
+      REQUIRE(parallel[job].kinetic_energy == serial[job].kinetic_energy);
+      REQUIRE(parallel[job].pressure == serial[job].pressure);
+    }
+  }
+
+  SECTION("Temperature follows the number of dimensions") {
+    json spec = {{"steps", 5},
+                 {"product",
+                  {{{"path", count}, {"values", {40}}},
+                   {{"path", "container.dimensions"}, {"values", {2, 3}}}}}};
+    Sweep sweep(config, spec);
+    vector<SweepResult> results = sweep.Run(1);
+    REQUIRE(results[0].error.empty());
+    REQUIRE(results[1].error.empty());
+    REQUIRE(results[0].temperature ==
+            Approx(results[0].kinetic_energy / 40));
+    REQUIRE(results[1].temperature ==
+            Approx(results[1].kinetic_energy / (40 * 1.5)));
+  }
+
+  SECTION("Rejected jobs are reported in the table") {
+    json spec = {
+        {"steps", 2},
+        {"points",
+         {{{"container.particles.Solitary Particle.max radius", 1000}}}}};
+    Sweep sweep(config, spec);
+    vector<SweepResult> results = sweep.Run(1);
+    REQUIRE_FALSE(results[0].error.empty());
+
+    std::ostringstream table;
+    sweep.WriteTable(table, results);
+    string header = table.str().substr(0, table.str().find('\n'));
+    REQUIRE(header ==
+            "job,/container/particles/Solitary Particle/max radius,particles,"
+            "steps,seed,seconds,particle steps per second,kinetic energy,"
+            "temperature,pressure,error");
+  }
+}
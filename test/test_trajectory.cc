@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/config.h"
+#include "core/particle_container.h"
+#include "core/particle_store.h"
+#include "core/trajectory.h"
+
+using idealgas::ParticleContainer;
+using idealgas::ParticleStore;
+using idealgas::TrajectoryFrame;
+using idealgas::TrajectoryOptions;
+using idealgas::TrajectoryReader;
+using idealgas::TrajectoryWriter;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The trajectory written by the tests, removed after each one
+const string kTrajectoryPath = "test_trajectory.bin";
+
+/**
+ * @brief Checks that a frame matches the particles it was taken from, to
+ * within half of each quantum.
+ *
+ * @param frame the frame read back
+ * @param particles the particles when the frame was taken
+ * @param options the options the frame was written with
+ * @return true when every value matches
+ */
+bool FrameMatches(const TrajectoryFrame& frame, const ParticleStore& particles,
+                  const TrajectoryOptions& options) {
+  // Allows for the rounding of the floats themselves
+  const float kSlack = 1e-4;
+  for (size_t axis = 0; axis < particles.GetDimensions(); ++axis) {
+    if (frame.positions[axis].size() != particles.size()) {
+      return false;
+    }
+    for (size_t index = 0; index < particles.size(); ++index) {
+      if (std::abs(frame.positions[axis][index] -
+                   particles.GetPositions(axis)[index]) >
+              options.position_quantum / 2 + kSlack ||
+          std::abs(frame.velocities[axis][index] -
+                   particles.GetVelocities(axis)[index]) >
+              options.velocity_quantum / 2 + kSlack) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST_CASE("Trajectories", "[trajectory]") {
+  TrajectoryOptions options;
+  options.stride = 2;
+  options.keyframe_interval = 4;
+
+  ParticleContainer container;
+  container.Configure(IDEALGAS_CONFIG_DIR "/test/config_test.json");
+  auto writer = std::make_shared<TrajectoryWriter>(kTrajectoryPath, options);
+  container.SetTrajectoryWriter(writer);
+
+  // Keep the particles of every step on the stride to compare against
+  vector<ParticleStore> expected;
+  for (size_t step = 0; step < 30; ++step) {
+    container.Increment();
+    if (step % options.stride == 0) {
+      expected.push_back(container.GetParticles());
+    }
+  }
+  writer->Close();
+  REQUIRE(writer->GetFrameCount() == expected.size());
+
+  SECTION("Frames read back in any order") {
+    TrajectoryReader reader(kTrajectoryPath);
+    REQUIRE(reader.GetFrameCount() == expected.size());
+    TrajectoryFrame frame;
+    for (size_t frame_number : {7, 3, 14, 0, 1, 2, 11, 14}) {
+      reader.ReadFrame(frame_number, frame);
+      REQUIRE(frame.step == frame_number * options.stride);
+      REQUIRE(FrameMatches(frame, expected[frame_number], options));
+    }
+    REQUIRE_THROWS_AS(reader.ReadFrame(expected.size(), frame),
+                      std::out_of_range);
+  }
+
+  SECTION("Frames are found without the index") {
+    // Drop the end of the index, as if the writer had crashed
+    std::ifstream input(kTrajectoryPath, std::ios::binary);
+    string bytes((std::istreambuf_iterator<char>(input)),
+                 std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream(kTrajectoryPath, std::ios::binary)
+        .write(bytes.data(), bytes.size() - 1);
+
+    TrajectoryReader reader(kTrajectoryPath);
+    REQUIRE(reader.GetFrameCount() == expected.size());
+    TrajectoryFrame frame;
+    reader.ReadFrame(9, frame);
+    REQUIRE(FrameMatches(frame, expected[9], options));
+  }
+
+  container.SetTrajectoryWriter(nullptr);
+  std::remove(kTrajectoryPath.c_str());
+}
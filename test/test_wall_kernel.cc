@@ -0,0 +1,210 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "core/wall_kernel.h"
+
+using idealgas::BoundaryMode;
+using idealgas::GetSupportedSimdLevel;
+using idealgas::ReflectAndIntegrate;
+using idealgas::SimdLevel;
+using std::vector;
+
+namespace {
+
+/**
+ * @brief The arrays of one wall kernel run.
+ *
+ */
+struct KernelState {
+  vector<float> x;
+  vector<float> y;
+  vector<float> velocity_x;
+  vector<float> velocity_y;
+  vector<float> radii;
+  vector<uint8_t> wall_hits;
+};
+
+/**
+ * @brief Creates particles spread over and just past a 100 by 80 container,
+ * including ones exactly on a wall, at rest, and with negative zero velocity.
+ *
+ * @param count the number of particles
+ * @return the KernelState of the particles
+ */
+KernelState MakeState(size_t count) {
+  std::mt19937 gen(count);
+  std::uniform_real_distribution<float> position_dist(-5, 105);
+  std::uniform_real_distribution<float> velocity_dist(-3, 3);
+  std::uniform_real_distribution<float> radius_dist(0, 6);
+
+  KernelState state;
+  for (size_t index = 0; index < count; ++index) {
+    state.x.push_back(position_dist(gen));
+    state.y.push_back(position_dist(gen));
+    state.velocity_x.push_back(velocity_dist(gen));
+    state.velocity_y.push_back(velocity_dist(gen));
+    state.radii.push_back(radius_dist(gen));
+
+    switch (index % 5) {
+      case 1:
+        state.x.back() = state.radii.back();
+        break;
+      case 2:
+        state.y.back() = 80 - state.radii.back();
+        break;
+      case 3:
+        state.velocity_x.back() = -0.0f;
+        break;
+      case 4:
+        state.velocity_y.back() = 0;
+        break;
+    }
+  }
+  state.wall_hits.assign(count, 2);
+  return state;
+}
+
+/**
+ * @brief Runs the wall kernel over a state for a few steps.
+ *
+ * @param level the SimdLevel to run with
+ * @param state the KernelState to update
+ * @param boundaries the BoundaryMode of each axis
+ */
+void RunKernel(SimdLevel level, KernelState& state,
+               const array<BoundaryMode, 2>& boundaries = {}) {
+  for (size_t step = 0; step < 3; ++step) {
+    ReflectAndIntegrate(level, state.x.data(), state.y.data(),
+                        state.velocity_x.data(), state.velocity_y.data(),
+                        state.radii.data(), state.x.size(), 100, 80, 1.5f,
+                        state.wall_hits.data(), boundaries);
+  }
+}
+
+/**
+ * @brief Checks that two float arrays hold exactly the same bits.
+ *
+ * @param lhs the first array
+ * @param rhs the second array
+ * @return true when every bit matches
+ */
+bool BitEqual(const vector<float>& lhs, const vector<float>& rhs) {
+  return lhs.size() == rhs.size() &&
+         std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(float)) == 0;
+}
+
+}  // namespace
+
+TEST_CASE("Wall kernel", "[walls][simd]") {
+  SECTION("Every supported level matches the scalar path bit for bit") {
+    vector<SimdLevel> levels;
+    for (SimdLevel level : {SimdLevel::kSse2, SimdLevel::kAvx2}) {
+      if (level <= GetSupportedSimdLevel()) {
+        levels.push_back(level);
+      }
+    }
+
+    // Sizes around the vector widths exercise the scalar remainder
+    for (size_t count : {0, 1, 3, 4, 7, 8, 9, 15, 17, 1000}) {
+      KernelState expected = MakeState(count);
+      RunKernel(SimdLevel::kScalar, expected);
+
+      for (SimdLevel level : levels) {
+        KernelState actual = MakeState(count);
+        RunKernel(level, actual);
+
+        REQUIRE(BitEqual(actual.x, expected.x));
+        REQUIRE(BitEqual(actual.y, expected.y));
+        REQUIRE(BitEqual(actual.velocity_x, expected.velocity_x));
+        REQUIRE(BitEqual(actual.velocity_y, expected.velocity_y));
+        REQUIRE(actual.wall_hits == expected.wall_hits);
+      }
+    }
+  }
+
+  SECTION("Periodic axes wrap at every level, bit for bit") {
+    const array<BoundaryMode, 2> boundaries = {BoundaryMode::kPeriodic,
+                                               BoundaryMode::kReflecting};
+    KernelState expected = MakeState(1000);
+    RunKernel(SimdLevel::kScalar, expected, boundaries);
+    for (size_t index = 0; index < expected.x.size(); ++index) {
+      REQUIRE(expected.x[index] >= 0);
+      REQUIRE(expected.x[index] < 100);
+      REQUIRE((expected.wall_hits[index] & idealgas::kWallHitX) == 0);
+    }
+
+    for (SimdLevel level : {SimdLevel::kSse2, SimdLevel::kAvx2}) {
+      if (level > GetSupportedSimdLevel()) {
+        continue;
+      }
+      KernelState actual = MakeState(1000);
+      RunKernel(level, actual, boundaries);
+      REQUIRE(BitEqual(actual.x, expected.x));
+      REQUIRE(BitEqual(actual.y, expected.y));
+      REQUIRE(BitEqual(actual.velocity_x, expected.velocity_x));
+      REQUIRE(BitEqual(actual.velocity_y, expected.velocity_y));
+      REQUIRE(actual.wall_hits == expected.wall_hits);
+    }
+  }
+
+  SECTION("Three axes match the scalar path and mark the z walls") {
+    // The z axis takes the x arrays of a state with one more particle, so
+    // that they differ from the x axis, in a container 100 deep
+    KernelState expected = MakeState(1000);
+    KernelState expected_z = MakeState(1001);
+    auto run = [](SimdLevel level, KernelState& state, KernelState& depth) {
+      for (size_t step = 0; step < 3; ++step) {
+        ReflectAndIntegrate(
+            level, 3, {state.x.data(), state.y.data(), depth.x.data()},
+            {state.velocity_x.data(), state.velocity_y.data(),
+             depth.velocity_x.data()},
+            state.radii.data(), state.x.size(), {100, 80, 100}, 1.5f,
+            state.wall_hits.data());
+      }
+    };
+    run(SimdLevel::kScalar, expected, expected_z);
+    bool any_z_hit = false;
+    for (uint8_t hits : expected.wall_hits) {
+      any_z_hit = any_z_hit || (hits & idealgas::kWallHitZ) != 0;
+    }
+    REQUIRE(any_z_hit);
+
+    for (SimdLevel level : {SimdLevel::kSse2, SimdLevel::kAvx2}) {
+      if (level > GetSupportedSimdLevel()) {
+        continue;
+      }
+      KernelState actual = MakeState(1000);
+      KernelState actual_z = MakeState(1001);
+      run(level, actual, actual_z);
+      REQUIRE(BitEqual(actual.x, expected.x));
+      REQUIRE(BitEqual(actual.y, expected.y));
+      REQUIRE(BitEqual(actual_z.x, expected_z.x));
+      REQUIRE(BitEqual(actual.velocity_x, expected.velocity_x));
+      REQUIRE(BitEqual(actual.velocity_y, expected.velocity_y));
+      REQUIRE(BitEqual(actual_z.velocity_x, expected_z.velocity_x));
+      REQUIRE(actual.wall_hits == expected.wall_hits);
+    }
+  }
+
+  SECTION("Hit mask marks only reflected particles, by axis") {
+    vector<float> x = {1, 50, 99, 50};
+    vector<float> y = {40, 1, 40, 40};
+    vector<float> velocity_x = {-1, 0, 1, 1};
+    vector<float> velocity_y = {0, -1, 0, 0};
+    vector<float> radii = {1, 1, 1, 1};
+    vector<uint8_t> wall_hits(4);
+
+    ReflectAndIntegrate(GetSupportedSimdLevel(), x.data(), y.data(),
+                        velocity_x.data(), velocity_y.data(), radii.data(), 4,
+                        100, 80, 1, wall_hits.data());
+
+    REQUIRE(wall_hits == vector<uint8_t>{1, 2, 1, 0});
+    REQUIRE(velocity_x == vector<float>{1, 0, -1, 1});
+    REQUIRE(velocity_y == vector<float>{0, 1, 0, 0});
+    REQUIRE(x == vector<float>{2, 50, 98, 51});
+  }
+}